@@ -0,0 +1,566 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Reed-Solomon encoding and error detection for many codewords at once.
+
+   Codewords are processed in SIMD lanes: lane l of a vector holds a symbol
+   of codeword i + l, so each row of symbols is loaded with a single load.
+   Multiplication by a constant c in GF(2^8) is done with two 16-entry table
+   lookups, c * x = c * (x & 0x0f) ^ c * (x & 0xf0), which map directly to
+   the byte shuffle instructions of SSSE3, AVX2 and NEON. */
+
+#include <string.h>
+
+#include <vector>
+
+#if defined(__i386__) || defined(__x86_64__)
+#include <immintrin.h>
+#define HAVE_RS_X86 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define HAVE_RS_NEON 1
+#endif
+
+#include "fec_private.h"
+
+/* field generator polynomial, see FEC_PARAMS */
+#define GF_POLY 0x11d
+
+typedef size_t (*rs_encode_func)(const fec_rs *rs, const uint8_t *const *rows,
+        size_t count, uint8_t *parity);
+typedef size_t (*rs_check_func)(const fec_rs *rs, const uint8_t *const *rows,
+        size_t count, uint8_t *errors);
+
+struct fec_rs {
+    int roots;
+    /* the number of codewords processed at once by the SIMD functions */
+    size_t lanes;
+    /* the non-leading generator polynomial coefficients, so that encoding
+       a symbol with feedback fb shifts the parity by one and adds
+       fb * gen[k] to parity byte k */
+    std::vector<uint8_t> gen;
+    /* the roots of the generator polynomial, alpha^i */
+    std::vector<uint8_t> root;
+    /* full multiplication tables for `gen' and `root', 256 bytes each */
+    std::vector<uint8_t> gen_mul;
+    std::vector<uint8_t> root_mul;
+    /* nibble multiplication tables for `gen' and `root', 16 bytes for the
+       low nibble followed by 16 bytes for the high nibble */
+    std::vector<uint8_t> gen_nib;
+    std::vector<uint8_t> root_nib;
+    /* process as many codewords as possible, return the number processed */
+    rs_encode_func encode_func;
+    rs_check_func check_func;
+};
+
+/* multiplies `a' and `b' in GF(2^8) */
+static uint8_t gf_mul(uint8_t a, uint8_t b)
+{
+    uint8_t product = 0;
+
+    while (b) {
+        if (b & 1) {
+            product ^= a;
+        }
+
+        a = (a & 0x80) ? (uint8_t)((a << 1) ^ GF_POLY) : (uint8_t)(a << 1);
+        b >>= 1;
+    }
+
+    return product;
+}
+
+/* fills the multiplication tables for constant `c' */
+static void make_tables(uint8_t c, uint8_t *mul, uint8_t *nib)
+{
+    for (int x = 0; x < 256; ++x) {
+        mul[x] = gf_mul(c, x);
+    }
+
+    for (int x = 0; x < 16; ++x) {
+        nib[x] = mul[x];
+        nib[16 + x] = mul[x << 4];
+    }
+}
+
+/* encodes codewords [`start', `count') one at a time */
+static void encode_scalar(const fec_rs *rs, const uint8_t *const *rows,
+        size_t start, size_t count, uint8_t *parity)
+{
+    int roots = rs->roots;
+    int n = FEC_RSM - roots;
+
+    for (size_t i = start; i < count; ++i) {
+        uint8_t bb[FEC_RSM] = {0};
+
+        for (int j = 0; j < n; ++j) {
+            const uint8_t *mul = &rs->gen_mul[rows[j][i] ^ bb[0]];
+
+            for (int k = 0; k < roots - 1; ++k) {
+                bb[k] = bb[k + 1] ^ mul[k * 256];
+            }
+
+            bb[roots - 1] = mul[(roots - 1) * 256];
+        }
+
+        memcpy(&parity[i * roots], bb, roots);
+    }
+}
+
+/* checks codewords [`start', `count') one at a time */
+static size_t check_scalar(const fec_rs *rs, const uint8_t *const *rows,
+        size_t start, size_t count, uint8_t *errors)
+{
+    int roots = rs->roots;
+    size_t nerrors = 0;
+
+    for (size_t i = start; i < count; ++i) {
+        uint8_t s[FEC_RSM] = {0};
+
+        for (int j = 0; j < FEC_RSM; ++j) {
+            uint8_t d = rows[j][i];
+
+            for (int k = 0; k < roots; ++k) {
+                s[k] = rs->root_mul[k * 256 + s[k]] ^ d;
+            }
+        }
+
+        uint8_t syndromes = 0;
+
+        for (int k = 0; k < roots; ++k) {
+            syndromes |= s[k];
+        }
+
+        errors[i] = syndromes != 0;
+        nerrors += errors[i];
+    }
+
+    return nerrors;
+}
+
+/* copies the parity in lanes of `bb' for codewords [i, i + lanes) */
+static void store_parity(const uint8_t *bb, int roots, size_t lanes,
+        size_t i, uint8_t *parity)
+{
+    for (size_t l = 0; l < lanes; ++l) {
+        for (int k = 0; k < roots; ++k) {
+            parity[(i + l) * roots + k] = bb[k * lanes + l];
+        }
+    }
+}
+
+/* marks codewords [i, i + lanes) with non-zero syndromes in `s' */
+static size_t store_errors(const uint8_t *s, size_t lanes, size_t i,
+        uint8_t *errors)
+{
+    size_t nerrors = 0;
+
+    for (size_t l = 0; l < lanes; ++l) {
+        errors[i + l] = s[l] != 0;
+        nerrors += errors[i + l];
+    }
+
+    return nerrors;
+}
+
+#ifdef HAVE_RS_X86
+__attribute__((target("ssse3")))
+static inline __m128i mul_ssse3(__m128i v, const uint8_t *nib)
+{
+    const __m128i mask = _mm_set1_epi8(0x0f);
+    __m128i lo = _mm_loadu_si128((const __m128i *)nib);
+    __m128i hi = _mm_loadu_si128((const __m128i *)(nib + 16));
+
+    return _mm_xor_si128(
+        _mm_shuffle_epi8(lo, _mm_and_si128(v, mask)),
+        _mm_shuffle_epi8(hi, _mm_and_si128(_mm_srli_epi64(v, 4), mask)));
+}
+
+__attribute__((target("ssse3")))
+static size_t encode_ssse3(const fec_rs *rs, const uint8_t *const *rows,
+        size_t count, uint8_t *parity)
+{
+    int roots = rs->roots;
+    int n = FEC_RSM - roots;
+    const uint8_t *gen = rs->gen_nib.data();
+    __m128i bb[FEC_RSM];
+    size_t i;
+
+    for (i = 0; i + 16 <= count; i += 16) {
+        for (int k = 0; k < roots; ++k) {
+            bb[k] = _mm_setzero_si128();
+        }
+
+        for (int j = 0; j < n; ++j) {
+            __m128i fb = _mm_xor_si128(
+                _mm_loadu_si128((const __m128i *)&rows[j][i]), bb[0]);
+
+            for (int k = 0; k < roots - 1; ++k) {
+                bb[k] = _mm_xor_si128(bb[k + 1], mul_ssse3(fb, &gen[k * 32]));
+            }
+
+            bb[roots - 1] = mul_ssse3(fb, &gen[(roots - 1) * 32]);
+        }
+
+        store_parity((const uint8_t *)bb, roots, 16, i, parity);
+    }
+
+    return i;
+}
+
+__attribute__((target("ssse3")))
+static size_t check_ssse3(const fec_rs *rs, const uint8_t *const *rows,
+        size_t count, uint8_t *errors)
+{
+    int roots = rs->roots;
+    const uint8_t *root = rs->root_nib.data();
+    __m128i s[FEC_RSM];
+    size_t nerrors = 0;
+    size_t i;
+
+    for (i = 0; i + 16 <= count; i += 16) {
+        for (int k = 0; k < roots; ++k) {
+            s[k] = _mm_setzero_si128();
+        }
+
+        for (int j = 0; j < FEC_RSM; ++j) {
+            __m128i d = _mm_loadu_si128((const __m128i *)&rows[j][i]);
+
+            for (int k = 0; k < roots; ++k) {
+                s[k] = _mm_xor_si128(mul_ssse3(s[k], &root[k * 32]), d);
+            }
+        }
+
+        __m128i syndromes = _mm_setzero_si128();
+
+        for (int k = 0; k < roots; ++k) {
+            syndromes = _mm_or_si128(syndromes, s[k]);
+        }
+
+        uint8_t lanes[16];
+        _mm_storeu_si128((__m128i *)lanes, syndromes);
+        nerrors += store_errors(lanes, 16, i, errors);
+    }
+
+    return nerrors;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i mul_avx2(__m256i v, const uint8_t *nib)
+{
+    const __m256i mask = _mm256_set1_epi8(0x0f);
+    __m256i lo = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128((const __m128i *)nib));
+    __m256i hi = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128((const __m128i *)(nib + 16)));
+
+    return _mm256_xor_si256(
+        _mm256_shuffle_epi8(lo, _mm256_and_si256(v, mask)),
+        _mm256_shuffle_epi8(hi,
+            _mm256_and_si256(_mm256_srli_epi64(v, 4), mask)));
+}
+
+__attribute__((target("avx2")))
+static size_t encode_avx2(const fec_rs *rs, const uint8_t *const *rows,
+        size_t count, uint8_t *parity)
+{
+    int roots = rs->roots;
+    int n = FEC_RSM - roots;
+    const uint8_t *gen = rs->gen_nib.data();
+    __m256i bb[FEC_RSM];
+    size_t i;
+
+    for (i = 0; i + 32 <= count; i += 32) {
+        for (int k = 0; k < roots; ++k) {
+            bb[k] = _mm256_setzero_si256();
+        }
+
+        for (int j = 0; j < n; ++j) {
+            __m256i fb = _mm256_xor_si256(
+                _mm256_loadu_si256((const __m256i *)&rows[j][i]), bb[0]);
+
+            for (int k = 0; k < roots - 1; ++k) {
+                bb[k] = _mm256_xor_si256(bb[k + 1],
+                                         mul_avx2(fb, &gen[k * 32]));
+            }
+
+            bb[roots - 1] = mul_avx2(fb, &gen[(roots - 1) * 32]);
+        }
+
+        store_parity((const uint8_t *)bb, roots, 32, i, parity);
+    }
+
+    return i;
+}
+
+__attribute__((target("avx2")))
+static size_t check_avx2(const fec_rs *rs, const uint8_t *const *rows,
+        size_t count, uint8_t *errors)
+{
+    int roots = rs->roots;
+    const uint8_t *root = rs->root_nib.data();
+    __m256i s[FEC_RSM];
+    size_t nerrors = 0;
+    size_t i;
+
+    for (i = 0; i + 32 <= count; i += 32) {
+        for (int k = 0; k < roots; ++k) {
+            s[k] = _mm256_setzero_si256();
+        }
+
+        for (int j = 0; j < FEC_RSM; ++j) {
+            __m256i d = _mm256_loadu_si256((const __m256i *)&rows[j][i]);
+
+            for (int k = 0; k < roots; ++k) {
+                s[k] = _mm256_xor_si256(mul_avx2(s[k], &root[k * 32]), d);
+            }
+        }
+
+        __m256i syndromes = _mm256_setzero_si256();
+
+        for (int k = 0; k < roots; ++k) {
+            syndromes = _mm256_or_si256(syndromes, s[k]);
+        }
+
+        uint8_t lanes[32];
+        _mm256_storeu_si256((__m256i *)lanes, syndromes);
+        nerrors += store_errors(lanes, 32, i, errors);
+    }
+
+    return nerrors;
+}
+#endif /* HAVE_RS_X86 */
+
+#ifdef HAVE_RS_NEON
+static inline uint8x16_t mul_neon(uint8x16_t v, const uint8_t *nib)
+{
+    const uint8x16_t mask = vdupq_n_u8(0x0f);
+
+    return veorq_u8(vqtbl1q_u8(vld1q_u8(nib), vandq_u8(v, mask)),
+                    vqtbl1q_u8(vld1q_u8(nib + 16), vshrq_n_u8(v, 4)));
+}
+
+static size_t encode_neon(const fec_rs *rs, const uint8_t *const *rows,
+        size_t count, uint8_t *parity)
+{
+    int roots = rs->roots;
+    int n = FEC_RSM - roots;
+    const uint8_t *gen = rs->gen_nib.data();
+    uint8x16_t bb[FEC_RSM];
+    size_t i;
+
+    for (i = 0; i + 16 <= count; i += 16) {
+        for (int k = 0; k < roots; ++k) {
+            bb[k] = vdupq_n_u8(0);
+        }
+
+        for (int j = 0; j < n; ++j) {
+            uint8x16_t fb = veorq_u8(vld1q_u8(&rows[j][i]), bb[0]);
+
+            for (int k = 0; k < roots - 1; ++k) {
+                bb[k] = veorq_u8(bb[k + 1], mul_neon(fb, &gen[k * 32]));
+            }
+
+            bb[roots - 1] = mul_neon(fb, &gen[(roots - 1) * 32]);
+        }
+
+        store_parity((const uint8_t *)bb, roots, 16, i, parity);
+    }
+
+    return i;
+}
+
+static size_t check_neon(const fec_rs *rs, const uint8_t *const *rows,
+        size_t count, uint8_t *errors)
+{
+    int roots = rs->roots;
+    const uint8_t *root = rs->root_nib.data();
+    uint8x16_t s[FEC_RSM];
+    size_t nerrors = 0;
+    size_t i;
+
+    for (i = 0; i + 16 <= count; i += 16) {
+        for (int k = 0; k < roots; ++k) {
+            s[k] = vdupq_n_u8(0);
+        }
+
+        for (int j = 0; j < FEC_RSM; ++j) {
+            uint8x16_t d = vld1q_u8(&rows[j][i]);
+
+            for (int k = 0; k < roots; ++k) {
+                s[k] = veorq_u8(mul_neon(s[k], &root[k * 32]), d);
+            }
+        }
+
+        uint8x16_t syndromes = vdupq_n_u8(0);
+
+        for (int k = 0; k < roots; ++k) {
+            syndromes = vorrq_u8(syndromes, s[k]);
+        }
+
+        uint8_t lanes[16];
+        vst1q_u8(lanes, syndromes);
+        nerrors += store_errors(lanes, 16, i, errors);
+    }
+
+    return nerrors;
+}
+#endif /* HAVE_RS_NEON */
+
+/* returns the fastest implementation supported by the CPU */
+static fec_rs_impl get_best_impl()
+{
+#if defined(HAVE_RS_X86)
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2")) {
+        return FEC_RS_AVX2;
+    } else if (__builtin_cpu_supports("ssse3")) {
+        return FEC_RS_SSSE3;
+    }
+#elif defined(HAVE_RS_NEON)
+    return FEC_RS_NEON;
+#endif
+    return FEC_RS_SCALAR;
+}
+
+fec_rs *fec_rs_init_impl(int roots, fec_rs_impl impl)
+{
+    if (roots <= 0 || roots >= FEC_RSM) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    if (impl == FEC_RS_BEST) {
+        impl = get_best_impl();
+    }
+
+    std::unique_ptr<fec_rs> rs(new (std::nothrow) fec_rs);
+
+    if (!rs) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    rs->lanes = 1;
+    rs->encode_func = NULL;
+    rs->check_func = NULL;
+
+    switch (impl) {
+    case FEC_RS_SCALAR:
+        break;
+#ifdef HAVE_RS_X86
+    case FEC_RS_SSSE3:
+        if (!__builtin_cpu_supports("ssse3")) {
+            return NULL;
+        }
+        rs->lanes = 16;
+        rs->encode_func = encode_ssse3;
+        rs->check_func = check_ssse3;
+        break;
+    case FEC_RS_AVX2:
+        if (!__builtin_cpu_supports("avx2")) {
+            return NULL;
+        }
+        rs->lanes = 32;
+        rs->encode_func = encode_avx2;
+        rs->check_func = check_avx2;
+        break;
+#endif
+#ifdef HAVE_RS_NEON
+    case FEC_RS_NEON:
+        rs->lanes = 16;
+        rs->encode_func = encode_neon;
+        rs->check_func = check_neon;
+        break;
+#endif
+    default:
+        return NULL;
+    }
+
+    /* the generator polynomial with roots alpha^i for i in [0, roots), as
+       computed by init_rs_char, lowest degree first */
+    std::vector<uint8_t> genpoly(roots + 1, 0);
+    uint8_t alpha_i = 1;
+
+    rs->roots = roots;
+    rs->root.resize(roots);
+    genpoly[0] = 1;
+
+    for (int i = 0; i < roots; ++i) {
+        rs->root[i] = alpha_i;
+
+        /* multiply by (x + alpha^i) */
+        for (int j = i + 1; j > 0; --j) {
+            genpoly[j] = genpoly[j - 1] ^ gf_mul(genpoly[j], alpha_i);
+        }
+
+        genpoly[0] = gf_mul(genpoly[0], alpha_i);
+        alpha_i = gf_mul(alpha_i, 2);
+    }
+
+    rs->gen.resize(roots);
+    rs->gen_mul.resize(roots * 256);
+    rs->gen_nib.resize(roots * 32);
+    rs->root_mul.resize(roots * 256);
+    rs->root_nib.resize(roots * 32);
+
+    for (int k = 0; k < roots; ++k) {
+        rs->gen[k] = genpoly[roots - 1 - k];
+        make_tables(rs->gen[k], &rs->gen_mul[k * 256], &rs->gen_nib[k * 32]);
+        make_tables(rs->root[k], &rs->root_mul[k * 256],
+                    &rs->root_nib[k * 32]);
+    }
+
+    return rs.release();
+}
+
+struct fec_rs *fec_rs_init(int roots)
+{
+    return fec_rs_init_impl(roots, FEC_RS_BEST);
+}
+
+void fec_rs_free(struct fec_rs *rs)
+{
+    delete rs;
+}
+
+void fec_rs_encode(const struct fec_rs *rs, const uint8_t *const *rows,
+        size_t count, uint8_t *parity)
+{
+    size_t done = 0;
+
+    if (rs->encode_func) {
+        done = rs->encode_func(rs, rows, count, parity);
+    }
+
+    encode_scalar(rs, rows, done, count, parity);
+}
+
+size_t fec_rs_check(const struct fec_rs *rs, const uint8_t *const *rows,
+        size_t count, uint8_t *errors)
+{
+    size_t done = 0;
+    size_t nerrors = 0;
+
+    if (rs->check_func) {
+        /* the SIMD implementations only process full vectors */
+        nerrors = rs->check_func(rs, rows, count, errors);
+        done = count - count % rs->lanes;
+    }
+
+    return nerrors + check_scalar(rs, rows, done, count, errors);
+}
@@ -396,6 +396,8 @@ static void reset_handle(fec_handle *f)
     f->fd = -1;
     f->flags = 0;
     f->mode = 0;
+    f->threads = 0;
+    f->pool.reset();
     f->errors = 0;
     f->data_size = 0;
     f->pos = 0;
@@ -403,6 +405,7 @@ static void reset_handle(fec_handle *f)
 
     f->ecc = {};
     f->verity = {};
+    f->verified.reset();
 }
 
 /* closes and flushes `f->fd' and releases any memory allocated for `f' */
@@ -410,6 +413,8 @@ int fec_close(struct fec_handle *f)
 {
     check(f);
 
+    f->pool.reset();
+
     if (f->fd != -1) {
         if (f->mode & O_RDWR && fdatasync(f->fd) == -1) {
             warn("fdatasync failed: %s", strerror(errno));
@@ -25,6 +25,7 @@
 #include <sys/syscall.h>
 #include <unistd.h>
 
+#include <atomic>
 #include <memory>
 #include <string>
 #include <vector>
@@ -44,6 +45,7 @@
 /* verity parameters */
 #define VERITY_CACHE_BLOCKS 4096
 #define VERITY_NO_CACHE UINT64_MAX
+#define VERITY_READ_BLOCKS 64 /* maximum number of blocks read at once */
 
 /* verity definitions */
 #define VERITY_METADATA_SIZE (8 * FEC_BLOCKSIZE)
@@ -93,7 +95,8 @@ struct hashtree_info {
 
     // Checks if the bytes in 'block' has the expected hash. And the 'index' is
     // the block number of is the input block in the filesystem.
-    bool check_block_hash_with_index(uint64_t index, const uint8_t *block);
+    bool check_block_hash_with_index(uint64_t index,
+                                     const uint8_t *block) const;
 
     // Reads the verity hash tree, validates it against the root hash in `root',
     // corrects errors if necessary, and copies valid data blocks for later use
@@ -106,14 +109,22 @@ struct hashtree_info {
 
     // Computes the hash for FEC_BLOCKSIZE bytes from buffer 'block' and
     // compares it to the expected value in 'expected'.
-    bool check_block_hash(const uint8_t *expected, const uint8_t *block);
+    bool check_block_hash(const uint8_t *expected, const uint8_t *block) const;
 
     // Computes the hash of 'block' and put the result in 'hash'.
-    int get_hash(const uint8_t *block, uint8_t *hash);
+    int get_hash(const uint8_t *block, uint8_t *hash) const;
 
     int nid_;  // NID for the hash algorithm.
     uint32_t digest_length_;
     uint32_t padded_digest_length_;
+
+    // The hash state after hashing the salt. Each block is hashed from a copy
+    // of it, so the salt is hashed only once and hashing a block needs no
+    // allocations or locking.
+    union {
+        SHA_CTX sha1;
+        SHA256_CTX sha256;
+    } salted_ctx_;
 };
 
 struct verity_info {
@@ -131,12 +142,24 @@ struct avb_info {
     hashtree_info hashtree;
 };
 
+struct work_pool;
+
+extern void work_pool_destroy(work_pool *pool);
+
+/* stops the threads of a pool when the owning fec_handle is released */
+struct work_pool_deleter {
+    void operator()(work_pool *pool) const { work_pool_destroy(pool); }
+};
+
 struct fec_handle {
     ecc_info ecc;
     int fd;
     int flags; /* additional flags passed to fec_open */
     int mode; /* mode for open(2) */
-    pthread_mutex_t mutex;
+    int threads; /* threads for processing reads, 0 for the default */
+    pthread_mutex_t mutex; /* protects creating `pool' and `verified' */
+    /* created by the first read that uses more threads */
+    std::unique_ptr<work_pool, work_pool_deleter> pool;
     uint64_t errors;
     uint64_t data_size;
     uint64_t pos;
@@ -144,8 +167,11 @@ struct fec_handle {
     // TODO(xunchang) switch to std::optional
     verity_info verity;
     avb_info avb;
+    // A bit for each data block, set when the block on disk is known to match
+    // the hash tree, so it does not have to be hashed again.
+    std::unique_ptr<std::atomic<uint64_t>[]> verified;
 
-    hashtree_info hashtree() const {
+    const hashtree_info &hashtree() const {
         return avb.valid ? avb.hashtree : verity.hashtree;
     }
 };
@@ -161,6 +187,18 @@ typedef ssize_t (*read_func)(fec_handle *f, uint8_t *dest, size_t count,
 extern ssize_t process(fec_handle *f, uint8_t *buf, size_t count,
         uint64_t offset, read_func func);
 
+/* Reed-Solomon codec implementations, for testing and benchmarking */
+enum fec_rs_impl {
+    FEC_RS_SCALAR,
+    FEC_RS_SSSE3,
+    FEC_RS_AVX2,
+    FEC_RS_NEON,
+    FEC_RS_BEST /* the fastest one supported by the CPU */
+};
+
+/* returns NULL if `impl' is not supported by the CPU */
+extern fec_rs *fec_rs_init_impl(int roots, fec_rs_impl impl);
+
 /* verity functions */
 extern uint64_t verity_get_size(uint64_t file_size, uint32_t *verity_levels,
                                 uint32_t *level_hashes,
@@ -14,6 +14,8 @@
  * limitations under the License.
  */
 
+#include <deque>
+
 #include "fec_private.h"
 
 struct process_info {
@@ -25,6 +27,18 @@ struct process_info {
     read_func func;
     ssize_t rc;
     size_t errors;
+    bool done;
+};
+
+/* worker threads owned by a fec_handle, which process parts of reads queued
+   by process() */
+struct work_pool {
+    pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+    pthread_cond_t work = PTHREAD_COND_INITIALIZER; /* signaled when queued */
+    pthread_cond_t done = PTHREAD_COND_INITIALIZER; /* signaled when done */
+    std::deque<process_info *> queue;
+    std::vector<pthread_t> threads;
+    bool stopping = false;
 };
 
 /* thread function  */
@@ -39,19 +53,69 @@ static void * __process(void *cookie)
     return p;
 }
 
-/* launches a maximum number of threads to process a read */
-ssize_t process(fec_handle *f, uint8_t *buf, size_t count, uint64_t offset,
-        read_func func)
+/* processes queued work until the pool is destroyed */
+static void * __work_pool_thread(void *cookie)
 {
-    check(f);
-    check(buf);
-    check(func);
+    work_pool *pool = static_cast<work_pool *>(cookie);
 
-    if (count == 0) {
-        return 0;
+    pthread_mutex_lock(&pool->mutex);
+
+    while (true) {
+        while (pool->queue.empty() && !pool->stopping) {
+            pthread_cond_wait(&pool->work, &pool->mutex);
+        }
+
+        if (pool->queue.empty()) {
+            break;
+        }
+
+        process_info *p = pool->queue.front();
+        pool->queue.pop_front();
+
+        pthread_mutex_unlock(&pool->mutex);
+        __process(p);
+        pthread_mutex_lock(&pool->mutex);
+
+        p->done = true;
+        pthread_cond_broadcast(&pool->done);
+    }
+
+    pthread_mutex_unlock(&pool->mutex);
+    return NULL;
+}
+
+/* stops the threads in `pool' and releases it */
+void work_pool_destroy(work_pool *pool)
+{
+    if (!pool) {
+        return;
     }
 
-    int threads = sysconf(_SC_NPROCESSORS_ONLN);
+    pthread_mutex_lock(&pool->mutex);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (auto thread : pool->threads) {
+        if (pthread_join(thread, NULL) != 0) {
+            error("failed to join thread: %s", strerror(errno));
+        }
+    }
+
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->work);
+    pthread_mutex_destroy(&pool->mutex);
+    delete pool;
+}
+
+/* returns the number of threads to use for reads */
+static int get_threads(fec_handle *f)
+{
+    int threads = f->threads;
+
+    if (threads == 0) {
+        threads = sysconf(_SC_NPROCESSORS_ONLN);
+    }
 
     if (threads < WORK_MIN_THREADS) {
         threads = WORK_MIN_THREADS;
@@ -59,9 +123,89 @@ ssize_t process(fec_handle *f, uint8_t *buf, size_t count, uint64_t offset,
         threads = WORK_MAX_THREADS;
     }
 
+    return threads;
+}
+
+/* returns the worker pool of `f', starting it if needed, or NULL if reads
+   are processed only in the calling thread */
+static work_pool *get_work_pool(fec_handle *f)
+{
+    pthread_mutex_lock(&f->mutex);
+
+    if (!f->pool) {
+        /* the calling thread processes a part of each read as well */
+        int workers = get_threads(f) - 1;
+
+        if (workers > 0) {
+            f->pool.reset(new (std::nothrow) work_pool);
+
+            if (!f->pool) {
+                error("failed to allocate a worker pool");
+            }
+        }
+
+        for (int i = 0; f->pool && i < workers; ++i) {
+            pthread_t thread;
+
+            if (pthread_create(&thread, NULL, __work_pool_thread,
+                               f->pool.get()) != 0) {
+                error("failed to create thread: %s", strerror(errno));
+                break;
+            }
+
+            f->pool->threads.push_back(thread);
+        }
+
+        if (f->pool && f->pool->threads.empty()) {
+            f->pool.reset();
+        }
+    }
+
+    work_pool *pool = f->pool.get();
+    pthread_mutex_unlock(&f->mutex);
+
+    return pool;
+}
+
+/* sets the number of threads used to process reads, and stops the current
+   worker threads, if any */
+int fec_set_threads(struct fec_handle *f, int threads)
+{
+    check(f);
+
+    if (threads < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    pthread_mutex_lock(&f->mutex);
+    f->threads = threads;
+    f->pool.reset();
+    pthread_mutex_unlock(&f->mutex);
+
+    return 0;
+}
+
+/* splits a read between the calling thread and the worker pool */
+ssize_t process(fec_handle *f, uint8_t *buf, size_t count, uint64_t offset,
+        read_func func)
+{
+    check(f);
+    check(buf);
+    check(func);
+
+    if (count == 0) {
+        return 0;
+    }
+
     uint64_t start = (offset / FEC_BLOCKSIZE) * FEC_BLOCKSIZE;
     size_t blocks = fec_div_round_up(count, FEC_BLOCKSIZE);
 
+    /* reads of a single block are not worth handing over to another
+       thread */
+    work_pool *pool = blocks > 1 ? get_work_pool(f) : NULL;
+    int threads = pool ? (int)pool->threads.size() + 1 : 1;
+
     size_t count_per_thread = fec_div_round_up(blocks, threads) * FEC_BLOCKSIZE;
     size_t max_threads = fec_div_round_up(count, count_per_thread);
 
@@ -76,11 +220,8 @@ ssize_t process(fec_handle *f, uint8_t *buf, size_t count, uint64_t offset,
     debug("%d threads, %zu bytes per thread (total %zu)", threads,
         count_per_thread, count);
 
-    std::vector<pthread_t> handles;
     process_info info[threads];
-    ssize_t rc = 0;
 
-    /* start threads to process queue */
     for (int i = 0; i < threads; ++i) {
         check(left > 0);
 
@@ -92,20 +233,12 @@ ssize_t process(fec_handle *f, uint8_t *buf, size_t count, uint64_t offset,
         info[i].func = func;
         info[i].rc = -1;
         info[i].errors = 0;
+        info[i].done = false;
 
         if (info[i].count > left) {
             info[i].count = left;
         }
 
-        pthread_t thread;
-
-        if (pthread_create(&thread, NULL, __process, &info[i]) != 0) {
-            error("failed to create thread: %s", strerror(errno));
-            rc = -1;
-        } else {
-            handles.push_back(thread);
-        }
-
         pos = end;
         end  += count_per_thread;
         left -= info[i].count;
@@ -113,20 +246,42 @@ ssize_t process(fec_handle *f, uint8_t *buf, size_t count, uint64_t offset,
 
     check(left == 0);
 
-    ssize_t nread = 0;
+    /* queue all but the first part to the workers */
+    if (threads > 1) {
+        pthread_mutex_lock(&pool->mutex);
 
-    /* wait for all threads to complete */
-    for (auto thread : handles) {
-        process_info *p = NULL;
+        for (int i = 1; i < threads; ++i) {
+            pool->queue.push_back(&info[i]);
+        }
 
-        if (pthread_join(thread, (void **)&p) != 0) {
-            error("failed to join thread: %s", strerror(errno));
-            rc = -1;
-        } else if (!p || p->rc == -1) {
+        pthread_cond_broadcast(&pool->work);
+        pthread_mutex_unlock(&pool->mutex);
+    }
+
+    __process(&info[0]);
+
+    /* wait for the workers to complete */
+    if (threads > 1) {
+        pthread_mutex_lock(&pool->mutex);
+
+        for (int i = 1; i < threads; ++i) {
+            while (!info[i].done) {
+                pthread_cond_wait(&pool->done, &pool->mutex);
+            }
+        }
+
+        pthread_mutex_unlock(&pool->mutex);
+    }
+
+    ssize_t rc = 0;
+    ssize_t nread = 0;
+
+    for (int i = 0; i < threads; ++i) {
+        if (info[i].rc == -1) {
             rc = -1;
         } else {
-            nread += p->rc;
-            f->errors += p->errors;
+            nread += info[i].rc;
+            f->errors += info[i].errors;
         }
     }
 
@@ -18,6 +18,8 @@
 #include <stdlib.h>
 #include <sys/mman.h>
 
+#include <algorithm>
+
 extern "C" {
     #include <fec.h>
 }
@@ -25,6 +27,7 @@ extern "C" {
 #include "fec_private.h"
 
 using rs_unique_ptr = std::unique_ptr<void, decltype(&free_rs_char)>;
+using codec_unique_ptr = std::unique_ptr<fec_rs, decltype(&fec_rs_free)>;
 
 /* prints a hexdump of `data' using warn(...) */
 static void dump(const char *name, uint64_t value, const uint8_t *data,
@@ -65,6 +68,50 @@ static void dump(const char *name, uint64_t value, const uint8_t *data,
     }
 }
 
+/* checks if block `index' is known to match the hash tree on disk */
+static inline bool is_verified(fec_handle *f, uint64_t index)
+{
+    if (!f->verified || unlikely(index >= f->hashtree().data_blocks)) {
+        return false;
+    }
+
+    uint64_t bit = 1ULL << (index % 64);
+    return f->verified[index / 64].load(std::memory_order_relaxed) & bit;
+}
+
+/* marks block `index' as verified or not */
+static inline void set_verified(fec_handle *f, uint64_t index, bool verified)
+{
+    if (!f->verified || unlikely(index >= f->hashtree().data_blocks)) {
+        return;
+    }
+
+    uint64_t bit = 1ULL << (index % 64);
+
+    if (verified) {
+        f->verified[index / 64].fetch_or(bit, std::memory_order_relaxed);
+    } else {
+        f->verified[index / 64].fetch_and(~bit, std::memory_order_relaxed);
+    }
+}
+
+/* allocates the bitmap of verified blocks, unless it already exists */
+static void init_verified(fec_handle *f)
+{
+    pthread_mutex_lock(&f->mutex);
+
+    if (!f->verified) {
+        size_t words = fec_div_round_up(f->hashtree().data_blocks, 64);
+        f->verified.reset(new (std::nothrow) std::atomic<uint64_t>[words]());
+
+        if (!f->verified) {
+            warn("failed to allocate the verified block bitmap");
+        }
+    }
+
+    pthread_mutex_unlock(&f->mutex);
+}
+
 /* checks if `offset' is within a corrupted block */
 static inline bool is_erasure(fec_handle *f, uint64_t offset,
         const uint8_t *data)
@@ -79,13 +126,14 @@ static inline bool is_erasure(fec_handle *f, uint64_t offset,
 
     uint64_t n = offset / FEC_BLOCKSIZE;
 
-    return !f->hashtree().check_block_hash_with_index(n, data);
+    return !is_verified(f, n) &&
+           !f->hashtree().check_block_hash_with_index(n, data);
 }
 
 /* check if `offset' is within a block expected to contain zeros */
 static inline bool is_zero(fec_handle *f, uint64_t offset)
 {
-    auto hashtree = f->hashtree();
+    const hashtree_info &hashtree = f->hashtree();
 
     if (hashtree.hash_data.empty() || unlikely(offset >= f->data_size)) {
         return false;
@@ -104,8 +152,9 @@ static inline bool is_zero(fec_handle *f, uint64_t offset)
 
 /* reads and decodes a single block starting from `offset', returns the number
    of bytes corrected in `errors' */
-static int __ecc_read(fec_handle *f, void *rs, uint8_t *dest, uint64_t offset,
-        bool use_erasures, uint8_t *ecc_data, size_t *errors)
+static int __ecc_read(fec_handle *f, void *rs, const fec_rs *codec,
+        uint8_t *dest, uint64_t offset, bool use_erasures, uint8_t *ecc_data,
+        size_t *errors)
 {
     check(offset % FEC_BLOCKSIZE == 0);
     ecc_info *e = &f->ecc;
@@ -118,12 +167,24 @@ static int __ecc_read(fec_handle *f, void *rs, uint8_t *dest, uint64_t offset,
     int erasures[e->rsn];
     int neras = 0;
 
+    /* the blocks of the RS block are stored as rows, so symbol j of
+       codeword i is at rows[j][i], followed by the parity as stored in the
+       file and a flag for each codeword with errors, see ecc_init */
+    const uint8_t *rows[FEC_RSM];
+    uint8_t *parity = &ecc_data[FEC_RSM * FEC_BLOCKSIZE];
+    uint8_t *flags = &parity[e->roots * FEC_BLOCKSIZE];
+
+    for (int i = 0; i < FEC_RSM; ++i) {
+        rows[i] = &ecc_data[i * FEC_BLOCKSIZE];
+    }
+
     /* verity is required to check for erasures */
     check(!use_erasures || !f->hashtree().hash_data.empty());
 
     for (int i = 0; i < e->rsn; ++i) {
         uint64_t interleaved = fec_ecc_interleave(rsb * e->rsn + i, e->rsn,
                                     e->rounds);
+        uint8_t *row = &ecc_data[i * FEC_BLOCKSIZE];
 
         if (interleaved == offset) {
             data_index = i;
@@ -131,11 +192,11 @@ static int __ecc_read(fec_handle *f, void *rs, uint8_t *dest, uint64_t offset,
 
         /* to improve our chances of correcting IO errors, initialize the
            buffer to zeros even if we are going to read to it later */
-        uint8_t bbuf[FEC_BLOCKSIZE] = {0};
+        memset(row, 0, FEC_BLOCKSIZE);
 
         if (likely(interleaved < e->start) && !is_zero(f, interleaved)) {
             /* copy raw data to reconstruct the RS block */
-            if (!raw_pread(f->fd, bbuf, FEC_BLOCKSIZE, interleaved)) {
+            if (!raw_pread(f->fd, row, FEC_BLOCKSIZE, interleaved)) {
                 warn("failed to read: %s", strerror(errno));
 
                 /* treat errors as corruption */
@@ -143,37 +204,58 @@ static int __ecc_read(fec_handle *f, void *rs, uint8_t *dest, uint64_t offset,
                     erasures[neras++] = i;
                 }
             } else if (use_erasures && neras <= e->roots &&
-                       is_erasure(f, interleaved, bbuf)) {
+                       is_erasure(f, interleaved, row)) {
                 erasures[neras++] = i;
             }
         }
+    }
+
+    check(data_index >= 0);
 
-        for (int j = 0; j < FEC_BLOCKSIZE; ++j) {
-            ecc_data[j * FEC_RSM + i] = bbuf[j];
+    /* the parity bytes of consecutive codewords are stored next to each
+       other, so read them all at once and transpose them to rows */
+    if (!raw_pread(f->fd, parity, e->roots * FEC_BLOCKSIZE,
+                   e->start + rsb * e->roots)) {
+        error("failed to read ecc data: %s", strerror(errno));
+        return -1;
+    }
+
+    for (int i = 0; i < FEC_BLOCKSIZE; ++i) {
+        for (int j = 0; j < e->roots; ++j) {
+            ecc_data[(e->rsn + j) * FEC_BLOCKSIZE + i] =
+                parity[i * e->roots + j];
         }
     }
 
-    check(data_index >= 0);
+    memcpy(dest, rows[data_index], FEC_BLOCKSIZE);
+
+    /* only codewords with non-zero syndromes need decoding; decode_rs_char
+       leaves the others unchanged even with erasures */
+    if (!fec_rs_check(codec, rows, FEC_BLOCKSIZE, flags)) {
+        return FEC_BLOCKSIZE;
+    }
 
     size_t nerrs = 0;
+    uint8_t data[FEC_RSM];
     uint8_t copy[FEC_RSM];
 
     for (int i = 0; i < FEC_BLOCKSIZE; ++i) {
-        /* copy parity data */
-        if (!raw_pread(f->fd, &ecc_data[i * FEC_RSM + e->rsn], e->roots,
-                       e->start + (i + rsb) * e->roots)) {
-            error("failed to read ecc data: %s", strerror(errno));
-            return -1;
+        if (!flags[i]) {
+            continue;
+        }
+
+        for (int j = 0; j < FEC_RSM; ++j) {
+            data[j] = rows[j][i];
         }
 
         /* for debugging decoding failures, because decode_rs_char can mangle
-           ecc_data */
+           data */
         if (unlikely(use_erasures)) {
-            memcpy(copy, &ecc_data[i * FEC_RSM], FEC_RSM);
+            memcpy(copy, data, FEC_RSM);
         }
 
         /* decode */
-        int rc = decode_rs_char(rs, &ecc_data[i * FEC_RSM], erasures, neras);
+        int rc = decode_rs_char(rs, data, erasures, neras);
 
         if (unlikely(rc < 0)) {
             if (use_erasures) {
@@ -193,7 +275,7 @@ static int __ecc_read(fec_handle *f, void *rs, uint8_t *dest, uint64_t offset,
             nerrs += rc;
         }
 
-        dest[i] = ecc_data[i * FEC_RSM + data_index];
+        dest[i] = data[data_index];
     }
 
     if (nerrs) {
@@ -205,20 +287,24 @@ static int __ecc_read(fec_handle *f, void *rs, uint8_t *dest, uint64_t offset,
 }
 
 /* initializes RS decoder and allocates memory for interleaving */
-static int ecc_init(fec_handle *f, rs_unique_ptr& rs,
+static int ecc_init(fec_handle *f, rs_unique_ptr& rs, codec_unique_ptr& codec,
         std::unique_ptr<uint8_t[]>& ecc_data)
 {
     check(f);
 
     rs.reset(init_rs_char(FEC_PARAMS(f->ecc.roots)));
+    codec.reset(fec_rs_init(f->ecc.roots));
 
-    if (unlikely(!rs)) {
+    if (unlikely(!rs || !codec)) {
         error("failed to initialize RS");
         errno = ENOMEM;
         return -1;
     }
 
-    ecc_data.reset(new (std::nothrow) uint8_t[FEC_RSM * FEC_BLOCKSIZE]);
+    /* space for the rows of an RS block, its parity as stored in the file,
+       and flags for codewords with errors */
+    ecc_data.reset(new (std::nothrow) uint8_t[
+        (FEC_RSM + f->ecc.roots + 1) * FEC_BLOCKSIZE]);
 
     if (unlikely(!ecc_data)) {
         error("failed to allocate ecc buffer");
@@ -243,9 +329,10 @@ static ssize_t ecc_read(fec_handle *f, uint8_t *dest, size_t count,
     debug("[%" PRIu64 ", %" PRIu64 ")", offset, offset + count);
 
     rs_unique_ptr rs(NULL, free_rs_char);
+    codec_unique_ptr codec(NULL, fec_rs_free);
     std::unique_ptr<uint8_t[]> ecc_data;
 
-    if (ecc_init(f, rs, ecc_data) == -1) {
+    if (ecc_init(f, rs, codec, ecc_data) == -1) {
         return -1;
     }
 
@@ -257,8 +344,8 @@ static ssize_t ecc_read(fec_handle *f, uint8_t *dest, size_t count,
 
     while (left > 0) {
         /* there's no erasure detection without verity metadata */
-        if (__ecc_read(f, rs.get(), data, curr * FEC_BLOCKSIZE, false,
-                ecc_data.get(), errors) == -1) {
+        if (__ecc_read(f, rs.get(), codec.get(), data, curr * FEC_BLOCKSIZE,
+                false, ecc_data.get(), errors) == -1) {
             return -1;
         }
 
@@ -279,6 +366,35 @@ static ssize_t ecc_read(fec_handle *f, uint8_t *dest, size_t count,
     return count;
 }
 
+/* reads `blocks' consecutive blocks starting from block `curr' to `data',
+   using a single read if possible; blocks that cannot be read are left for
+   error correction */
+static bool verity_read_blocks(fec_handle *f, uint8_t *data, uint64_t curr,
+        size_t blocks)
+{
+    if (blocks > 1 && raw_pread(f->fd, data, blocks * FEC_BLOCKSIZE,
+                                curr * FEC_BLOCKSIZE)) {
+        return true;
+    }
+
+    /* read a block at a time, so an I/O error only affects the blocks
+       that are actually unreadable */
+    for (size_t i = 0; i < blocks; ++i) {
+        if (!raw_pread(f->fd, &data[i * FEC_BLOCKSIZE], FEC_BLOCKSIZE,
+                       (curr + i) * FEC_BLOCKSIZE)) {
+            if (errno == EIO) {
+                warn("I/O error encounter when reading, attempting to recover using fec");
+                set_verified(f, curr + i, false);
+            } else {
+                error("failed to read: %s", strerror(errno));
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
 /* reads `count' bytes from `offset', corrects possible errors with
    erasure detection, and verifies the integrity of read data using
    verity hash tree; returns the number of corrections in `errors' */
@@ -295,109 +411,138 @@ static ssize_t verity_read(fec_handle *f, uint8_t *dest, size_t count,
     debug("[%" PRIu64 ", %" PRIu64 ")", offset, offset + count);
 
     rs_unique_ptr rs(NULL, free_rs_char);
+    codec_unique_ptr codec(NULL, fec_rs_free);
     std::unique_ptr<uint8_t[]> ecc_data;
 
-    if (f->ecc.start && ecc_init(f, rs, ecc_data) == -1) {
+    if (f->ecc.start && ecc_init(f, rs, codec, ecc_data) == -1) {
         return -1;
     }
 
+    const hashtree_info &hashtree = f->hashtree();
+    bool rdonly = (f->mode & O_ACCMODE) == O_RDONLY;
     uint64_t curr = offset / FEC_BLOCKSIZE;
     size_t coff = (size_t)(offset - curr * FEC_BLOCKSIZE);
     size_t left = count;
-    uint8_t data[FEC_BLOCKSIZE];
+    uint8_t block[FEC_BLOCKSIZE];
 
     uint64_t max_hash_block =
-        (f->hashtree().hash_data.size() - SHA256_DIGEST_LENGTH) /
+        (hashtree.hash_data.size() - SHA256_DIGEST_LENGTH) /
         SHA256_DIGEST_LENGTH;
 
     while (left > 0) {
         check(curr <= max_hash_block);
-        uint64_t curr_offset = curr * FEC_BLOCKSIZE;
 
-        bool expect_zeros = is_zero(f, curr_offset);
+        /* whole blocks are read directly to `dest', partial blocks at
+           either end of the range go through `block' */
+        bool direct = coff == 0 && left >= FEC_BLOCKSIZE;
+        uint8_t *run = direct ? dest : block;
+        size_t blocks = 1;
 
         /* if we are in read-only mode and expect to read a zero block,
            skip reading and just return zeros */
-        if ((f->mode & O_ACCMODE) == O_RDONLY && expect_zeros) {
-            memset(data, 0, FEC_BLOCKSIZE);
-            goto valid;
-        }
+        bool skip = rdonly && is_zero(f, curr * FEC_BLOCKSIZE);
 
-        /* copy raw data without error correction */
-        if (!raw_pread(f->fd, data, FEC_BLOCKSIZE, curr_offset)) {
-            if (errno == EIO) {
-                warn("I/O error encounter when reading, attempting to recover using fec");
-            } else {
-                error("failed to read: %s", strerror(errno));
-                return -1;
+        if (direct && !skip) {
+            size_t max_blocks = std::min<uint64_t>(
+                std::min<size_t>(left / FEC_BLOCKSIZE, VERITY_READ_BLOCKS),
+                max_hash_block - curr + 1);
+
+            while (blocks < max_blocks &&
+                   !(rdonly && is_zero(f, (curr + blocks) * FEC_BLOCKSIZE))) {
+                ++blocks;
             }
         }
 
-        if (likely(f->hashtree().check_block_hash_with_index(curr, data))) {
-            goto valid;
+        if (skip) {
+            memset(run, 0, FEC_BLOCKSIZE);
+        } else if (!verity_read_blocks(f, run, curr, blocks)) {
+            return -1;
         }
 
-        /* we know the block is supposed to contain zeros, so return zeros
-           instead of trying to correct it */
-        if (expect_zeros) {
-            memset(data, 0, FEC_BLOCKSIZE);
-            goto corrected;
-        }
+        for (size_t i = 0; i < blocks; ++i) {
+            uint8_t *data = &run[i * FEC_BLOCKSIZE];
+            uint64_t curr_offset = (curr + i) * FEC_BLOCKSIZE;
 
-        if (!f->ecc.start) {
-            /* fatal error without ecc */
-            error("[%" PRIu64 ", %" PRIu64 "): corrupted block %" PRIu64,
-                offset, offset + count, curr);
-            return -1;
-        } else {
-            debug("[%" PRIu64 ", %" PRIu64 "): corrupted block %" PRIu64,
-                offset, offset + count, curr);
-        }
+            if (skip || is_verified(f, curr + i)) {
+                continue;
+            }
 
-        /* try to correct without erasures first, because checking for
-           erasure locations is slower */
-        if (__ecc_read(f, rs.get(), data, curr_offset, false, ecc_data.get(),
-                       errors) == FEC_BLOCKSIZE &&
-            f->hashtree().check_block_hash_with_index(curr, data)) {
-            goto corrected;
-        }
+            if (likely(hashtree.check_block_hash_with_index(curr + i, data))) {
+                set_verified(f, curr + i, true);
+                continue;
+            }
 
-        /* try to correct with erasures */
-        if (__ecc_read(f, rs.get(), data, curr_offset, true, ecc_data.get(),
-                       errors) == FEC_BLOCKSIZE &&
-            f->hashtree().check_block_hash_with_index(curr, data)) {
-            goto corrected;
-        }
+            /* we know the block is supposed to contain zeros, so return
+               zeros instead of trying to correct it */
+            if (is_zero(f, curr_offset)) {
+                memset(data, 0, FEC_BLOCKSIZE);
+                goto corrected;
+            }
+
+            if (!f->ecc.start) {
+                /* fatal error without ecc */
+                error("[%" PRIu64 ", %" PRIu64 "): corrupted block %" PRIu64,
+                    offset, offset + count, curr + i);
+                return -1;
+            } else {
+                debug("[%" PRIu64 ", %" PRIu64 "): corrupted block %" PRIu64,
+                    offset, offset + count, curr + i);
+            }
 
-        error("[%" PRIu64 ", %" PRIu64 "): corrupted block %" PRIu64
-            " (offset %" PRIu64 ") cannot be recovered",
-            offset, offset + count, curr, curr_offset);
-        dump("decoded block", curr, data, FEC_BLOCKSIZE);
+            /* try to correct without erasures first, because checking for
+               erasure locations is slower */
+            if (__ecc_read(f, rs.get(), codec.get(), data, curr_offset,
+                           false, ecc_data.get(), errors) == FEC_BLOCKSIZE &&
+                hashtree.check_block_hash_with_index(curr + i, data)) {
+                goto corrected;
+            }
 
-        errno = EIO;
-        return -1;
+            /* try to correct with erasures */
+            if (__ecc_read(f, rs.get(), codec.get(), data, curr_offset,
+                           true, ecc_data.get(), errors) == FEC_BLOCKSIZE &&
+                hashtree.check_block_hash_with_index(curr + i, data)) {
+                goto corrected;
+            }
 
-corrected:
-        /* update the corrected block to the file if we are in r/w mode */
-        if (f->mode & O_RDWR &&
-            !raw_pwrite(f->fd, data, FEC_BLOCKSIZE, curr_offset)) {
-            error("failed to write: %s", strerror(errno));
+            error("[%" PRIu64 ", %" PRIu64 "): corrupted block %" PRIu64
+                " (offset %" PRIu64 ") cannot be recovered",
+                offset, offset + count, curr + i, curr_offset);
+            dump("decoded block", curr + i, data, FEC_BLOCKSIZE);
+
+            errno = EIO;
             return -1;
-        }
 
-valid:
-        size_t copy = FEC_BLOCKSIZE - coff;
+corrected:
+            /* update the corrected block to the file if we are in r/w
+               mode; only then is the block on disk valid */
+            if (f->mode & O_RDWR) {
+                set_verified(f, curr + i, false);
+
+                if (!raw_pwrite(f->fd, data, FEC_BLOCKSIZE, curr_offset)) {
+                    error("failed to write: %s", strerror(errno));
+                    return -1;
+                }
 
-        if (copy > left) {
-            copy = left;
+                set_verified(f, curr + i, true);
+            }
         }
 
-        memcpy(dest, &data[coff], copy);
+        size_t copy = blocks * FEC_BLOCKSIZE;
+
+        if (!direct) {
+            copy = FEC_BLOCKSIZE - coff;
+
+            if (copy > left) {
+                copy = left;
+            }
+
+            memcpy(dest, &block[coff], copy);
+        }
 
         dest += copy;
         left -= copy;
         coff = 0;
-        ++curr;
+        curr += blocks;
     }
 
     return count;
@@ -529,6 +674,8 @@ ssize_t fec_pread(struct fec_handle *f, void *buf, size_t count,
     }
 
     if (!f->hashtree().hash_data.empty()) {
+        init_verified(f);
+
         return process(f, (uint8_t *)buf,
                        get_max_count(offset, count, f->data_size), offset,
                        verity_read);
@@ -22,7 +22,6 @@
 #include <vector>
 
 #include <android-base/strings.h>
-#include <openssl/evp.h>
 
 #include "fec_private.h"
 
@@ -121,20 +120,17 @@ uint64_t verity_get_size(uint64_t file_size, uint32_t *verity_levels,
     return total * FEC_BLOCKSIZE;
 }
 
-int hashtree_info::get_hash(const uint8_t *block, uint8_t *hash) {
-    auto md = EVP_get_digestbynid(nid_);
-    check(md);
-    auto mdctx = EVP_MD_CTX_new();
-    check(mdctx);
-
-    EVP_DigestInit_ex(mdctx, md, nullptr);
-    EVP_DigestUpdate(mdctx, salt.data(), salt.size());
-    EVP_DigestUpdate(mdctx, block, FEC_BLOCKSIZE);
-    unsigned int hash_size;
-    EVP_DigestFinal_ex(mdctx, hash, &hash_size);
-    EVP_MD_CTX_free(mdctx);
+int hashtree_info::get_hash(const uint8_t *block, uint8_t *hash) const {
+    if (nid_ == NID_sha1) {
+        SHA_CTX ctx = salted_ctx_.sha1;
+        SHA1_Update(&ctx, block, FEC_BLOCKSIZE);
+        SHA1_Final(hash, &ctx);
+    } else {
+        SHA256_CTX ctx = salted_ctx_.sha256;
+        SHA256_Update(&ctx, block, FEC_BLOCKSIZE);
+        SHA256_Final(hash, &ctx);
+    }
 
-    check(hash_size == digest_length_);
     return 0;
 }
 
@@ -151,25 +147,33 @@ int hashtree_info::initialize(uint64_t hash_start, uint64_t data_blocks,
     // The padded digest size for both sha256 and sha1 are 256 bytes.
     padded_digest_length_ = SHA256_DIGEST_LENGTH;
 
+    if (nid == NID_sha1) {
+        SHA1_Init(&salted_ctx_.sha1);
+        SHA1_Update(&salted_ctx_.sha1, salt.data(), salt.size());
+    } else {
+        SHA256_Init(&salted_ctx_.sha256);
+        SHA256_Update(&salted_ctx_.sha256, salt.data(), salt.size());
+    }
+
     return 0;
 }
 
 bool hashtree_info::check_block_hash(const uint8_t *expected,
-                                     const uint8_t *block) {
+                                     const uint8_t *block) const {
     check(block);
-    std::vector<uint8_t> hash(digest_length_, 0);
+    uint8_t hash[SHA256_DIGEST_LENGTH];
 
-    if (unlikely(get_hash(block, hash.data()) == -1)) {
+    if (unlikely(get_hash(block, hash) == -1)) {
         error("failed to hash");
         return false;
     }
 
     check(expected);
-    return !memcmp(expected, hash.data(), digest_length_);
+    return !memcmp(expected, hash, digest_length_);
 }
 
 bool hashtree_info::check_block_hash_with_index(uint64_t index,
-                                                const uint8_t *block) {
+                                                const uint8_t *block) const {
     check(index < data_blocks);
 
     const uint8_t *expected = &hash_data[index * padded_digest_length_];
@@ -62,6 +62,29 @@ inline uint64_t fec_ecc_get_size(uint64_t file_size, int roots)
                 + FEC_BLOCKSIZE;
 }
 
+/* Reed-Solomon codec for RS(FEC_RSM, FEC_RSM - roots) with FEC_PARAMS,
+   producing the same codes as init_rs_char(FEC_PARAMS(roots)). It works on
+   many codewords at once, using SIMD instructions where available, with the
+   codewords stored in rows: symbol j of codeword i is `rows[j][i]', as in
+   the interleaved blocks of an image */
+struct fec_rs;
+
+extern struct fec_rs *fec_rs_init(int roots);
+
+extern void fec_rs_free(struct fec_rs *rs);
+
+/* computes the parity of `count' codewords from the FEC_RSM - roots data
+   rows in `rows', and stores the roots bytes for codeword i to
+   `parity[i * roots]' */
+extern void fec_rs_encode(const struct fec_rs *rs, const uint8_t *const *rows,
+        size_t count, uint8_t *parity);
+
+/* computes the syndromes of `count' codewords from the FEC_RSM rows of data
+   and parity in `rows', and sets `errors[i]' to 1 if codeword i has errors
+   and needs to be corrected with decode_rs_char, 0 otherwise; returns the
+   number of codewords with errors */
+extern size_t fec_rs_check(const struct fec_rs *rs, const uint8_t *const *rows,
+        size_t count, uint8_t *errors);
 
 #ifdef __cplusplus
 } /* extern "C" */
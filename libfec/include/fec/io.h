@@ -92,6 +92,8 @@ extern int fec_open(struct fec_handle **f, const char *path, int mode,
 
 extern int fec_close(struct fec_handle *f);
 
+extern int fec_set_threads(struct fec_handle *f, int threads);
+
 extern int fec_verity_set_status(struct fec_handle *f, bool enabled);
 
 extern int fec_verity_get_metadata(struct fec_handle *f,
@@ -147,6 +149,10 @@ namespace fec {
             return !fec_close(handle_.release());
         }
 
+        bool set_threads(int threads) {
+            return !fec_set_threads(handle_.get(), threads);
+        }
+
         bool seek(int64_t offset, int whence) {
             return !fec_seek(handle_.get(), offset, whence);
         }
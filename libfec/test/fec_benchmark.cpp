@@ -0,0 +1,341 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <android-base/file.h>
+#include <android-base/strings.h>
+#include <benchmark/benchmark.h>
+#include <verity/hash_tree_builder.h>
+
+extern "C" {
+#include <fec.h>
+}
+
+#include "../fec_private.h"
+#include "fec/io.h"
+
+// The size of the file system in the benchmark image.
+static constexpr uint64_t kDataSize = 64 * 1024 * 1024;
+
+// An image with verity metadata, created once for all benchmarks. Reads are
+// served from the page cache, so the benchmarks measure the cost of libfec
+// itself rather than the storage.
+class VerityImage {
+   public:
+    VerityImage() {
+        std::vector<uint8_t> image(kDataSize);
+        // Every block has different contents and none of them are zeros, so
+        // every block is read and verified.
+        uint32_t seed = 1;
+        for (size_t i = 0; i < image.size(); i += sizeof(seed)) {
+            seed = seed * 1103515245 + 12345;
+            memcpy(&image[i], &seed, sizeof(seed));
+        }
+
+        HashTreeBuilder builder(FEC_BLOCKSIZE,
+                                HashTreeBuilder::HashFunction("sha256"));
+        std::vector<uint8_t> salt(32, 10);
+        if (!builder.Initialize(image.size(), salt) ||
+            !builder.Update(image.data(), image.size()) ||
+            !builder.BuildHashTree() ||
+            !android::base::WriteFully(file_.fd, image.data(), image.size()) ||
+            !builder.WriteHashTreeToFd(file_.fd, image.size())) {
+            abort();
+        }
+        uint64_t metadata_start =
+            image.size() + builder.CalculateSize(image.size());
+
+        std::vector<std::string> table = {
+            "1",
+            "fake_block_device",
+            "fake_block_device",
+            "4096",
+            "4096",
+            std::to_string(kDataSize / FEC_BLOCKSIZE),
+            std::to_string(kDataSize / FEC_BLOCKSIZE),
+            "sha256",
+            HashTreeBuilder::BytesArrayToString(builder.root_hash()),
+            HashTreeBuilder::BytesArrayToString(salt),
+        };
+        std::string verity_table = android::base::Join(table, ' ');
+        verity_header header = {
+            VERITY_MAGIC, VERITY_VERSION, {},
+            static_cast<uint32_t>(verity_table.size())};
+
+        std::vector<uint8_t> metadata(VERITY_METADATA_SIZE, 0);
+        memcpy(metadata.data(), &header, sizeof(header));
+        memcpy(metadata.data() + sizeof(header), verity_table.data(),
+               verity_table.size());
+        if (pwrite64(file_.fd, metadata.data(), metadata.size(),
+                     metadata_start) != static_cast<ssize_t>(metadata.size())) {
+            abort();
+        }
+    }
+
+    const char *path() const { return file_.path; }
+
+   private:
+    TemporaryFile file_;
+};
+
+static const VerityImage &GetVerityImage() {
+    static VerityImage image;
+    return image;
+}
+
+// Reads the whole file system sequentially, returns false on failure.
+static bool ReadAll(fec::io &input, std::vector<uint8_t> &buffer) {
+    uint64_t offset = 0;
+    while (offset < kDataSize) {
+        ssize_t bytes = input.pread(buffer.data(), buffer.size(), offset);
+        if (bytes <= 0) {
+            return false;
+        }
+        offset += bytes;
+    }
+    return true;
+}
+
+// Reads the whole file system with a new handle every time, so every block
+// is verified against the hash tree. Arguments are the read size and the
+// number of threads.
+static void BM_fec_read(benchmark::State &state) {
+    std::vector<uint8_t> buffer(state.range(0));
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        fec::io input;
+        if (!input.open(GetVerityImage().path(), O_RDONLY) ||
+            !input.set_threads(state.range(1))) {
+            state.SkipWithError("failed to open the image");
+            return;
+        }
+        state.ResumeTiming();
+
+        if (!ReadAll(input, buffer)) {
+            state.SkipWithError("fec_pread failed");
+            return;
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * kDataSize);
+}
+BENCHMARK(BM_fec_read)
+    ->ArgsProduct({benchmark::CreateRange(FEC_BLOCKSIZE, 16 * 1024 * 1024, 4),
+                   {1, 4}})
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+// Reads the whole file system again with the same handle, where every
+// block has already been verified.
+static void BM_fec_reread(benchmark::State &state) {
+    std::vector<uint8_t> buffer(state.range(0));
+
+    fec::io input;
+    if (!input.open(GetVerityImage().path(), O_RDONLY) ||
+        !input.set_threads(state.range(1)) || !ReadAll(input, buffer)) {
+        state.SkipWithError("failed to read the image");
+        return;
+    }
+
+    for (auto _ : state) {
+        if (!ReadAll(input, buffer)) {
+            state.SkipWithError("fec_pread failed");
+            return;
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * kDataSize);
+}
+BENCHMARK(BM_fec_reread)
+    ->ArgsProduct({benchmark::CreateRange(FEC_BLOCKSIZE, 16 * 1024 * 1024, 4),
+                   {1, 4}})
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+// Reads the same data without libfec, for the upper bound.
+static void BM_raw_read(benchmark::State &state) {
+    size_t read_size = state.range(0);
+    std::vector<uint8_t> buffer(read_size);
+
+    android::base::unique_fd fd(
+        TEMP_FAILURE_RETRY(open(GetVerityImage().path(), O_RDONLY)));
+    if (fd == -1) {
+        state.SkipWithError("failed to open the image");
+        return;
+    }
+
+    for (auto _ : state) {
+        for (uint64_t offset = 0; offset < kDataSize; offset += read_size) {
+            if (!raw_pread(fd, buffer.data(), read_size, offset)) {
+                state.SkipWithError("pread failed");
+                return;
+            }
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * kDataSize);
+}
+BENCHMARK(BM_raw_read)
+    ->RangeMultiplier(4)
+    ->Range(FEC_BLOCKSIZE, 16 * 1024 * 1024)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+// The number of codewords in an RS block, one for each byte in a block.
+static constexpr size_t kCodewords = FEC_BLOCKSIZE;
+
+// Random data for an RS block stored as rows, as in an image.
+static std::vector<uint8_t> GetRsData() {
+    std::vector<uint8_t> data(FEC_RSM * kCodewords);
+    uint32_t seed = 1;
+    for (auto &byte : data) {
+        seed = seed * 1103515245 + 12345;
+        byte = seed >> 24;
+    }
+    return data;
+}
+
+static std::vector<const uint8_t *> GetRows(const std::vector<uint8_t> &data) {
+    std::vector<const uint8_t *> rows;
+    for (int j = 0; j < FEC_RSM; ++j) {
+        rows.push_back(&data[j * kCodewords]);
+    }
+    return rows;
+}
+
+// Encodes an RS block with each fec_rs implementation. Arguments are the
+// number of roots and the implementation.
+static void BM_fec_rs_encode(benchmark::State &state) {
+    int roots = state.range(0);
+    std::unique_ptr<fec_rs, decltype(&fec_rs_free)> rs(
+        fec_rs_init_impl(roots, static_cast<fec_rs_impl>(state.range(1))),
+        fec_rs_free);
+    if (!rs) {
+        state.SkipWithError("not supported");
+        return;
+    }
+
+    std::vector<uint8_t> data = GetRsData();
+    std::vector<const uint8_t *> rows = GetRows(data);
+    std::vector<uint8_t> parity(kCodewords * roots);
+
+    for (auto _ : state) {
+        fec_rs_encode(rs.get(), rows.data(), kCodewords, parity.data());
+        benchmark::DoNotOptimize(parity.data());
+    }
+    state.SetBytesProcessed(state.iterations() * kCodewords *
+                            (FEC_RSM - roots));
+}
+BENCHMARK(BM_fec_rs_encode)
+    ->ArgsProduct({{2, 24},
+                   {FEC_RS_SCALAR, FEC_RS_SSSE3, FEC_RS_AVX2, FEC_RS_NEON}});
+
+// Encodes the same RS block a codeword at a time with encode_rs_char.
+static void BM_encode_rs_char(benchmark::State &state) {
+    int roots = state.range(0);
+    std::unique_ptr<void, decltype(&free_rs_char)> rs(
+        init_rs_char(FEC_PARAMS(roots)), free_rs_char);
+
+    std::vector<uint8_t> data = GetRsData();
+    std::vector<uint8_t> parity(kCodewords * roots);
+    uint8_t codeword[FEC_RSM];
+
+    for (auto _ : state) {
+        for (size_t i = 0; i < kCodewords; ++i) {
+            for (int j = 0; j < FEC_RSM - roots; ++j) {
+                codeword[j] = data[j * kCodewords + i];
+            }
+            encode_rs_char(rs.get(), codeword, &parity[i * roots]);
+        }
+        benchmark::DoNotOptimize(parity.data());
+    }
+    state.SetBytesProcessed(state.iterations() * kCodewords *
+                            (FEC_RSM - roots));
+}
+BENCHMARK(BM_encode_rs_char)->Arg(2)->Arg(24);
+
+// Checks an RS block without errors with each fec_rs implementation.
+static void BM_fec_rs_check(benchmark::State &state) {
+    int roots = state.range(0);
+    std::unique_ptr<fec_rs, decltype(&fec_rs_free)> rs(
+        fec_rs_init_impl(roots, static_cast<fec_rs_impl>(state.range(1))),
+        fec_rs_free);
+    if (!rs) {
+        state.SkipWithError("not supported");
+        return;
+    }
+
+    std::vector<uint8_t> data = GetRsData();
+    std::vector<const uint8_t *> rows = GetRows(data);
+    std::vector<uint8_t> parity(kCodewords * roots);
+    fec_rs_encode(rs.get(), rows.data(), kCodewords, parity.data());
+    for (size_t i = 0; i < kCodewords; ++i) {
+        for (int k = 0; k < roots; ++k) {
+            data[(FEC_RSM - roots + k) * kCodewords + i] =
+                parity[i * roots + k];
+        }
+    }
+    std::vector<uint8_t> errors(kCodewords);
+
+    for (auto _ : state) {
+        if (fec_rs_check(rs.get(), rows.data(), kCodewords, errors.data())) {
+            state.SkipWithError("unexpected errors");
+            return;
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * kCodewords * FEC_RSM);
+}
+BENCHMARK(BM_fec_rs_check)
+    ->ArgsProduct({{2, 24},
+                   {FEC_RS_SCALAR, FEC_RS_SSSE3, FEC_RS_AVX2, FEC_RS_NEON}});
+
+// Decodes the same RS block a codeword at a time with decode_rs_char, which
+// is what libfec did for every codeword before checking the syndromes.
+static void BM_decode_rs_char(benchmark::State &state) {
+    int roots = state.range(0);
+    std::unique_ptr<void, decltype(&free_rs_char)> rs(
+        init_rs_char(FEC_PARAMS(roots)), free_rs_char);
+
+    std::vector<uint8_t> data = GetRsData();
+    std::vector<uint8_t> codewords(kCodewords * FEC_RSM);
+    for (size_t i = 0; i < kCodewords; ++i) {
+        for (int j = 0; j < FEC_RSM - roots; ++j) {
+            codewords[i * FEC_RSM + j] = data[j * kCodewords + i];
+        }
+        encode_rs_char(rs.get(), &codewords[i * FEC_RSM],
+                       &codewords[i * FEC_RSM + FEC_RSM - roots]);
+    }
+
+    for (auto _ : state) {
+        for (size_t i = 0; i < kCodewords; ++i) {
+            if (decode_rs_char(rs.get(), &codewords[i * FEC_RSM], nullptr,
+                               0) != 0) {
+                state.SkipWithError("unexpected errors");
+                return;
+            }
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * kCodewords * FEC_RSM);
+}
+BENCHMARK(BM_decode_rs_char)->Arg(2)->Arg(24);
+
+BENCHMARK_MAIN();
@@ -17,6 +17,7 @@
 #include <stdint.h>
 #include <stdlib.h>
 
+#include <algorithm>
 #include <string>
 #include <vector>
 
@@ -25,6 +26,10 @@
 #include <gtest/gtest.h>
 #include <verity/hash_tree_builder.h>
 
+extern "C" {
+#include <fec.h>
+}
+
 #include "../fec_private.h"
 #include "fec/io.h"
 
@@ -217,6 +222,136 @@ TEST_F(FecUnitTest, VerityImage_FecRead) {
     ASSERT_EQ(std::vector<uint8_t>(1024, 255), read_data);
 }
 
+TEST_F(FecUnitTest, VerityImage_FecReadMultipleBlocks) {
+    TemporaryFile verity_image;
+    BuildAndAppendsVerityMetadata();
+    std::vector<uint8_t> expected(image_.begin(), image_.begin() + 1024 * 1024);
+    ASSERT_TRUE(android::base::WriteFully(verity_image.fd, image_.data(),
+                                          image_.size()));
+    TemporaryFile ecc_image;
+    BuildAndAppendsEccImage(verity_image.path, ecc_image.path);
+    std::string ecc_content;
+    ASSERT_TRUE(android::base::ReadFileToString(ecc_image.path, &ecc_content));
+    ASSERT_TRUE(android::base::WriteStringToFd(ecc_content, verity_image.fd));
+
+    // Corrupt blocks in the middle of a multi-block read.
+    for (uint64_t corrupt_offset : {4096 * 10 + 7, 4096 * 100, 4096 * 101}) {
+        ASSERT_EQ(corrupt_offset, lseek64(verity_image.fd, corrupt_offset, 0));
+        std::vector<uint8_t> corruption(100, 3);
+        ASSERT_TRUE(android::base::WriteFully(
+            verity_image.fd, corruption.data(), corruption.size()));
+    }
+
+    struct fec_handle *handle = nullptr;
+    ASSERT_EQ(0,
+              fec_open(&handle, verity_image.path, O_RDONLY, FEC_FS_EXT4, 2));
+    fec::handle guard(handle, fec_close);
+
+    // A whole-image read, starting and ending in the middle of a block.
+    std::vector<uint8_t> read_data(expected.size() - 200, 0);
+    ASSERT_EQ(static_cast<ssize_t>(read_data.size()),
+              fec_pread(handle, read_data.data(), read_data.size(), 100));
+    ASSERT_EQ(std::vector<uint8_t>(expected.begin() + 100, expected.end() - 100),
+              read_data);
+
+    // Block aligned reads of various sizes.
+    for (size_t size : {4096, 3 * 4096, 64 * 4096, 100 * 4096}) {
+        read_data.resize(size);
+        ASSERT_EQ(static_cast<ssize_t>(size),
+                  fec_pread(handle, read_data.data(), size, 4096 * 90));
+        ASSERT_EQ(std::vector<uint8_t>(expected.begin() + 4096 * 90,
+                                       expected.begin() + 4096 * 90 + size),
+                  read_data);
+    }
+}
+
+TEST_F(FecUnitTest, VerityImage_FecReadThreads) {
+    TemporaryFile verity_image;
+    BuildAndAppendsVerityMetadata();
+    std::vector<uint8_t> expected(image_.begin(), image_.begin() + 1024 * 1024);
+    ASSERT_TRUE(android::base::WriteFully(verity_image.fd, image_.data(),
+                                          image_.size()));
+
+    struct fec_handle *handle = nullptr;
+    ASSERT_EQ(0,
+              fec_open(&handle, verity_image.path, O_RDONLY, FEC_FS_EXT4, 2));
+    fec::handle guard(handle, fec_close);
+
+    for (int threads : {1, 2, 4, 0}) {
+        ASSERT_EQ(0, fec_set_threads(handle, threads));
+        ASSERT_EQ(nullptr, handle->pool);
+
+        std::vector<uint8_t> read_data(expected.size(), 0);
+        ASSERT_EQ(static_cast<ssize_t>(read_data.size()),
+                  fec_pread(handle, read_data.data(), read_data.size(), 0));
+        ASSERT_EQ(expected, read_data);
+        if (threads == 1) {
+            ASSERT_EQ(nullptr, handle->pool);
+        } else if (threads > 1) {
+            ASSERT_NE(nullptr, handle->pool);
+        }
+    }
+    ASSERT_EQ(-1, fec_set_threads(handle, -1));
+}
+
+TEST_F(FecUnitTest, VerityImage_VerifiedBlocks) {
+    TemporaryFile verity_image;
+    BuildAndAppendsVerityMetadata();
+    ASSERT_TRUE(android::base::WriteFully(verity_image.fd, image_.data(),
+                                          image_.size()));
+    TemporaryFile ecc_image;
+    BuildAndAppendsEccImage(verity_image.path, ecc_image.path);
+    std::string ecc_content;
+    ASSERT_TRUE(android::base::ReadFileToString(ecc_image.path, &ecc_content));
+    ASSERT_TRUE(android::base::WriteStringToFd(ecc_content, verity_image.fd));
+
+    uint64_t corrupt_offset = 4096 * 10;
+    ASSERT_EQ(corrupt_offset, lseek64(verity_image.fd, corrupt_offset, 0));
+    std::vector<uint8_t> corruption(50, 99);
+    ASSERT_TRUE(android::base::WriteFully(verity_image.fd, corruption.data(),
+                                          corruption.size()));
+
+    auto is_verified = [](fec_handle *handle, uint64_t block) {
+        return (handle->verified[block / 64] & (1ULL << (block % 64))) != 0;
+    };
+    std::vector<uint8_t> read_data(4096 * 4, 0);
+    std::vector<uint8_t> expected(image_.begin() + 4096 * 9,
+                                  image_.begin() + 4096 * 13);
+
+    // Corrected blocks are not marked as verified in read-only mode, because
+    // the block on disk is still corrupted.
+    struct fec_handle *handle = nullptr;
+    ASSERT_EQ(0,
+              fec_open(&handle, verity_image.path, O_RDONLY, FEC_FS_EXT4, 2));
+    fec::handle guard(handle, fec_close);
+    for (int i = 1; i <= 2; i++) {
+        ASSERT_EQ(static_cast<ssize_t>(read_data.size()),
+                  fec_pread(handle, read_data.data(), read_data.size(),
+                            4096 * 9));
+        ASSERT_EQ(expected, read_data);
+        ASSERT_TRUE(is_verified(handle, 9));
+        ASSERT_FALSE(is_verified(handle, 10));
+        ASSERT_TRUE(is_verified(handle, 11));
+        ASSERT_FALSE(is_verified(handle, 13));
+        ASSERT_EQ(i * 50u, handle->errors);
+    }
+    guard.reset();
+
+    // In read-write mode the corrected block is written back, so it is only
+    // corrected once.
+    handle = nullptr;
+    ASSERT_EQ(0, fec_open(&handle, verity_image.path, O_RDWR, FEC_FS_EXT4, 2));
+    guard.reset(handle);
+    for (int i = 1; i <= 2; i++) {
+        ASSERT_EQ(static_cast<ssize_t>(read_data.size()),
+                  fec_pread(handle, read_data.data(), read_data.size(),
+                            4096 * 9));
+        ASSERT_EQ(expected, read_data);
+        ASSERT_TRUE(is_verified(handle, 10));
+        ASSERT_EQ(50u, handle->errors);
+    }
+}
+
 TEST_F(FecUnitTest, LoadAvbImage_HashtreeFooter) {
     TemporaryFile avb_image;
     ASSERT_TRUE(
@@ -298,3 +433,123 @@ TEST_F(FecUnitTest, AvbImage_FecRead) {
     ASSERT_EQ(1024, fec_pread(handle, read_data.data(), 1024, corrupt_offset));
     ASSERT_EQ(std::vector<uint8_t>(1024, 10), read_data);
 }
+
+// Codewords stored as rows for fec_rs_encode and fec_rs_check, with the
+// parity in the last `roots' rows.
+class RsRows {
+   public:
+    RsRows(int roots, size_t count)
+        : roots_(roots), count_(count), data_(FEC_RSM * count) {
+        uint32_t seed = roots * count;
+        for (auto &byte : data_) {
+            seed = seed * 1103515245 + 12345;
+            byte = seed >> 24;
+        }
+        for (int j = 0; j < FEC_RSM; ++j) {
+            rows_.push_back(&data_[j * count]);
+        }
+    }
+
+    const uint8_t *const *rows() const { return rows_.data(); }
+    uint8_t &at(size_t codeword, int j) { return data_[j * count_ + codeword]; }
+
+    std::vector<uint8_t> codeword(size_t i) const {
+        std::vector<uint8_t> data(FEC_RSM);
+        for (int j = 0; j < FEC_RSM; ++j) {
+            data[j] = data_[j * count_ + i];
+        }
+        return data;
+    }
+
+    // Stores codeword-major `parity' to the parity rows.
+    void SetParity(const std::vector<uint8_t> &parity) {
+        for (size_t i = 0; i < count_; ++i) {
+            for (int k = 0; k < roots_; ++k) {
+                at(i, FEC_RSM - roots_ + k) = parity[i * roots_ + k];
+            }
+        }
+    }
+
+   private:
+    int roots_;
+    size_t count_;
+    std::vector<uint8_t> data_;
+    std::vector<const uint8_t *> rows_;
+};
+
+static std::vector<fec_rs_impl> GetSupportedRsImpls(int roots) {
+    std::vector<fec_rs_impl> impls;
+    for (auto impl : {FEC_RS_SCALAR, FEC_RS_SSSE3, FEC_RS_AVX2, FEC_RS_NEON,
+                      FEC_RS_BEST}) {
+        fec_rs *rs = fec_rs_init_impl(roots, impl);
+        if (rs != nullptr) {
+            impls.push_back(impl);
+            fec_rs_free(rs);
+        }
+    }
+    return impls;
+}
+
+TEST(FecRsTest, EncodeMatchesEncodeRsChar) {
+    // Include counts that are not a multiple of any vector size.
+    for (int roots : {2, 8, 16, 24}) {
+        for (size_t count : {1, 15, 31, 100, 4096}) {
+            RsRows rows(roots, count);
+
+            void *ref = init_rs_char(FEC_PARAMS(roots));
+            ASSERT_NE(nullptr, ref);
+            std::vector<uint8_t> expected(count * roots);
+            for (size_t i = 0; i < count; ++i) {
+                encode_rs_char(ref, rows.codeword(i).data(),
+                               &expected[i * roots]);
+            }
+            free_rs_char(ref);
+
+            for (auto impl : GetSupportedRsImpls(roots)) {
+                fec_rs *rs = fec_rs_init_impl(roots, impl);
+                std::vector<uint8_t> parity(count * roots);
+                fec_rs_encode(rs, rows.rows(), count, parity.data());
+                fec_rs_free(rs);
+
+                ASSERT_EQ(expected, parity)
+                    << "roots " << roots << ", count " << count
+                    << ", impl " << impl;
+            }
+        }
+    }
+}
+
+TEST(FecRsTest, CheckFindsCorruptedCodewords) {
+    for (int roots : {2, 24}) {
+        size_t count = 1000;
+        RsRows rows(roots, count);
+
+        fec_rs *rs = fec_rs_init(roots);
+        ASSERT_NE(nullptr, rs);
+        std::vector<uint8_t> parity(count * roots);
+        fec_rs_encode(rs, rows.rows(), count, parity.data());
+        fec_rs_free(rs);
+        rows.SetParity(parity);
+
+        std::vector<size_t> corrupted = {0, 17, 31, 32, 500, 999};
+        for (size_t i : corrupted) {
+            rows.at(i, i % FEC_RSM) ^= 0x5a;
+        }
+
+        for (auto impl : GetSupportedRsImpls(roots)) {
+            fec_rs *rs = fec_rs_init_impl(roots, impl);
+            std::vector<uint8_t> errors(count, 0xff);
+            ASSERT_EQ(corrupted.size(),
+                      fec_rs_check(rs, rows.rows(), count, errors.data()))
+                << "impl " << impl;
+            fec_rs_free(rs);
+
+            for (size_t i = 0; i < count; ++i) {
+                bool expected = std::find(corrupted.begin(), corrupted.end(),
+                                          i) != corrupted.end();
+                ASSERT_EQ(expected, errors[i] == 1)
+                    << "codeword " << i << ", impl " << impl;
+            }
+        }
+    }
+}
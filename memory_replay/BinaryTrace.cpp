@@ -0,0 +1,279 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <err.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <stack>
+#include <unordered_map>
+#include <vector>
+
+#include <android-base/file.h>
+#include <android-base/unique_fd.h>
+
+#include "AllocParser.h"
+#include "BinaryTrace.h"
+#include "ReplayTimer.h"
+
+bool IsBinaryTraceFile(const char* filename) {
+  android::base::unique_fd fd(TEMP_FAILURE_RETRY(open(filename, O_RDONLY | O_CLOEXEC)));
+  if (fd == -1) {
+    return false;
+  }
+  char magic[sizeof(kBinaryTraceMagic)];
+  return android::base::ReadFully(fd, magic, sizeof(magic)) &&
+         memcmp(magic, kBinaryTraceMagic, sizeof(magic)) == 0;
+}
+
+void BinaryTraceOpen(const char* filename, BinaryTrace* trace) {
+  android::base::unique_fd fd(TEMP_FAILURE_RETRY(open(filename, O_RDONLY | O_CLOEXEC)));
+  if (fd == -1) {
+    err(1, "Unable to open %s", filename);
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    err(1, "fstat of %s failed", filename);
+  }
+  size_t file_size = st.st_size;
+  if (file_size < sizeof(BinaryTraceHeader)) {
+    errx(1, "File Error: %s is too small to be a binary trace", filename);
+  }
+  void* map = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (map == MAP_FAILED) {
+    err(1, "Unable to map %s of size %zu", filename, file_size);
+  }
+  const BinaryTraceHeader* header = reinterpret_cast<const BinaryTraceHeader*>(map);
+  if (memcmp(header->magic, kBinaryTraceMagic, sizeof(kBinaryTraceMagic)) != 0) {
+    errx(1, "File Error: %s is not a binary trace", filename);
+  }
+  if (header->version != kBinaryTraceVersion || header->entry_size != sizeof(BinaryTraceEntry)) {
+    errx(1,
+         "File Error: %s has unsupported version %u or entry size %u, expected version %u, "
+         "convert the text trace again",
+         filename, header->version, header->entry_size, kBinaryTraceVersion);
+  }
+  if ((file_size - sizeof(BinaryTraceHeader)) / sizeof(BinaryTraceEntry) != header->num_entries ||
+      (file_size - sizeof(BinaryTraceHeader)) % sizeof(BinaryTraceEntry) != 0) {
+    errx(1, "File Error: %s is truncated, expected %" PRIu64 " entries", filename,
+         header->num_entries);
+  }
+
+  // Entries are read in order, so let the kernel read ahead aggressively.
+  madvise(map, file_size, MADV_SEQUENTIAL);
+
+  // Replay indexes arrays of threads and slots with the entries, so check
+  // them once here instead of for every replayed entry.
+  const BinaryTraceEntry* entries = reinterpret_cast<const BinaryTraceEntry*>(header + 1);
+  for (uint64_t i = 0; i < header->num_entries; i++) {
+    const BinaryTraceEntry& entry = entries[i];
+    if (entry.type > THREAD_DONE) {
+      errx(1, "File Error: %s entry %" PRIu64 " has unknown type %u", filename, i, entry.type);
+    }
+    if (entry.thread >= header->num_threads) {
+      errx(1, "File Error: %s entry %" PRIu64 " has thread %u, but only %u threads", filename, i,
+           entry.thread, header->num_threads);
+    }
+    if (entry.slot > header->max_live_allocs || entry.old_slot > header->max_live_allocs) {
+      errx(1, "File Error: %s entry %" PRIu64 " has slot %u/%u, but only %" PRIu64 " slots",
+           filename, i, entry.slot, entry.old_slot, header->max_live_allocs);
+    }
+  }
+
+  trace->header = header;
+  trace->entries = entries;
+  trace->num_entries = header->num_entries;
+  trace->map = map;
+  trace->map_size = file_size;
+}
+
+static uint32_t GetSlot(std::stack<uint32_t>& free_slots, uint64_t* num_slots) {
+  if (free_slots.empty()) {
+    return ++(*num_slots);
+  }
+  uint32_t slot = free_slots.top();
+  free_slots.pop();
+  return slot;
+}
+
+void BinaryTraceCreate(const AllocEntry* entries, size_t num_entries, BinaryTrace* trace) {
+  size_t map_size = sizeof(BinaryTraceHeader) + num_entries * sizeof(BinaryTraceEntry);
+  void* map = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE, -1, 0);
+  if (map == MAP_FAILED) {
+    err(1, "Unable to allocate a map of size %zu for the binary trace", map_size);
+  }
+  BinaryTraceHeader* header = reinterpret_cast<BinaryTraceHeader*>(map);
+  memcpy(header->magic, kBinaryTraceMagic, sizeof(kBinaryTraceMagic));
+  header->version = kBinaryTraceVersion;
+  header->entry_size = sizeof(BinaryTraceEntry);
+  header->num_entries = num_entries;
+  BinaryTraceEntry* binary_entries = reinterpret_cast<BinaryTraceEntry*>(header + 1);
+
+  // Freed slots are only reused by the thread that freed them, so reusing
+  // a slot never makes an allocation depend on another thread. Slots freed
+  // by a thread that is done are not reused.
+  uint64_t num_slots = 0;
+  std::vector<std::stack<uint32_t>> thread_free_slots;
+  std::unordered_map<uint64_t, uint32_t> ptr_to_slot;
+  // The size of every live allocation, so frees can record what they free.
+  std::unordered_map<uint64_t, uint64_t> ptr_to_bytes;
+  std::unordered_map<pid_t, uint32_t> tid_to_thread;
+  for (size_t i = 0; i < num_entries; i++) {
+    const AllocEntry& entry = entries[i];
+    BinaryTraceEntry* binary_entry = &binary_entries[i];
+    binary_entry->tid = entry.tid;
+    binary_entry->type = entry.type;
+    binary_entry->size = entry.size;
+    binary_entry->st = entry.st;
+    binary_entry->et = entry.et;
+
+    auto thread_entry = tid_to_thread.find(entry.tid);
+    if (thread_entry == tid_to_thread.end()) {
+      thread_entry = tid_to_thread.emplace(entry.tid, header->num_threads++).first;
+      thread_free_slots.emplace_back();
+      if (tid_to_thread.size() > header->max_active_threads) {
+        header->max_active_threads = tid_to_thread.size();
+      }
+    }
+    binary_entry->thread = thread_entry->second;
+    std::stack<uint32_t>& free_slots = thread_free_slots[thread_entry->second];
+
+    switch (entry.type) {
+      case CALLOC:
+        binary_entry->arg = entry.u.n_elements;
+        break;
+      case MEMALIGN:
+        binary_entry->arg = entry.u.align;
+        break;
+      case REALLOC:
+        if (entry.u.old_ptr != 0) {
+          auto slot_entry = ptr_to_slot.find(entry.u.old_ptr);
+          if (slot_entry == ptr_to_slot.end()) {
+            errx(1, "File Error: Failed to find realloc pointer %" PRIx64, entry.u.old_ptr);
+          }
+          binary_entry->old_slot = slot_entry->second;
+          binary_entry->arg = ptr_to_bytes[entry.u.old_ptr];
+          free_slots.push(slot_entry->second);
+          ptr_to_slot.erase(slot_entry);
+          ptr_to_bytes.erase(entry.u.old_ptr);
+        }
+        break;
+      case FREE:
+        if (entry.ptr != 0) {
+          auto slot_entry = ptr_to_slot.find(entry.ptr);
+          if (slot_entry == ptr_to_slot.end()) {
+            errx(1, "File Error: Unable to find free pointer %" PRIx64, entry.ptr);
+          }
+          binary_entry->slot = slot_entry->second;
+          binary_entry->size = ptr_to_bytes[entry.ptr];
+          free_slots.push(slot_entry->second);
+          ptr_to_slot.erase(slot_entry);
+          ptr_to_bytes.erase(entry.ptr);
+        }
+        break;
+      case MALLOC:
+      case THREAD_DONE:
+        break;
+    }
+
+    switch (entry.type) {
+      case MALLOC:
+      case CALLOC:
+      case MEMALIGN:
+      case REALLOC:
+        if (entry.ptr != 0) {
+          // If the pointer is still live, the trace missed its free. Keep
+          // the old slot allocated, so it is released when replay finishes.
+          binary_entry->slot = GetSlot(free_slots, &num_slots);
+          ptr_to_slot[entry.ptr] = binary_entry->slot;
+          ptr_to_bytes[entry.ptr] =
+              entry.type == CALLOC ? entry.u.n_elements * entry.size : entry.size;
+        }
+        break;
+      case THREAD_DONE:
+        free_slots = std::stack<uint32_t>();
+        tid_to_thread.erase(thread_entry);
+        break;
+      case FREE:
+        break;
+    }
+  }
+  header->max_live_allocs = num_slots;
+
+  trace->header = header;
+  trace->entries = binary_entries;
+  trace->num_entries = num_entries;
+  trace->map = map;
+  trace->map_size = map_size;
+}
+
+void BinaryTraceWrite(const BinaryTrace& trace, const char* filename) {
+  int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+  android::base::unique_fd fd(TEMP_FAILURE_RETRY(open(filename, flags, 0644)));
+  if (fd == -1) {
+    err(1, "Unable to create %s", filename);
+  }
+  if (!android::base::WriteFully(fd, trace.map, trace.map_size)) {
+    err(1, "Unable to write %s", filename);
+  }
+}
+
+void BinaryTraceFree(BinaryTrace* trace) {
+  if (trace->map != nullptr) {
+    munmap(trace->map, trace->map_size);
+  }
+  *trace = BinaryTrace();
+}
+
+void BinaryTraceGetEntry(const BinaryTraceEntry& binary_entry, AllocEntry* entry) {
+  entry->tid = binary_entry.tid;
+  entry->type = static_cast<AllocEnum>(binary_entry.type);
+  entry->ptr = binary_entry.slot;
+  entry->size = binary_entry.size;
+  if (binary_entry.type == REALLOC) {
+    entry->u.old_ptr = binary_entry.old_slot;
+  } else {
+    entry->u.n_elements = binary_entry.arg;
+  }
+  entry->st = binary_entry.st;
+  entry->et = binary_entry.et;
+}
+
+uint64_t BinaryTraceGetStartTime(const BinaryTrace& trace) {
+  return GetTraceStartTime(trace.entries, trace.num_entries);
+}
+
+int64_t BinaryTraceGetLiveBytesDelta(const BinaryTraceEntry& entry) {
+  switch (entry.type) {
+    case MALLOC:
+    case MEMALIGN:
+      return entry.slot != 0 ? entry.size : 0;
+    case CALLOC:
+      return entry.slot != 0 ? entry.arg * entry.size : 0;
+    case REALLOC:
+      return (entry.slot != 0 ? entry.size : 0) - (entry.old_slot != 0 ? entry.arg : 0);
+    case FREE:
+      return -entry.size;
+    default:
+      return 0;
+  }
+}
@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <sys/types.h>
+
+// Forward Declarations.
+struct AllocEntry;
+
+// A binary trace is a precompiled version of a text trace that can be
+// mapped and replayed directly. The file is a BinaryTraceHeader followed by
+// num_entries BinaryTraceEntry records, in the byte order of the machine
+// that created it.
+//
+// Pointers are replaced by slots, indexes into an array of max_live_allocs
+// live allocations. A slot value of zero represents a nullptr, so slot N
+// refers to array index N - 1. A freed slot is only reused by the thread
+// that freed it, so two threads share a slot only when one frees or
+// reallocs a pointer allocated by the other.
+//
+// Threads are replaced by thread indexes in [0, num_threads). A tid that
+// is reused after a thread_done gets a new thread index.
+
+constexpr char kBinaryTraceMagic[8] = {'M', 'E', 'M', 'T', 'R', 'A', 'C', 'E'};
+// Every change to the meaning of the fields bumps the version, and files
+// with any other version are rejected, so they must be converted again:
+// 1: The initial format.
+// 2: Free entries store the size of the freed allocation.
+// 3: Realloc entries store the size of the old allocation in arg.
+constexpr uint32_t kBinaryTraceVersion = 3;
+
+struct BinaryTraceHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t entry_size;
+  uint64_t num_entries;
+  // The number of slots used by the entries. It is at least the maximum
+  // number of allocations live at the same time.
+  uint64_t max_live_allocs;
+  uint32_t num_threads;
+  // The maximum number of threads alive at the same time.
+  uint32_t max_active_threads;
+  uint64_t reserved[3];
+};
+static_assert(sizeof(BinaryTraceHeader) == 64, "BinaryTraceHeader layout changed");
+
+struct BinaryTraceEntry {
+  // The requested size for allocations, the size of the freed allocation
+  // for free.
+  uint64_t size;
+  // n_elements for calloc, alignment for memalign, the size of the old
+  // allocation for realloc, zero otherwise.
+  uint64_t arg;
+  uint64_t st;
+  uint64_t et;
+  int32_t tid;
+  uint32_t thread;
+  // The slot of the returned pointer for allocations, the slot of the freed
+  // pointer for free.
+  uint32_t slot;
+  // The slot of the old pointer for realloc, zero otherwise.
+  uint32_t old_slot;
+  uint8_t type;
+  uint8_t reserved[7];
+};
+static_assert(sizeof(BinaryTraceEntry) == 56, "BinaryTraceEntry layout changed");
+
+struct BinaryTrace {
+  const BinaryTraceHeader* header = nullptr;
+  const BinaryTraceEntry* entries = nullptr;
+  size_t num_entries = 0;
+
+  void* map = nullptr;
+  size_t map_size = 0;
+};
+
+// Returns true if filename starts with the binary trace magic.
+bool IsBinaryTraceFile(const char* filename);
+
+// Map a binary trace file read-only. Exits on error.
+void BinaryTraceOpen(const char* filename, BinaryTrace* trace);
+
+// Convert parsed text entries into a binary trace kept in an anonymous map.
+// Exits if a freed pointer was never allocated.
+void BinaryTraceCreate(const AllocEntry* entries, size_t num_entries, BinaryTrace* trace);
+
+// Write a binary trace to filename. Exits on error.
+void BinaryTraceWrite(const BinaryTrace& trace, const char* filename);
+
+void BinaryTraceFree(BinaryTrace* trace);
+
+// Returns the earliest non zero start time of the entries, or zero if the
+// trace has no timestamps.
+uint64_t BinaryTraceGetStartTime(const BinaryTrace& trace);
+
+// Returns the change in the number of bytes the trace has allocated after
+// the entry.
+int64_t BinaryTraceGetLiveBytesDelta(const BinaryTraceEntry& entry);
+
+// Fill an AllocEntry from a binary entry, using slots as pointer values.
+void BinaryTraceGetEntry(const BinaryTraceEntry& binary_entry, AllocEntry* entry);
@@ -0,0 +1,325 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <err.h>
+#include <errno.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+
+#include "Alloc.h"
+#include "AllocParser.h"
+#include "BinaryTrace.h"
+#include "ConcurrentReplay.h"
+#include "LatencyStats.h"
+#include "ReplayTimer.h"
+#include "Pointers.h"
+#include "Utils.h"
+
+// Set in a slot sequence number when a thread sleeps waiting for it.
+static constexpr uint32_t kWaitersBit = 1U << 31;
+// Most dependencies are satisfied by the time they are checked, or shortly
+// after, so spin for a while before sleeping.
+static constexpr size_t kMaxSpins = 4000;
+
+// Use maps instead of new to avoid allocations in the replay process.
+template <typename T>
+static T* MapArray(size_t count, const char* name) {
+  size_t size = std::max<size_t>(count, 1) * sizeof(T);
+  void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE, -1, 0);
+  if (memory == MAP_FAILED) {
+    err(1, "Unable to allocate %zu %s", count, name);
+  }
+  return reinterpret_cast<T*>(memory);
+}
+
+template <typename T>
+static void UnmapArray(T* array, size_t count) {
+  if (array != nullptr) {
+    munmap(array, std::max<size_t>(count, 1) * sizeof(T));
+  }
+}
+
+static void FutexWait(std::atomic_uint32_t* addr, uint32_t value) {
+  syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr), FUTEX_WAIT_PRIVATE, value, nullptr,
+          nullptr, 0);
+}
+
+static void FutexWakeAll(std::atomic_uint32_t* addr) {
+  syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr,
+          nullptr, 0);
+}
+
+// Returns true if the thread had to sleep.
+static bool WaitForSeq(std::atomic_uint32_t* seq, uint32_t expected) {
+  for (size_t spins = 0; spins < kMaxSpins; spins++) {
+    if ((seq->load(std::memory_order_acquire) & ~kWaitersBit) == expected) {
+      return false;
+    }
+  }
+  while (true) {
+    uint32_t value = seq->load(std::memory_order_acquire);
+    if ((value & ~kWaitersBit) == expected) {
+      return true;
+    }
+    if ((value & kWaitersBit) == 0 &&
+        !seq->compare_exchange_weak(value, value | kWaitersBit, std::memory_order_acquire)) {
+      continue;
+    }
+    FutexWait(seq, value | kWaitersBit);
+  }
+}
+
+static void SetSeq(std::atomic_uint32_t* seq, uint32_t value) {
+  if (seq->exchange(value, std::memory_order_release) & kWaitersBit) {
+    FutexWakeAll(seq);
+  }
+}
+
+ConcurrentReplay::ConcurrentReplay(const BinaryTrace& trace, Pointers* pointers)
+    : trace_(trace),
+      pointers_(pointers),
+      num_entries_(trace.num_entries),
+      num_threads_(trace.header->num_threads),
+      num_slots_(trace.header->max_live_allocs + 1) {
+  PartitionEntries();
+  num_workers_ = std::max<size_t>(trace_.header->max_active_threads, 1);
+  workers_ = MapArray<pthread_t>(num_workers_, "worker threads");
+  worker_live_bytes_ = MapArray<LiveBytesCounter>(num_workers_, "worker live bytes");
+}
+
+ConcurrentReplay::~ConcurrentReplay() {
+  UnmapArray(ops_, num_entries_);
+  UnmapArray(thread_offsets_, num_threads_ + 1);
+  UnmapArray(slot_seqs_, num_slots_);
+  UnmapArray(workers_, num_workers_);
+  UnmapArray(worker_live_bytes_, num_workers_);
+  if (worker_latency_stats_ != nullptr) {
+    for (size_t i = 0; i < num_workers_; i++) {
+      LatencyStats::Destroy(worker_latency_stats_[i]);
+    }
+    UnmapArray(worker_latency_stats_, num_workers_);
+  }
+  LatencyStats::Destroy(latency_stats_);
+  UnmapArray(worker_timing_errors_, num_workers_);
+}
+
+void ConcurrentReplay::EnableLatencyStats() {
+  if (latency_stats_ != nullptr) {
+    return;
+  }
+  // The stats themselves are created by every Run().
+  latency_stats_ = LatencyStats::Create();
+  worker_latency_stats_ = MapArray<LatencyStats*>(num_workers_, "worker latency stats");
+}
+
+void ConcurrentReplay::EnableTimedReplay(double speedup) {
+  uint64_t start_nsecs = BinaryTraceGetStartTime(trace_);
+  if (start_nsecs == 0) {
+    errx(1, "File Error: The trace has no timestamps, it cannot be replayed in time");
+  }
+  uint64_t end_nsecs = start_nsecs;
+  for (size_t i = 0; i < num_entries_; i++) {
+    end_nsecs = std::max<uint64_t>(end_nsecs, trace_.entries[i].st);
+  }
+
+  timed_ = true;
+  timer_ = ReplayTimer(start_nsecs, speedup);
+  scaled_trace_nsecs_ = (end_nsecs - start_nsecs) / speedup;
+  if (worker_timing_errors_ == nullptr) {
+    worker_timing_errors_ = MapArray<LatencyHistogram>(num_workers_, "worker timing errors");
+  }
+}
+
+void ConcurrentReplay::PartitionEntries() {
+  size_t num_threads = num_threads_;
+  size_t num_slots = num_slots_;
+  ops_ = MapArray<ReplayOp>(num_entries_, "replay ops");
+  thread_offsets_ = MapArray<uint64_t>(num_threads + 1, "thread offsets");
+  slot_seqs_ = MapArray<std::atomic_uint32_t>(num_slots, "slot sequence numbers");
+
+  for (size_t i = 0; i < trace_.num_entries; i++) {
+    uint32_t thread = trace_.entries[i].thread;
+    if (thread >= num_threads) {
+      errx(1, "File Error: Entry %zu has thread index %u, but there are %zu threads", i, thread,
+           num_threads);
+    }
+    thread_offsets_[thread + 1]++;
+  }
+  for (size_t i = 0; i < num_threads; i++) {
+    thread_offsets_[i + 1] += thread_offsets_[i];
+  }
+
+  // The sequence numbers are computed in trace order, which is a valid
+  // order to execute all entries. A realloc moves its old slot first, so a
+  // realloc reusing its old slot waits for old_slot_seq, then slot_seq is
+  // reached by itself.
+  uint64_t* next_op = MapArray<uint64_t>(num_threads, "thread positions");
+  memcpy(next_op, thread_offsets_, num_threads * sizeof(uint64_t));
+  for (size_t i = 0; i < trace_.num_entries; i++) {
+    const BinaryTraceEntry& entry = trace_.entries[i];
+    if (entry.slot >= num_slots || entry.old_slot >= num_slots) {
+      errx(1, "File Error: Entry %zu uses a slot past the maximum live allocations %zu", i,
+           num_slots - 1);
+    }
+    ReplayOp& op = ops_[next_op[entry.thread]++];
+    op.entry_index = i;
+    if (entry.type == REALLOC && entry.old_slot != 0) {
+      op.old_slot_seq = slot_seqs_[entry.old_slot].fetch_add(1, std::memory_order_relaxed);
+    }
+    if (entry.slot != 0) {
+      op.slot_seq = slot_seqs_[entry.slot].fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+  UnmapArray(next_op, num_threads);
+  for (size_t i = 0; i < num_slots; i++) {
+    if (slot_seqs_[i].load(std::memory_order_relaxed) >= kWaitersBit) {
+      errx(1, "File Error: Slot %zu is used too many times", i);
+    }
+  }
+}
+
+void ConcurrentReplay::RunThread(uint32_t thread, size_t worker) {
+  LatencyStats* stats = worker_latency_stats_ != nullptr ? worker_latency_stats_[worker] : nullptr;
+  LatencyHistogram* timing_errors =
+      worker_timing_errors_ != nullptr ? &worker_timing_errors_[worker] : nullptr;
+  std::atomic_int64_t& live_bytes = worker_live_bytes_[worker].bytes;
+  uint64_t time_nsecs = 0;
+  uint64_t blocked_waits = 0;
+  AllocEntry entry;
+  for (uint64_t i = thread_offsets_[thread]; i < thread_offsets_[thread + 1]; i++) {
+    const ReplayOp& op = ops_[i];
+    const BinaryTraceEntry& binary_entry = trace_.entries[op.entry_index];
+    uint32_t slot = binary_entry.slot;
+    uint32_t old_slot = binary_entry.type == REALLOC ? binary_entry.old_slot : 0;
+    // Entries without a timestamp, like thread_done, run right away.
+    bool timed = timed_ && binary_entry.st != 0;
+    if (timed) {
+      timer_.WaitUntil(binary_entry.st);
+    }
+
+    bool blocked = false;
+    if (old_slot != 0) {
+      blocked |= WaitForSeq(&slot_seqs_[old_slot], op.old_slot_seq);
+    }
+    if (slot != 0 && slot != old_slot) {
+      blocked |= WaitForSeq(&slot_seqs_[slot], op.slot_seq);
+    }
+    if (blocked) {
+      blocked_waits++;
+    }
+    if (timed) {
+      uint64_t deadline = timer_.GetDeadline(binary_entry.st);
+      uint64_t now = Nanotime();
+      timing_errors->Record(now > deadline ? now - deadline : 0);
+    }
+
+    BinaryTraceGetEntry(binary_entry, &entry);
+    uint64_t entry_nsecs = AllocExecute(entry, pointers_);
+    time_nsecs += entry_nsecs;
+    if (stats != nullptr) {
+      stats->Record(entry, entry_nsecs);
+    }
+    // Only this worker writes its counter, so no atomic add is needed.
+    live_bytes.store(live_bytes.load(std::memory_order_relaxed) +
+                         BinaryTraceGetLiveBytesDelta(binary_entry),
+                     std::memory_order_relaxed);
+
+    if (old_slot != 0 && old_slot != slot) {
+      SetSeq(&slot_seqs_[old_slot], op.old_slot_seq + 1);
+    }
+    if (slot != 0) {
+      SetSeq(&slot_seqs_[slot], op.slot_seq + 1);
+    }
+  }
+  total_time_nsecs_ += time_nsecs;
+  num_blocked_waits_ += blocked_waits;
+}
+
+void ConcurrentReplay::RunWorker() {
+  size_t worker = next_worker_.fetch_add(1);
+  while (true) {
+    uint32_t thread = next_thread_.fetch_add(1);
+    if (thread >= num_threads_) {
+      break;
+    }
+    RunThread(thread, worker);
+  }
+}
+
+void ConcurrentReplay::Run() {
+  for (size_t i = 0; i < num_slots_; i++) {
+    slot_seqs_[i].store(0, std::memory_order_relaxed);
+  }
+  next_thread_ = 0;
+  next_worker_ = 0;
+  total_time_nsecs_ = 0;
+  num_blocked_waits_ = 0;
+  if (latency_stats_ != nullptr) {
+    // Only keep the latencies of the last run.
+    for (size_t i = 0; i < num_workers_; i++) {
+      LatencyStats::Destroy(worker_latency_stats_[i]);
+      worker_latency_stats_[i] = LatencyStats::Create();
+    }
+    LatencyStats::Destroy(latency_stats_);
+    latency_stats_ = LatencyStats::Create();
+  }
+  for (size_t i = 0; i < num_workers_; i++) {
+    worker_live_bytes_[i].bytes = 0;
+  }
+  timing_errors_ = {};
+  if (worker_timing_errors_ != nullptr) {
+    for (size_t i = 0; i < num_workers_; i++) {
+      worker_timing_errors_[i] = {};
+    }
+  }
+  uint64_t start_nsecs = Nanotime();
+  timer_.Start();
+  auto worker_runner = [](void* data) -> void* {
+    reinterpret_cast<ConcurrentReplay*>(data)->RunWorker();
+    return nullptr;
+  };
+  for (size_t i = 0; i < num_workers_; i++) {
+    if ((errno = pthread_create(&workers_[i], nullptr, worker_runner, this)) != 0) {
+      err(1, "Failed to create worker thread %zu", i);
+    }
+  }
+  for (size_t i = 0; i < num_workers_; i++) {
+    int ret = pthread_join(workers_[i], nullptr);
+    if (ret != 0) {
+      errx(1, "pthread_join failed: %s", strerror(ret));
+    }
+  }
+  wall_time_nsecs_ = Nanotime() - start_nsecs;
+  if (latency_stats_ != nullptr) {
+    for (size_t i = 0; i < num_workers_; i++) {
+      latency_stats_->Merge(*worker_latency_stats_[i]);
+    }
+  }
+  if (worker_timing_errors_ != nullptr) {
+    for (size_t i = 0; i < num_workers_; i++) {
+      timing_errors_.Merge(worker_timing_errors_[i]);
+    }
+  }
+}
@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <atomic>
+
+#include "LatencyStats.h"
+#include "MemorySampler.h"
+#include "ReplayTimer.h"
+
+// Forward Declarations.
+struct BinaryTrace;
+class Pointers;
+
+// Replays a binary trace with every trace thread running its own stream of
+// entries, instead of dispatching all entries from one thread.
+//
+// The only ordering enforced between threads is the one of the trace
+// pointers: each slot has a sequence number counting the entries that used
+// it so far. An entry waits until the sequence numbers of its slots reach
+// the values computed when partitioning the trace, so a free waits for the
+// allocation on another thread. Freed slots are only reused by the thread
+// that freed them, so an allocation never waits for another thread. Waiting
+// spins for a short time, then sleeps on a futex.
+//
+// Trace threads are run by a pool of max_active_threads workers, in the
+// order they first appear in the trace.
+//
+// In a timed replay, every entry also waits for its recorded start time,
+// scaled by the speedup, before running.
+class ConcurrentReplay {
+ public:
+  ConcurrentReplay(const BinaryTrace& trace, Pointers* pointers);
+  virtual ~ConcurrentReplay();
+
+  // Replay all entries and wait for all trace threads to finish. To run the
+  // trace again, the pointers of the previous run must be freed first.
+  void Run();
+
+  size_t num_workers() { return num_workers_; }
+  // The sum of the time spent in allocation calls by all threads.
+  uint64_t total_time_nsecs() { return total_time_nsecs_; }
+  // The elapsed time of Run().
+  uint64_t wall_time_nsecs() { return wall_time_nsecs_; }
+  // The number of entries that had to sleep waiting for another thread.
+  uint64_t num_blocked_waits() { return num_blocked_waits_; }
+
+  // Record the latency of every entry in histograms of the worker running
+  // it, which are merged at the end of Run().
+  void EnableLatencyStats();
+  // nullptr unless latency stats are enabled.
+  const LatencyStats* latency_stats() { return latency_stats_; }
+
+  // Run every entry at its recorded start time, relative to the earliest
+  // one. Exits if the trace has no timestamps.
+  void EnableTimedReplay(double speedup);
+  // How late entries started in the last timed run, compared to their
+  // deadlines. Includes the time spent waiting for other threads.
+  const LatencyHistogram& timing_errors() { return timing_errors_; }
+  // The duration of the trace, scaled by the speedup.
+  uint64_t scaled_trace_nsecs() { return scaled_trace_nsecs_; }
+
+  // The bytes allocated by the trace so far, one counter per worker. The
+  // sum is the number of live bytes.
+  const LiveBytesCounter* live_bytes_counters() { return worker_live_bytes_; }
+
+ private:
+  struct ReplayOp {
+    uint64_t entry_index;
+    // The sequence numbers slot and old_slot must reach before the entry
+    // can be executed.
+    uint32_t slot_seq;
+    uint32_t old_slot_seq;
+  };
+
+  void PartitionEntries();
+  void RunWorker();
+  void RunThread(uint32_t thread, size_t worker);
+
+  const BinaryTrace& trace_;
+  Pointers* pointers_ = nullptr;
+  size_t num_entries_ = 0;
+  size_t num_threads_ = 0;
+  size_t num_slots_ = 0;
+
+  // Ops of trace thread N are ops_[thread_offsets_[N], thread_offsets_[N + 1]).
+  ReplayOp* ops_ = nullptr;
+  uint64_t* thread_offsets_ = nullptr;
+  // Indexed by slot, slot zero is never waited for.
+  std::atomic_uint32_t* slot_seqs_ = nullptr;
+  pthread_t* workers_ = nullptr;
+  size_t num_workers_ = 0;
+  // Indexed by worker, so recording never contends.
+  LiveBytesCounter* worker_live_bytes_ = nullptr;
+  LatencyStats** worker_latency_stats_ = nullptr;
+  LatencyStats* latency_stats_ = nullptr;
+
+  bool timed_ = false;
+  ReplayTimer timer_{0, 1.0};
+  uint64_t scaled_trace_nsecs_ = 0;
+  // Indexed by worker.
+  LatencyHistogram* worker_timing_errors_ = nullptr;
+  LatencyHistogram timing_errors_ = {};
+
+  std::atomic_uint32_t next_thread_ = 0;
+  std::atomic_uint32_t next_worker_ = 0;
+  std::atomic_uint64_t total_time_nsecs_ = 0;
+  std::atomic_uint64_t num_blocked_waits_ = 0;
+  uint64_t wall_time_nsecs_ = 0;
+};
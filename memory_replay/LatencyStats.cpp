@@ -0,0 +1,238 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <err.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include <android-base/unique_fd.h>
+
+#include "LatencyStats.h"
+
+// The percentiles printed and written for every histogram.
+static constexpr double kPercentiles[] = {50, 90, 99, 99.9};
+static constexpr const char* kPercentileNames[] = {"p50", "p90", "p99", "p99.9"};
+
+size_t LatencyHistogram::GetBucket(uint64_t nsecs) {
+  if (nsecs < kSubBuckets) {
+    return nsecs;
+  }
+  size_t msb = 63 - __builtin_clzll(nsecs);
+  if (msb >= kMaxValueBits) {
+    return kNumBuckets - 1;
+  }
+  size_t shift = msb - kSubBucketBits;
+  return (shift + 1) * kSubBuckets + ((nsecs >> shift) & (kSubBuckets - 1));
+}
+
+uint64_t LatencyHistogram::GetBucketUpperBound(size_t bucket) {
+  if (bucket < kSubBuckets) {
+    return bucket;
+  }
+  size_t shift = bucket / kSubBuckets - 1;
+  uint64_t lower = (kSubBuckets + bucket % kSubBuckets) << shift;
+  return lower + (1ULL << shift) - 1;
+}
+
+void LatencyHistogram::Record(uint64_t nsecs) {
+  counts_[GetBucket(nsecs)]++;
+  count_++;
+  total_nsecs_ += nsecs;
+  max_nsecs_ = std::max(max_nsecs_, nsecs);
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram& other) {
+  if (other.count_ == 0) {
+    return;
+  }
+  for (size_t i = 0; i < kNumBuckets; i++) {
+    counts_[i] += other.counts_[i];
+  }
+  count_ += other.count_;
+  total_nsecs_ += other.total_nsecs_;
+  max_nsecs_ = std::max(max_nsecs_, other.max_nsecs_);
+}
+
+uint64_t LatencyHistogram::Percentile(double percentile) const {
+  if (count_ == 0) {
+    return 0;
+  }
+  // The rank of the percentile value, starting at 1.
+  uint64_t rank = static_cast<uint64_t>(count_ * percentile / 100.0 + 0.5);
+  rank = std::clamp<uint64_t>(rank, 1, count_);
+  uint64_t seen = 0;
+  for (size_t i = 0; i < kNumBuckets; i++) {
+    seen += counts_[i];
+    if (seen >= rank) {
+      return std::min(GetBucketUpperBound(i), max_nsecs_);
+    }
+  }
+  return max_nsecs_;
+}
+
+LatencyStats* LatencyStats::Create() {
+  void* memory =
+      mmap(nullptr, sizeof(LatencyStats), PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE, -1, 0);
+  if (memory == MAP_FAILED) {
+    err(1, "Unable to allocate latency histograms of size %zu", sizeof(LatencyStats));
+  }
+  return reinterpret_cast<LatencyStats*>(memory);
+}
+
+void LatencyStats::Destroy(LatencyStats* stats) {
+  if (stats != nullptr) {
+    munmap(stats, sizeof(LatencyStats));
+  }
+}
+
+size_t LatencyStats::GetSizeClass(uint64_t size) {
+  size_t size_class = 0;
+  for (uint64_t limit = 16; size > limit && size_class < kNumSizeClasses - 1; limit *= 4) {
+    size_class++;
+  }
+  return size_class;
+}
+
+const char* LatencyStats::GetSizeClassName(size_t size_class) {
+  static constexpr const char* kNames[kNumSizeClasses] = {
+      "<=16", "<=64", "<=256", "<=1K", "<=4K", "<=16K", "<=64K", ">64K",
+  };
+  return kNames[size_class];
+}
+
+const char* LatencyStats::GetOpName(AllocEnum type) {
+  switch (type) {
+    case MALLOC:
+      return "malloc";
+    case CALLOC:
+      return "calloc";
+    case MEMALIGN:
+      return "memalign";
+    case REALLOC:
+      return "realloc";
+    case FREE:
+      return "free";
+    case THREAD_DONE:
+      return "thread_done";
+  }
+  return "unknown";
+}
+
+void LatencyStats::Record(AllocEnum type, uint64_t size, uint64_t nsecs) {
+  if (type < kNumOpTypes) {
+    histograms_[type][GetSizeClass(size)].Record(nsecs);
+  }
+}
+
+void LatencyStats::Record(const AllocEntry& entry, uint64_t nsecs) {
+  uint64_t size = entry.size;
+  if (entry.type == CALLOC) {
+    size *= entry.u.n_elements;
+  }
+  Record(entry.type, size, nsecs);
+}
+
+void LatencyStats::Merge(const LatencyStats& other) {
+  for (size_t type = 0; type < kNumOpTypes; type++) {
+    for (size_t size_class = 0; size_class < kNumSizeClasses; size_class++) {
+      histograms_[type][size_class].Merge(other.histograms_[type][size_class]);
+    }
+  }
+}
+
+LatencyHistogram LatencyStats::GetAllSizes(AllocEnum type) const {
+  LatencyHistogram histogram = {};
+  for (size_t size_class = 0; size_class < kNumSizeClasses; size_class++) {
+    histogram.Merge(histograms_[type][size_class]);
+  }
+  return histogram;
+}
+
+static void PrintRow(int fd, const char* op, const char* size_class,
+                     const LatencyHistogram& histogram) {
+  dprintf(fd, "%-9s %-6s %12" PRIu64 " %10" PRIu64, op, size_class, histogram.count(),
+          histogram.total_nsecs() / histogram.count());
+  for (double percentile : kPercentiles) {
+    dprintf(fd, " %10" PRIu64, histogram.Percentile(percentile));
+  }
+  dprintf(fd, " %10" PRIu64 "\n", histogram.max_nsecs());
+}
+
+void LatencyStats::Print(int fd) const {
+  dprintf(fd, "%-9s %-6s %12s %10s", "Op", "Size", "Count", "Mean(ns)");
+  for (const char* name : kPercentileNames) {
+    dprintf(fd, " %10s", name);
+  }
+  dprintf(fd, " %10s\n", "max");
+  for (size_t type = 0; type < kNumOpTypes; type++) {
+    AllocEnum op = static_cast<AllocEnum>(type);
+    LatencyHistogram all_sizes = GetAllSizes(op);
+    if (all_sizes.count() == 0) {
+      continue;
+    }
+    for (size_t size_class = 0; size_class < kNumSizeClasses; size_class++) {
+      if (histograms_[type][size_class].count() != 0) {
+        PrintRow(fd, GetOpName(op), GetSizeClassName(size_class), histograms_[type][size_class]);
+      }
+    }
+    PrintRow(fd, GetOpName(op), "all", all_sizes);
+  }
+}
+
+static void WriteJsonObject(int fd, bool* first, const char* op, const char* size_class,
+                            const LatencyHistogram& histogram) {
+  dprintf(fd, "%s\n  {\"op\": \"%s\", \"size_class\": \"%s\", \"count\": %" PRIu64
+          ", \"mean_ns\": %" PRIu64,
+          *first ? "" : ",", op, size_class, histogram.count(),
+          histogram.total_nsecs() / histogram.count());
+  for (size_t i = 0; i < sizeof(kPercentiles) / sizeof(kPercentiles[0]); i++) {
+    dprintf(fd, ", \"%s_ns\": %" PRIu64, kPercentileNames[i],
+            histogram.Percentile(kPercentiles[i]));
+  }
+  dprintf(fd, ", \"max_ns\": %" PRIu64 "}", histogram.max_nsecs());
+  *first = false;
+}
+
+void LatencyStats::WriteJson(const char* filename) const {
+  android::base::unique_fd fd(
+      TEMP_FAILURE_RETRY(open(filename, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)));
+  if (fd == -1) {
+    err(1, "Unable to create %s", filename);
+  }
+  bool first = true;
+  dprintf(fd, "[");
+  for (size_t type = 0; type < kNumOpTypes; type++) {
+    AllocEnum op = static_cast<AllocEnum>(type);
+    LatencyHistogram all_sizes = GetAllSizes(op);
+    if (all_sizes.count() == 0) {
+      continue;
+    }
+    for (size_t size_class = 0; size_class < kNumSizeClasses; size_class++) {
+      if (histograms_[type][size_class].count() != 0) {
+        WriteJsonObject(fd, &first, GetOpName(op), GetSizeClassName(size_class),
+                        histograms_[type][size_class]);
+      }
+    }
+    WriteJsonObject(fd, &first, GetOpName(op), "all", all_sizes);
+  }
+  dprintf(fd, "\n]\n");
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "AllocParser.h"
+
+// A log-linear histogram of latencies in nanoseconds. Every power of two
+// range is split into kSubBuckets linear buckets, so a bucket is at most
+// 12.5% wide relative to its values. Recording only increments counters,
+// and histograms are merged by adding counters.
+class LatencyHistogram {
+ public:
+  static constexpr size_t kSubBucketBits = 3;
+  static constexpr size_t kSubBuckets = 1 << kSubBucketBits;
+  // Latencies are clamped to 2^40ns, about 18 minutes.
+  static constexpr size_t kMaxValueBits = 40;
+  static constexpr size_t kNumBuckets = (kMaxValueBits - kSubBucketBits + 1) * kSubBuckets;
+
+  void Record(uint64_t nsecs);
+  void Merge(const LatencyHistogram& other);
+
+  uint64_t count() const { return count_; }
+  uint64_t total_nsecs() const { return total_nsecs_; }
+  uint64_t max_nsecs() const { return max_nsecs_; }
+  // Returns the upper bound of the bucket containing the given percentile,
+  // in the range (0, 100], or 0 if the histogram is empty.
+  uint64_t Percentile(double percentile) const;
+
+  static size_t GetBucket(uint64_t nsecs);
+  static uint64_t GetBucketUpperBound(size_t bucket);
+
+ private:
+  uint64_t counts_[kNumBuckets];
+  uint64_t count_;
+  uint64_t total_nsecs_;
+  uint64_t max_nsecs_;
+};
+
+// Latency histograms per operation type and allocation size class. A
+// LatencyStats is big, so it is expected to be zero filled memory from a
+// map, where untouched histograms cost nothing.
+class LatencyStats {
+ public:
+  // The operation types are MALLOC to FREE of AllocEnum.
+  static constexpr size_t kNumOpTypes = THREAD_DONE;
+  // Size classes are powers of four from <= 16 bytes to > 64KB.
+  static constexpr size_t kNumSizeClasses = 8;
+
+  // Allocate a zeroed LatencyStats from a map. Exits on error.
+  static LatencyStats* Create();
+  static void Destroy(LatencyStats* stats);
+
+  // For free, size is the size of the freed allocation, if known.
+  void Record(AllocEnum type, uint64_t size, uint64_t nsecs);
+  void Record(const AllocEntry& entry, uint64_t nsecs);
+  void Merge(const LatencyStats& other);
+
+  const LatencyHistogram& Get(AllocEnum type, size_t size_class) const {
+    return histograms_[type][size_class];
+  }
+  // All size classes of an operation type merged.
+  LatencyHistogram GetAllSizes(AllocEnum type) const;
+
+  static size_t GetSizeClass(uint64_t size);
+  static const char* GetSizeClassName(size_t size_class);
+  static const char* GetOpName(AllocEnum type);
+
+  // Print a percentile table of all non empty histograms.
+  void Print(int fd) const;
+  // Write all non empty histograms as a JSON array. Exits on error.
+  void WriteJson(const char* filename) const;
+
+ private:
+  LatencyHistogram histograms_[kNumOpTypes][kNumSizeClasses];
+};
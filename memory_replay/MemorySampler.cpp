@@ -0,0 +1,252 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include <android-base/unique_fd.h>
+
+#include "MemorySampler.h"
+#include "NativeInfo.h"
+#include "Utils.h"
+
+// mallinfo only has int fields on glibc, mallinfo2 fixes that.
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+#define HAVE_MALLINFO2 1
+#endif
+
+static uint64_t GetAllocatorBytes() {
+#if defined(HAVE_MALLINFO2)
+  return mallinfo2().uordblks;
+#else
+  return mallinfo().uordblks;
+#endif
+}
+
+// Read a small proc file from the start, without reopening it.
+static bool ReadProcFile(int fd, char* buffer, size_t buffer_len) {
+  ssize_t bytes = TEMP_FAILURE_RETRY(pread(fd, buffer, buffer_len - 1, 0));
+  if (bytes <= 0) {
+    return false;
+  }
+  buffer[bytes] = '\0';
+  return true;
+}
+
+MemorySampler::MemorySampler(const char* filename, uint64_t interval_nsecs,
+                             const LiveBytesCounter* counters, size_t num_counters)
+    : interval_nsecs_(interval_nsecs), counters_(counters), num_counters_(num_counters) {
+  timeline_fd_.reset(
+      TEMP_FAILURE_RETRY(open(filename, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)));
+  if (timeline_fd_ == -1) {
+    err(1, "Unable to create %s", filename);
+  }
+  size_t len = strlen(filename);
+  json_ = len >= 5 && strcmp(&filename[len - 5], ".json") == 0;
+
+  statm_fd_.reset(open("/proc/self/statm", O_RDONLY | O_CLOEXEC));
+  if (statm_fd_ == -1) {
+    err(1, "Cannot open /proc/self/statm");
+  }
+  // Added in Linux 4.14, without it there is no cheap way to get the PSS.
+  smaps_rollup_fd_.reset(open("/proc/self/smaps_rollup", O_RDONLY | O_CLOEXEC));
+
+  pthread_condattr_t attr;
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&cond_, &attr);
+  pthread_condattr_destroy(&attr);
+}
+
+MemorySampler::~MemorySampler() {
+  pthread_cond_destroy(&cond_);
+}
+
+void MemorySampler::GetSample(MemorySample* sample) {
+  char buffer[2048];
+  static const size_t pagesize = getpagesize();
+  uint64_t size_pages = 0;
+  uint64_t resident_pages = 0;
+  if (ReadProcFile(statm_fd_, buffer, sizeof(buffer))) {
+    sscanf(buffer, "%" SCNu64 " %" SCNu64, &size_pages, &resident_pages);
+  }
+  sample->va_bytes = size_pages * pagesize;
+  sample->rss_bytes = resident_pages * pagesize;
+
+  uint64_t pss_kb = 0;
+  if (smaps_rollup_fd_ != -1 && ReadProcFile(smaps_rollup_fd_, buffer, sizeof(buffer))) {
+    char* pss = strstr(buffer, "\nPss:");
+    if (pss != nullptr) {
+      sscanf(pss, "\nPss: %" SCNu64, &pss_kb);
+    }
+  }
+  sample->pss_bytes = pss_kb * 1024;
+
+  sample->allocator_bytes = GetAllocatorBytes();
+
+  int64_t live_bytes = 0;
+  for (size_t i = 0; i < num_counters_; i++) {
+    live_bytes += counters_[i].bytes.load(std::memory_order_relaxed);
+  }
+  sample->live_bytes = live_bytes;
+}
+
+void MemorySampler::TakeSample() {
+  MemorySample sample;
+  GetSample(&sample);
+  sample.time_nsecs = Nanotime() - start_nsecs_;
+  WriteSample(sample);
+  num_samples_++;
+
+  if (sample.rss_bytes > peak_.rss_bytes) {
+    peak_rss_live_bytes_ = std::max<int64_t>(sample.live_bytes, 0);
+  }
+  peak_.rss_bytes = std::max(peak_.rss_bytes, sample.rss_bytes);
+  peak_.va_bytes = std::max(peak_.va_bytes, sample.va_bytes);
+  peak_.pss_bytes = std::max(peak_.pss_bytes, sample.pss_bytes);
+  peak_.allocator_bytes = std::max(peak_.allocator_bytes, sample.allocator_bytes);
+  peak_.live_bytes = std::max(peak_.live_bytes, sample.live_bytes);
+  if (sample.live_bytes > 0) {
+    uint64_t rss_growth = sample.rss_bytes - std::min(sample.rss_bytes, baseline_.rss_bytes);
+    fragmentation_ratio_sum_ += static_cast<double>(rss_growth) / sample.live_bytes;
+    num_fragmentation_ratios_++;
+  }
+}
+
+void MemorySampler::WriteSample(const MemorySample& sample) {
+  if (json_) {
+    dprintf(timeline_fd_,
+            "%s\n  {\"time_ns\": %" PRIu64 ", \"live_bytes\": %" PRId64 ", \"rss_bytes\": %" PRIu64
+            ", \"pss_bytes\": %" PRIu64 ", \"va_bytes\": %" PRIu64 ", \"allocator_bytes\": %" PRIu64
+            "}",
+            num_samples_ == 0 ? "" : ",", sample.time_nsecs, sample.live_bytes, sample.rss_bytes,
+            sample.pss_bytes, sample.va_bytes, sample.allocator_bytes);
+  } else {
+    dprintf(timeline_fd_,
+            "%" PRIu64 ",%" PRId64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 "\n",
+            sample.time_nsecs, sample.live_bytes, sample.rss_bytes, sample.pss_bytes,
+            sample.va_bytes, sample.allocator_bytes);
+  }
+}
+
+void MemorySampler::Run() {
+  uint64_t next_nsecs = Nanotime();
+  pthread_mutex_lock(&mutex_);
+  while (!stop_) {
+    TakeSample();
+
+    next_nsecs += interval_nsecs_;
+    struct timespec ts = {
+        .tv_sec = static_cast<time_t>(next_nsecs / 1000000000),
+        .tv_nsec = static_cast<long>(next_nsecs % 1000000000),
+    };
+    while (!stop_ && pthread_cond_timedwait(&cond_, &mutex_, &ts) != ETIMEDOUT) {
+    }
+  }
+  pthread_mutex_unlock(&mutex_);
+}
+
+void MemorySampler::Start() {
+  if (json_) {
+    dprintf(timeline_fd_, "{\"samples\": [");
+  } else {
+    dprintf(timeline_fd_, "time_ns,live_bytes,rss_bytes,pss_bytes,va_bytes,allocator_bytes\n");
+  }
+
+  GetSample(&baseline_);
+  baseline_.time_nsecs = 0;
+  start_nsecs_ = Nanotime();
+  stop_ = false;
+  auto sampler_runner = [](void* data) -> void* {
+    reinterpret_cast<MemorySampler*>(data)->Run();
+    return nullptr;
+  };
+  if ((errno = pthread_create(&thread_, nullptr, sampler_runner, this)) != 0) {
+    err(1, "Failed to create the memory sampling thread");
+  }
+}
+
+void MemorySampler::Stop() {
+  pthread_mutex_lock(&mutex_);
+  stop_ = true;
+  pthread_cond_signal(&cond_);
+  pthread_mutex_unlock(&mutex_);
+  int ret = pthread_join(thread_, nullptr);
+  if (ret != 0) {
+    errx(1, "pthread_join failed: %s", strerror(ret));
+  }
+
+  // Always include the state at the end of the replay.
+  TakeSample();
+
+  if (json_) {
+    dprintf(timeline_fd_,
+            "\n], \"summary\": {\"num_samples\": %zu, \"baseline_rss_bytes\": %" PRIu64
+            ", \"peak_live_bytes\": %" PRId64 ", \"peak_rss_bytes\": %" PRIu64
+            ", \"peak_pss_bytes\": %" PRIu64 ", \"peak_va_bytes\": %" PRIu64
+            ", \"peak_allocator_bytes\": %" PRIu64
+            ", \"peak_fragmentation_ratio\": %.3f, \"mean_fragmentation_ratio\": %.3f}}\n",
+            num_samples_, baseline_.rss_bytes, peak_.live_bytes, peak_.rss_bytes, peak_.pss_bytes,
+            peak_.va_bytes, peak_.allocator_bytes, peak_fragmentation_ratio(),
+            mean_fragmentation_ratio());
+  }
+}
+
+double MemorySampler::peak_fragmentation_ratio() const {
+  if (peak_rss_live_bytes_ == 0) {
+    return 0;
+  }
+  uint64_t rss_growth = peak_.rss_bytes - std::min(peak_.rss_bytes, baseline_.rss_bytes);
+  return static_cast<double>(rss_growth) / peak_rss_live_bytes_;
+}
+
+double MemorySampler::mean_fragmentation_ratio() const {
+  if (num_fragmentation_ratios_ == 0) {
+    return 0;
+  }
+  return fragmentation_ratio_sum_ / num_fragmentation_ratios_;
+}
+
+static void PrintBytes(int fd, const char* name, uint64_t bytes) {
+  char buffer[256];
+  NativeFormatFloat(buffer, sizeof(buffer), bytes, 1024 * 1024);
+  dprintf(fd, "%s: %" PRIu64 " bytes %sMB\n", name, bytes, buffer);
+}
+
+void MemorySampler::PrintSummary(int fd) const {
+  dprintf(fd, "Memory Samples: %zu\n", num_samples_);
+  PrintBytes(fd, "Baseline RSS", baseline_.rss_bytes);
+  PrintBytes(fd, "Peak Live Bytes", std::max<int64_t>(peak_.live_bytes, 0));
+  PrintBytes(fd, "Peak RSS", peak_.rss_bytes);
+  if (smaps_rollup_fd_ != -1) {
+    PrintBytes(fd, "Peak PSS", peak_.pss_bytes);
+  }
+  PrintBytes(fd, "Peak VA Space", peak_.va_bytes);
+  PrintBytes(fd, "Peak Allocator Bytes", peak_.allocator_bytes);
+  dprintf(fd, "Fragmentation Ratio At Peak RSS: %.3f\n", peak_fragmentation_ratio());
+  dprintf(fd, "Mean Fragmentation Ratio: %.3f\n", mean_fragmentation_ratio());
+}
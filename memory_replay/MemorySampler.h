@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <atomic>
+
+#include <android-base/unique_fd.h>
+
+// The number of bytes allocated by the trace, kept by one replay thread.
+// Signed, since a thread can free allocations made by another thread.
+struct alignas(64) LiveBytesCounter {
+  std::atomic_int64_t bytes;
+};
+
+struct MemorySample {
+  // Relative to the start of the sampling.
+  uint64_t time_nsecs;
+  // The sum of the sizes of the live allocations of the trace.
+  int64_t live_bytes;
+  // From /proc/self/statm.
+  uint64_t rss_bytes;
+  uint64_t va_bytes;
+  // From /proc/self/smaps_rollup, zero if it is not supported.
+  uint64_t pss_bytes;
+  // The bytes in use according to the allocator, from mallinfo.
+  uint64_t allocator_bytes;
+};
+
+// Samples the memory usage of the process from a background thread at a
+// fixed interval while a trace is replayed, and writes every sample to a
+// timeline file. The file is JSON if its name ends in .json, CSV otherwise.
+//
+// Samples only read /proc/self/statm and /proc/self/smaps_rollup from fds
+// kept open, and sum the live bytes counters of the replay threads, so
+// sampling often does not disturb the replay.
+class MemorySampler {
+ public:
+  // Exits if filename cannot be created.
+  MemorySampler(const char* filename, uint64_t interval_nsecs, const LiveBytesCounter* counters,
+                size_t num_counters);
+  virtual ~MemorySampler();
+
+  // Take the baseline sample and start the sampling thread.
+  void Start();
+  // Take a final sample and stop the sampling thread.
+  void Stop();
+
+  // Print the peak usage and fragmentation ratios.
+  void PrintSummary(int fd) const;
+
+  // Fill all fields of sample except time_nsecs.
+  void GetSample(MemorySample* sample);
+
+  size_t num_samples() const { return num_samples_; }
+  const MemorySample& baseline() const { return baseline_; }
+  const MemorySample& peak() const { return peak_; }
+  // The RSS growth above the baseline divided by the live bytes, at the
+  // peak RSS. Zero if nothing was live.
+  double peak_fragmentation_ratio() const;
+  // The mean of the ratio over all samples with live allocations.
+  double mean_fragmentation_ratio() const;
+
+ private:
+  void Run();
+  void TakeSample();
+  void WriteSample(const MemorySample& sample);
+
+  android::base::unique_fd timeline_fd_;
+  bool json_ = false;
+  android::base::unique_fd statm_fd_;
+  android::base::unique_fd smaps_rollup_fd_;
+  uint64_t interval_nsecs_ = 0;
+  const LiveBytesCounter* counters_ = nullptr;
+  size_t num_counters_ = 0;
+
+  pthread_t thread_;
+  pthread_mutex_t mutex_ = PTHREAD_MUTEX_INITIALIZER;
+  pthread_cond_t cond_;
+  bool stop_ = false;
+
+  uint64_t start_nsecs_ = 0;
+  size_t num_samples_ = 0;
+  MemorySample baseline_ = {};
+  // The maximum of every field, over all samples.
+  MemorySample peak_ = {};
+  // The RSS and live bytes of the sample with the peak RSS.
+  uint64_t peak_rss_live_bytes_ = 0;
+  double fragmentation_ratio_sum_ = 0;
+  size_t num_fragmentation_ratios_ = 0;
+};
@@ -110,6 +110,7 @@ void Pointers::FreeAll() {
   for (size_t i = 0; i < max_pointers_; i++) {
     if (atomic_load(&pointers_[i].key_pointer) != 0) {
       free(pointers_[i].pointer);
+      atomic_store(&pointers_[i].key_pointer, uintptr_t(0));
     }
   }
 }
@@ -35,6 +35,7 @@ class Pointers {
 
   size_t max_pointers() { return max_pointers_; }
 
+  // Free all remaining pointers, and empty the table so it can be reused.
   void FreeAll();
 
  private:
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <err.h>
+#include <errno.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "ReplayTimer.h"
+#include "Utils.h"
+
+ReplayTimer::ReplayTimer(uint64_t trace_start_nsecs, double speedup)
+    : trace_start_nsecs_(trace_start_nsecs), speedup_(speedup) {
+  if (!(speedup_ > 0)) {
+    errx(1, "The speedup must be greater than zero: %f", speedup_);
+  }
+}
+
+void ReplayTimer::Start() {
+  start_nsecs_ = Nanotime();
+}
+
+uint64_t ReplayTimer::GetDeadline(uint64_t trace_nsecs) const {
+  if (trace_nsecs <= trace_start_nsecs_) {
+    return start_nsecs_;
+  }
+  return start_nsecs_ + static_cast<uint64_t>((trace_nsecs - trace_start_nsecs_) / speedup_);
+}
+
+void ReplayTimer::WaitUntil(uint64_t trace_nsecs) const {
+  uint64_t deadline = GetDeadline(trace_nsecs);
+  uint64_t now = Nanotime();
+  if (now >= deadline) {
+    return;
+  }
+  if (deadline - now > kSpinNsecs) {
+    uint64_t wakeup = deadline - kSpinNsecs;
+    struct timespec ts = {
+        .tv_sec = static_cast<time_t>(wakeup / 1000000000),
+        .tv_nsec = static_cast<long>(wakeup % 1000000000),
+    };
+    int ret;
+    while ((ret = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr)) == EINTR) {
+    }
+    if (ret != 0) {
+      errno = ret;
+      err(1, "clock_nanosleep failed");
+    }
+  }
+  while (Nanotime() < deadline) {
+  }
+}
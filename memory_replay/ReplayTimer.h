@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <sys/types.h>
+
+// Maps the recorded start times of trace entries to deadlines on
+// CLOCK_MONOTONIC, so a replay reproduces the gaps between operations.
+//
+// Deadlines are absolute, so an entry that runs late does not push back
+// the entries after it. Long waits sleep with clock_nanosleep until
+// kSpinNsecs before the deadline, then spin, since a sleep alone overshoots
+// by the timer slack plus the wakeup latency.
+class ReplayTimer {
+ public:
+  static constexpr uint64_t kSpinNsecs = 100000;
+
+  // trace_start_nsecs is the earliest start time in the trace, which is
+  // replayed when Start() is called. With a speedup of 10, a gap of 10ms in
+  // the trace is replayed as a gap of 1ms.
+  ReplayTimer(uint64_t trace_start_nsecs, double speedup);
+
+  void Start();
+
+  // Returns the CLOCK_MONOTONIC time at which an entry that started at
+  // trace_nsecs should run.
+  uint64_t GetDeadline(uint64_t trace_nsecs) const;
+
+  // Wait until the deadline of trace_nsecs. Returns immediately if the
+  // deadline has passed.
+  void WaitUntil(uint64_t trace_nsecs) const;
+
+  double speedup() const { return speedup_; }
+  uint64_t start_nsecs() const { return start_nsecs_; }
+
+ private:
+  uint64_t trace_start_nsecs_ = 0;
+  double speedup_ = 1.0;
+  uint64_t start_nsecs_ = 0;
+};
+
+// Returns the earliest non zero start time of the entries, or zero if none
+// of them has a timestamp. Used for AllocEntry and BinaryTraceEntry arrays.
+template <typename Entry>
+uint64_t GetTraceStartTime(const Entry* entries, size_t num_entries) {
+  uint64_t start_nsecs = 0;
+  for (size_t i = 0; i < num_entries; i++) {
+    uint64_t st = entries[i].st;
+    if (st != 0 && (start_nsecs == 0 || st < start_nsecs)) {
+      start_nsecs = st;
+    }
+  }
+  return start_nsecs;
+}
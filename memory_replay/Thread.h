@@ -22,6 +22,7 @@
 
 // Forward Declarations.
 struct AllocEntry;
+class LatencyStats;
 class Pointers;
 
 class Thread {
@@ -39,6 +40,9 @@ class Thread {
   void set_pointers(Pointers* pointers) { pointers_ = pointers; }
   Pointers* pointers() { return pointers_; }
 
+  // nullptr unless latency stats are enabled in Threads.
+  LatencyStats* latency_stats() { return latency_stats_; }
+
   void SetAllocEntry(const AllocEntry* entry) { entry_ = entry; }
   const AllocEntry& GetAllocEntry() { return *entry_; }
 
@@ -52,6 +56,7 @@ class Thread {
   uint64_t total_time_nsecs_ = 0;
 
   Pointers* pointers_ = nullptr;
+  LatencyStats* latency_stats_ = nullptr;
 
   const AllocEntry* entry_;
 
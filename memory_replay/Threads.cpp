@@ -27,6 +27,7 @@
 #include <new>
 
 #include "Alloc.h"
+#include "LatencyStats.h"
 #include "Pointers.h"
 #include "Thread.h"
 #include "Threads.h"
@@ -36,7 +37,11 @@ void* ThreadRunner(void* data) {
   while (true) {
     thread->WaitForPending();
     const AllocEntry& entry = thread->GetAllocEntry();
-    thread->AddTimeNsecs(AllocExecute(entry, thread->pointers()));
+    uint64_t time_nsecs = AllocExecute(entry, thread->pointers());
+    thread->AddTimeNsecs(time_nsecs);
+    if (thread->latency_stats() != nullptr) {
+      thread->latency_stats()->Record(entry, time_nsecs);
+    }
     bool thread_done = entry.type == THREAD_DONE;
     thread->ClearPending();
     if (thread_done) {
@@ -67,6 +72,14 @@ Threads::~Threads() {
     threads_ = nullptr;
     data_size_ = 0;
   }
+  LatencyStats::Destroy(latency_stats_);
+  latency_stats_ = nullptr;
+}
+
+void Threads::EnableLatencyStats() {
+  if (latency_stats_ == nullptr) {
+    latency_stats_ = LatencyStats::Create();
+  }
 }
 
 Thread* Threads::CreateThread(pid_t tid) {
@@ -81,6 +94,9 @@ Thread* Threads::CreateThread(pid_t tid) {
   thread->tid_ = tid;
   thread->pointers_ = pointers_;
   thread->total_time_nsecs_ = 0;
+  if (latency_stats_ != nullptr) {
+    thread->latency_stats_ = LatencyStats::Create();
+  }
   if ((errno = pthread_create(&thread->thread_id_, nullptr, ThreadRunner, thread)) != 0) {
     err(1, "Failed to create thread %d: %s\n", tid, strerror(errno));
   }
@@ -140,6 +156,11 @@ void Threads::Finish(Thread* thread) {
     exit(1);
   }
   total_time_nsecs_ += thread->total_time_nsecs_;
+  if (thread->latency_stats_ != nullptr) {
+    latency_stats_->Merge(*thread->latency_stats_);
+    LatencyStats::Destroy(thread->latency_stats_);
+    thread->latency_stats_ = nullptr;
+  }
   thread->tid_ = 0;
   num_threads_--;
 }
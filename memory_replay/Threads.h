@@ -20,6 +20,7 @@
 #include <sys/types.h>
 
 // Forward Declarations.
+class LatencyStats;
 class Pointers;
 class Thread;
 
@@ -38,6 +39,13 @@ class Threads {
   size_t max_threads() { return max_threads_; }
   uint64_t total_time_nsecs() { return total_time_nsecs_; }
 
+  // Record the latency of every entry in histograms of the thread running
+  // it, which are merged when the thread finishes. Must be called before
+  // any thread is created.
+  void EnableLatencyStats();
+  // nullptr unless latency stats are enabled.
+  const LatencyStats* latency_stats() { return latency_stats_; }
+
  private:
   Pointers* pointers_ = nullptr;
   Thread* threads_ = nullptr;
@@ -45,6 +53,7 @@ class Threads {
   size_t max_threads_ = 0;
   size_t num_threads_= 0;
   uint64_t total_time_nsecs_ = 0;
+  LatencyStats* latency_stats_ = nullptr;
 
   Thread* FindEmptyEntry(pid_t tid);
   size_t GetHashEntry(pid_t tid);
@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include <dirent.h>
 #include <err.h>
 #include <inttypes.h>
 #include <malloc.h>
@@ -26,9 +27,8 @@
 #include <unistd.h>
 
 #include <algorithm>
-#include <stack>
+#include <random>
 #include <string>
-#include <unordered_map>
 #include <vector>
 
 #include <android-base/file.h>
@@ -36,25 +36,19 @@
 #include <benchmark/benchmark.h>
 
 #include "Alloc.h"
+#include "BinaryTrace.h"
+#include "ConcurrentReplay.h"
 #include "File.h"
+#include "LatencyStats.h"
+#include "Pointers.h"
 #include "Utils.h"
 
 struct TraceDataType {
-  AllocEntry* entries = nullptr;
-  size_t num_entries = 0;
+  BinaryTrace trace;
   void** ptrs = nullptr;
   size_t num_ptrs = 0;
 };
 
-static size_t GetIndex(std::stack<size_t>& free_indices, size_t* max_index) {
-  if (free_indices.empty()) {
-    return (*max_index)++;
-  }
-  size_t index = free_indices.top();
-  free_indices.pop();
-  return index;
-}
-
 static void FreePtrs(TraceDataType* trace_data) {
   for (size_t i = 0; i < trace_data->num_ptrs; i++) {
     void* ptr = trace_data->ptrs[i];
@@ -71,7 +65,7 @@ static void FreeTraceData(TraceDataType* trace_data) {
   }
 
   munmap(trace_data->ptrs, sizeof(void*) * trace_data->num_ptrs);
-  FreeEntries(trace_data->entries, trace_data->num_entries);
+  BinaryTraceFree(&trace_data->trace);
 }
 
 static void GetTraceData(const std::string& filename, TraceDataType* trace_data) {
@@ -86,61 +80,25 @@ static void GetTraceData(const std::string& filename, TraceDataType* trace_data)
   }
 
   cached_filename = filename;
-  GetUnwindInfo(filename.c_str(), &trace_data->entries, &trace_data->num_entries);
-
-  // This loop will convert the ptr field into an index into the ptrs array.
-  // Creating this index allows the trace run to quickly store or retrieve the
-  // allocation.
-  // For free, the ptr field will be index + one, where a zero represents
-  // a free(nullptr) call.
-  // For realloc, the old_pointer field will be index + one, where a zero
-  // represents a realloc(nullptr, XX).
-  trace_data->num_ptrs = 0;
-  std::stack<size_t> free_indices;
-  std::unordered_map<uint64_t, size_t> ptr_to_index;
-  for (size_t i = 0; i < trace_data->num_entries; i++) {
-    AllocEntry* entry = &trace_data->entries[i];
-    switch (entry->type) {
-      case MALLOC:
-      case CALLOC:
-      case MEMALIGN: {
-        size_t idx = GetIndex(free_indices, &trace_data->num_ptrs);
-        ptr_to_index[entry->ptr] = idx;
-        entry->ptr = idx;
-        break;
-      }
-      case REALLOC: {
-        if (entry->u.old_ptr != 0) {
-          auto idx_entry = ptr_to_index.find(entry->u.old_ptr);
-          if (idx_entry == ptr_to_index.end()) {
-            errx(1, "File Error: Failed to find realloc pointer %" PRIx64, entry->u.old_ptr);
-          }
-          size_t old_pointer_idx = idx_entry->second;
-          free_indices.push(old_pointer_idx);
-          ptr_to_index.erase(idx_entry);
-          entry->u.old_ptr = old_pointer_idx + 1;
-        }
-        size_t idx = GetIndex(free_indices, &trace_data->num_ptrs);
-        ptr_to_index[entry->ptr] = idx;
-        entry->ptr = idx;
-        break;
-      }
-      case FREE:
-        if (entry->ptr != 0) {
-          auto idx_entry = ptr_to_index.find(entry->ptr);
-          if (idx_entry == ptr_to_index.end()) {
-            errx(1, "File Error: Unable to find free pointer %" PRIx64, entry->ptr);
-          }
-          free_indices.push(idx_entry->second);
-          entry->ptr = idx_entry->second + 1;
-          ptr_to_index.erase(idx_entry);
-        }
-        break;
-      case THREAD_DONE:
-        break;
-    }
+  if (IsBinaryTraceFile(filename.c_str())) {
+    // Binary traces are mapped directly, so no parsing is needed.
+    BinaryTraceOpen(filename.c_str(), &trace_data->trace);
+  } else {
+    // Text traces are converted into a binary trace in memory, which
+    // replaces every pointer with a slot into the ptrs array. Using slots
+    // allows the trace run to quickly store or retrieve the allocation.
+    AllocEntry* entries;
+    size_t num_entries;
+    GetUnwindInfo(filename.c_str(), &entries, &num_entries);
+    BinaryTraceCreate(entries, num_entries, &trace_data->trace);
+    FreeEntries(entries, num_entries);
   }
-  void* map = mmap(nullptr, sizeof(void*) * trace_data->num_ptrs, PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE, -1, 0);
+
+  // Always map at least one pointer, so a trace without allocations still
+  // has a valid ptrs array.
+  trace_data->num_ptrs = std::max<size_t>(trace_data->trace.header->max_live_allocs, 1);
+  void* map = mmap(nullptr, sizeof(void*) * trace_data->num_ptrs, PROT_READ | PROT_WRITE,
+                   MAP_ANON | MAP_PRIVATE, -1, 0);
   if (map == MAP_FAILED) {
     err(1, "mmap failed\n");
   }
@@ -149,14 +107,30 @@ static void GetTraceData(const std::string& filename, TraceDataType* trace_data)
   cached_trace_data = *trace_data;
 }
 
-static void RunTrace(benchmark::State& state, TraceDataType* trace_data) {
+// Store an allocation in its slot. Slot zero means the traced call returned
+// nullptr, so there is nothing to keep the allocation for.
+static void StorePtr(void** ptrs, uint32_t slot, void* ptr, const char* name) {
+  if (slot == 0) {
+    free(ptr);
+    return;
+  }
+  if (ptrs[slot - 1] != nullptr) {
+    errx(1, "Internal Error: %s pointer being replaced is not nullptr", name);
+  }
+  ptrs[slot - 1] = ptr;
+}
+
+static void RunTrace(benchmark::State& state, TraceDataType* trace_data,
+                     LatencyStats* latency_stats) {
   int pagesize = getpagesize();
   uint64_t total_ns = 0;
   uint64_t start_ns;
+  uint64_t op_ns = 0;
   void** ptrs = trace_data->ptrs;
-  for (size_t i = 0; i < trace_data->num_entries; i++) {
+  const BinaryTraceEntry* entries = trace_data->trace.entries;
+  for (size_t i = 0; i < trace_data->trace.num_entries; i++) {
     void* ptr;
-    const AllocEntry& entry = trace_data->entries[i];
+    const BinaryTraceEntry& entry = entries[i];
     switch (entry.type) {
       case MALLOC:
         start_ns = Nanotime();
@@ -165,51 +139,42 @@ static void RunTrace(benchmark::State& state, TraceDataType* trace_data) {
           errx(1, "malloc returned nullptr");
         }
         MakeAllocationResident(ptr, entry.size, pagesize);
-        total_ns += Nanotime() - start_ns;
+        op_ns = Nanotime() - start_ns;
 
-        if (ptrs[entry.ptr] != nullptr) {
-          errx(1, "Internal Error: malloc pointer being replaced is not nullptr");
-        }
-        ptrs[entry.ptr] = ptr;
+        StorePtr(ptrs, entry.slot, ptr, "malloc");
         break;
 
       case CALLOC:
         start_ns = Nanotime();
-        ptr = calloc(entry.u.n_elements, entry.size);
+        ptr = calloc(entry.arg, entry.size);
         if (ptr == nullptr) {
           errx(1, "calloc returned nullptr");
         }
         MakeAllocationResident(ptr, entry.size, pagesize);
-        total_ns += Nanotime() - start_ns;
+        op_ns = Nanotime() - start_ns;
 
-        if (ptrs[entry.ptr] != nullptr) {
-          errx(1, "Internal Error: calloc pointer being replaced is not nullptr");
-        }
-        ptrs[entry.ptr] = ptr;
+        StorePtr(ptrs, entry.slot, ptr, "calloc");
         break;
 
       case MEMALIGN:
         start_ns = Nanotime();
-        ptr = memalign(entry.u.align, entry.size);
+        ptr = memalign(entry.arg, entry.size);
         if (ptr == nullptr) {
           errx(1, "memalign returned nullptr");
         }
         MakeAllocationResident(ptr, entry.size, pagesize);
-        total_ns += Nanotime() - start_ns;
+        op_ns = Nanotime() - start_ns;
 
-        if (ptrs[entry.ptr] != nullptr) {
-          errx(1, "Internal Error: memalign pointer being replaced is not nullptr");
-        }
-        ptrs[entry.ptr] = ptr;
+        StorePtr(ptrs, entry.slot, ptr, "memalign");
         break;
 
       case REALLOC:
         start_ns = Nanotime();
-        if (entry.u.old_ptr == 0) {
+        if (entry.old_slot == 0) {
           ptr = realloc(nullptr, entry.size);
         } else {
-          ptr = realloc(ptrs[entry.u.old_ptr - 1], entry.size);
-          ptrs[entry.u.old_ptr - 1] = nullptr;
+          ptr = realloc(ptrs[entry.old_slot - 1], entry.size);
+          ptrs[entry.old_slot - 1] = nullptr;
         }
         if (entry.size > 0) {
           if (ptr == nullptr) {
@@ -217,59 +182,122 @@ static void RunTrace(benchmark::State& state, TraceDataType* trace_data) {
           }
           MakeAllocationResident(ptr, entry.size, pagesize);
         }
-        total_ns += Nanotime() - start_ns;
+        op_ns = Nanotime() - start_ns;
 
-        if (ptrs[entry.ptr] != nullptr) {
-          errx(1, "Internal Error: realloc pointer being replaced is not nullptr");
-        }
-        ptrs[entry.ptr] = ptr;
+        StorePtr(ptrs, entry.slot, ptr, "realloc");
         break;
 
       case FREE:
-        if (entry.ptr != 0) {
-          ptr = ptrs[entry.ptr - 1];
-          ptrs[entry.ptr - 1] = nullptr;
+        if (entry.slot != 0) {
+          ptr = ptrs[entry.slot - 1];
+          ptrs[entry.slot - 1] = nullptr;
         } else {
           ptr = nullptr;
         }
         start_ns = Nanotime();
         free(ptr);
-        total_ns += Nanotime() - start_ns;
+        op_ns = Nanotime() - start_ns;
         break;
 
       case THREAD_DONE:
-        break;
+        continue;
     }
+    total_ns += op_ns;
+    // For free, the binary trace stores the size of the freed allocation.
+    latency_stats->Record(static_cast<AllocEnum>(entry.type),
+                          entry.type == CALLOC ? entry.arg * entry.size : entry.size, op_ns);
   }
   state.SetIterationTime(total_ns / double(1000000000.0));
 
   FreePtrs(trace_data);
 }
 
-// Run a trace as if all of the allocations occurred in a single thread.
-// This is not completely realistic, but it is a possible worst case that
-// could happen in an app.
-static void BenchmarkTrace(benchmark::State& state, const char* filename, bool enable_decay_time) {
+// Report the latency percentiles of every operation type in the trace, in
+// nanoseconds, across all iterations.
+static void SetLatencyCounters(benchmark::State& state, const LatencyStats& latency_stats) {
+  for (size_t type = 0; type < LatencyStats::kNumOpTypes; type++) {
+    AllocEnum op = static_cast<AllocEnum>(type);
+    LatencyHistogram histogram = latency_stats.GetAllSizes(op);
+    if (histogram.count() == 0) {
+      continue;
+    }
+    std::string name(LatencyStats::GetOpName(op));
+    state.counters[name + "_p50_ns"] = histogram.Percentile(50);
+    state.counters[name + "_p99_ns"] = histogram.Percentile(99);
+    state.counters[name + "_p99.9_ns"] = histogram.Percentile(99.9);
+  }
+}
+
+static void SetDecayTime(bool enable_decay_time) {
 #if defined(__BIONIC__)
   if (enable_decay_time) {
     mallopt(M_DECAY_TIME, 1);
   } else {
     mallopt(M_DECAY_TIME, 0);
   }
+#else
+  (void)enable_decay_time;
 #endif
-  std::string full_filename(android::base::GetExecutableDirectory() + "/traces/" + filename);
+}
+
+// Run a trace as if all of the allocations occurred in a single thread.
+// This is not completely realistic, but it is a possible worst case that
+// could happen in an app.
+static void BenchmarkTrace(benchmark::State& state, const std::string& filename,
+                           bool enable_decay_time) {
+  SetDecayTime(enable_decay_time);
 
   TraceDataType trace_data;
-  GetTraceData(full_filename, &trace_data);
+  GetTraceData(filename, &trace_data);
 
+  LatencyStats* latency_stats = LatencyStats::Create();
   for (auto _ : state) {
-    RunTrace(state, &trace_data);
+    RunTrace(state, &trace_data, latency_stats);
   }
+  SetLatencyCounters(state, *latency_stats);
+  LatencyStats::Destroy(latency_stats);
 
   // Don't free the trace_data, it is cached. The last set of trace data
   // will be leaked away.
 }
 
+// Run every thread of a trace on its own thread, only waiting for other
+// threads when freeing or reusing one of their allocations. The iteration
+// time is the elapsed time of the whole replay, so it includes the time
+// threads wait for each other and measures how the allocator scales.
+static void BenchmarkThreadedTrace(benchmark::State& state, const BinaryTrace& trace) {
+  Pointers pointers(std::max<size_t>(trace.header->max_live_allocs, 1));
+  ConcurrentReplay replay(trace, &pointers);
+  replay.EnableLatencyStats();
+
+  uint64_t total_time_nsecs = 0;
+  uint64_t blocked_waits = 0;
+  for (auto _ : state) {
+    replay.Run();
+    state.SetIterationTime(replay.wall_time_nsecs() / double(1000000000.0));
+    total_time_nsecs += replay.total_time_nsecs();
+    blocked_waits += replay.num_blocked_waits();
+    pointers.FreeAll();
+  }
+  state.counters["threads"] = replay.num_workers();
+  // The time spent in allocation calls by all threads, per iteration.
+  state.counters["alloc_time_us"] =
+      benchmark::Counter(total_time_nsecs / 1000.0, benchmark::Counter::kAvgIterations);
+  state.counters["blocked_waits"] =
+      benchmark::Counter(blocked_waits, benchmark::Counter::kAvgIterations);
+  // Only the latencies of the last iteration are kept.
+  SetLatencyCounters(state, *replay.latency_stats());
+}
+
+static void BenchmarkThreadedTraceFile(benchmark::State& state, const std::string& filename,
+                                       bool enable_decay_time) {
+  SetDecayTime(enable_decay_time);
+
+  TraceDataType trace_data;
+  GetTraceData(filename, &trace_data);
+  BenchmarkThreadedTrace(state, trace_data.trace);
+}
+
 #define BENCH_OPTIONS                 \
   UseManualTime()                     \
       ->Unit(benchmark::kMicrosecond) \
@@ -277,137 +305,174 @@ static void BenchmarkTrace(benchmark::State& state, const char* filename, bool e
       ->Repetitions(4)                \
       ->ReportAggregatesOnly(true)
 
-static void BM_angry_birds2(benchmark::State& state) {
-  BenchmarkTrace(state, "angry_birds2.zip", true);
-}
-BENCHMARK(BM_angry_birds2)->BENCH_OPTIONS;
-
-#if defined(__BIONIC__)
-static void BM_angry_birds2_no_decay(benchmark::State& state) {
-  BenchmarkTrace(state, "angry_birds2.zip", false);
-}
-BENCHMARK(BM_angry_birds2_no_decay)->BENCH_OPTIONS;
-#endif
-
-static void BM_camera(benchmark::State& state) {
-  BenchmarkTrace(state, "camera.zip", true);
-}
-BENCHMARK(BM_camera)->BENCH_OPTIONS;
-
-#if defined(__BIONIC__)
-static void BM_camera_no_decay(benchmark::State& state) {
-  BenchmarkTrace(state, "camera.zip", false);
-}
-BENCHMARK(BM_camera_no_decay)->BENCH_OPTIONS;
-#endif
-
-static void BM_candy_crush_saga(benchmark::State& state) {
-  BenchmarkTrace(state, "candy_crush_saga.zip", true);
-}
-BENCHMARK(BM_candy_crush_saga)->BENCH_OPTIONS;
-
-#if defined(__BIONIC__)
-static void BM_candy_crush_saga_no_decay(benchmark::State& state) {
-  BenchmarkTrace(state, "candy_crush_saga.zip", false);
-}
-BENCHMARK(BM_candy_crush_saga_no_decay)->BENCH_OPTIONS;
-#endif
-
-void BM_gmail(benchmark::State& state) {
-  BenchmarkTrace(state, "gmail.zip", true);
-}
-BENCHMARK(BM_gmail)->BENCH_OPTIONS;
-
-#if defined(__BIONIC__)
-void BM_gmail_no_decay(benchmark::State& state) {
-  BenchmarkTrace(state, "gmail.zip", false);
-}
-BENCHMARK(BM_gmail_no_decay)->BENCH_OPTIONS;
-#endif
-
-void BM_maps(benchmark::State& state) {
-  BenchmarkTrace(state, "maps.zip", true);
-}
-BENCHMARK(BM_maps)->BENCH_OPTIONS;
-
-#if defined(__BIONIC__)
-void BM_maps_no_decay(benchmark::State& state) {
-  BenchmarkTrace(state, "maps.zip", false);
-}
-BENCHMARK(BM_maps_no_decay)->BENCH_OPTIONS;
-#endif
-
-void BM_photos(benchmark::State& state) {
-  BenchmarkTrace(state, "photos.zip", true);
-}
-BENCHMARK(BM_photos)->BENCH_OPTIONS;
+// Register a single threaded and a threaded benchmark for every trace in
+// the traces directory next to the executable, with and without decay.
+static void RegisterTraceBenchmarks() {
+  std::string traces_dir(android::base::GetExecutableDirectory() + "/traces");
+  std::vector<std::string> filenames;
+  DIR* dir = opendir(traces_dir.c_str());
+  if (dir == nullptr) {
+    return;
+  }
+  dirent* entry;
+  while ((entry = readdir(dir)) != nullptr) {
+    std::string name(entry->d_name);
+    if (android::base::EndsWith(name, ".zip") || android::base::EndsWith(name, ".txt") ||
+        android::base::EndsWith(name, ".bin")) {
+      filenames.push_back(name);
+    }
+  }
+  closedir(dir);
+  std::sort(filenames.begin(), filenames.end());
+
+  for (const std::string& filename : filenames) {
+    std::string full_filename(traces_dir + "/" + filename);
+    // The names of zipped traces do not change, so results can be compared
+    // with older runs.
+    std::string name("BM_" + filename);
+    if (android::base::EndsWith(name, ".zip")) {
+      name.resize(name.size() - 4);
+    }
 
+    benchmark::RegisterBenchmark(name.c_str(), BenchmarkTrace, full_filename, true)->BENCH_OPTIONS;
 #if defined(__BIONIC__)
-void BM_photos_no_decay(benchmark::State& state) {
-  BenchmarkTrace(state, "photos.zip", false);
-}
-BENCHMARK(BM_photos_no_decay)->BENCH_OPTIONS;
+    benchmark::RegisterBenchmark((name + "_no_decay").c_str(), BenchmarkTrace, full_filename,
+                                 false)
+        ->BENCH_OPTIONS;
 #endif
-
-void BM_pubg(benchmark::State& state) {
-  BenchmarkTrace(state, "pubg.zip", true);
-}
-BENCHMARK(BM_pubg)->BENCH_OPTIONS;
-
+    benchmark::RegisterBenchmark((name + "_threaded").c_str(), BenchmarkThreadedTraceFile,
+                                 full_filename, true)
+        ->BENCH_OPTIONS;
 #if defined(__BIONIC__)
-void BM_pubg_no_decay(benchmark::State& state) {
-  BenchmarkTrace(state, "pubg.zip", false);
-}
-BENCHMARK(BM_pubg_no_decay)->BENCH_OPTIONS;
+    benchmark::RegisterBenchmark((name + "_threaded_no_decay").c_str(), BenchmarkThreadedTraceFile,
+                                 full_filename, false)
+        ->BENCH_OPTIONS;
 #endif
-
-void BM_surfaceflinger(benchmark::State& state) {
-  BenchmarkTrace(state, "surfaceflinger.zip", true);
+  }
 }
-BENCHMARK(BM_surfaceflinger)->BENCH_OPTIONS;
 
-#if defined(__BIONIC__)
-void BM_surfaceflinger_no_decay(benchmark::State& state) {
-  BenchmarkTrace(state, "surfaceflinger.zip", false);
-}
-BENCHMARK(BM_surfaceflinger_no_decay)->BENCH_OPTIONS;
-#endif
+// Synthetic workloads are generated as text trace entries, so they are
+// replayed exactly like a recorded trace.
+class TraceGenerator {
+ public:
+  void Malloc(pid_t tid, size_t size) {
+    AllocEntry entry = {.tid = tid, .type = MALLOC, .ptr = next_ptr_, .size = size};
+    entries_.push_back(entry);
+    next_ptr_ += 16;
+  }
+  void Free(pid_t tid, uint64_t ptr) {
+    AllocEntry entry = {.tid = tid, .type = FREE, .ptr = ptr};
+    entries_.push_back(entry);
+  }
+  void ThreadDone(pid_t tid) {
+    AllocEntry entry = {.tid = tid, .type = THREAD_DONE};
+    entries_.push_back(entry);
+  }
+  // The pointer the next Malloc will return.
+  uint64_t next_ptr() const { return next_ptr_; }
 
-void BM_system_server(benchmark::State& state) {
-  BenchmarkTrace(state, "system_server.zip", true);
-}
-BENCHMARK(BM_system_server)->BENCH_OPTIONS;
+  void Create(BinaryTrace* trace) { BinaryTraceCreate(entries_.data(), entries_.size(), trace); }
 
-#if defined(__BIONIC__)
-void BM_system_server_no_decay(benchmark::State& state) {
-  BenchmarkTrace(state, "system_server.zip", false);
-}
-BENCHMARK(BM_system_server_no_decay)->BENCH_OPTIONS;
-#endif
+ private:
+  std::vector<AllocEntry> entries_;
+  uint64_t next_ptr_ = 0x1000;
+};
 
-void BM_systemui(benchmark::State& state) {
-  BenchmarkTrace(state, "systemui.zip", true);
+// Every producer thread allocates batches of objects that are freed by its
+// consumer thread, like a message queue. Every free is a cross thread free,
+// and producers reuse memory freed by another thread.
+static void GenerateProducerConsumer(size_t num_pairs, BinaryTrace* trace) {
+  constexpr size_t kRounds = 500;
+  constexpr size_t kBatchSize = 32;
+  std::mt19937 random(num_pairs);
+  std::uniform_int_distribution<size_t> sizes(8, 512);
+  TraceGenerator generator;
+  std::vector<std::vector<uint64_t>> batches(num_pairs);
+  for (size_t round = 0; round <= kRounds; round++) {
+    for (size_t pair = 0; pair < num_pairs; pair++) {
+      pid_t producer = 1000 + 2 * pair;
+      pid_t consumer = producer + 1;
+      for (uint64_t ptr : batches[pair]) {
+        generator.Free(consumer, ptr);
+      }
+      batches[pair].clear();
+      if (round == kRounds) {
+        generator.ThreadDone(producer);
+        generator.ThreadDone(consumer);
+        continue;
+      }
+      for (size_t i = 0; i < kBatchSize; i++) {
+        batches[pair].push_back(generator.next_ptr());
+        generator.Malloc(producer, sizes(random));
+      }
+    }
+  }
+  generator.Create(trace);
 }
-BENCHMARK(BM_systemui)->BENCH_OPTIONS;
 
-#if defined(__BIONIC__)
-void BM_systemui_no_decay(benchmark::State& state) {
-  BenchmarkTrace(state, "systemui.zip", false);
+// Every thread allocates objects of all sizes from 16 bytes to 64KB, keeping
+// a window of live objects, so all size classes of the allocator are hit by
+// all threads at once.
+static void GenerateSizeClassStorm(size_t num_threads, BinaryTrace* trace) {
+  constexpr size_t kAllocsPerThread = 20000;
+  constexpr size_t kLiveWindow = 64;
+  std::mt19937 random(num_threads);
+  TraceGenerator generator;
+  std::vector<std::vector<uint64_t>> live(num_threads);
+  for (size_t i = 0; i < kAllocsPerThread; i++) {
+    // Sweep the powers of two, with some jitter to hit every size class.
+    size_t size = (16 << (i % 13)) + random() % 16;
+    for (size_t thread = 0; thread < num_threads; thread++) {
+      pid_t tid = 1000 + thread;
+      if (live[thread].size() == kLiveWindow) {
+        size_t index = random() % kLiveWindow;
+        generator.Free(tid, live[thread][index]);
+        live[thread][index] = live[thread].back();
+        live[thread].pop_back();
+      }
+      live[thread].push_back(generator.next_ptr());
+      generator.Malloc(tid, size);
+    }
+  }
+  for (size_t thread = 0; thread < num_threads; thread++) {
+    pid_t tid = 1000 + thread;
+    for (uint64_t ptr : live[thread]) {
+      generator.Free(tid, ptr);
+    }
+    generator.ThreadDone(tid);
+  }
+  generator.Create(trace);
 }
-BENCHMARK(BM_systemui_no_decay)->BENCH_OPTIONS;
-#endif
 
-void BM_youtube(benchmark::State& state) {
-  BenchmarkTrace(state, "youtube.zip", true);
+static void BM_producer_consumer(benchmark::State& state) {
+  BinaryTrace trace;
+  GenerateProducerConsumer(state.range(0), &trace);
+  BenchmarkThreadedTrace(state, trace);
+  BinaryTraceFree(&trace);
 }
-BENCHMARK(BM_youtube)->BENCH_OPTIONS;
-
-#if defined(__BIONIC__)
-void BM_youtube_no_decay(benchmark::State& state) {
-  BenchmarkTrace(state, "youtube.zip", false);
+BENCHMARK(BM_producer_consumer)
+    ->UseManualTime()
+    ->Unit(benchmark::kMicrosecond)
+    ->Repetitions(4)
+    ->ReportAggregatesOnly(true)
+    ->ArgName("pairs")
+    ->RangeMultiplier(2)
+    ->Range(1, 8);
+
+static void BM_size_class_storm(benchmark::State& state) {
+  BinaryTrace trace;
+  GenerateSizeClassStorm(state.range(0), &trace);
+  BenchmarkThreadedTrace(state, trace);
+  BinaryTraceFree(&trace);
 }
-BENCHMARK(BM_youtube_no_decay)->BENCH_OPTIONS;
-#endif
+BENCHMARK(BM_size_class_storm)
+    ->UseManualTime()
+    ->Unit(benchmark::kMicrosecond)
+    ->Repetitions(4)
+    ->ReportAggregatesOnly(true)
+    ->ArgName("threads")
+    ->RangeMultiplier(2)
+    ->Range(1, 16);
 
 int main(int argc, char** argv) {
   std::vector<char*> args;
@@ -439,6 +504,8 @@ int main(int argc, char** argv) {
     }
   }
 
+  RegisterTraceBenchmarks();
+
   argc = args.size();
   ::benchmark::Initialize(&argc, args.data());
   if (::benchmark::ReportUnrecognizedArguments(argc, args.data())) return 1;
@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "AllocParser.h"
+#include "BinaryTrace.h"
+#include "File.h"
+
+// Converts a text trace into a binary trace, which memory_replay and
+// trace_benchmark can map directly instead of parsing.
+int main(int argc, char** argv) {
+  if (argc != 3) {
+    fprintf(stderr, "Usage: %s MEMORY_LOG_FILE BINARY_TRACE_FILE\n", basename(argv[0]));
+    fprintf(stderr, "  MEMORY_LOG_FILE\n");
+    fprintf(stderr, "    This can either be a text file or a zipped text file.\n");
+    fprintf(stderr, "  BINARY_TRACE_FILE\n");
+    fprintf(stderr, "    The output file, which can be passed to memory_replay in place\n");
+    fprintf(stderr, "    of MEMORY_LOG_FILE.\n");
+    return 1;
+  }
+
+  AllocEntry* entries;
+  size_t num_entries;
+  GetUnwindInfo(argv[1], &entries, &num_entries);
+
+  BinaryTrace trace;
+  BinaryTraceCreate(entries, num_entries, &trace);
+  FreeEntries(entries, num_entries);
+
+  BinaryTraceWrite(trace, argv[2]);
+
+  printf("Entries:                  %" PRIu64 "\n", trace.header->num_entries);
+  printf("Allocation slots:         %" PRIu64 "\n", trace.header->max_live_allocs);
+  printf("Threads:                  %u\n", trace.header->num_threads);
+  printf("Maximum active threads:   %u\n", trace.header->max_active_threads);
+  BinaryTraceFree(&trace);
+  return 0;
+}
@@ -17,25 +17,85 @@
 #include <err.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <getopt.h>
 #include <inttypes.h>
 #include <malloc.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <optional>
+
 #include "Alloc.h"
+#include "BinaryTrace.h"
+#include "ConcurrentReplay.h"
 #include "File.h"
+#include "LatencyStats.h"
+#include "MemorySampler.h"
 #include "NativeInfo.h"
 #include "Pointers.h"
+#include "ReplayTimer.h"
 #include "Thread.h"
 #include "Threads.h"
+#include "Utils.h"
 
 constexpr size_t kDefaultMaxThreads = 512;
 
+struct ReplayOptions {
+  bool concurrent = false;
+  bool latency = false;
+  const char* latency_json = nullptr;
+  bool timed = false;
+  double speedup = 1.0;
+  const char* timeline = nullptr;
+  uint64_t timeline_interval_nsecs = 10000000;
+};
+
+static void ReportLatencyStats(const LatencyStats* stats, const ReplayOptions& options) {
+  if (stats == nullptr) {
+    return;
+  }
+  dprintf(STDOUT_FILENO, "\nAllocation/Free Latency:\n");
+  stats->Print(STDOUT_FILENO);
+  if (options.latency_json != nullptr) {
+    stats->WriteJson(options.latency_json);
+    dprintf(STDOUT_FILENO, "Latency histograms written to %s\n", options.latency_json);
+  }
+}
+
+static void ReportTimingErrors(const LatencyHistogram& timing_errors, uint64_t scaled_trace_nsecs,
+                               uint64_t replay_nsecs) {
+  char buffer[256];
+  NativeFormatFloat(buffer, sizeof(buffer), scaled_trace_nsecs, 1000000000);
+  dprintf(STDOUT_FILENO, "Scaled Trace Time: %" PRIu64 "ns %ss\n", scaled_trace_nsecs, buffer);
+  NativeFormatFloat(buffer, sizeof(buffer), replay_nsecs, 1000000000);
+  dprintf(STDOUT_FILENO, "Timed Replay Time: %" PRIu64 "ns %ss\n", replay_nsecs, buffer);
+  if (timing_errors.count() == 0) {
+    return;
+  }
+  dprintf(STDOUT_FILENO,
+          "Timing Error: %" PRIu64 " entries mean %" PRIu64 "ns p50 %" PRIu64 "ns p99 %" PRIu64
+          "ns p99.9 %" PRIu64 "ns max %" PRIu64 "ns\n",
+          timing_errors.count(), timing_errors.total_nsecs() / timing_errors.count(),
+          timing_errors.Percentile(50), timing_errors.Percentile(99),
+          timing_errors.Percentile(99.9), timing_errors.max_nsecs());
+}
+
+static void ReportTimeline(const MemorySampler* sampler, const ReplayOptions& options) {
+  if (sampler == nullptr) {
+    return;
+  }
+  dprintf(STDOUT_FILENO, "\nMemory Timeline:\n");
+  sampler->PrintSummary(STDOUT_FILENO);
+  dprintf(STDOUT_FILENO, "Timeline written to %s\n", options.timeline);
+}
+
 static size_t GetMaxAllocs(const AllocEntry* entries, size_t num_entries) {
   size_t max_allocs = 0;
   size_t num_allocs = 0;
@@ -70,13 +130,90 @@ static size_t GetMaxAllocs(const AllocEntry* entries, size_t num_entries) {
   return max_allocs;
 }
 
-static void ProcessDump(const AllocEntry* entries, size_t num_entries, size_t max_threads) {
-  // Do a pass to get the maximum number of allocations used at one
-  // time to allow a single mmap that can hold the maximum number of
-  // pointers needed at once.
-  size_t max_allocs = GetMaxAllocs(entries, num_entries);
+// Entries of a parsed text trace.
+class TextTraceEntries {
+ public:
+  TextTraceEntries(const AllocEntry* entries, size_t num_entries)
+      : entries_(entries), num_entries_(num_entries) {}
+
+  size_t size() const { return num_entries_; }
+  pid_t GetTid(size_t i) const { return entries_[i].tid; }
+  const AllocEntry& Get(size_t i) { return entries_[i]; }
+  // The size of freed allocations is not known, text traces are converted
+  // into binary traces when the live bytes are needed.
+  int64_t GetLiveBytesDelta(size_t) const { return 0; }
+  uint64_t GetStartTime() const { return GetTraceStartTime(entries_, num_entries_); }
+
+ private:
+  const AllocEntry* entries_;
+  size_t num_entries_;
+};
+
+// Entries of a mapped binary trace. Each entry is converted into an
+// AllocEntry owned by its thread index, so Get() must only be called once
+// the thread has finished executing its previous entry.
+class BinaryTraceEntries {
+ public:
+  explicit BinaryTraceEntries(const BinaryTrace& trace) : trace_(trace) {
+    // Use a map instead of new to avoid allocations in the replay process.
+    map_size_ = std::max<size_t>(trace_.header->num_threads, 1) * sizeof(AllocEntry);
+    void* map = mmap(nullptr, map_size_, PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE, -1, 0);
+    if (map == MAP_FAILED) {
+      err(1, "Unable to allocate entries for %u threads", trace_.header->num_threads);
+    }
+    thread_entries_ = reinterpret_cast<AllocEntry*>(map);
+  }
+  ~BinaryTraceEntries() { munmap(thread_entries_, map_size_); }
+
+  size_t size() const { return trace_.num_entries; }
+  pid_t GetTid(size_t i) const { return trace_.entries[i].tid; }
+  const AllocEntry& Get(size_t i) {
+    AllocEntry* entry = &thread_entries_[trace_.entries[i].thread];
+    BinaryTraceGetEntry(trace_.entries[i], entry);
+    return *entry;
+  }
+  uint64_t GetStartTime() const { return BinaryTraceGetStartTime(trace_); }
+  int64_t GetLiveBytesDelta(size_t i) const {
+    return BinaryTraceGetLiveBytesDelta(trace_.entries[i]);
+  }
+
+ private:
+  const BinaryTrace& trace_;
+  AllocEntry* thread_entries_ = nullptr;
+  size_t map_size_ = 0;
+};
+
+// max_allocs is the maximum number of allocations used at one time, to
+// allow a single mmap that can hold the maximum number of pointers needed
+// at once.
+template <typename TraceEntries>
+static void ProcessDump(TraceEntries& entries, size_t max_allocs, size_t max_threads,
+                        const ReplayOptions& options) {
   Pointers pointers(max_allocs);
   Threads threads(&pointers, max_threads);
+  if (options.latency) {
+    threads.EnableLatencyStats();
+  }
+  // In a timed replay, entries are dispatched at their scaled start time.
+  uint64_t trace_start_nsecs = 0;
+  if (options.timed) {
+    trace_start_nsecs = entries.GetStartTime();
+    if (trace_start_nsecs == 0) {
+      errx(1, "File Error: The trace has no timestamps, it cannot be replayed in time");
+    }
+  }
+  ReplayTimer timer(trace_start_nsecs, options.speedup);
+  LatencyHistogram timing_errors = {};
+  uint64_t trace_end_nsecs = trace_start_nsecs;
+  // The entries are dispatched from this thread only, so one counter is
+  // enough.
+  LiveBytesCounter live_bytes = {};
+  // Kept out of the heap, to avoid allocations in the replay process.
+  std::optional<MemorySampler> timeline;
+  MemorySampler* sampler = nullptr;
+  if (options.timeline != nullptr) {
+    sampler = &timeline.emplace(options.timeline, options.timeline_interval_nsecs, &live_bytes, 1);
+  }
 
   dprintf(STDOUT_FILENO, "Maximum threads available:   %zu\n", threads.max_threads());
   dprintf(STDOUT_FILENO, "Maximum allocations in dump: %zu\n", max_allocs);
@@ -84,21 +221,28 @@ static void ProcessDump(const AllocEntry* entries, size_t num_entries, size_t ma
 
   NativePrintInfo("Initial ");
 
-  for (size_t i = 0; i < num_entries; i++) {
-    if (((i + 1) % 100000) == 0) {
+  if (sampler != nullptr) {
+    sampler->Start();
+  }
+  timer.Start();
+  for (size_t i = 0; i < entries.size(); i++) {
+    // Scanning smaps is slow, so skip it when sampling the memory usage, and
+    // in a timed replay, where it would delay the entries after it.
+    if (sampler == nullptr && !options.timed && ((i + 1) % 100000) == 0) {
       dprintf(STDOUT_FILENO, "  At line %zu:\n", i + 1);
       NativePrintInfo("    ");
     }
-    const AllocEntry& entry = entries[i];
-    Thread* thread = threads.FindThread(entry.tid);
+    pid_t tid = entries.GetTid(i);
+    Thread* thread = threads.FindThread(tid);
     if (thread == nullptr) {
-      thread = threads.CreateThread(entry.tid);
+      thread = threads.CreateThread(tid);
     }
 
     // Wait for the thread to complete any previous actions before handling
     // the next action.
     thread->WaitForReady();
 
+    const AllocEntry& entry = entries.Get(i);
     thread->SetAllocEntry(&entry);
 
     bool does_free = AllocDoesFree(entry);
@@ -109,10 +253,24 @@ static void ProcessDump(const AllocEntry* entries, size_t num_entries, size_t ma
       threads.WaitForAllToQuiesce();
     }
 
+    // Entries without a timestamp, like thread_done, run right away.
+    if (options.timed && entry.st != 0) {
+      timer.WaitUntil(entry.st);
+      uint64_t deadline = timer.GetDeadline(entry.st);
+      uint64_t now = Nanotime();
+      timing_errors.Record(now > deadline ? now - deadline : 0);
+      trace_end_nsecs = std::max<uint64_t>(trace_end_nsecs, entry.st);
+    }
+
     // Tell the thread to execute the action.
     thread->SetPending();
+    if (sampler != nullptr) {
+      live_bytes.bytes.store(live_bytes.bytes.load(std::memory_order_relaxed) +
+                                 entries.GetLiveBytesDelta(i),
+                             std::memory_order_relaxed);
+    }
 
-    if (entries[i].type == THREAD_DONE) {
+    if (entry.type == THREAD_DONE) {
       // Wait for the thread to finish and clear the thread entry.
       threads.Finish(thread);
     }
@@ -126,6 +284,10 @@ static void ProcessDump(const AllocEntry* entries, size_t num_entries, size_t ma
   }
   // Wait for all threads to stop processing actions.
   threads.WaitForAllToQuiesce();
+  uint64_t replay_nsecs = Nanotime() - timer.start_nsecs();
+  if (sampler != nullptr) {
+    sampler->Stop();
+  }
 
   NativePrintInfo("Final ");
 
@@ -140,25 +302,195 @@ static void ProcessDump(const AllocEntry* entries, size_t num_entries, size_t ma
   uint64_t total_nsecs = threads.total_time_nsecs();
   NativeFormatFloat(buffer, sizeof(buffer), total_nsecs, 1000000000);
   dprintf(STDOUT_FILENO, "Total Allocation/Free Time: %" PRIu64 "ns %ss\n", total_nsecs, buffer);
+  if (options.timed) {
+    ReportTimingErrors(timing_errors, (trace_end_nsecs - trace_start_nsecs) / options.speedup,
+                       replay_nsecs);
+  }
+
+  ReportLatencyStats(threads.latency_stats(), options);
+  ReportTimeline(sampler, options);
+}
+
+// Replay with every trace thread running its own entries, only waiting for
+// other threads when using a pointer they allocated or freed.
+static void ProcessDumpConcurrently(const BinaryTrace& trace, const ReplayOptions& options) {
+  Pointers pointers(std::max<size_t>(trace.header->max_live_allocs, 1));
+  ConcurrentReplay replay(trace, &pointers);
+  if (options.latency) {
+    replay.EnableLatencyStats();
+  }
+  if (options.timed) {
+    replay.EnableTimedReplay(options.speedup);
+  }
+  std::optional<MemorySampler> timeline;
+  MemorySampler* sampler = nullptr;
+  if (options.timeline != nullptr) {
+    sampler = &timeline.emplace(options.timeline, options.timeline_interval_nsecs,
+                                replay.live_bytes_counters(), replay.num_workers());
+  }
+
+  dprintf(STDOUT_FILENO, "Worker threads:              %zu\n", replay.num_workers());
+  dprintf(STDOUT_FILENO, "Allocation slots in dump:    %" PRIu64 "\n",
+          trace.header->max_live_allocs);
+  dprintf(STDOUT_FILENO, "Total pointers available:    %zu\n\n", pointers.max_pointers());
+
+  NativePrintInfo("Initial ");
+
+  if (sampler != nullptr) {
+    sampler->Start();
+  }
+  replay.Run();
+  if (sampler != nullptr) {
+    sampler->Stop();
+  }
+
+  NativePrintInfo("Final ");
+
+  // Free any outstanding pointers.
+  pointers.FreeAll();
+
+  char buffer[256];
+  uint64_t total_nsecs = replay.total_time_nsecs();
+  NativeFormatFloat(buffer, sizeof(buffer), total_nsecs, 1000000000);
+  dprintf(STDOUT_FILENO, "Total Allocation/Free Time: %" PRIu64 "ns %ss\n", total_nsecs, buffer);
+  uint64_t wall_nsecs = replay.wall_time_nsecs();
+  NativeFormatFloat(buffer, sizeof(buffer), wall_nsecs, 1000000000);
+  dprintf(STDOUT_FILENO, "Total Replay Time: %" PRIu64 "ns %ss\n", wall_nsecs, buffer);
+  dprintf(STDOUT_FILENO, "Entries Waiting For Other Threads: %" PRIu64 "\n",
+          replay.num_blocked_waits());
+  if (options.timed) {
+    ReportTimingErrors(replay.timing_errors(), replay.scaled_trace_nsecs(), wall_nsecs);
+  }
+
+  ReportLatencyStats(replay.latency_stats(), options);
+  ReportTimeline(sampler, options);
+}
+
+// Replay a mapped or converted binary trace. Unless max_threads was given on
+// the command line, it is raised to the number of threads the trace needs.
+static void ProcessBinaryTrace(const BinaryTrace& trace, size_t max_threads,
+                               bool max_threads_set, const ReplayOptions& options) {
+  if (options.concurrent) {
+    ProcessDumpConcurrently(trace, options);
+    return;
+  }
+  if (!max_threads_set) {
+    max_threads = std::max<size_t>(max_threads, trace.header->max_active_threads);
+  }
+  BinaryTraceEntries entries(trace);
+  ProcessDump(entries, trace.header->max_live_allocs, max_threads, options);
+}
+
+static void Usage(const char* name) {
+  fprintf(stderr, "Usage: %s [--concurrent] [--latency] [--latency-json FILE] [--timed]\n", name);
+  fprintf(stderr, "       [--speedup FACTOR] [--timeline FILE] [--timeline-interval MSECS]\n");
+  fprintf(stderr, "       MEMORY_LOG_FILE [MAX_THREADS]\n");
+  fprintf(stderr, "  MEMORY_LOG_FILE\n");
+  fprintf(stderr, "    This can either be a text file, a zipped text file or a binary\n");
+  fprintf(stderr, "    trace file created by memory_replay_convert.\n");
+  fprintf(stderr, "  MAX_THREADs\n");
+  fprintf(stderr, "    The maximum number of threads in the trace. The default is %zu.\n",
+          kDefaultMaxThreads);
+  fprintf(stderr, "    This pre-allocates the memory for thread data to avoid allocating\n");
+  fprintf(stderr, "    while the trace is being replayed.\n");
+  fprintf(stderr, "  --concurrent\n");
+  fprintf(stderr, "    Run the entries of every trace thread on its own thread, only\n");
+  fprintf(stderr, "    waiting for other threads to allocate or free the same pointer.\n");
+  fprintf(stderr, "    By default, all entries are dispatched in trace order, and all\n");
+  fprintf(stderr, "    threads are idle before every free. MAX_THREADS is not used, the\n");
+  fprintf(stderr, "    maximum number of threads comes from the trace.\n");
+  fprintf(stderr, "  --latency\n");
+  fprintf(stderr, "    Print percentiles of the latency of every allocation call, by\n");
+  fprintf(stderr, "    operation and size class.\n");
+  fprintf(stderr, "  --latency-json FILE\n");
+  fprintf(stderr, "    Also write the latency percentiles to FILE as JSON. Implies\n");
+  fprintf(stderr, "    --latency.\n");
+  fprintf(stderr, "  --timed\n");
+  fprintf(stderr, "    Run every entry at the time it was recorded, relative to the start\n");
+  fprintf(stderr, "    of the trace, to reproduce the idle time between allocations.\n");
+  fprintf(stderr, "    Prints how late entries ran compared to their recorded time.\n");
+  fprintf(stderr, "    Requires a trace with timestamps.\n");
+  fprintf(stderr, "  --speedup FACTOR\n");
+  fprintf(stderr, "    Replay FACTOR times faster than recorded, for example 10 turns a\n");
+  fprintf(stderr, "    10ms gap into 1ms. Implies --timed.\n");
+  fprintf(stderr, "  --timeline FILE\n");
+  fprintf(stderr, "    Sample the RSS, PSS, VA space and allocator usage of the process\n");
+  fprintf(stderr, "    along with the bytes allocated by the trace, and write the samples\n");
+  fprintf(stderr, "    to FILE, as JSON if FILE ends in .json or CSV otherwise. Prints\n");
+  fprintf(stderr, "    the peak usage and the ratio of the RSS growth to the live bytes.\n");
+  fprintf(stderr, "  --timeline-interval MSECS\n");
+  fprintf(stderr, "    The interval between samples, the default is 10ms.\n");
 }
 
 int main(int argc, char** argv) {
-  if (argc != 2 && argc != 3) {
-    if (argc > 3) {
+  ReplayOptions options;
+  static const option kOptions[] = {
+      {"concurrent", no_argument, nullptr, 'c'},
+      {"latency", no_argument, nullptr, 'l'},
+      {"latency-json", required_argument, nullptr, 'j'},
+      {"timed", no_argument, nullptr, 't'},
+      {"speedup", required_argument, nullptr, 's'},
+      {"timeline", required_argument, nullptr, 'm'},
+      {"timeline-interval", required_argument, nullptr, 'i'},
+      {nullptr, 0, nullptr, 0},
+  };
+  int opt;
+  while ((opt = getopt_long(argc, argv, "", kOptions, nullptr)) != -1) {
+    switch (opt) {
+      case 'c':
+        options.concurrent = true;
+        break;
+      case 'l':
+        options.latency = true;
+        break;
+      case 'j':
+        options.latency = true;
+        options.latency_json = optarg;
+        break;
+      case 't':
+        options.timed = true;
+        break;
+      case 's': {
+        char* end;
+        options.timed = true;
+        options.speedup = strtod(optarg, &end);
+        if (*end != '\0' || !(options.speedup > 0)) {
+          fprintf(stderr, "Invalid speedup '%s', it must be a number greater than zero.\n",
+                  optarg);
+          return 1;
+        }
+        break;
+      }
+      case 'm':
+        options.timeline = optarg;
+        break;
+      case 'i': {
+        char* end;
+        uint64_t interval_msecs = strtoull(optarg, &end, 10);
+        if (*end != '\0' || interval_msecs == 0) {
+          fprintf(stderr, "Invalid timeline interval '%s', it must be a positive integer.\n",
+                  optarg);
+          return 1;
+        }
+        options.timeline_interval_nsecs = interval_msecs * 1000000;
+        break;
+      }
+      default:
+        Usage(basename(argv[0]));
+        return 1;
+    }
+  }
+  int num_args = argc - optind;
+  if (num_args != 1 && num_args != 2) {
+    if (num_args > 2) {
       fprintf(stderr, "Only two arguments are expected.\n");
     } else {
       fprintf(stderr, "Requires at least one argument.\n");
     }
-    fprintf(stderr, "Usage: %s MEMORY_LOG_FILE [MAX_THREADS]\n", basename(argv[0]));
-    fprintf(stderr, "  MEMORY_LOG_FILE\n");
-    fprintf(stderr, "    This can either be a text file or a zipped text file.\n");
-    fprintf(stderr, "  MAX_THREADs\n");
-    fprintf(stderr, "    The maximum number of threads in the trace. The default is %zu.\n",
-            kDefaultMaxThreads);
-    fprintf(stderr, "    This pre-allocates the memory for thread data to avoid allocating\n");
-    fprintf(stderr, "    while the trace is being replayed.\n");
+    Usage(basename(argv[0]));
     return 1;
   }
+  const char* filename = argv[optind];
 
 #if defined(__LP64__)
   dprintf(STDOUT_FILENO, "64 bit environment.\n");
@@ -172,17 +504,44 @@ int main(int argc, char** argv) {
 #endif
 
   size_t max_threads = kDefaultMaxThreads;
-  if (argc == 3) {
-    max_threads = atoi(argv[2]);
+  if (num_args == 2) {
+    max_threads = atoi(argv[optind + 1]);
+  }
+
+  if (IsBinaryTraceFile(filename)) {
+    // A binary trace is mapped directly, and already knows the maximum
+    // number of allocations and threads.
+    BinaryTrace trace;
+    BinaryTraceOpen(filename, &trace);
+
+    dprintf(STDOUT_FILENO, "Processing: %s\n", filename);
+
+    ProcessBinaryTrace(trace, max_threads, num_args == 2, options);
+    BinaryTraceFree(&trace);
+    return 0;
   }
 
   AllocEntry* entries;
   size_t num_entries;
-  GetUnwindInfo(argv[1], &entries, &num_entries);
+  GetUnwindInfo(filename, &entries, &num_entries);
 
-  dprintf(STDOUT_FILENO, "Processing: %s\n", argv[1]);
+  dprintf(STDOUT_FILENO, "Processing: %s\n", filename);
+
+  if (options.concurrent || options.timeline != nullptr) {
+    // The concurrent replay needs the per thread and per pointer information
+    // of a binary trace, and the timeline needs the size of every free.
+    // Converting allocates, so prefer binary traces.
+    BinaryTrace trace;
+    BinaryTraceCreate(entries, num_entries, &trace);
+    FreeEntries(entries, num_entries);
+    ProcessBinaryTrace(trace, max_threads, num_args == 2, options);
+    BinaryTraceFree(&trace);
+    return 0;
+  }
 
-  ProcessDump(entries, num_entries, max_threads);
+  // Do a pass to get the maximum number of allocations used at one time.
+  TextTraceEntries text_entries(entries, num_entries);
+  ProcessDump(text_entries, GetMaxAllocs(entries, num_entries), max_threads, options);
 
   FreeEntries(entries, num_entries);
 
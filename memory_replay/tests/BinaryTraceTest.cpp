@@ -0,0 +1,255 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include <android-base/file.h>
+#include <gtest/gtest.h>
+
+#include "Alloc.h"
+#include "BinaryTrace.h"
+
+static std::vector<AllocEntry> GetTestEntries() {
+  std::vector<std::string> lines = {
+      "100: malloc 0x1000 16",
+      "200: calloc 0x2000 4 8",
+      "100: free 0x1000",
+      "200: memalign 0x3000 64 128",
+      "100: realloc 0x4000 0x2000 32",
+      "200: free 0x0",
+      "200: thread_done 0x0",
+      "200: malloc 0x5000 10",
+      "200: free 0x4000",
+      "200: free 0x3000",
+      "200: free 0x5000",
+  };
+  std::vector<AllocEntry> entries(lines.size());
+  for (size_t i = 0; i < lines.size(); i++) {
+    AllocGetData(lines[i], &entries[i]);
+  }
+  return entries;
+}
+
+static void VerifyTestTrace(const BinaryTrace& trace) {
+  ASSERT_EQ(11U, trace.num_entries);
+  EXPECT_EQ(11U, trace.header->num_entries);
+  EXPECT_EQ(4U, trace.header->max_live_allocs);
+  // Thread 200 gets a new thread index after thread_done.
+  EXPECT_EQ(3U, trace.header->num_threads);
+  EXPECT_EQ(2U, trace.header->max_active_threads);
+
+  const BinaryTraceEntry* entries = trace.entries;
+  EXPECT_EQ(100, entries[0].tid);
+  EXPECT_EQ(0U, entries[0].thread);
+  EXPECT_EQ(MALLOC, entries[0].type);
+  EXPECT_EQ(1U, entries[0].slot);
+  EXPECT_EQ(16U, entries[0].size);
+
+  EXPECT_EQ(1U, entries[1].thread);
+  EXPECT_EQ(CALLOC, entries[1].type);
+  EXPECT_EQ(2U, entries[1].slot);
+  EXPECT_EQ(4U, entries[1].arg);
+  EXPECT_EQ(8U, entries[1].size);
+
+  EXPECT_EQ(FREE, entries[2].type);
+  EXPECT_EQ(1U, entries[2].slot);
+  // A free records the size of the freed allocation.
+  EXPECT_EQ(16U, entries[2].size);
+
+  // Slot 1 was freed by thread 100, so thread 200 doesn't reuse it.
+  EXPECT_EQ(MEMALIGN, entries[3].type);
+  EXPECT_EQ(3U, entries[3].slot);
+  EXPECT_EQ(64U, entries[3].arg);
+
+  // The old slot is released before the new one is taken, and reused first.
+  EXPECT_EQ(REALLOC, entries[4].type);
+  EXPECT_EQ(2U, entries[4].old_slot);
+  EXPECT_EQ(2U, entries[4].slot);
+  EXPECT_EQ(32U, entries[4].size);
+  // The size of the old allocation of a realloc.
+  EXPECT_EQ(32U, entries[4].arg);
+
+  EXPECT_EQ(FREE, entries[5].type);
+  EXPECT_EQ(0U, entries[5].slot);
+  EXPECT_EQ(0U, entries[5].size);
+
+  EXPECT_EQ(THREAD_DONE, entries[6].type);
+  EXPECT_EQ(1U, entries[6].thread);
+
+  // Slot 1 is only free on thread 100.
+  EXPECT_EQ(2U, entries[7].thread);
+  EXPECT_EQ(4U, entries[7].slot);
+
+  EXPECT_EQ(2U, entries[8].slot);
+  EXPECT_EQ(3U, entries[9].slot);
+  EXPECT_EQ(4U, entries[10].slot);
+}
+
+TEST(BinaryTraceTest, create) {
+  std::vector<AllocEntry> entries = GetTestEntries();
+  BinaryTrace trace;
+  BinaryTraceCreate(entries.data(), entries.size(), &trace);
+  VerifyTestTrace(trace);
+  BinaryTraceFree(&trace);
+  EXPECT_EQ(nullptr, trace.map);
+}
+
+TEST(BinaryTraceTest, create_bad_free) {
+  std::vector<AllocEntry> entries(1);
+  AllocGetData("100: free 0x1000", &entries[0]);
+  BinaryTrace trace;
+  EXPECT_DEATH(BinaryTraceCreate(entries.data(), entries.size(), &trace), "");
+}
+
+TEST(BinaryTraceTest, write_and_open) {
+  std::vector<AllocEntry> entries = GetTestEntries();
+  BinaryTrace trace;
+  BinaryTraceCreate(entries.data(), entries.size(), &trace);
+  TemporaryFile tf;
+  BinaryTraceWrite(trace, tf.path);
+  BinaryTraceFree(&trace);
+
+  ASSERT_TRUE(IsBinaryTraceFile(tf.path));
+  BinaryTraceOpen(tf.path, &trace);
+  VerifyTestTrace(trace);
+  BinaryTraceFree(&trace);
+}
+
+TEST(BinaryTraceTest, open_bad_file) {
+  std::string text_file = android::base::GetExecutableDirectory() + "/tests/test.txt";
+  EXPECT_FALSE(IsBinaryTraceFile(text_file.c_str()));
+  EXPECT_FALSE(IsBinaryTraceFile("/does/not/exist"));
+
+  BinaryTrace trace;
+  EXPECT_DEATH(BinaryTraceOpen(text_file.c_str(), &trace), "");
+  EXPECT_DEATH(BinaryTraceOpen("/does/not/exist", &trace), "");
+
+  // A truncated file is rejected.
+  std::vector<AllocEntry> entries = GetTestEntries();
+  BinaryTraceCreate(entries.data(), entries.size(), &trace);
+  TemporaryFile tf;
+  ASSERT_TRUE(android::base::WriteFully(tf.fd, trace.map, trace.map_size - 1));
+  EXPECT_DEATH(BinaryTraceOpen(tf.path, &trace), "");
+
+  // A file written by an older version is rejected, its fields have a
+  // different meaning.
+  reinterpret_cast<BinaryTraceHeader*>(trace.map)->version = kBinaryTraceVersion - 1;
+  TemporaryFile old_tf;
+  BinaryTraceWrite(trace, old_tf.path);
+  BinaryTraceFree(&trace);
+  EXPECT_DEATH(BinaryTraceOpen(old_tf.path, &trace), "unsupported version 2");
+}
+
+TEST(BinaryTraceTest, open_bad_entries) {
+  std::vector<AllocEntry> entries = GetTestEntries();
+  BinaryTrace trace;
+  BinaryTraceCreate(entries.data(), entries.size(), &trace);
+  BinaryTraceEntry* binary_entries = reinterpret_cast<BinaryTraceEntry*>(
+      reinterpret_cast<BinaryTraceHeader*>(trace.map) + 1);
+
+  // Write the trace with one entry changed, and expect the open to fail.
+  auto check_bad_entry = [&](size_t index, auto change, const char* message) {
+    BinaryTraceEntry saved = binary_entries[index];
+    change(&binary_entries[index]);
+    TemporaryFile tf;
+    BinaryTraceWrite(trace, tf.path);
+    binary_entries[index] = saved;
+    BinaryTrace bad_trace;
+    EXPECT_DEATH(BinaryTraceOpen(tf.path, &bad_trace), message);
+  };
+  check_bad_entry(0, [](BinaryTraceEntry* e) { e->type = THREAD_DONE + 1; }, "unknown type");
+  check_bad_entry(1, [](BinaryTraceEntry* e) { e->thread = 3; }, "has thread 3");
+  check_bad_entry(2, [](BinaryTraceEntry* e) { e->slot = 5; }, "has slot 5/0");
+  check_bad_entry(4, [](BinaryTraceEntry* e) { e->old_slot = 5; }, "has slot 2/5");
+
+  // The unchanged trace opens.
+  TemporaryFile tf;
+  BinaryTraceWrite(trace, tf.path);
+  BinaryTraceFree(&trace);
+  BinaryTraceOpen(tf.path, &trace);
+  VerifyTestTrace(trace);
+  BinaryTraceFree(&trace);
+}
+
+TEST(BinaryTraceTest, create_per_thread_slots) {
+  std::vector<std::string> lines = {
+      "100: malloc 0x1000 16",
+      "200: malloc 0x2000 16",
+      "100: free 0x1000",
+      "200: free 0x2000",
+      "200: malloc 0x3000 16",
+      "100: malloc 0x4000 16",
+      "100: free 0x3000",
+      "200: malloc 0x5000 16",
+  };
+  std::vector<AllocEntry> entries(lines.size());
+  for (size_t i = 0; i < lines.size(); i++) {
+    AllocGetData(lines[i], &entries[i]);
+  }
+  BinaryTrace trace;
+  BinaryTraceCreate(entries.data(), entries.size(), &trace);
+  ASSERT_EQ(lines.size(), trace.num_entries);
+  EXPECT_EQ(3U, trace.header->max_live_allocs);
+
+  // Every thread reuses the slots it freed itself.
+  std::vector<uint32_t> expected_slots = {1, 2, 1, 2, 2, 1, 2, 3};
+  for (size_t i = 0; i < trace.num_entries; i++) {
+    EXPECT_EQ(expected_slots[i], trace.entries[i].slot) << "Entry " << i;
+  }
+
+  BinaryTraceFree(&trace);
+}
+
+TEST(BinaryTraceTest, get_entry) {
+  std::vector<AllocEntry> entries = GetTestEntries();
+  BinaryTrace trace;
+  BinaryTraceCreate(entries.data(), entries.size(), &trace);
+
+  AllocEntry entry;
+  BinaryTraceGetEntry(trace.entries[1], &entry);
+  EXPECT_EQ(200, entry.tid);
+  EXPECT_EQ(CALLOC, entry.type);
+  EXPECT_EQ(2U, entry.ptr);
+  EXPECT_EQ(8U, entry.size);
+  EXPECT_EQ(4U, entry.u.n_elements);
+
+  BinaryTraceGetEntry(trace.entries[4], &entry);
+  EXPECT_EQ(REALLOC, entry.type);
+  EXPECT_EQ(2U, entry.ptr);
+  EXPECT_EQ(2U, entry.u.old_ptr);
+  EXPECT_EQ(32U, entry.size);
+
+  BinaryTraceFree(&trace);
+}
+
+TEST(BinaryTraceTest, live_bytes_delta) {
+  std::vector<AllocEntry> entries = GetTestEntries();
+  BinaryTrace trace;
+  BinaryTraceCreate(entries.data(), entries.size(), &trace);
+
+  std::vector<int64_t> expected_live_bytes = {16, 48, 32, 160, 160, 160, 160, 170, 138, 10, 0};
+  ASSERT_EQ(expected_live_bytes.size(), trace.num_entries);
+  int64_t live_bytes = 0;
+  for (size_t i = 0; i < trace.num_entries; i++) {
+    live_bytes += BinaryTraceGetLiveBytesDelta(trace.entries[i]);
+    EXPECT_EQ(expected_live_bytes[i], live_bytes) << "Entry " << i;
+  }
+
+  BinaryTraceFree(&trace);
+}
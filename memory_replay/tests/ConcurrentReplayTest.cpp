@@ -0,0 +1,238 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "Alloc.h"
+#include "BinaryTrace.h"
+#include "ConcurrentReplay.h"
+#include "LatencyStats.h"
+#include "Pointers.h"
+
+static void CreateTrace(const std::vector<std::string>& lines, BinaryTrace* trace) {
+  std::vector<AllocEntry> entries(lines.size());
+  for (size_t i = 0; i < lines.size(); i++) {
+    AllocGetData(lines[i], &entries[i]);
+  }
+  BinaryTraceCreate(entries.data(), entries.size(), trace);
+}
+
+TEST(ConcurrentReplayTest, cross_thread_dependencies) {
+  BinaryTrace trace;
+  CreateTrace(
+      {
+          "100: malloc 0x1000 16",
+          "200: free 0x1000",
+          "200: malloc 0x2000 32",
+          "100: realloc 0x2000 0x2000 64",
+          "300: realloc 0x3000 0x2000 128",
+          "100: thread_done 0x0",
+          "200: thread_done 0x0",
+          "300: free 0x3000",
+          "300: thread_done 0x0",
+      },
+      &trace);
+  {
+    Pointers pointers(trace.header->max_live_allocs);
+    ConcurrentReplay replay(trace, &pointers);
+    EXPECT_EQ(3U, replay.num_workers());
+
+    // A free running before the allocation it depends on exits the process.
+    replay.Run();
+    pointers.FreeAll();
+  }
+  BinaryTraceFree(&trace);
+}
+
+TEST(ConcurrentReplayTest, reused_tids_share_workers) {
+  BinaryTrace trace;
+  CreateTrace(
+      {
+          "100: malloc 0x1000 16",
+          "200: malloc 0x2000 16",
+          "200: thread_done 0x0",
+          "200: free 0x1000",
+          "200: thread_done 0x0",
+          "300: free 0x2000",
+          "100: thread_done 0x0",
+          "300: thread_done 0x0",
+      },
+      &trace);
+  ASSERT_EQ(4U, trace.header->num_threads);
+  {
+    Pointers pointers(trace.header->max_live_allocs);
+    ConcurrentReplay replay(trace, &pointers);
+    EXPECT_EQ(2U, replay.num_workers());
+    replay.Run();
+    pointers.FreeAll();
+  }
+  BinaryTraceFree(&trace);
+}
+
+TEST(ConcurrentReplayTest, producer_consumer) {
+  // Every pointer is allocated on one thread and freed on the next one.
+  constexpr size_t kThreads = 4;
+  constexpr size_t kAllocsPerThread = 2000;
+  std::vector<std::string> lines;
+  char line[128];
+  for (size_t i = 0; i < kAllocsPerThread; i++) {
+    for (size_t t = 0; t < kThreads; t++) {
+      uint64_t ptr = 0x1000 + (i * kThreads + t) * 0x10;
+      snprintf(line, sizeof(line), "%zu: malloc 0x%" PRIx64 " %zu", 100 + t, ptr, i % 500 + 1);
+      lines.push_back(line);
+    }
+    for (size_t t = 0; t < kThreads; t++) {
+      uint64_t ptr = 0x1000 + (i * kThreads + t) * 0x10;
+      snprintf(line, sizeof(line), "%zu: free 0x%" PRIx64, 100 + (t + 1) % kThreads, ptr);
+      lines.push_back(line);
+    }
+  }
+  BinaryTrace trace;
+  CreateTrace(lines, &trace);
+  {
+    Pointers pointers(trace.header->max_live_allocs);
+    ConcurrentReplay replay(trace, &pointers);
+    EXPECT_EQ(kThreads, replay.num_workers());
+    for (size_t i = 0; i < 3; i++) {
+      replay.Run();
+      EXPECT_GT(replay.wall_time_nsecs(), 0U);
+    }
+    pointers.FreeAll();
+  }
+  BinaryTraceFree(&trace);
+}
+
+TEST(ConcurrentReplayTest, disjoint_threads_never_block) {
+  // Two threads allocate and free their own pointers, interleaved in the
+  // trace, so slots freed by one thread are free when the other allocates.
+  constexpr size_t kThreads = 2;
+  constexpr size_t kAllocsPerThread = 2000;
+  std::vector<std::string> lines;
+  char line[128];
+  for (size_t i = 0; i < kAllocsPerThread; i++) {
+    for (size_t t = 0; t < kThreads; t++) {
+      uint64_t ptr = 0x1000 + (i * kThreads + t) * 0x10;
+      snprintf(line, sizeof(line), "%zu: malloc 0x%" PRIx64 " %zu", 100 + t, ptr, i % 500 + 1);
+      lines.push_back(line);
+      snprintf(line, sizeof(line), "%zu: free 0x%" PRIx64, 100 + t, ptr);
+      lines.push_back(line);
+    }
+  }
+  BinaryTrace trace;
+  CreateTrace(lines, &trace);
+  // No slot is used by both threads.
+  std::vector<uint32_t> slot_threads(trace.header->max_live_allocs + 1, UINT32_MAX);
+  for (size_t i = 0; i < trace.num_entries; i++) {
+    const BinaryTraceEntry& entry = trace.entries[i];
+    if (slot_threads[entry.slot] == UINT32_MAX) {
+      slot_threads[entry.slot] = entry.thread;
+    }
+    EXPECT_EQ(slot_threads[entry.slot], entry.thread) << "Entry " << i;
+  }
+  {
+    Pointers pointers(trace.header->max_live_allocs);
+    ConcurrentReplay replay(trace, &pointers);
+    EXPECT_EQ(kThreads, replay.num_workers());
+    for (size_t i = 0; i < 3; i++) {
+      replay.Run();
+      EXPECT_EQ(0U, replay.num_blocked_waits());
+    }
+    pointers.FreeAll();
+  }
+  BinaryTraceFree(&trace);
+}
+
+TEST(ConcurrentReplayTest, latency_stats) {
+  BinaryTrace trace;
+  CreateTrace(
+      {
+          "100: malloc 0x1000 16",
+          "200: calloc 0x2000 100 10",
+          "100: free 0x2000",
+          "200: free 0x1000",
+          "100: thread_done 0x0",
+          "200: thread_done 0x0",
+      },
+      &trace);
+  {
+    Pointers pointers(trace.header->max_live_allocs);
+    ConcurrentReplay replay(trace, &pointers);
+    EXPECT_EQ(nullptr, replay.latency_stats());
+    replay.EnableLatencyStats();
+
+    // Latencies are only kept for the last run.
+    for (size_t i = 0; i < 2; i++) {
+      replay.Run();
+      pointers.FreeAll();
+
+      const LatencyStats* stats = replay.latency_stats();
+      ASSERT_NE(nullptr, stats);
+      EXPECT_EQ(1U, stats->Get(MALLOC, LatencyStats::GetSizeClass(16)).count());
+      EXPECT_EQ(1U, stats->Get(CALLOC, LatencyStats::GetSizeClass(1000)).count());
+      // Frees are classified by the size of the freed allocation.
+      EXPECT_EQ(1U, stats->Get(FREE, LatencyStats::GetSizeClass(16)).count());
+      EXPECT_EQ(1U, stats->Get(FREE, LatencyStats::GetSizeClass(1000)).count());
+      EXPECT_EQ(0U, stats->GetAllSizes(REALLOC).count());
+    }
+  }
+  BinaryTraceFree(&trace);
+}
+
+TEST(ConcurrentReplayTest, timed_replay) {
+  // Timestamps are in nanoseconds, the trace spans 40ms.
+  BinaryTrace trace;
+  CreateTrace(
+      {
+          "100: malloc 0x1000 16 1000000000 1000000100",
+          "200: malloc 0x2000 32 1010000000 1010000100",
+          "100: free 0x2000 1020000000 1020000100",
+          "200: free 0x1000 1040000000 1040000100",
+          "100: thread_done 0x0",
+          "200: thread_done 0x0",
+      },
+      &trace);
+  {
+    Pointers pointers(trace.header->max_live_allocs);
+    ConcurrentReplay replay(trace, &pointers);
+    replay.EnableTimedReplay(2.0);
+    EXPECT_EQ(20000000U, replay.scaled_trace_nsecs());
+
+    replay.Run();
+    pointers.FreeAll();
+    EXPECT_GE(replay.wall_time_nsecs(), 20000000U);
+    // Entries without timestamps are not timed.
+    EXPECT_EQ(4U, replay.timing_errors().count());
+  }
+  BinaryTraceFree(&trace);
+}
+
+TEST(ConcurrentReplayTest, timed_replay_without_timestamps) {
+  BinaryTrace trace;
+  CreateTrace({"100: malloc 0x1000 16", "100: free 0x1000"}, &trace);
+  {
+    Pointers pointers(trace.header->max_live_allocs);
+    ConcurrentReplay replay(trace, &pointers);
+    EXPECT_DEATH(replay.EnableTimedReplay(1.0), "no timestamps");
+  }
+  BinaryTraceFree(&trace);
+}
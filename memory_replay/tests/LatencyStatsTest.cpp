@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+
+#include <string>
+
+#include <android-base/file.h>
+#include <gtest/gtest.h>
+
+#include "LatencyStats.h"
+
+TEST(LatencyStatsTest, bucket_bounds) {
+  // Small values get a bucket each.
+  for (uint64_t nsecs = 0; nsecs < LatencyHistogram::kSubBuckets; nsecs++) {
+    EXPECT_EQ(nsecs, LatencyHistogram::GetBucket(nsecs));
+    EXPECT_EQ(nsecs, LatencyHistogram::GetBucketUpperBound(nsecs));
+  }
+
+  // Every value is in a bucket with an upper bound of at most 12.5% more,
+  // and buckets never go backwards.
+  size_t last_bucket = 0;
+  constexpr uint64_t kMaxValue = 1ULL << LatencyHistogram::kMaxValueBits;
+  for (uint64_t nsecs = 1; nsecs < kMaxValue; nsecs = nsecs * 9 / 8 + 1) {
+    size_t bucket = LatencyHistogram::GetBucket(nsecs);
+    ASSERT_LT(bucket, LatencyHistogram::kNumBuckets);
+    ASSERT_GE(bucket, last_bucket);
+    uint64_t upper_bound = LatencyHistogram::GetBucketUpperBound(bucket);
+    ASSERT_LE(nsecs, upper_bound) << "nsecs " << nsecs;
+    ASSERT_LE(upper_bound - nsecs, nsecs / 8) << "nsecs " << nsecs;
+    if (bucket > 0) {
+      ASSERT_LT(LatencyHistogram::GetBucketUpperBound(bucket - 1), nsecs) << "nsecs " << nsecs;
+    }
+    last_bucket = bucket;
+  }
+
+  EXPECT_EQ(LatencyHistogram::kNumBuckets - 1, LatencyHistogram::GetBucket(UINT64_MAX));
+}
+
+TEST(LatencyStatsTest, percentiles) {
+  LatencyHistogram histogram = {};
+  EXPECT_EQ(0U, histogram.Percentile(50));
+
+  for (uint64_t nsecs = 1; nsecs <= 1000; nsecs++) {
+    histogram.Record(nsecs);
+  }
+  EXPECT_EQ(1000U, histogram.count());
+  EXPECT_EQ(500500U, histogram.total_nsecs());
+  EXPECT_EQ(1000U, histogram.max_nsecs());
+
+  // Percentiles are bucket upper bounds, so they are within 12.5%.
+  uint64_t p50 = histogram.Percentile(50);
+  EXPECT_GE(p50, 500U);
+  EXPECT_LE(p50, 500U + 500U / 8);
+  uint64_t p99 = histogram.Percentile(99);
+  EXPECT_GE(p99, 990U);
+  // Never more than the maximum recorded value.
+  EXPECT_EQ(1000U, p99);
+  EXPECT_EQ(1000U, histogram.Percentile(100));
+  EXPECT_EQ(1U, histogram.Percentile(0));
+}
+
+TEST(LatencyStatsTest, merge) {
+  LatencyStats* stats1 = LatencyStats::Create();
+  LatencyStats* stats2 = LatencyStats::Create();
+
+  stats1->Record(MALLOC, 16, 100);
+  stats1->Record(MALLOC, 1000, 200);
+  stats2->Record(MALLOC, 16, 5000);
+  stats2->Record(FREE, 16, 50);
+  // Thread done is not an allocation call.
+  stats2->Record(THREAD_DONE, 0, 50);
+
+  stats1->Merge(*stats2);
+  const LatencyHistogram& malloc16 = stats1->Get(MALLOC, LatencyStats::GetSizeClass(16));
+  EXPECT_EQ(2U, malloc16.count());
+  EXPECT_EQ(5100U, malloc16.total_nsecs());
+  EXPECT_EQ(5000U, malloc16.max_nsecs());
+  EXPECT_EQ(1U, stats1->Get(MALLOC, LatencyStats::GetSizeClass(1000)).count());
+  EXPECT_EQ(3U, stats1->GetAllSizes(MALLOC).count());
+  EXPECT_EQ(1U, stats1->GetAllSizes(FREE).count());
+
+  LatencyStats::Destroy(stats1);
+  LatencyStats::Destroy(stats2);
+}
+
+TEST(LatencyStatsTest, size_classes) {
+  EXPECT_EQ(0U, LatencyStats::GetSizeClass(0));
+  EXPECT_EQ(0U, LatencyStats::GetSizeClass(16));
+  EXPECT_EQ(1U, LatencyStats::GetSizeClass(17));
+  EXPECT_EQ(1U, LatencyStats::GetSizeClass(64));
+  EXPECT_EQ(2U, LatencyStats::GetSizeClass(256));
+  EXPECT_EQ(3U, LatencyStats::GetSizeClass(1024));
+  EXPECT_EQ(4U, LatencyStats::GetSizeClass(4096));
+  EXPECT_EQ(5U, LatencyStats::GetSizeClass(16384));
+  EXPECT_EQ(6U, LatencyStats::GetSizeClass(65536));
+  EXPECT_EQ(7U, LatencyStats::GetSizeClass(65537));
+  EXPECT_EQ(7U, LatencyStats::GetSizeClass(UINT64_MAX));
+  EXPECT_STREQ(">64K", LatencyStats::GetSizeClassName(7));
+
+  // The size of a calloc is the total size.
+  LatencyStats* stats = LatencyStats::Create();
+  AllocEntry entry = {.type = CALLOC, .size = 100};
+  entry.u.n_elements = 100;
+  stats->Record(entry, 10);
+  EXPECT_EQ(1U, stats->Get(CALLOC, LatencyStats::GetSizeClass(10000)).count());
+  LatencyStats::Destroy(stats);
+}
+
+TEST(LatencyStatsTest, write_json) {
+  LatencyStats* stats = LatencyStats::Create();
+  stats->Record(MALLOC, 16, 100);
+  stats->Record(FREE, 100000, 30);
+
+  TemporaryFile tf;
+  stats->WriteJson(tf.path);
+  LatencyStats::Destroy(stats);
+
+  std::string json;
+  ASSERT_TRUE(android::base::ReadFileToString(tf.path, &json));
+  EXPECT_EQ(
+      "[\n"
+      "  {\"op\": \"malloc\", \"size_class\": \"<=16\", \"count\": 1, \"mean_ns\": 100, "
+      "\"p50_ns\": 100, \"p90_ns\": 100, \"p99_ns\": 100, \"p99.9_ns\": 100, \"max_ns\": 100},\n"
+      "  {\"op\": \"malloc\", \"size_class\": \"all\", \"count\": 1, \"mean_ns\": 100, "
+      "\"p50_ns\": 100, \"p90_ns\": 100, \"p99_ns\": 100, \"p99.9_ns\": 100, \"max_ns\": 100},\n"
+      "  {\"op\": \"free\", \"size_class\": \">64K\", \"count\": 1, \"mean_ns\": 30, "
+      "\"p50_ns\": 30, \"p90_ns\": 30, \"p99_ns\": 30, \"p99.9_ns\": 30, \"max_ns\": 30},\n"
+      "  {\"op\": \"free\", \"size_class\": \"all\", \"count\": 1, \"mean_ns\": 30, "
+      "\"p50_ns\": 30, \"p90_ns\": 30, \"p99_ns\": 30, \"p99.9_ns\": 30, \"max_ns\": 30}\n"
+      "]\n",
+      json);
+}
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include <android-base/file.h>
+#include <android-base/strings.h>
+#include <gtest/gtest.h>
+
+#include "MemorySampler.h"
+
+TEST(MemorySamplerTest, get_sample) {
+  TemporaryFile tf;
+  LiveBytesCounter counters[2] = {};
+  counters[0].bytes = 1000;
+  counters[1].bytes = -200;
+  MemorySampler sampler(tf.path, 1000000, counters, 2);
+
+  MemorySample sample = {};
+  sampler.GetSample(&sample);
+  EXPECT_EQ(800, sample.live_bytes);
+  EXPECT_NE(0U, sample.rss_bytes);
+  EXPECT_LE(sample.rss_bytes, sample.va_bytes);
+}
+
+static void RunTimeline(MemorySampler* sampler, LiveBytesCounter* counter) {
+  constexpr size_t kMapSize = 16 * 1024 * 1024;
+  sampler->Start();
+  void* map = mmap(nullptr, kMapSize, PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE, -1, 0);
+  ASSERT_NE(MAP_FAILED, map);
+  memset(map, 1, kMapSize);
+  counter->bytes = kMapSize;
+  usleep(20000);
+  sampler->Stop();
+  munmap(map, kMapSize);
+
+  EXPECT_LE(2U, sampler->num_samples());
+  EXPECT_EQ(int64_t(kMapSize), sampler->peak().live_bytes);
+  EXPECT_LE(sampler->baseline().rss_bytes + kMapSize, sampler->peak().rss_bytes);
+  // The RSS grew by about the live bytes, other memory of the process can
+  // change a little while sampling.
+  EXPECT_LE(0.9, sampler->peak_fragmentation_ratio());
+  EXPECT_LE(0.9, sampler->mean_fragmentation_ratio());
+}
+
+TEST(MemorySamplerTest, csv_timeline) {
+  TemporaryFile tf;
+  LiveBytesCounter counter = {};
+  MemorySampler sampler(tf.path, 1000000, &counter, 1);
+  RunTimeline(&sampler, &counter);
+
+  std::string timeline;
+  ASSERT_TRUE(android::base::ReadFileToString(tf.path, &timeline));
+  std::vector<std::string> lines = android::base::Split(timeline, "\n");
+  // The header, every sample, and the empty string after the last newline.
+  ASSERT_EQ(sampler.num_samples() + 2, lines.size());
+  EXPECT_EQ("time_ns,live_bytes,rss_bytes,pss_bytes,va_bytes,allocator_bytes", lines[0]);
+  EXPECT_EQ(6U, android::base::Split(lines[1], ",").size());
+  EXPECT_EQ("", lines.back());
+}
+
+TEST(MemorySamplerTest, json_timeline) {
+  TemporaryFile tf;
+  std::string filename = std::string(tf.path) + ".json";
+  LiveBytesCounter counter = {};
+  {
+    MemorySampler sampler(filename.c_str(), 1000000, &counter, 1);
+    RunTimeline(&sampler, &counter);
+  }
+
+  std::string timeline;
+  ASSERT_TRUE(android::base::ReadFileToString(filename, &timeline));
+  unlink(filename.c_str());
+  EXPECT_TRUE(android::base::StartsWith(timeline, "{\"samples\": [\n  {\"time_ns\": "));
+  EXPECT_NE(std::string::npos, timeline.find("\"summary\": {\"num_samples\": "));
+  EXPECT_NE(std::string::npos, timeline.find("\"peak_live_bytes\": 16777216"));
+  EXPECT_TRUE(android::base::EndsWith(timeline, "}}\n"));
+}
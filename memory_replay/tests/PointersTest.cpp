@@ -87,6 +87,16 @@ static void TestNoEntriesLeft() {
   }
 }
 
+TEST(PointersTest, free_all_empties) {
+  Pointers pointers(1);
+
+  // Without emptying the table, Add would run out of entries.
+  for (size_t i = 0; i < 2 * pointers.max_pointers(); i++) {
+    pointers.Add(0x1234, malloc(10));
+    pointers.FreeAll();
+  }
+}
+
 TEST(PointersTest_DeathTest, no_entries_left) {
   ASSERT_EXIT(TestNoEntriesLeft(), ::testing::ExitedWithCode(1), "");
 }
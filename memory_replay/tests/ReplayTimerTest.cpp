@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+
+#include <gtest/gtest.h>
+
+#include "Alloc.h"
+#include "ReplayTimer.h"
+#include "Utils.h"
+
+TEST(ReplayTimerTest, deadlines) {
+  ReplayTimer timer(1000000, 10.0);
+  timer.Start();
+  uint64_t start_nsecs = timer.start_nsecs();
+  EXPECT_EQ(start_nsecs, timer.GetDeadline(1000000));
+  // Timestamps before the start of the trace run right away.
+  EXPECT_EQ(start_nsecs, timer.GetDeadline(10));
+  EXPECT_EQ(start_nsecs + 100, timer.GetDeadline(1001000));
+  EXPECT_EQ(start_nsecs + 1000000, timer.GetDeadline(11000000));
+}
+
+TEST(ReplayTimerTest, wait_until) {
+  ReplayTimer timer(5000000, 1.0);
+  timer.Start();
+
+  // Long enough to sleep, then spin.
+  timer.WaitUntil(15000000);
+  uint64_t now = Nanotime();
+  EXPECT_GE(now, timer.GetDeadline(15000000));
+
+  // Short enough to only spin.
+  timer.WaitUntil(15050000);
+  EXPECT_GE(Nanotime(), timer.GetDeadline(15050000));
+
+  // A deadline that has passed does not wait.
+  uint64_t before_nsecs = Nanotime();
+  timer.WaitUntil(5000000);
+  EXPECT_LT(Nanotime() - before_nsecs, 1000000U);
+}
+
+TEST(ReplayTimerTest, bad_speedup) {
+  EXPECT_DEATH(ReplayTimer(0, 0.0), "speedup");
+  EXPECT_DEATH(ReplayTimer(0, -1.0), "speedup");
+}
+
+TEST(ReplayTimerTest, get_trace_start_time) {
+  AllocEntry entries[3] = {};
+  EXPECT_EQ(0U, GetTraceStartTime(entries, 3));
+  // Entries without a timestamp are ignored.
+  entries[0].st = 0;
+  entries[1].st = 2000;
+  entries[2].st = 1000;
+  EXPECT_EQ(1000U, GetTraceStartTime(entries, 3));
+  EXPECT_EQ(2000U, GetTraceStartTime(entries, 2));
+}
@@ -17,6 +17,7 @@
 #include <gtest/gtest.h>
 
 #include "Alloc.h"
+#include "LatencyStats.h"
 #include "Pointers.h"
 #include "Thread.h"
 #include "Threads.h"
@@ -120,6 +121,41 @@ TEST(ThreadsTest, verify_quiesce) {
   ASSERT_EQ(0U, threads.num_threads());
 }
 
+TEST(ThreadsTest, latency_stats) {
+  Pointers pointers(4);
+
+  Threads threads(&pointers, 1);
+  EXPECT_EQ(nullptr, threads.latency_stats());
+  threads.EnableLatencyStats();
+  ASSERT_NE(nullptr, threads.latency_stats());
+
+  AllocEntry entries[] = {
+      {.type = MALLOC, .ptr = 0x1234, .size = 100},
+      {.type = MALLOC, .ptr = 0x5678, .size = 10000},
+      {.type = FREE, .ptr = 0x1234},
+      {.type = FREE, .ptr = 0x5678},
+      {.type = THREAD_DONE},
+  };
+  for (pid_t tid : {900, 901}) {
+    Thread* thread = threads.CreateThread(tid);
+    ASSERT_NE(nullptr, thread->latency_stats());
+    for (const AllocEntry& entry : entries) {
+      thread->WaitForReady();
+      thread->SetAllocEntry(&entry);
+      thread->SetPending();
+    }
+    threads.Finish(thread);
+  }
+
+  // The stats of both threads are merged when they finish.
+  const LatencyStats* stats = threads.latency_stats();
+  EXPECT_EQ(2U, stats->Get(MALLOC, LatencyStats::GetSizeClass(100)).count());
+  EXPECT_EQ(2U, stats->Get(MALLOC, LatencyStats::GetSizeClass(10000)).count());
+  EXPECT_EQ(4U, stats->GetAllSizes(MALLOC).count());
+  EXPECT_EQ(4U, stats->GetAllSizes(FREE).count());
+  EXPECT_EQ(0U, stats->GetAllSizes(CALLOC).count());
+}
+
 static void TestTooManyThreads() {
   Pointers pointers(4);
 
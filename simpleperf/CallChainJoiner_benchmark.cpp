@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "CallChainJoiner.h"
+
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+using namespace simpleperf;
+using namespace simpleperf::call_chain_joiner_impl;
+
+// Add [chain_count] callchains of [depth] frames spread over 16 threads. Each thread keeps a
+// stable stack bottom, and chains are cut at random depths like callchains limited by the
+// dwarf stack size, so the joiner has to extend most of them.
+static void BM_CallChainJoiner(benchmark::State& state) {
+  size_t chain_count = state.range(0);
+  size_t depth = state.range(1);
+  constexpr pid_t kThreads = 16;
+
+  std::mt19937_64 rng(chain_count + depth);
+  std::uniform_int_distribution<size_t> cut_dist(depth / 2, depth);
+  std::uniform_int_distribution<uint64_t> leaf_dist(0, 1023);
+  struct Chain {
+    pid_t tid;
+    std::vector<uint64_t> ips;
+    std::vector<uint64_t> sps;
+  };
+  std::vector<Chain> chains;
+  for (size_t i = 0; i < chain_count; i++) {
+    Chain chain;
+    chain.tid = 1 + i % kThreads;
+    size_t len = cut_dist(rng);
+    for (size_t j = 0; j < len; j++) {
+      // level 0 is the bottom of the stack. Frames near the leaf differ between samples, frames
+      // near the bottom are shared.
+      size_t level = depth - 1 - j;
+      uint64_t ip = level + 4 >= depth ? 0x100000 + leaf_dist(rng) * 4 : 0x200000 + level * 16;
+      chain.ips.push_back(ip);
+      chain.sps.push_back(0x7f000000 - level * 64 - chain.tid * 0x100000);
+    }
+    chains.push_back(std::move(chain));
+  }
+
+  for (auto _ : state) {
+    CallChainJoiner joiner(sizeof(CacheNode) * 64 * 1024, 1, false);
+    for (auto& chain : chains) {
+      if (!joiner.AddCallChain(chain.tid, chain.tid, CallChainJoiner::ORIGINAL_OFFLINE, chain.ips,
+                               chain.sps)) {
+        state.SkipWithError("AddCallChain failed");
+        return;
+      }
+    }
+    if (!joiner.JoinCallChains()) {
+      state.SkipWithError("JoinCallChains failed");
+      return;
+    }
+    pid_t pid;
+    pid_t tid;
+    CallChainJoiner::ChainType type;
+    std::vector<uint64_t> ips;
+    std::vector<uint64_t> sps;
+    while (joiner.GetNextCallChain(pid, tid, type, ips, sps)) {
+      benchmark::DoNotOptimize(ips.data());
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * chain_count);
+}
+BENCHMARK(BM_CallChainJoiner)
+    ->ArgNames({"chains", "depth"})
+    ->Args({10000, 16})
+    ->Args({10000, 64})
+    ->Args({100000, 16})
+    ->Args({100000, 64})
+    ->Unit(benchmark::kMillisecond);
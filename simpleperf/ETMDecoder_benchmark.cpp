@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <unistd.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <android-base/file.h>
+#include <benchmark/benchmark.h>
+
+#include "command.h"
+#include "get_test_data.h"
+#include "utils.h"
+
+using namespace simpleperf;
+
+// ETMDecoder is driven by the inject command, which decodes aux data of a cs-etm recording.
+// The branch-list output only decodes etm packets into branch lists, while the autofdo output
+// also decodes instruction ranges from binaries.
+static void ETMDecoderBenchmark(benchmark::State& state, const std::string& output_format) {
+  std::string input = GetTestData(PERF_DATA_ETM_TEST_LOOP);
+  TemporaryFile tmpfile;
+  close(tmpfile.release());
+  std::vector<std::string> args = {"-i",       input,        "--symdir", GetTestDataDir() + "etm",
+                                   "--output", output_format, "-o",      tmpfile.path};
+  for (auto _ : state) {
+    std::unique_ptr<Command> cmd = CreateCommandInstance("inject");
+    if (!cmd->Run(args)) {
+      state.SkipWithError("inject command failed");
+      return;
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * GetFileSize(input));
+}
+
+static void BM_ETMDecoder_BranchList(benchmark::State& state) {
+  ETMDecoderBenchmark(state, "branch-list");
+}
+BENCHMARK(BM_ETMDecoder_BranchList)->Unit(benchmark::kMillisecond);
+
+static void BM_ETMDecoder_InstrRange(benchmark::State& state) {
+  ETMDecoderBenchmark(state, "autofdo");
+}
+BENCHMARK(BM_ETMDecoder_InstrRange)->Unit(benchmark::kMillisecond);
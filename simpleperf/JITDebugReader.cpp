@@ -17,7 +17,9 @@
 #include "JITDebugReader.h"
 
 #include <inttypes.h>
+#include <limits.h>
 #include <stdio.h>
+#include <string.h>
 #include <sys/mman.h>
 #include <sys/uio.h>
 #include <sys/user.h>
@@ -49,6 +51,16 @@ using android::base::StringPrintf;
 // remotely.
 static constexpr size_t MAX_JIT_SYMFILE_SIZE = 1 * kMegabyte;
 
+// Symfiles are read in batches, each using one process_vm_readv() call per IOV_MAX symfiles. Limit
+// the buffer used by a batch.
+static constexpr size_t kMaxSymFileBatchSize = 16 * kMegabyte;
+
+// When walking the code entry list, read the whole page containing an entry instead of only the
+// entry. Entries are usually allocated close to each other, so following entries can often be
+// found in pages already read.
+static constexpr uint64_t kEntryPageSize = 4096;
+static constexpr size_t kMaxCachedEntryPages = 256;
+
 // It takes about 30us-130us on Pixel (depending on the cpu frequency) to check if the descriptors
 // have been updated (most time spent in process_vm_preadv). We want to know if the JIT debug info
 // changed as soon as possible, while not wasting too much time checking for updates. So use a
@@ -208,7 +220,12 @@ JITDebugReader::JITDebugReader(const std::string& symfile_prefix, SymFileOption
                                SyncOption sync_option)
     : symfile_prefix_(symfile_prefix), symfile_option_(symfile_option), sync_option_(sync_option) {}
 
-JITDebugReader::~JITDebugReader() {}
+JITDebugReader::~JITDebugReader() {
+  LOG(DEBUG) << "JITDebugReader: remote_read_calls " << stats_.remote_read_calls
+             << ", remote_read_bytes " << stats_.remote_read_bytes << ", code_entries_read "
+             << stats_.code_entries_read << ", symfiles_read " << stats_.symfiles_read
+             << ", symfile_cache_hits " << stats_.symfile_cache_hits;
+}
 
 bool JITDebugReader::RegisterDebugInfoCallback(IOEventLoop* loop,
                                                const debug_info_callback_t& callback) {
@@ -482,6 +499,7 @@ bool JITDebugReader::ReadRemoteMem(Process& process, uint64_t remote_addr, uint6
   remote_iov.iov_base = reinterpret_cast<void*>(static_cast<uintptr_t>(remote_addr));
   remote_iov.iov_len = size;
   ssize_t result = process_vm_readv(process.pid, &local_iov, 1, &remote_iov, 1, 0);
+  stats_.remote_read_calls++;
   if (static_cast<size_t>(result) != size) {
     PLOG(DEBUG) << "ReadRemoteMem("
                 << " pid " << process.pid << ", addr " << std::hex << remote_addr << ", size "
@@ -489,9 +507,69 @@ bool JITDebugReader::ReadRemoteMem(Process& process, uint64_t remote_addr, uint6
     process.died = true;
     return false;
   }
+  stats_.remote_read_bytes += size;
   return true;
 }
 
+size_t ReadRemoteMemBatch(pid_t pid, std::vector<RemoteMemRequest>& requests) {
+  size_t calls = 0;
+  std::vector<iovec> local_iovs;
+  std::vector<iovec> remote_iovs;
+  size_t i = 0;
+  while (i < requests.size()) {
+    size_t n = std::min<size_t>(requests.size() - i, IOV_MAX);
+    local_iovs.resize(n);
+    remote_iovs.resize(n);
+    for (size_t j = 0; j < n; ++j) {
+      RemoteMemRequest& request = requests[i + j];
+      local_iovs[j].iov_base = request.data;
+      local_iovs[j].iov_len = request.size;
+      remote_iovs[j].iov_base = reinterpret_cast<void*>(static_cast<uintptr_t>(request.addr));
+      remote_iovs[j].iov_len = request.size;
+    }
+    ssize_t result = process_vm_readv(pid, local_iovs.data(), n, remote_iovs.data(), n, 0);
+    calls++;
+    if (result < 0) {
+      if (errno != EFAULT) {
+        // The process may have exited, no need to read the remaining requests.
+        PLOG(DEBUG) << "process_vm_readv(pid " << pid << ") failed";
+        for (; i < requests.size(); ++i) {
+          requests[i].success = false;
+        }
+        break;
+      }
+      result = 0;
+    }
+    // process_vm_readv() stops at the first remote iovec it can't fully read. So mark requests
+    // before it as success, mark it as failed, and continue from the one after it.
+    uint64_t left = static_cast<uint64_t>(result);
+    size_t j = 0;
+    for (; j < n && requests[i + j].size <= left; ++j) {
+      requests[i + j].success = true;
+      left -= requests[i + j].size;
+    }
+    if (j < n) {
+      requests[i + j].success = false;
+      j++;
+    }
+    i += j;
+  }
+  return calls;
+}
+
+void JITDebugReader::ReadRemoteMemBatch(Process& process, std::vector<RemoteMemRequest>& requests) {
+  stats_.remote_read_calls += simpleperf::ReadRemoteMemBatch(process.pid, requests);
+  for (const auto& request : requests) {
+    if (request.success) {
+      stats_.remote_read_bytes += request.size;
+    } else {
+      LOG(DEBUG) << "ReadRemoteMemBatch(pid " << process.pid << ", addr " << std::hex
+                 << request.addr << ", size " << request.size << ") failed";
+      process.died = true;
+    }
+  }
+}
+
 bool JITDebugReader::ReadDescriptors(Process& process, Descriptor* jit_descriptor,
                                      Descriptor* dex_descriptor) {
   if (process.is_64bit) {
@@ -518,6 +596,7 @@ bool JITDebugReader::ReadDescriptorsImpl(Process& process, Descriptor* jit_descr
       reinterpret_cast<void*>(static_cast<uintptr_t>(process.dex_descriptor_addr));
   remote_iovs[1].iov_len = sizeof(DescriptorT);
   ssize_t result = process_vm_readv(process.pid, local_iovs, 2, remote_iovs, 2, 0);
+  stats_.remote_read_calls++;
   if (static_cast<size_t>(result) != sizeof(DescriptorT) * 2) {
     PLOG(DEBUG) << "ReadDescriptor(pid " << process.pid << ", jit_addr " << std::hex
                 << process.jit_descriptor_addr << ", dex_addr " << process.dex_descriptor_addr
@@ -525,6 +604,7 @@ bool JITDebugReader::ReadDescriptorsImpl(Process& process, Descriptor* jit_descr
     process.died = true;
     return false;
   }
+  stats_.remote_read_bytes += sizeof(DescriptorT) * 2;
 
   if (!ParseDescriptor(raw_jit_descriptor, jit_descriptor) ||
       !ParseDescriptor(raw_dex_descriptor, dex_descriptor)) {
@@ -580,15 +660,46 @@ bool JITDebugReader::ReadNewCodeEntriesImpl(Process& process, const Descriptor&
   uint64_t current_entry_addr = descriptor.first_entry_addr;
   uint64_t prev_entry_addr = 0u;
   std::unordered_set<uint64_t> entry_addr_set;
+  std::unordered_map<uint64_t, std::unique_ptr<char[]>> entry_pages;
+
+  auto read_entry = [&](uint64_t addr, CodeEntryT* entry) {
+    uint64_t page_addr = addr & ~(kEntryPageSize - 1);
+    if (addr + sizeof(CodeEntryT) <= page_addr + kEntryPageSize) {
+      auto it = entry_pages.find(page_addr);
+      if (it == entry_pages.end()) {
+        if (entry_pages.size() == kMaxCachedEntryPages) {
+          entry_pages.clear();
+        }
+        std::unique_ptr<char[]> page(new char[kEntryPageSize]);
+        std::vector<RemoteMemRequest> requests(1);
+        requests[0].addr = page_addr;
+        requests[0].size = kEntryPageSize;
+        requests[0].data = page.get();
+        stats_.remote_read_calls += simpleperf::ReadRemoteMemBatch(process.pid, requests);
+        if (requests[0].success) {
+          stats_.remote_read_bytes += kEntryPageSize;
+          it = entry_pages.emplace(page_addr, std::move(page)).first;
+        }
+      }
+      if (it != entry_pages.end()) {
+        memcpy(entry, it->second.get() + (addr - page_addr), sizeof(CodeEntryT));
+        return true;
+      }
+    }
+    // The entry crosses a page boundary, or the page isn't fully readable.
+    return ReadRemoteMem(process, addr, sizeof(CodeEntryT), entry);
+  };
+
   for (size_t i = 0u; i < read_entry_limit && current_entry_addr != 0u; ++i) {
     if (entry_addr_set.find(current_entry_addr) != entry_addr_set.end()) {
       // We enter a loop, which means a broken linked list.
       return false;
     }
     CodeEntryT entry;
-    if (!ReadRemoteMem(process, current_entry_addr, sizeof(entry), &entry)) {
+    if (!read_entry(current_entry_addr, &entry)) {
       return false;
     }
+    stats_.code_entries_read++;
     if (entry.prev_addr != prev_entry_addr || !entry.Valid()) {
       // A broken linked list
       return false;
@@ -617,47 +728,76 @@ bool JITDebugReader::ReadJITCodeDebugInfo(Process& process,
                                           const std::vector<CodeEntry>& jit_entries,
                                           std::vector<JITDebugInfo>* debug_info) {
   std::vector<char> data;
-
-  for (auto& jit_entry : jit_entries) {
-    if (jit_entry.symfile_size > MAX_JIT_SYMFILE_SIZE) {
-      continue;
-    }
-    if (data.size() < jit_entry.symfile_size) {
-      data.resize(jit_entry.symfile_size);
-    }
-    if (!ReadRemoteMem(process, jit_entry.symfile_addr, jit_entry.symfile_size, data.data())) {
-      continue;
-    }
-    if (!IsValidElfFileMagic(data.data(), jit_entry.symfile_size)) {
-      continue;
-    }
-    TempSymFile* symfile = GetTempSymFile(process, jit_entry);
-    if (symfile == nullptr) {
-      return false;
-    }
-    uint64_t file_offset = symfile->GetOffset();
-    if (!symfile->WriteEntry(data.data(), jit_entry.symfile_size)) {
-      return false;
-    }
-
-    auto callback = [&](const ElfFileSymbol& symbol) {
-      if (symbol.len == 0) {  // Some arm labels can have zero length.
-        return;
+  std::vector<RemoteMemRequest> requests;
+  // Entries in a batch, and their index in requests (-1 for symfiles found in cache).
+  std::vector<std::pair<const CodeEntry*, int>> batch;
+
+  size_t i = 0;
+  while (i < jit_entries.size()) {
+    // 1. Collect a batch of symfiles to read.
+    batch.clear();
+    requests.clear();
+    uint64_t batch_size = 0;
+    for (; i < jit_entries.size(); ++i) {
+      const CodeEntry& jit_entry = jit_entries[i];
+      if (jit_entry.symfile_size > MAX_JIT_SYMFILE_SIZE) {
+        continue;
+      }
+      if (IsInJITZygoteCache(process, jit_entry)) {
+        ZygoteSymFileKey key{jit_entry.symfile_addr, jit_entry.symfile_size, jit_entry.timestamp};
+        if (zygote_symfile_cache_.count(key) != 0) {
+          batch.emplace_back(&jit_entry, -1);
+          continue;
+        }
+      }
+      if (batch_size + jit_entry.symfile_size > kMaxSymFileBatchSize && !requests.empty()) {
+        break;
+      }
+      RemoteMemRequest request;
+      request.addr = jit_entry.symfile_addr;
+      request.size = jit_entry.symfile_size;
+      // Set data after resizing the buffer.
+      request.data = nullptr;
+      batch.emplace_back(&jit_entry, static_cast<int>(requests.size()));
+      requests.push_back(request);
+      batch_size += jit_entry.symfile_size;
+    }
+
+    // 2. Read symfiles in the batch.
+    if (data.size() < batch_size) {
+      data.resize(batch_size);
+    }
+    uint64_t offset = 0;
+    for (auto& request : requests) {
+      request.data = data.data() + offset;
+      offset += request.size;
+    }
+    ReadRemoteMemBatch(process, requests);
+
+    // 3. Add debug info in the order of entries.
+    for (auto& [jit_entry, request_index] : batch) {
+      if (request_index == -1) {
+        ZygoteSymFileKey key{jit_entry->symfile_addr, jit_entry->symfile_size,
+                             jit_entry->timestamp};
+        const ZygoteSymFile& cached = zygote_symfile_cache_[key];
+        std::string path = zygote_symfile_->GetPath() +
+                           StringPrintf(":%" PRIu64 "-%" PRIu64, cached.file_offset,
+                                        cached.file_offset + jit_entry->symfile_size);
+        for (const auto& [vaddr, len] : cached.symbols) {
+          debug_info->emplace_back(process.pid, jit_entry->timestamp, vaddr, len, path,
+                                   cached.file_offset);
+        }
+        stats_.symfile_cache_hits++;
+        continue;
+      }
+      const RemoteMemRequest& request = requests[request_index];
+      if (!request.success || !IsValidElfFileMagic(request.data, request.size)) {
+        continue;
+      }
+      stats_.symfiles_read++;
+      if (!AddJITCodeSymFile(process, *jit_entry, request.data, debug_info)) {
+        return false;
       }
-      // Pass out the location of the symfile for unwinding and symbolization.
-      std::string location_in_file =
-          StringPrintf(":%" PRIu64 "-%" PRIu64, file_offset, file_offset + jit_entry.symfile_size);
-      debug_info->emplace_back(process.pid, jit_entry.timestamp, symbol.vaddr, symbol.len,
-                               symfile->GetPath() + location_in_file, file_offset);
-
-      LOG(VERBOSE) << "JITSymbol " << symbol.name << " at [" << std::hex << symbol.vaddr << " - "
-                   << (symbol.vaddr + symbol.len) << " with size " << symbol.len << " in "
-                   << symfile->GetPath() << location_in_file;
-    };
-    ElfStatus status;
-    auto elf = ElfFile::Open(data.data(), jit_entry.symfile_size, &status);
-    if (elf) {
-      elf->ParseSymbols(callback);
     }
   }
 
@@ -670,14 +810,59 @@ bool JITDebugReader::ReadJITCodeDebugInfo(Process& process,
   return true;
 }
 
-TempSymFile* JITDebugReader::GetTempSymFile(Process& process, const CodeEntry& jit_entry) {
-  bool is_zygote = false;
+bool JITDebugReader::AddJITCodeSymFile(Process& process, const CodeEntry& jit_entry,
+                                       const char* data, std::vector<JITDebugInfo>* debug_info) {
+  bool is_zygote = IsInJITZygoteCache(process, jit_entry);
+  TempSymFile* symfile = GetTempSymFile(is_zygote);
+  if (symfile == nullptr) {
+    return false;
+  }
+  uint64_t file_offset = symfile->GetOffset();
+  if (!symfile->WriteEntry(data, jit_entry.symfile_size)) {
+    return false;
+  }
+  ZygoteSymFile* cached = nullptr;
+  if (is_zygote) {
+    ZygoteSymFileKey key{jit_entry.symfile_addr, jit_entry.symfile_size, jit_entry.timestamp};
+    cached = &zygote_symfile_cache_[key];
+    cached->file_offset = file_offset;
+  }
+
+  auto callback = [&](const ElfFileSymbol& symbol) {
+    if (symbol.len == 0) {  // Some arm labels can have zero length.
+      return;
+    }
+    // Pass out the location of the symfile for unwinding and symbolization.
+    std::string location_in_file =
+        StringPrintf(":%" PRIu64 "-%" PRIu64, file_offset, file_offset + jit_entry.symfile_size);
+    debug_info->emplace_back(process.pid, jit_entry.timestamp, symbol.vaddr, symbol.len,
+                             symfile->GetPath() + location_in_file, file_offset);
+    if (cached != nullptr) {
+      cached->symbols.emplace_back(symbol.vaddr, symbol.len);
+    }
+
+    LOG(VERBOSE) << "JITSymbol " << symbol.name << " at [" << std::hex << symbol.vaddr << " - "
+                 << (symbol.vaddr + symbol.len) << " with size " << symbol.len << " in "
+                 << symfile->GetPath() << location_in_file;
+  };
+  ElfStatus status;
+  auto elf = ElfFile::Open(data, jit_entry.symfile_size, &status);
+  if (elf) {
+    elf->ParseSymbols(callback);
+  }
+  return true;
+}
+
+bool JITDebugReader::IsInJITZygoteCache(Process& process, const CodeEntry& jit_entry) {
   for (const auto& range : process.jit_zygote_cache_ranges_) {
     if (jit_entry.symfile_addr >= range.first && jit_entry.symfile_addr < range.second) {
-      is_zygote = true;
-      break;
+      return true;
     }
   }
+  return false;
+}
+
+TempSymFile* JITDebugReader::GetTempSymFile(bool is_zygote) {
   if (is_zygote) {
     if (!zygote_symfile_) {
       std::string path = symfile_prefix_ + "_" + kJITZygoteCacheFile;
@@ -88,6 +88,7 @@ struct JITDebugInfo {
   bool operator>(const JITDebugInfo& other) const { return timestamp > other.timestamp; }
 };
 
+struct RemoteMemRequest;
 class TempSymFile;
 
 // JITDebugReader reads debug info of JIT code and dex files of processes using ART. The
@@ -134,7 +135,21 @@ class JITDebugReader {
            path.find(std::string("_") + kJITZygoteCacheFile + ":") != path.npos;
   }
 
+  // Counters of the work done reading debug info from remote processes.
+  struct Stats {
+    uint64_t remote_read_calls = 0;  // number of process_vm_readv() calls
+    uint64_t remote_read_bytes = 0;
+    uint64_t code_entries_read = 0;
+    uint64_t symfiles_read = 0;
+    uint64_t symfile_cache_hits = 0;
+  };
+
+  const Stats& GetStats() const { return stats_; }
+
  private:
+  // Drives the private reading functions on a fake process in JITDebugReader_benchmark.cpp.
+  friend class JITDebugReaderBenchmarkHelper;
+
   enum class DescriptorType {
     kDEX,
     kJIT,
@@ -157,6 +172,34 @@ class JITDebugReader {
     uint64_t timestamp;  // CLOCK_MONOTONIC time of last action
   };
 
+  // A symfile in the jit zygote cache. It is shared by all app processes forked from zygote, so
+  // we only need to read it once.
+  struct ZygoteSymFileKey {
+    uint64_t addr;
+    uint64_t size;
+    uint64_t timestamp;
+
+    bool operator==(const ZygoteSymFileKey& other) const {
+      return addr == other.addr && size == other.size && timestamp == other.timestamp;
+    }
+  };
+
+  struct ZygoteSymFileKeyHash {
+    size_t operator()(const ZygoteSymFileKey& key) const {
+      size_t seed = std::hash<uint64_t>()(key.addr);
+      for (uint64_t value : {key.size, key.timestamp}) {
+        seed ^= std::hash<uint64_t>()(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+      }
+      return seed;
+    }
+  };
+
+  struct ZygoteSymFile {
+    uint64_t file_offset;
+    // (vaddr, len) of symbols in the symfile
+    std::vector<std::pair<uint64_t, uint64_t>> symbols;
+  };
+
   struct Process {
     pid_t pid = -1;
     bool initialized = false;
@@ -190,6 +233,7 @@ class JITDebugReader {
   bool InitializeProcess(Process& process);
   const DescriptorsLocation* GetDescriptorsLocation(const std::string& art_lib_path);
   bool ReadRemoteMem(Process& process, uint64_t remote_addr, uint64_t size, void* data);
+  void ReadRemoteMemBatch(Process& process, std::vector<RemoteMemRequest>& requests);
   bool ReadDescriptors(Process& process, Descriptor* jit_descriptor, Descriptor* dex_descriptor);
   template <typename DescriptorT>
   bool ReadDescriptorsImpl(Process& process, Descriptor* jit_descriptor,
@@ -207,7 +251,10 @@ class JITDebugReader {
 
   bool ReadJITCodeDebugInfo(Process& process, const std::vector<CodeEntry>& jit_entries,
                             std::vector<JITDebugInfo>* debug_info);
-  TempSymFile* GetTempSymFile(Process& process, const CodeEntry& jit_entry);
+  bool AddJITCodeSymFile(Process& process, const CodeEntry& jit_entry, const char* data,
+                         std::vector<JITDebugInfo>* debug_info);
+  bool IsInJITZygoteCache(Process& process, const CodeEntry& jit_entry);
+  TempSymFile* GetTempSymFile(bool is_zygote);
   void ReadDexFileDebugInfo(Process& process, const std::vector<CodeEntry>& dex_entries,
                             std::vector<JITDebugInfo>* debug_info);
   bool AddDebugInfo(const std::vector<JITDebugInfo>& debug_info, bool sync_kernel_records);
@@ -231,6 +278,9 @@ class JITDebugReader {
   // temporary files used to store jit symfiles created by the app process and the zygote process.
   std::unique_ptr<TempSymFile> app_symfile_;
   std::unique_ptr<TempSymFile> zygote_symfile_;
+  std::unordered_map<ZygoteSymFileKey, ZygoteSymFile, ZygoteSymFileKeyHash> zygote_symfile_cache_;
+
+  Stats stats_;
 };
 
 }  // namespace simpleperf
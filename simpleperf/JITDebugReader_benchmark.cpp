@@ -0,0 +1,219 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "JITDebugReader_impl.h"
+
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include <android-base/file.h>
+#include <benchmark/benchmark.h>
+
+#include "JITDebugReader.h"
+#include "get_test_data.h"
+
+using namespace simpleperf;
+
+// Requests reading [count] scattered blocks of [size] bytes, like reading jit code entries and
+// their symfiles. The current process is used as the remote process.
+static std::vector<RemoteMemRequest> CreateRequests(std::vector<char>& src, std::vector<char>& dst,
+                                                    size_t count, size_t size) {
+  src.assign(count * size * 2, 'a');
+  dst.resize(count * size);
+  std::vector<RemoteMemRequest> requests(count);
+  for (size_t i = 0; i < count; i++) {
+    requests[i].addr = reinterpret_cast<uintptr_t>(src.data() + i * size * 2);
+    requests[i].size = size;
+    requests[i].data = dst.data() + i * size;
+  }
+  return requests;
+}
+
+static void BM_ReadRemoteMem_PerRequest(benchmark::State& state) {
+  std::vector<char> src;
+  std::vector<char> dst;
+  std::vector<RemoteMemRequest> requests =
+      CreateRequests(src, dst, state.range(0), state.range(1));
+  pid_t pid = getpid();
+  for (auto _ : state) {
+    for (auto& request : requests) {
+      iovec local_iov = {request.data, request.size};
+      iovec remote_iov = {reinterpret_cast<void*>(request.addr), request.size};
+      benchmark::DoNotOptimize(process_vm_readv(pid, &local_iov, 1, &remote_iov, 1, 0));
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * dst.size());
+}
+BENCHMARK(BM_ReadRemoteMem_PerRequest)
+    ->ArgNames({"requests", "size"})
+    ->Args({256, 64})
+    ->Args({256, 4096})
+    ->Args({4096, 64});
+
+static void BM_ReadRemoteMem_Batch(benchmark::State& state) {
+  std::vector<char> src;
+  std::vector<char> dst;
+  std::vector<RemoteMemRequest> requests =
+      CreateRequests(src, dst, state.range(0), state.range(1));
+  pid_t pid = getpid();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(ReadRemoteMemBatch(pid, requests));
+  }
+  state.SetBytesProcessed(state.iterations() * dst.size());
+}
+BENCHMARK(BM_ReadRemoteMem_Batch)
+    ->ArgNames({"requests", "size"})
+    ->Args({256, 64})
+    ->Args({256, 4096})
+    ->Args({4096, 64});
+
+namespace simpleperf {
+
+// Reads jit debug info from a fake ART process. The current process is used as the remote
+// process, holding a linked list of jit code entries in the "Android2" layout, newest first. Each
+// entry has its own copy of an elf file as symfile.
+class JITDebugReaderBenchmarkHelper {
+ public:
+  // Match the layout of JITCodeEntry64V2 in JITDebugReader.cpp.
+  struct FakeCodeEntry {
+    uint64_t next_addr;
+    uint64_t prev_addr;
+    uint64_t symfile_addr;
+    uint64_t symfile_size;
+    uint64_t register_timestamp;
+    uint32_t seqlock;
+    uint32_t pad;
+  };
+  static_assert(sizeof(FakeCodeEntry) == 48, "");
+
+  JITDebugReaderBenchmarkHelper(size_t entry_count, bool in_zygote_cache)
+      : reader_(std::string(tmpdir_.path) + "/perf", JITDebugReader::SymFileOption::kDropSymFiles,
+                JITDebugReader::SyncOption::kNoSync) {
+    std::string elf;
+    android::base::ReadFileToString(GetTestData(ELF_FILE), &elf);
+    symfile_size_ = elf.size();
+    symfiles_.resize(entry_count * symfile_size_);
+    entries_.resize(entry_count);
+    for (size_t i = 0; i < entry_count; i++) {
+      elf.copy(symfiles_.data() + i * symfile_size_, symfile_size_);
+      FakeCodeEntry& entry = entries_[i];
+      entry.next_addr = i + 1 < entry_count ? Addr(&entries_[i + 1]) : 0;
+      entry.prev_addr = i > 0 ? Addr(&entries_[i - 1]) : 0;
+      entry.symfile_addr = Addr(symfiles_.data() + i * symfile_size_);
+      entry.symfile_size = symfile_size_;
+      entry.register_timestamp = entry_count - i;
+      entry.seqlock = 0;
+      entry.pad = 0;
+    }
+    process_.pid = getpid();
+    process_.initialized = true;
+    process_.is_64bit = true;
+    if (in_zygote_cache) {
+      process_.jit_zygote_cache_ranges_.emplace_back(Addr(symfiles_.data()),
+                                                     Addr(symfiles_.data() + symfiles_.size()));
+    }
+    descriptor_.type = JITDebugReader::DescriptorType::kJIT;
+    descriptor_.version = 2;
+    descriptor_.first_entry_addr = Addr(entries_.data());
+  }
+
+  bool ReadNewCodeEntries() {
+    code_entries_.clear();
+    return reader_.ReadNewCodeEntries(process_, descriptor_, 0, entries_.size(), &code_entries_) &&
+           code_entries_.size() == entries_.size();
+  }
+
+  bool ReadJITCodeDebugInfo() {
+    std::vector<JITDebugInfo> debug_info;
+    return reader_.ReadJITCodeDebugInfo(process_, code_entries_, &debug_info) &&
+           !debug_info.empty();
+  }
+
+  // Remove the app symfile written by the last read, so the temporary file doesn't grow across
+  // iterations. Symfiles in the zygote cache are kept, as the cache refers to them.
+  void DropAppSymFile() {
+    if (reader_.app_symfile_) {
+      unlink(reader_.app_symfile_->GetPath().c_str());
+      reader_.app_symfile_.reset();
+    }
+  }
+
+  size_t SymFileBytes() const { return symfiles_.size(); }
+
+ private:
+  template <typename T>
+  static uint64_t Addr(const T* p) {
+    return reinterpret_cast<uintptr_t>(p);
+  }
+
+  TemporaryDir tmpdir_;
+  JITDebugReader reader_;
+  size_t symfile_size_ = 0;
+  std::vector<char> symfiles_;
+  std::vector<FakeCodeEntry> entries_;
+  JITDebugReader::Process process_;
+  JITDebugReader::Descriptor descriptor_;
+  std::vector<JITDebugReader::CodeEntry> code_entries_;
+};
+
+}  // namespace simpleperf
+
+static void BM_ReadNewCodeEntries(benchmark::State& state) {
+  if (sizeof(void*) != 8) {
+    state.SkipWithError("the fake process needs the 64-bit entry layout");
+    return;
+  }
+  JITDebugReaderBenchmarkHelper helper(state.range(0), false);
+  for (auto _ : state) {
+    if (!helper.ReadNewCodeEntries()) {
+      state.SkipWithError("failed to read code entries");
+      return;
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ReadNewCodeEntries)->ArgNames({"entries"})->Arg(256)->Arg(4096);
+
+// The second argument puts symfiles in the jit zygote cache, so only the first iteration reads
+// them from the remote process.
+static void BM_ReadJITCodeDebugInfo(benchmark::State& state) {
+  if (sizeof(void*) != 8) {
+    state.SkipWithError("the fake process needs the 64-bit entry layout");
+    return;
+  }
+  JITDebugReaderBenchmarkHelper helper(state.range(0), state.range(1) != 0);
+  if (!helper.ReadNewCodeEntries()) {
+    state.SkipWithError("failed to read code entries");
+    return;
+  }
+  for (auto _ : state) {
+    if (!helper.ReadJITCodeDebugInfo()) {
+      state.SkipWithError("failed to read jit debug info");
+      return;
+    }
+    state.PauseTiming();
+    helper.DropAppSymFile();
+    state.ResumeTiming();
+  }
+  state.SetBytesProcessed(state.iterations() * helper.SymFileBytes());
+}
+BENCHMARK(BM_ReadJITCodeDebugInfo)
+    ->ArgNames({"entries", "zygote"})
+    ->Args({256, 0})
+    ->Args({256, 1});
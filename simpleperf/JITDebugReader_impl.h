@@ -17,9 +17,11 @@
 #pragma once
 
 #include <stdio.h>
+#include <sys/types.h>
 
 #include <memory>
 #include <string>
+#include <vector>
 
 #include <android-base/logging.h>
 
@@ -89,4 +91,17 @@ class TempSymFile {
   bool need_flush_ = false;
 };
 
+// A request to read [addr, addr + size) in a remote process into data.
+struct RemoteMemRequest {
+  uint64_t addr;
+  uint64_t size;
+  char* data;
+  bool success = false;
+};
+
+// Read all requests using as few process_vm_readv() calls as possible, by passing many iovecs in
+// each call. A request failing to read doesn't stop reading the following requests.
+// Return the number of process_vm_readv() calls made.
+size_t ReadRemoteMemBatch(pid_t pid, std::vector<RemoteMemRequest>& requests);
+
 }  // namespace simpleperf
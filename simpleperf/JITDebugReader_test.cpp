@@ -41,3 +41,30 @@ TEST(TempSymFile, smoke) {
   ASSERT_TRUE(android::base::ReadFullyAtOffset(tmpfile.fd, buf, test_data.size(), offset));
   ASSERT_EQ(strncmp(test_data.c_str(), buf, test_data.size()), 0);
 }
+
+TEST(JITDebugReader, ReadRemoteMemBatch) {
+  // Read from the current process, with an unreadable request in the middle.
+  std::vector<std::string> src = {"first", "second", "third"};
+  std::vector<std::string> dst = {std::string(5, '\0'), std::string(6, '\0'),
+                                  std::string(5, '\0')};
+  std::vector<char> bad_dst(16);
+  std::vector<RemoteMemRequest> requests(4);
+  for (size_t i = 0, j = 0; i < requests.size(); ++i) {
+    if (i == 1) {
+      requests[i].addr = 0;
+      requests[i].size = bad_dst.size();
+      requests[i].data = bad_dst.data();
+      continue;
+    }
+    requests[i].addr = reinterpret_cast<uintptr_t>(src[j].data());
+    requests[i].size = src[j].size();
+    requests[i].data = dst[j].data();
+    j++;
+  }
+  ASSERT_EQ(ReadRemoteMemBatch(getpid(), requests), 2u);
+  ASSERT_TRUE(requests[0].success);
+  ASSERT_FALSE(requests[1].success);
+  ASSERT_TRUE(requests[2].success);
+  ASSERT_TRUE(requests[3].success);
+  ASSERT_EQ(dst, src);
+}
@@ -19,6 +19,7 @@
 #include <inttypes.h>
 #include <sys/mman.h>
 
+#include <mutex>
 #include <unordered_map>
 
 #include <android-base/logging.h>
@@ -186,6 +187,10 @@ unwindstack::Regs* OfflineUnwinderImpl::GetBacktraceRegs(const RegSet& regs) {
 }
 
 static std::shared_ptr<unwindstack::MapInfo> CreateMapInfo(const MapEntry* entry) {
+  // Dso::GetDebugFilePath() and ApkInspector fill their caches lazily. Serialize them so that
+  // unwinders in different threads can unwind samples using the same ThreadTree.
+  static std::mutex mutex;
+  std::lock_guard<std::mutex> lock(mutex);
   std::string name_holder;
   const char* name = entry->dso->GetDebugFilePath().data();
   uint64_t pgoff = entry->pgoff;
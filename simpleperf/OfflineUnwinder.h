@@ -56,6 +56,8 @@ struct UnwindingResult {
   uint64_t stack_end;
 };
 
+// An OfflineUnwinder isn't thread safe. But different OfflineUnwinders can unwind samples in
+// parallel, as long as the ThreadTree they read isn't modified meanwhile.
 class OfflineUnwinder {
  public:
   static constexpr const char* META_KEY_ARM64_PAC_MASK = "arm64_pac_mask";
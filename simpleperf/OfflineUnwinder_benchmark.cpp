@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "OfflineUnwinder.h"
+
+#include <memory>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "dso.h"
+#include "get_test_data.h"
+#include "perf_regs.h"
+#include "record_file.h"
+#include "thread_tree.h"
+
+using namespace simpleperf;
+
+// Unwind all samples in a file recorded with `-g --no-unwind`, reusing the thread tree built
+// from the whole file. Unwinding is the dominant cost of `simpleperf debug-unwind` and of
+// recording with dwarf callchains.
+static void BM_OfflineUnwinder_UnwindCallChain(benchmark::State& state) {
+  Dso::SetSymFsDir(GetTestDataDir());
+  std::unique_ptr<RecordFileReader> reader =
+      RecordFileReader::CreateInstance(GetTestData(NATIVELIB_IN_APK_PERF_DATA));
+  ThreadTree thread_tree;
+  if (!reader || !reader->LoadBuildIdAndFileFeatures(thread_tree)) {
+    state.SkipWithError("failed to read perf.data");
+    return;
+  }
+  ScopedCurrentArch scoped_arch(GetArchType(reader->ReadFeatureString(PerfFileFormat::FEAT_ARCH)));
+  std::vector<std::unique_ptr<SampleRecord>> samples;
+  auto callback = [&](std::unique_ptr<Record> r) {
+    thread_tree.Update(*r);
+    if (r->type() == PERF_RECORD_SAMPLE) {
+      auto& sr = *static_cast<SampleRecord*>(r.get());
+      if (sr.stack_user_data.size > 0) {
+        samples.emplace_back(static_cast<SampleRecord*>(r.release()));
+      }
+    }
+    return true;
+  };
+  if (!reader->ReadDataSection(callback) || samples.empty()) {
+    state.SkipWithError("no sample to unwind");
+    return;
+  }
+  std::unique_ptr<OfflineUnwinder> unwinder = OfflineUnwinder::Create(false);
+  unwinder->LoadMetaInfo(reader->GetMetaInfoFeature());
+
+  std::vector<uint64_t> ips;
+  std::vector<uint64_t> sps;
+  size_t frames = 0;
+  for (auto _ : state) {
+    for (auto& sr : samples) {
+      ThreadEntry* thread = thread_tree.FindThreadOrNew(sr->tid_data.pid, sr->tid_data.tid);
+      RegSet regs(sr->regs_user_data.abi, sr->regs_user_data.reg_mask, sr->regs_user_data.regs);
+      unwinder->UnwindCallChain(*thread, regs, sr->stack_user_data.data, sr->stack_user_data.size,
+                                &ips, &sps);
+      frames += ips.size();
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * samples.size());
+  state.counters["frames_per_sample"] =
+      static_cast<double>(frames) / (state.iterations() * samples.size());
+  Dso::SetSymFsDir("");
+}
+BENCHMARK(BM_OfflineUnwinder_UnwindCallChain)->Unit(benchmark::kMicrosecond);
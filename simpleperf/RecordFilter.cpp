@@ -24,10 +24,10 @@ using android::base::Trim;
 
 namespace simpleperf {
 
-namespace {
-
 using TimeRange = std::pair<uint64_t, uint64_t>;
 
+// Time ranges are kept sorted and disjoint, so a timestamp is in at most one range. Samples are
+// mostly checked in time order, so the range matched last time is checked first.
 class TimeRanges {
  public:
   void Begin(uint64_t timestamp) {
@@ -52,34 +52,49 @@ class TimeRanges {
   void NoMoreTimestamp() {
     if (begin_time_.has_value()) {
       ranges_.emplace_back(begin_time_.value(), UINT64_MAX);
+      begin_time_.reset();
     }
     std::sort(ranges_.begin(), ranges_.end());
+    // Merge overlapping ranges.
+    size_t n = 0;
+    for (size_t i = 0; i < ranges_.size(); i++) {
+      if (n > 0 && ranges_[i].first <= ranges_[n - 1].second) {
+        ranges_[n - 1].second = std::max(ranges_[n - 1].second, ranges_[i].second);
+      } else {
+        ranges_[n++] = ranges_[i];
+      }
+    }
+    ranges_.resize(n);
+    last_index_ = 0;
   }
 
   bool Empty() const { return ranges_.empty(); }
 
-  bool InRange(uint64_t timestamp) const {
-    auto it = std::upper_bound(ranges_.begin(), ranges_.end(),
-                               std::pair<uint64_t, uint64_t>(timestamp, 0));
-    if (it != ranges_.end() && it->first == timestamp) {
+  bool InRange(uint64_t timestamp) {
+    if (last_index_ < ranges_.size() && InRange(ranges_[last_index_], timestamp)) {
       return true;
     }
-    if (it != ranges_.begin()) {
-      --it;
-      if (it->second > timestamp) {
-        return true;
-      }
+    auto it = std::upper_bound(
+        ranges_.begin(), ranges_.end(), timestamp,
+        [](uint64_t t, const TimeRange& range) { return t < range.first; });
+    if (it == ranges_.begin()) {
+      return false;
     }
-    return false;
+    --it;
+    last_index_ = it - ranges_.begin();
+    return InRange(*it, timestamp);
   }
 
  private:
+  static bool InRange(const TimeRange& range, uint64_t timestamp) {
+    return range.first <= timestamp && timestamp < range.second;
+  }
+
   std::optional<uint64_t> begin_time_;
   std::vector<TimeRange> ranges_;
+  size_t last_index_ = 0;
 };
 
-}  // namespace
-
 class TimeFilter {
  public:
   const std::string& GetClock() const { return clock_; }
@@ -111,22 +126,38 @@ class TimeFilter {
     return global_ranges_.Empty() && process_ranges_.empty() && thread_ranges_.empty();
   }
 
-  bool Check(const SampleRecord& sample) const {
-    uint64_t timestamp = sample.Timestamp();
-    if (!global_ranges_.Empty() && !global_ranges_.InRange(timestamp)) {
-      return false;
-    }
+  // Find time ranges to check for a thread. Return false if the thread has no time ranges, then
+  // all its samples are filtered out.
+  bool GetThreadRanges(pid_t pid, pid_t tid, TimeRanges** process_ranges,
+                       TimeRanges** thread_ranges) {
+    *process_ranges = nullptr;
+    *thread_ranges = nullptr;
     if (!process_ranges_.empty()) {
-      auto it = process_ranges_.find(sample.tid_data.pid);
-      if (it == process_ranges_.end() || !it->second.InRange(timestamp)) {
+      auto it = process_ranges_.find(pid);
+      if (it == process_ranges_.end()) {
         return false;
       }
+      *process_ranges = &it->second;
     }
     if (!thread_ranges_.empty()) {
-      auto it = thread_ranges_.find(sample.tid_data.tid);
-      if (it == thread_ranges_.end() || !it->second.InRange(timestamp)) {
+      auto it = thread_ranges_.find(tid);
+      if (it == thread_ranges_.end()) {
         return false;
       }
+      *thread_ranges = &it->second;
+    }
+    return true;
+  }
+
+  bool Check(TimeRanges* process_ranges, TimeRanges* thread_ranges, uint64_t timestamp) {
+    if (!global_ranges_.Empty() && !global_ranges_.InRange(timestamp)) {
+      return false;
+    }
+    if (process_ranges != nullptr && !process_ranges->InRange(timestamp)) {
+      return false;
+    }
+    if (thread_ranges != nullptr && !thread_ranges->InRange(timestamp)) {
+      return false;
     }
     return true;
   }
@@ -196,6 +227,7 @@ class FilterFileReader {
         }
       }
     }
+    time_filter_->NoMoreTimestamp();
     return true;
   }
 
@@ -291,18 +323,21 @@ bool RecordFilter::ParseOptions(OptionValueMap& options) {
 void RecordFilter::AddPids(const std::set<pid_t>& pids, bool exclude) {
   RecordFilterCondition& cond = GetCondition(exclude);
   cond.used = true;
+  ClearThreadVerdicts();
   cond.pids.insert(pids.begin(), pids.end());
 }
 
 void RecordFilter::AddTids(const std::set<pid_t>& tids, bool exclude) {
   RecordFilterCondition& cond = GetCondition(exclude);
   cond.used = true;
+  ClearThreadVerdicts();
   cond.tids.insert(tids.begin(), tids.end());
 }
 
 bool RecordFilter::AddProcessNameRegex(const std::string& process_name, bool exclude) {
   RecordFilterCondition& cond = GetCondition(exclude);
   cond.used = true;
+  ClearThreadVerdicts();
   if (auto regex = RegEx::Create(process_name); regex != nullptr) {
     cond.process_name_regs.emplace_back(std::move(regex));
     return true;
@@ -313,6 +348,7 @@ bool RecordFilter::AddProcessNameRegex(const std::string& process_name, bool exc
 bool RecordFilter::AddThreadNameRegex(const std::string& thread_name, bool exclude) {
   RecordFilterCondition& cond = GetCondition(exclude);
   cond.used = true;
+  ClearThreadVerdicts();
   if (auto regex = RegEx::Create(thread_name); regex != nullptr) {
     cond.thread_name_regs.emplace_back(std::move(regex));
     return true;
@@ -323,6 +359,7 @@ bool RecordFilter::AddThreadNameRegex(const std::string& thread_name, bool exclu
 void RecordFilter::AddUids(const std::set<uint32_t>& uids, bool exclude) {
   RecordFilterCondition& cond = GetCondition(exclude);
   cond.used = true;
+  ClearThreadVerdicts();
   cond.uids.insert(uids.begin(), uids.end());
 }
 
@@ -332,22 +369,32 @@ bool RecordFilter::SetFilterFile(const std::string& filename) {
     return false;
   }
   time_filter_ = std::move(reader.GetTimeFilter());
+  ClearThreadVerdicts();
   return true;
 }
 
 bool RecordFilter::Check(const SampleRecord* r) {
-  if (exclude_condition_.used && CheckCondition(r, exclude_condition_)) {
-    return false;
+  if (!exclude_condition_.used && !include_condition_.used && !time_filter_) {
+    return true;
   }
-  if (include_condition_.used && !CheckCondition(r, include_condition_)) {
+  const ThreadVerdict& verdict = GetThreadVerdict(r->tid_data.pid, r->tid_data.tid);
+  if (!verdict.pass) {
     return false;
   }
-  if (time_filter_ && !time_filter_->Check(*r)) {
-    return false;
+  if (time_filter_) {
+    return verdict.has_time_ranges &&
+           time_filter_->Check(verdict.process_ranges, verdict.thread_ranges, r->Timestamp());
   }
   return true;
 }
 
+bool RecordFilter::CheckThread(pid_t pid, pid_t tid) {
+  if (!exclude_condition_.used && !include_condition_.used) {
+    return true;
+  }
+  return GetThreadVerdict(pid, tid).pass;
+}
+
 bool RecordFilter::CheckClock(const std::string& clock) {
   if (time_filter_ && time_filter_->GetClock() != clock) {
     LOG(ERROR) << "clock generating sample timestamps is " << clock
@@ -361,31 +408,78 @@ void RecordFilter::Clear() {
   exclude_condition_ = RecordFilterCondition();
   include_condition_ = RecordFilterCondition();
   pid_to_uid_map_.clear();
+  ClearThreadVerdicts();
+}
+
+const RecordFilter::ThreadVerdict& RecordFilter::GetThreadVerdict(pid_t pid, pid_t tid) {
+  // Covers tids on most devices, while limiting the vector size.
+  static constexpr pid_t kMaxDenseTid = 1 << 18;
+  ThreadVerdict* verdict;
+  if (tid >= 0 && tid < kMaxDenseTid) {
+    if (static_cast<size_t>(tid) >= dense_thread_verdicts_.size()) {
+      dense_thread_verdicts_.resize(tid + 1);
+    }
+    verdict = &dense_thread_verdicts_[tid];
+  } else {
+    verdict = &sparse_thread_verdicts_[tid];
+  }
+  uint64_t version = thread_tree_.GetThreadNameVersion();
+  if (verdict->valid && verdict->pid == pid && verdict->thread_name_version == version) {
+    return *verdict;
+  }
+  // The version changes when any thread is added or renamed. The verdict only depends on the
+  // names of this thread and its process. Comms are interned, so comparing pointers is enough.
+  auto find_comm = [&](pid_t id) -> const char* {
+    const ThreadEntry* thread = thread_tree_.FindThread(id);
+    return thread != nullptr ? thread->comm : nullptr;
+  };
+  const char* process_comm = find_comm(pid);
+  const char* thread_comm = find_comm(tid);
+  verdict->thread_name_version = version;
+  if (verdict->valid && verdict->pid == pid && verdict->process_comm == process_comm &&
+      verdict->thread_comm == thread_comm) {
+    return *verdict;
+  }
+  verdict->valid = true;
+  verdict->pid = pid;
+  verdict->process_comm = process_comm;
+  verdict->thread_comm = thread_comm;
+  verdict->pass = !(exclude_condition_.used && CheckCondition(pid, tid, exclude_condition_)) &&
+                  !(include_condition_.used && !CheckCondition(pid, tid, include_condition_));
+  verdict->has_time_ranges =
+      time_filter_ &&
+      time_filter_->GetThreadRanges(pid, tid, &verdict->process_ranges, &verdict->thread_ranges);
+  return *verdict;
+}
+
+void RecordFilter::ClearThreadVerdicts() {
+  dense_thread_verdicts_.clear();
+  sparse_thread_verdicts_.clear();
 }
 
-bool RecordFilter::CheckCondition(const SampleRecord* r, const RecordFilterCondition& condition) {
-  if (condition.pids.count(r->tid_data.pid) == 1) {
+bool RecordFilter::CheckCondition(pid_t pid, pid_t tid, const RecordFilterCondition& condition) {
+  if (condition.pids.count(pid) == 1) {
     return true;
   }
-  if (condition.tids.count(r->tid_data.tid) == 1) {
+  if (condition.tids.count(tid) == 1) {
     return true;
   }
   if (!condition.process_name_regs.empty()) {
-    if (ThreadEntry* process = thread_tree_.FindThread(r->tid_data.pid); process != nullptr) {
+    if (ThreadEntry* process = thread_tree_.FindThread(pid); process != nullptr) {
       if (SearchInRegs(process->comm, condition.process_name_regs)) {
         return true;
       }
     }
   }
   if (!condition.thread_name_regs.empty()) {
-    if (ThreadEntry* thread = thread_tree_.FindThread(r->tid_data.tid); thread != nullptr) {
+    if (ThreadEntry* thread = thread_tree_.FindThread(tid); thread != nullptr) {
       if (SearchInRegs(thread->comm, condition.thread_name_regs)) {
         return true;
       }
     }
   }
   if (!condition.uids.empty()) {
-    if (auto uid_value = GetUidForProcess(r->tid_data.pid); uid_value) {
+    if (auto uid_value = GetUidForProcess(pid); uid_value) {
       if (condition.uids.count(uid_value.value()) == 1) {
         return true;
       }
@@ -47,7 +47,7 @@ namespace simpleperf {
   "                                            the regular expression.\n"                          \
   "--include-uid uid1,uid2,...   Include samples for processes belonging to selected uids.\n"
 
-#define RECORD_FILTER_OPTION_HELP_MSG_FOR_REPORTING                                                \
+#define RECORD_FILTER_OPTION_HELP_MSG_FOR_INJECTING                                                \
   "--exclude-pid pid1,pid2,...   Exclude samples for selected processes.\n"                        \
   "--exclude-tid tid1,tid2,...   Exclude samples for selected threads.\n"                          \
   "--exclude-process-name process_name_regex   Exclude samples for processes with name\n"          \
@@ -59,7 +59,10 @@ namespace simpleperf {
   "--include-process-name process_name_regex   Include samples for processes with name\n"          \
   "                                            containing the regular expression.\n"               \
   "--include-thread-name thread_name_regex     Include samples for threads with name containing\n" \
-  "                                            the regular expression.\n"                          \
+  "                                            the regular expression.\n"
+
+#define RECORD_FILTER_OPTION_HELP_MSG_FOR_REPORTING                                                \
+  RECORD_FILTER_OPTION_HELP_MSG_FOR_INJECTING                                                      \
   "--filter-file <file>          Use filter file to filter samples based on timestamps. The\n"     \
   "                              file format is in doc/sampler_filter.md.\n"
 
@@ -103,6 +106,7 @@ struct RecordFilterCondition {
 };
 
 class TimeFilter;
+class TimeRanges;
 
 // Filter SampleRecords based on the rule below:
 //   out_sample_records = (in_sample_records & ~exclude_conditions) & include_conditions
@@ -121,6 +125,8 @@ class RecordFilter {
 
   // Return true if the record passes filter.
   bool Check(const SampleRecord* r);
+  // Return true if the thread passes conditions on threads. The time filter isn't checked.
+  bool CheckThread(pid_t pid, pid_t tid);
 
   // Check if the clock matches the clock for timestamps in the filter file.
   bool CheckClock(const std::string& clock);
@@ -131,7 +137,25 @@ class RecordFilter {
   void Clear();
 
  private:
-  bool CheckCondition(const SampleRecord* r, const RecordFilterCondition& condition);
+  // Conditions on threads are checked once per thread, and only checked again when thread names
+  // in thread_tree_ change.
+  struct ThreadVerdict {
+    bool valid = false;
+    pid_t pid = 0;
+    uint64_t thread_name_version = 0;
+    // Names of the process and the thread when the verdict was computed.
+    const char* process_comm = nullptr;
+    const char* thread_comm = nullptr;
+    bool pass = false;
+    // Whether the thread has time ranges in time_filter_, and the ranges to check.
+    bool has_time_ranges = false;
+    TimeRanges* process_ranges = nullptr;
+    TimeRanges* thread_ranges = nullptr;
+  };
+
+  const ThreadVerdict& GetThreadVerdict(pid_t pid, pid_t tid);
+  void ClearThreadVerdicts();
+  bool CheckCondition(pid_t pid, pid_t tid, const RecordFilterCondition& condition);
   bool SearchInRegs(std::string_view s, const std::vector<std::unique_ptr<RegEx>>& regs);
   std::optional<uint32_t> GetUidForProcess(pid_t pid);
 
@@ -140,6 +164,9 @@ class RecordFilter {
   RecordFilterCondition include_condition_;
   std::unordered_map<pid_t, std::optional<uint32_t>> pid_to_uid_map_;
   std::unique_ptr<TimeFilter> time_filter_;
+  // Verdicts of small tids are kept in a vector indexed by tid, others are in a map.
+  std::vector<ThreadVerdict> dense_thread_verdicts_;
+  std::unordered_map<pid_t, ThreadVerdict> sparse_thread_verdicts_;
 };
 
 }  // namespace simpleperf
@@ -86,6 +86,33 @@ TEST_F(RecordFilterTest, exclude_thread_name_regex) {
   ASSERT_TRUE(filter.Check(GetRecord(1, 2)));
 }
 
+TEST_F(RecordFilterTest, thread_name_change) {
+  ASSERT_TRUE(filter.AddThreadNameRegex("threadA", false));
+  thread_tree.SetThreadName(1, 1, "threadA");
+  ASSERT_TRUE(filter.Check(GetRecord(1, 1)));
+  // Verdicts for a thread are updated when its name changes.
+  thread_tree.SetThreadName(1, 1, "threadB");
+  ASSERT_FALSE(filter.Check(GetRecord(1, 1)));
+  thread_tree.SetThreadName(1, 1, "threadA");
+  ASSERT_TRUE(filter.Check(GetRecord(1, 1)));
+  // Verdicts are updated when conditions change.
+  ASSERT_TRUE(filter.AddThreadNameRegex("threadA", true));
+  ASSERT_FALSE(filter.Check(GetRecord(1, 1)));
+}
+
+TEST_F(RecordFilterTest, process_name_change) {
+  ASSERT_TRUE(filter.AddProcessNameRegex("processA", false));
+  thread_tree.SetThreadName(1, 1, "processA");
+  thread_tree.SetThreadName(1, 2, "thread");
+  ASSERT_TRUE(filter.Check(GetRecord(1, 2)));
+  // Adding other threads doesn't change the verdict.
+  thread_tree.SetThreadName(3, 3, "processB");
+  ASSERT_TRUE(filter.Check(GetRecord(1, 2)));
+  // Verdicts for a thread are updated when the name of its process changes.
+  thread_tree.SetThreadName(1, 1, "processB");
+  ASSERT_FALSE(filter.Check(GetRecord(1, 2)));
+}
+
 TEST_F(RecordFilterTest, exclude_uid) {
   pid_t pid = getpid();
   std::optional<uint32_t> uid = GetProcessUid(pid);
@@ -161,6 +188,24 @@ TEST_F(RecordFilterTest, global_time_filter) {
   ASSERT_FALSE(filter.Check(r));
 }
 
+TEST_F(RecordFilterTest, overlapping_time_ranges) {
+  ASSERT_TRUE(
+      SetFilterData("GLOBAL_BEGIN 3000\n"
+                    "GLOBAL_END 4000\n"
+                    "GLOBAL_BEGIN 1000\n"
+                    "GLOBAL_END 5000\n"
+                    "GLOBAL_BEGIN 6000"));
+  SampleRecord* r = GetRecord(1, 1);
+  for (uint64_t time : {999, 5000, 5999}) {
+    r->time_data.time = time;
+    ASSERT_FALSE(filter.Check(r)) << time;
+  }
+  for (uint64_t time : {1000, 2000, 4500, 6000, 7000, 3000}) {
+    r->time_data.time = time;
+    ASSERT_TRUE(filter.Check(r)) << time;
+  }
+}
+
 TEST_F(RecordFilterTest, process_time_filter) {
   ASSERT_TRUE(
       SetFilterData("PROCESS_BEGIN 1 1000\n"
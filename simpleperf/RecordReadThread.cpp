@@ -20,6 +20,7 @@
 #include <unistd.h>
 
 #include <algorithm>
+#include <thread>
 #include <unordered_map>
 
 #include "environment.h"
@@ -31,6 +32,8 @@ namespace simpleperf {
 
 static constexpr size_t kDefaultLowBufferLevel = 10 * kMegabyte;
 static constexpr size_t kDefaultCriticalBufferLevel = 5 * kMegabyte;
+static constexpr size_t kMinEventFdsToMapInParallel = 256;
+static constexpr size_t kMaxThreadsToMapBuffers = 8;
 
 RecordBuffer::RecordBuffer(size_t buffer_size)
     : read_head_(0), write_head_(0), buffer_size_(buffer_size), buffer_(new char[buffer_size]) {}
@@ -391,51 +394,72 @@ bool RecordReadThread::HandleCmd(IOEventLoop& loop) {
 
 bool RecordReadThread::HandleAddEventFds(IOEventLoop& loop,
                                          const std::vector<EventFd*>& event_fds) {
-  std::unordered_map<int, EventFd*> cpu_map;
-  for (size_t pages = max_mmap_pages_; pages >= min_mmap_pages_; pages >>= 1) {
-    bool success = true;
-    bool report_error = pages == min_mmap_pages_;
-    for (EventFd* fd : event_fds) {
-      auto it = cpu_map.find(fd->Cpu());
-      if (it == cpu_map.end()) {
-        if (!fd->CreateMappedBuffer(pages, report_error)) {
-          success = false;
-          break;
-        }
-        if (IsEtmEventType(fd->attr().type)) {
-          if (!fd->CreateAuxBuffer(aux_buffer_size_, report_error)) {
-            fd->DestroyMappedBuffer();
-            success = false;
-            break;
-          }
-        }
-        cpu_map[fd->Cpu()] = fd;
-      } else {
-        if (!fd->ShareMappedBuffer(*(it->second), pages == min_mmap_pages_)) {
-          success = false;
-          break;
-        }
+  // Event fds on the same cpu share one mapped buffer, created by the first event fd on that cpu.
+  // Cpus don't share anything, so mapped buffers are created in parallel on different cpus.
+  uint64_t start_time = GetSystemClock();
+  std::vector<std::vector<EventFd*>> fds_per_cpu;
+  std::unordered_map<int, size_t> cpu_index_map;
+  for (EventFd* fd : event_fds) {
+    auto it = cpu_index_map.find(fd->Cpu());
+    if (it == cpu_index_map.end()) {
+      it = cpu_index_map.emplace(fd->Cpu(), fds_per_cpu.size()).first;
+      fds_per_cpu.emplace_back();
+    }
+    fds_per_cpu[it->second].push_back(fd);
+  }
+
+  auto map_buffer_on_cpu = [&](const std::vector<EventFd*>& fds, size_t pages, bool report_error) {
+    EventFd* leader = fds[0];
+    if (!leader->CreateMappedBuffer(pages, report_error)) {
+      return false;
+    }
+    if (IsEtmEventType(leader->attr().type)) {
+      if (!leader->CreateAuxBuffer(aux_buffer_size_, report_error)) {
+        leader->DestroyMappedBuffer();
+        return false;
       }
     }
+    for (size_t i = 1; i < fds.size(); i++) {
+      if (!fds[i]->ShareMappedBuffer(*leader, report_error)) {
+        return false;
+      }
+    }
+    return true;
+  };
+
+  bool success = false;
+  size_t max_threads =
+      event_fds.size() >= kMinEventFdsToMapInParallel
+          ? std::min<size_t>(kMaxThreadsToMapBuffers, std::thread::hardware_concurrency())
+          : 1;
+  for (size_t pages = max_mmap_pages_; pages >= min_mmap_pages_; pages >>= 1) {
+    bool report_error = pages == min_mmap_pages_;
+    std::vector<char> cpu_success(fds_per_cpu.size(), 0);
+    RunInParallel(fds_per_cpu.size(), max_threads, [&](size_t i) {
+      cpu_success[i] = map_buffer_on_cpu(fds_per_cpu[i], pages, report_error);
+    });
+    success = std::all_of(cpu_success.begin(), cpu_success.end(), [](char c) { return c != 0; });
     if (success) {
       LOG(VERBOSE) << "Each kernel buffer is " << pages << " pages.";
       break;
     }
-    for (auto& pair : cpu_map) {
-      pair.second->DestroyMappedBuffer();
-      pair.second->DestroyAuxBuffer();
+    for (auto& fds : fds_per_cpu) {
+      fds[0]->DestroyMappedBuffer();
+      fds[0]->DestroyAuxBuffer();
     }
-    cpu_map.clear();
   }
-  if (cpu_map.empty()) {
+  if (!success || fds_per_cpu.empty()) {
     return false;
   }
-  for (auto& pair : cpu_map) {
-    if (!pair.second->StartPolling(loop, [this]() { return ReadRecordsFromKernelBuffer(); })) {
+  for (auto& fds : fds_per_cpu) {
+    if (!fds[0]->StartPolling(loop, [this]() { return ReadRecordsFromKernelBuffer(); })) {
       return false;
     }
-    kernel_record_readers_.emplace_back(pair.second);
+    kernel_record_readers_.emplace_back(fds[0]);
   }
+  LOG(VERBOSE) << "Mapped buffers for " << event_fds.size() << " event files on "
+               << fds_per_cpu.size() << " cpus in " << (GetSystemClock() - start_time) / 1e6
+               << " ms";
   return true;
 }
 
@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// simpleperf_benchmark measures the throughput of the stages used by report/inject commands.
+// Run it on host or device as:
+//   simpleperf_benchmark [-t <testdata_dir>] [--log <severity>] [benchmark options]
+// Results can be saved in json format with `--benchmark_out=<file> --benchmark_out_format=json`,
+// or printed in json format with `--benchmark_format=json`.
+
+#include <string.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/strings.h>
+#include <benchmark/benchmark.h>
+
+#include "environment.h"
+#include "get_test_data.h"
+#include "utils.h"
+
+using namespace simpleperf;
+
+static std::string testdata_dir;
+
+int main(int argc, char** argv) {
+  android::base::InitLogging(argv, android::base::StderrLogger);
+  android::base::LogSeverity log_severity = android::base::WARNING;
+  testdata_dir = android::base::GetExecutableDirectory() + "/testdata";
+
+  std::vector<char*> args;
+  args.push_back(argv[0]);
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+      testdata_dir = argv[++i];
+    } else if (strcmp(argv[i], "--log") == 0 && i + 1 < argc) {
+      if (!GetLogSeverity(argv[++i], &log_severity)) {
+        LOG(ERROR) << "Unknown log severity: " << argv[i];
+        return 1;
+      }
+    } else {
+      args.push_back(argv[i]);
+    }
+  }
+  android::base::ScopedLogSeverity severity(log_severity);
+  if (!IsDir(testdata_dir)) {
+    LOG(ERROR) << "testdata wasn't found. Use \"" << argv[0] << " -t <testdata_dir>\"";
+    return 1;
+  }
+  if (!android::base::EndsWith(testdata_dir, OS_PATH_SEPARATOR)) {
+    testdata_dir += OS_PATH_SEPARATOR;
+  }
+
+#if defined(__ANDROID__)
+  std::string tmp_dir = "/data/local/tmp";
+#else
+  std::string tmp_dir = "/tmp";
+#endif
+  std::unique_ptr<ScopedTempFiles> scoped_temp_files = ScopedTempFiles::Create(tmp_dir);
+  if (!scoped_temp_files) {
+    return 1;
+  }
+
+  argc = args.size();
+  ::benchmark::Initialize(&argc, args.data());
+  if (::benchmark::ReportUnrecognizedArguments(argc, args.data())) return 1;
+  ::benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
+
+std::string GetTestData(const std::string& filename) {
+  return testdata_dir + filename;
+}
+
+const std::string& GetTestDataDir() {
+  return testdata_dir;
+}
@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "benchmark_util.h"
+
+#include <inttypes.h>
+#include <unistd.h>
+
+#include <map>
+#include <memory>
+#include <random>
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/stringprintf.h>
+
+#include "event_attr.h"
+#include "event_type.h"
+#include "record_file.h"
+
+namespace simpleperf {
+
+std::string SyntheticDsoPath(size_t index) {
+  return android::base::StringPrintf("/synthetic/lib%zu.so", index);
+}
+
+static uint32_t SyntheticPid(size_t process) {
+  return 1000 + process * 100;
+}
+
+static uint32_t SyntheticTid(size_t process, size_t thread) {
+  return SyntheticPid(process) + thread;
+}
+
+std::vector<std::unique_ptr<SampleRecord>> GenerateSyntheticSamples(const perf_event_attr& attr,
+                                                                    size_t sample_count,
+                                                                    size_t callchain_depth) {
+  std::mt19937_64 rng(sample_count * 131 + callchain_depth);
+  std::uniform_int_distribution<uint64_t> addr_dist(
+      kSyntheticDsoStart, kSyntheticDsoStart + kSyntheticDsoCount * kSyntheticDsoSize - 1);
+  std::uniform_int_distribution<size_t> process_dist(0, kSyntheticProcessCount - 1);
+  std::uniform_int_distribution<size_t> thread_dist(0, kSyntheticThreadsPerProcess - 1);
+
+  std::vector<std::unique_ptr<SampleRecord>> samples;
+  samples.reserve(sample_count);
+  PerfSampleReadType read_data;
+  std::vector<uint64_t> ips;
+  uint64_t time = 1000000;
+  for (size_t i = 0; i < sample_count; i++) {
+    size_t process = process_dist(rng);
+    uint32_t pid = SyntheticPid(process);
+    uint32_t tid = SyntheticTid(process, thread_dist(rng));
+    uint64_t ip = addr_dist(rng);
+    ips.clear();
+    if (callchain_depth > 0) {
+      ips.push_back(ip);
+      while (ips.size() < callchain_depth) {
+        ips.push_back(addr_dist(rng));
+      }
+    }
+    time += 1000;
+    samples.emplace_back(new SampleRecord(attr, 0, ip, pid, tid, time, i % 8, 1, read_data, ips,
+                                          {}, 0));
+  }
+  return samples;
+}
+
+static bool WriteSyntheticPerfData(const std::string& path, size_t sample_count,
+                                   size_t callchain_depth) {
+  std::unique_ptr<EventTypeAndModifier> event_type = ParseEventType("cpu-cycles");
+  if (!event_type) {
+    return false;
+  }
+  EventAttrIds attr_ids(1);
+  perf_event_attr& attr = attr_ids[0].attr;
+  attr = CreateDefaultPerfEventAttr(event_type->event_type);
+  attr.sample_id_all = 1;
+  if (callchain_depth > 0) {
+    attr.sample_type |= PERF_SAMPLE_CALLCHAIN;
+  }
+  attr_ids[0].ids.push_back(0);
+
+  std::unique_ptr<RecordFileWriter> writer = RecordFileWriter::CreateInstance(path);
+  if (!writer || !writer->WriteAttrSection(attr_ids)) {
+    return false;
+  }
+  for (size_t process = 0; process < kSyntheticProcessCount; process++) {
+    uint32_t pid = SyntheticPid(process);
+    for (size_t thread = 0; thread < kSyntheticThreadsPerProcess; thread++) {
+      uint32_t tid = SyntheticTid(process, thread);
+      std::string comm = android::base::StringPrintf("synthetic_%u", tid);
+      if (!writer->WriteRecord(CommRecord(attr, pid, tid, comm, 0, 0))) {
+        return false;
+      }
+    }
+    for (size_t i = 0; i < kSyntheticDsoCount; i++) {
+      MmapRecord mmap(attr, false, pid, pid, kSyntheticDsoStart + i * kSyntheticDsoSize,
+                      kSyntheticDsoSize, 0, SyntheticDsoPath(i), 0);
+      if (!writer->WriteRecord(mmap)) {
+        return false;
+      }
+    }
+  }
+  for (auto& sample : GenerateSyntheticSamples(attr, sample_count, callchain_depth)) {
+    if (!writer->WriteRecord(*sample)) {
+      return false;
+    }
+  }
+
+  if (!writer->BeginWriteFeatures(1)) {
+    return false;
+  }
+  for (size_t i = 0; i < kSyntheticDsoCount; i++) {
+    FileFeature file;
+    file.path = SyntheticDsoPath(i);
+    file.type = DSO_ELF_FILE;
+    file.min_vaddr = 0;
+    file.file_offset_of_min_vaddr = 0;
+    for (uint64_t addr = 0; addr < kSyntheticDsoSize; addr += kSyntheticSymbolSize) {
+      std::string name = android::base::StringPrintf("lib%zu_func_%" PRIx64, i, addr);
+      file.symbols.emplace_back(name, addr, kSyntheticSymbolSize);
+    }
+    if (!writer->WriteFileFeature(file)) {
+      return false;
+    }
+  }
+  return writer->EndWriteFeatures() && writer->Close();
+}
+
+const std::string& GetSyntheticPerfData(size_t sample_count, size_t callchain_depth) {
+  struct SyntheticFile {
+    std::unique_ptr<TemporaryFile> tmpfile;
+    std::string path;
+  };
+  static std::map<std::pair<size_t, size_t>, SyntheticFile> files;
+
+  SyntheticFile& file = files[std::make_pair(sample_count, callchain_depth)];
+  if (!file.tmpfile) {
+    file.tmpfile.reset(new TemporaryFile);
+    close(file.tmpfile->release());
+    if (WriteSyntheticPerfData(file.tmpfile->path, sample_count, callchain_depth)) {
+      file.path = file.tmpfile->path;
+    } else {
+      LOG(ERROR) << "failed to generate synthetic perf.data";
+    }
+  }
+  return file.path;
+}
+
+void SyntheticPerfDataArgs(benchmark::internal::Benchmark* b) {
+  for (int64_t sample_count : {1000, 10000, 100000}) {
+    for (int64_t callchain_depth : {0, 16, 64}) {
+      b->Args({sample_count, callchain_depth});
+    }
+  }
+  b->ArgNames({"samples", "depth"});
+}
+
+}  // namespace simpleperf
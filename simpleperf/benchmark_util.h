@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMPLE_PERF_BENCHMARK_UTIL_H_
+#define SIMPLE_PERF_BENCHMARK_UTIL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "record.h"
+
+namespace simpleperf {
+
+// Layout of the synthetic processes used by benchmarks. Each process maps kSyntheticDsoCount
+// libraries, and each library is fully covered by symbols of kSyntheticSymbolSize bytes.
+constexpr size_t kSyntheticProcessCount = 4;
+constexpr size_t kSyntheticThreadsPerProcess = 4;
+constexpr size_t kSyntheticDsoCount = 16;
+constexpr uint64_t kSyntheticDsoStart = 0x70000000;
+constexpr uint64_t kSyntheticDsoSize = 0x100000;
+constexpr uint64_t kSyntheticSymbolSize = 0x100;
+
+std::string SyntheticDsoPath(size_t index);
+
+// Generate sample records with callchains of [callchain_depth] ips, using a fixed seed so that
+// runs are comparable.
+std::vector<std::unique_ptr<SampleRecord>> GenerateSyntheticSamples(const perf_event_attr& attr,
+                                                                    size_t sample_count,
+                                                                    size_t callchain_depth);
+
+// Return the path of a synthetic perf.data, which contains mmap records for the synthetic
+// processes, [sample_count] samples and file features with symbols for all libraries. Files are
+// generated on first use and reused by later benchmarks. Return an empty string on failure.
+const std::string& GetSyntheticPerfData(size_t sample_count, size_t callchain_depth);
+
+// Args used by benchmarks parameterized by (sample_count, callchain_depth).
+void SyntheticPerfDataArgs(benchmark::internal::Benchmark* b);
+
+}  // namespace simpleperf
+
+#endif  // SIMPLE_PERF_BENCHMARK_UTIL_H_
@@ -17,8 +17,11 @@
 #include <stdio.h>
 
 #include <algorithm>
+#include <iterator>
+#include <map>
 #include <memory>
 #include <string>
+#include <tuple>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -114,6 +117,140 @@ struct UnwindingStat {
   }
 };
 
+static const char* GetUnwindingErrorName(uint64_t error_code) {
+  static const char* const names[] = {
+      "ERROR_NONE",           "ERROR_MEMORY_INVALID",        "ERROR_UNWIND_INFO",
+      "ERROR_UNSUPPORTED",    "ERROR_INVALID_MAP",           "ERROR_MAX_FRAMES_EXCEEDED",
+      "ERROR_REPEATED_FRAME", "ERROR_INVALID_ELF",           "ERROR_THREAD_DOES_NOT_EXIST",
+      "ERROR_THREAD_TIMEOUT", "ERROR_SYSTEM_CALL",           "ERROR_BAD_ARCH",
+      "ERROR_MAPS_PARSE",     "ERROR_INVALID_PARAMETER",
+  };
+  static_assert(std::size(names) == ERROR_MAX + 1);
+  return error_code < std::size(names) ? names[error_code] : "ERROR_UNKNOWN";
+}
+
+// Aggregate failed unwinding results by error code and the last unwound frame, which is where
+// unwinding stopped. Reading it scales better than reading 100k+ failed samples one by one.
+class UnwindingFailureSummary {
+ public:
+  enum class Format { CSV, JSON };
+
+  void AddFailure(uint64_t error_code, const std::string& dso, const std::string& symbol,
+                  const std::string& map, uint64_t sample_time) {
+    Bucket& bucket = buckets_[Key(error_code, dso, symbol, map)];
+    bucket.count++;
+    if (bucket.example_sample_times.size() < kMaxExampleSampleTimes) {
+      bucket.example_sample_times.push_back(sample_time);
+    }
+  }
+
+  bool Write(const std::string& filename, Format format) const {
+    std::unique_ptr<FILE, decltype(&fclose)> fp(fopen(filename.c_str(), "we"), fclose);
+    if (!fp) {
+      PLOG(ERROR) << "failed to write to " << filename;
+      return false;
+    }
+    // Print the most frequent failures first.
+    std::vector<const std::pair<const Key, Bucket>*> items;
+    for (const auto& item : buckets_) {
+      items.push_back(&item);
+    }
+    std::stable_sort(items.begin(), items.end(),
+                     [](auto a, auto b) { return a->second.count > b->second.count; });
+    if (format == Format::CSV) {
+      fprintf(fp.get(), "error_code,error_name,dso,symbol,map,count,example_sample_times\n");
+    } else {
+      fprintf(fp.get(), "[");
+    }
+    for (size_t i = 0; i < items.size(); i++) {
+      const auto& [error_code, dso, symbol, map] = items[i]->first;
+      const Bucket& bucket = items[i]->second;
+      std::string times;
+      for (uint64_t time : bucket.example_sample_times) {
+        if (!times.empty()) {
+          times += format == Format::CSV ? ";" : ", ";
+        }
+        times += std::to_string(time);
+      }
+      if (format == Format::CSV) {
+        fprintf(fp.get(), "%" PRIu64 ",%s,%s,%s,%s,%" PRIu64 ",%s\n", error_code,
+                GetUnwindingErrorName(error_code), ToCsvField(dso).c_str(),
+                ToCsvField(symbol).c_str(), ToCsvField(map).c_str(), bucket.count, times.c_str());
+      } else {
+        fprintf(fp.get(),
+                "%s\n  {\"error_code\": %" PRIu64
+                ", \"error_name\": \"%s\", \"dso\": %s, \"symbol\": %s, "
+                "\"map\": %s, \"count\": %" PRIu64 ", \"example_sample_times\": [%s]}",
+                i == 0 ? "" : ",", error_code, GetUnwindingErrorName(error_code),
+                ToJsonString(dso).c_str(), ToJsonString(symbol).c_str(),
+                ToJsonString(map).c_str(), bucket.count, times.c_str());
+      }
+    }
+    if (format == Format::JSON) {
+      fprintf(fp.get(), "\n]\n");
+    }
+    if (fflush(fp.get()) != 0) {
+      PLOG(ERROR) << "failed to write to " << filename;
+      return false;
+    }
+    return true;
+  }
+
+ private:
+  // (error code, dso, symbol, map) of the last unwound frame.
+  using Key = std::tuple<uint64_t, std::string, std::string, std::string>;
+  struct Bucket {
+    uint64_t count = 0;
+    std::vector<uint64_t> example_sample_times;
+  };
+  static constexpr size_t kMaxExampleSampleTimes = 5;
+
+  static std::string ToCsvField(const std::string& s) {
+    // Demangled C++ symbols often contain commas.
+    if (s.find_first_of(",\"\n") == std::string::npos) {
+      return s;
+    }
+    std::string result = "\"";
+    for (char c : s) {
+      if (c == '"') {
+        result += '"';
+      }
+      result += c;
+    }
+    return result + "\"";
+  }
+
+  static std::string ToJsonString(const std::string& s) {
+    std::string result = "\"";
+    for (char c : s) {
+      if (c == '"' || c == '\\') {
+        result += '\\';
+        result += c;
+      } else if (static_cast<unsigned char>(c) < 0x20) {
+        result += android::base::StringPrintf("\\u%04x", c);
+      } else {
+        result += c;
+      }
+    }
+    return result + "\"";
+  }
+
+  std::map<Key, Bucket> buckets_;
+};
+
+// Add the last frame of a failed unwinding result to the summary.
+static void AddUnwindingFailure(UnwindingFailureSummary& summary, const UnwindingResult& result,
+                                uint64_t sample_time, const Dso* dso, const Symbol* symbol,
+                                const MapEntry* map, uint64_t pgoff) {
+  std::string map_str;
+  if (map != nullptr) {
+    map_str = android::base::StringPrintf("[0x%" PRIx64 "-0x%" PRIx64 "], pgoff 0x%" PRIx64,
+                                          map->start_addr, map->get_end_addr(), pgoff);
+  }
+  summary.AddFailure(result.error_code, dso != nullptr ? dso->Path() : "",
+                     symbol != nullptr ? symbol->DemangledName() : "", map_str, sample_time);
+}
+
 class RecordFileProcessor {
  public:
   RecordFileProcessor(const std::string& output_filename, bool output_binary_mode)
@@ -128,6 +265,9 @@ class RecordFileProcessor {
     }
   }
 
+  // Failed unwinding results are also added to the summary, if set.
+  void SetFailureSummary(UnwindingFailureSummary* summary) { failure_summary_ = summary; }
+
   bool ProcessFile(const std::string& input_filename) {
     // 1. Check input file.
     record_filename_ = input_filename;
@@ -205,6 +345,7 @@ class RecordFileProcessor {
   // Map from file path to offset in the recording file.
   std::unordered_map<std::string, DebugUnwindFileLocation> debug_unwind_files_;
   CallChainReportBuilder callchain_report_builder_;
+  UnwindingFailureSummary* failure_summary_ = nullptr;
 };
 
 static void DumpUnwindingResult(const UnwindingResult& result, FILE* fp) {
@@ -218,10 +359,12 @@ static void DumpUnwindingResult(const UnwindingResult& result, FILE* fp) {
 class SampleUnwinder : public RecordFileProcessor {
  public:
   SampleUnwinder(const std::string& output_filename,
-                 const std::unordered_set<uint64_t>& sample_times, bool skip_sample_print)
+                 const std::unordered_set<uint64_t>& sample_times, bool skip_sample_print,
+                 size_t jobs)
       : RecordFileProcessor(output_filename, false),
         sample_times_(sample_times),
-        skip_sample_print_(skip_sample_print) {}
+        skip_sample_print_(skip_sample_print),
+        jobs_(jobs) {}
 
  protected:
   bool CheckRecordCmd(const std::string& record_cmd) override {
@@ -235,6 +378,13 @@ class SampleUnwinder : public RecordFileProcessor {
   }
 
   bool Process() override {
+    // Unwinders cache maps of processes, so each thread uses its own unwinder.
+    unwinders_.push_back(unwinder_.get());
+    for (size_t i = 1; i < jobs_; i++) {
+      owned_unwinders_.emplace_back(OfflineUnwinder::Create(true));
+      owned_unwinders_.back()->LoadMetaInfo(reader_->GetMetaInfoFeature());
+      unwinders_.push_back(owned_unwinders_.back().get());
+    }
     if (!GetMemStat(&stat_.mem_before_unwinding)) {
       return false;
     }
@@ -242,6 +392,9 @@ class SampleUnwinder : public RecordFileProcessor {
             [&](std::unique_ptr<Record> r) { return ProcessRecord(std::move(r)); })) {
       return false;
     }
+    if (!UnwindTasks()) {
+      return false;
+    }
     if (!GetMemStat(&stat_.mem_after_unwinding)) {
       return false;
     }
@@ -264,7 +417,13 @@ class SampleUnwinder : public RecordFileProcessor {
           regs = &last_unwinding_result_->regs_user_data;
         }
         if (stack->size > 0 || regs->reg_mask > 0) {
-          if (!UnwindRecord(sr, *regs, *stack)) {
+          UnwindingTask& task = tasks_.emplace_back();
+          task.thread = GetThreadForUnwinding(sr);
+          task.regs = regs;
+          task.stack = stack;
+          task.sample.reset(static_cast<SampleRecord*>(r.release()));
+          task.unwinding_result_record = std::move(last_unwinding_result_);
+          if (tasks_.size() >= (jobs_ == 1 ? 1 : kTaskBatchSize) && !UnwindTasks()) {
             return false;
           }
         }
@@ -300,56 +459,135 @@ class SampleUnwinder : public RecordFileProcessor {
     }
   }
 
-  bool UnwindRecord(const SampleRecord& r, const PerfSampleRegsUserType& regs,
-                    const PerfSampleStackUserType& stack) {
-    ThreadEntry* thread = thread_tree_.FindThreadOrNew(r.tid_data.pid, r.tid_data.tid);
-
-    RegSet reg_set(regs.abi, regs.reg_mask, regs.regs);
+ private:
+  struct UnwindingTask {
+    std::unique_ptr<SampleRecord> sample;
+    // Keeps regs and stack data when they are stored in an UnwindingResultRecord.
+    std::unique_ptr<UnwindingResultRecord> unwinding_result_record;
+    const PerfSampleRegsUserType* regs = nullptr;
+    const PerfSampleStackUserType* stack = nullptr;
+    // The thread with maps at the time of the sample.
+    ThreadEntry thread;
+    bool unwinding_ok = false;
+    UnwindingResult unwinding_result;
     std::vector<uint64_t> ips;
     std::vector<uint64_t> sps;
-    if (!unwinder_->UnwindCallChain(*thread, reg_set, stack.data, stack.size, &ips, &sps)) {
-      return false;
+  };
+
+  struct MapSetSnapshot {
+    const MapSet* source = nullptr;
+    uint64_t version = 0;
+    std::shared_ptr<MapSet> maps;
+  };
+
+  // Samples are unwound in batches of this size when using multiple threads.
+  static constexpr size_t kTaskBatchSize = 1024;
+
+  ThreadEntry GetThreadForUnwinding(const SampleRecord& r) {
+    ThreadEntry thread = *thread_tree_.FindThreadOrNew(r.tid_data.pid, r.tid_data.tid);
+    if (jobs_ > 1) {
+      // Maps may change before the batch is unwound. So unwind with a copy of them, shared by
+      // samples of the same process until the maps change.
+      MapSetSnapshot& snapshot = map_snapshots_[thread.pid];
+      if (snapshot.source != thread.maps.get() || snapshot.version != thread.maps->version) {
+        snapshot.source = thread.maps.get();
+        snapshot.version = thread.maps->version;
+        snapshot.maps = std::make_shared<MapSet>(*thread.maps);
+      }
+      thread.maps = snapshot.maps;
+    }
+    return thread;
+  }
+
+  bool UnwindTasks() {
+    if (tasks_.empty()) {
+      return true;
     }
-    stat_.AddUnwindingResult(unwinder_->GetUnwindingResult());
+    size_t threads = std::min(jobs_, tasks_.size());
+    size_t tasks_per_thread = (tasks_.size() + threads - 1) / threads;
+    RunInParallel(threads, threads, [&](size_t thread_index) {
+      OfflineUnwinder* unwinder = unwinders_[thread_index];
+      size_t end = std::min(tasks_.size(), (thread_index + 1) * tasks_per_thread);
+      for (size_t i = thread_index * tasks_per_thread; i < end; i++) {
+        UnwindingTask& task = tasks_[i];
+        RegSet reg_set(task.regs->abi, task.regs->reg_mask, task.regs->regs);
+        task.unwinding_ok = unwinder->UnwindCallChain(task.thread, reg_set, task.stack->data,
+                                                      task.stack->size, &task.ips, &task.sps);
+        task.unwinding_result = unwinder->GetUnwindingResult();
+      }
+    });
+    // Report results in sample order.
+    for (UnwindingTask& task : tasks_) {
+      if (!task.unwinding_ok) {
+        return false;
+      }
+      stat_.AddUnwindingResult(task.unwinding_result);
+      ReportUnwindingResult(task);
+    }
+    tasks_.clear();
+    return true;
+  }
 
+  void ReportUnwindingResult(UnwindingTask& task) {
+    bool failed = task.unwinding_result.error_code != ERROR_NONE;
+    if (skip_sample_print_ && !(failed && failure_summary_ != nullptr)) {
+      return;
+    }
+    uint64_t sample_time = task.sample->Timestamp();
+    std::vector<CallChainReportEntry> entries =
+        callchain_report_builder_.Build(&task.thread, task.ips, 0);
     if (!skip_sample_print_) {
-      // Print unwinding result.
-      fprintf(out_fp_, "sample_time: %" PRIu64 "\n", r.Timestamp());
-      DumpUnwindingResult(unwinder_->GetUnwindingResult(), out_fp_);
-      std::vector<CallChainReportEntry> entries = callchain_report_builder_.Build(thread, ips, 0);
-      for (size_t i = 0; i < entries.size(); i++) {
-        size_t id = i + 1;
-        auto& entry = entries[i];
-        fprintf(out_fp_, "ip_%zu: 0x%" PRIx64 "\n", id, entry.ip);
-        fprintf(out_fp_, "sp_%zu: 0x%" PRIx64 "\n", id, sps[i]);
-
-        Dso* dso = entry.map->dso;
-        uint64_t pgoff = entry.map->pgoff;
-        if (dso->Path() == record_filename_) {
-          auto it = debug_unwind_dsos_.find(entry.map->pgoff);
-          CHECK(it != debug_unwind_dsos_.end());
-          const auto& p = it->second;
-          dso = p.first;
-          pgoff = p.second;
-          if (!JITDebugReader::IsPathInJITSymFile(dso->Path())) {
-            entry.vaddr_in_file = dso->IpToVaddrInFile(entry.ip, entry.map->start_addr, pgoff);
-          }
-          entry.symbol = dso->FindSymbol(entry.vaddr_in_file);
+      fprintf(out_fp_, "sample_time: %" PRIu64 "\n", sample_time);
+      DumpUnwindingResult(task.unwinding_result, out_fp_);
+    }
+    Dso* dso = nullptr;
+    uint64_t pgoff = 0;
+    for (size_t i = 0; i < entries.size(); i++) {
+      size_t id = i + 1;
+      auto& entry = entries[i];
+      dso = entry.map->dso;
+      pgoff = entry.map->pgoff;
+      if (dso->Path() == record_filename_) {
+        auto it = debug_unwind_dsos_.find(entry.map->pgoff);
+        CHECK(it != debug_unwind_dsos_.end());
+        const auto& p = it->second;
+        dso = p.first;
+        pgoff = p.second;
+        if (!JITDebugReader::IsPathInJITSymFile(dso->Path())) {
+          entry.vaddr_in_file = dso->IpToVaddrInFile(entry.ip, entry.map->start_addr, pgoff);
         }
-        fprintf(out_fp_, "map_%zu: [0x%" PRIx64 "-0x%" PRIx64 "], pgoff 0x%" PRIx64 "\n", id,
-                entry.map->start_addr, entry.map->get_end_addr(), pgoff);
-        fprintf(out_fp_, "dso_%zu: %s\n", id, dso->Path().c_str());
-        fprintf(out_fp_, "vaddr_in_file_%zu: 0x%" PRIx64 "\n", id, entry.vaddr_in_file);
-        fprintf(out_fp_, "symbol_%zu: %s\n", id, entry.symbol->DemangledName());
+        entry.symbol = dso->FindSymbol(entry.vaddr_in_file);
       }
+      if (skip_sample_print_) {
+        continue;
+      }
+      fprintf(out_fp_, "ip_%zu: 0x%" PRIx64 "\n", id, entry.ip);
+      fprintf(out_fp_, "sp_%zu: 0x%" PRIx64 "\n", id, task.sps[i]);
+      fprintf(out_fp_, "map_%zu: [0x%" PRIx64 "-0x%" PRIx64 "], pgoff 0x%" PRIx64 "\n", id,
+              entry.map->start_addr, entry.map->get_end_addr(), pgoff);
+      fprintf(out_fp_, "dso_%zu: %s\n", id, dso->Path().c_str());
+      fprintf(out_fp_, "vaddr_in_file_%zu: 0x%" PRIx64 "\n", id, entry.vaddr_in_file);
+      fprintf(out_fp_, "symbol_%zu: %s\n", id, entry.symbol->DemangledName());
+    }
+    if (!skip_sample_print_) {
       fprintf(out_fp_, "\n");
     }
-    return true;
+    if (failed && failure_summary_ != nullptr) {
+      const CallChainReportEntry* last = entries.empty() ? nullptr : &entries.back();
+      AddUnwindingFailure(*failure_summary_, task.unwinding_result, sample_time, dso,
+                          last != nullptr ? last->symbol : nullptr,
+                          last != nullptr ? last->map : nullptr, pgoff);
+    }
   }
 
- private:
   const std::unordered_set<uint64_t> sample_times_;
   bool skip_sample_print_;
+  const size_t jobs_;
+  // unwinders_[i] is used by the i-th thread.
+  std::vector<OfflineUnwinder*> unwinders_;
+  std::vector<std::unique_ptr<OfflineUnwinder>> owned_unwinders_;
+  std::vector<UnwindingTask> tasks_;
+  std::unordered_map<int, MapSetSnapshot> map_snapshots_;
   // Map from offset in recording file to the corresponding debug_unwind_file.
   std::unordered_map<uint64_t, std::pair<Dso*, uint64_t>> debug_unwind_dsos_;
   UnwindingStat stat_;
@@ -503,8 +741,8 @@ class TestFileGenerator : public RecordFileProcessor {
 
 class ReportGenerator : public RecordFileProcessor {
  public:
-  ReportGenerator(const std::string& output_filename)
-      : RecordFileProcessor(output_filename, false) {}
+  ReportGenerator(const std::string& output_filename, bool skip_sample_print)
+      : RecordFileProcessor(output_filename, false), skip_sample_print_(skip_sample_print) {}
 
  protected:
   bool CheckRecordCmd(const std::string& record_cmd) override {
@@ -546,11 +784,22 @@ class ReportGenerator : public RecordFileProcessor {
     if (kernel_ip_count != 0) {
       ips.erase(ips.begin(), ips.begin() + kernel_ip_count);
     }
+    std::vector<CallChainReportEntry> entries = callchain_report_builder_.Build(thread, ips, 0);
+    if (failure_summary_ != nullptr && unwinding_r.unwinding_result.error_code != ERROR_NONE) {
+      const CallChainReportEntry* last = entries.empty() ? nullptr : &entries.back();
+      AddUnwindingFailure(*failure_summary_, unwinding_r.unwinding_result, sr.Timestamp(),
+                          last != nullptr ? last->map->dso : nullptr,
+                          last != nullptr ? last->symbol : nullptr,
+                          last != nullptr ? last->map : nullptr,
+                          last != nullptr ? last->map->pgoff : 0);
+    }
+    if (skip_sample_print_) {
+      return;
+    }
 
     fprintf(out_fp_, "sample_time: %" PRIu64 "\n", sr.Timestamp());
     DumpUnwindingResult(unwinding_r.unwinding_result, out_fp_);
     // Print callchain.
-    std::vector<CallChainReportEntry> entries = callchain_report_builder_.Build(thread, ips, 0);
     for (size_t i = 0; i < entries.size(); i++) {
       size_t id = i + 1;
       const auto& entry = entries[i];
@@ -599,6 +848,7 @@ class ReportGenerator : public RecordFileProcessor {
     }
   }
 
+  bool skip_sample_print_;
   std::unique_ptr<UnwindingResultRecord> last_unwinding_result_;
 };
 
@@ -609,15 +859,21 @@ class DebugUnwindCommand : public Command {
             "debug-unwind", "Debug/test offline unwinding.",
             // clang-format off
 "Usage: simpleperf debug-unwind [options]\n"
+"--failure-summary <file>  Write failed unwinding results, aggregated by error code and the\n"
+"                          dso, symbol and map of the last unwound frame, to <file>. Used with\n"
+"                          --unwind-sample or --generate-report.\n"
+"--failure-summary-format csv|json  Format of the failure summary. Default is csv.\n"
 "--generate-report         Generate a failed unwinding report.\n"
 "--generate-test-file      Generate a test file with only one sample.\n"
 "-i <file>                 Input recording file. Default is perf.data.\n"
+"-j <thread_count>         Unwind samples using <thread_count> threads with --unwind-sample.\n"
+"                          Default is 1.\n"
 "-o <file>                 Output file. Default is stdout.\n"
 "--keep-binaries-in-test-file  binary1,binary2...   Keep binaries in test file.\n"
 "--sample-time time1,time2...      Only process samples recorded at selected times.\n"
 "--symfs <dir>                     Look for files with symbols relative to this directory.\n"
 "--unwind-sample                   Unwind samples.\n"
-"--skip-sample-print               Skip printing unwound samples.\n"
+"--skip-sample-print               Skip printing unwound samples or failed unwinding results.\n"
 "\n"
 "Examples:\n"
 "1. Unwind a sample.\n"
@@ -630,6 +886,9 @@ class DebugUnwindCommand : public Command {
 "$ simpleperf debug-unwind -i perf.data --generate-report -o report.txt\n"
 "  perf.data should be generated with \"--keep-failed-unwinding-debug-info\" or \\\n"
 "  \"--keep-failed-unwinding-result\".\n"
+"4. Unwind samples in parallel and summarize unwinding failures.\n"
+"$ simpleperf debug-unwind -i perf.data --unwind-sample -j 8 --skip-sample-print \\\n"
+"     --failure-summary failures.csv\n"
 "\n"
             // clang-format on
         ) {}
@@ -647,6 +906,9 @@ class DebugUnwindCommand : public Command {
   bool generate_test_file_;
   std::unordered_set<std::string> kept_binaries_in_test_file_;
   std::unordered_set<uint64_t> sample_times_;
+  size_t jobs_ = 1;
+  std::string failure_summary_filename_;
+  UnwindingFailureSummary::Format failure_summary_format_ = UnwindingFailureSummary::Format::CSV;
 };
 
 bool DebugUnwindCommand::Run(const std::vector<std::string>& args) {
@@ -656,27 +918,41 @@ bool DebugUnwindCommand::Run(const std::vector<std::string>& args) {
   }
 
   // 2. Distribute sub commands.
-  if (unwind_sample_) {
-    SampleUnwinder sample_unwinder(output_filename_, sample_times_, skip_sample_print_);
-    return sample_unwinder.ProcessFile(input_filename_);
+  std::unique_ptr<UnwindingFailureSummary> failure_summary;
+  if (!failure_summary_filename_.empty()) {
+    failure_summary.reset(new UnwindingFailureSummary);
   }
-  if (generate_test_file_) {
+  if (unwind_sample_) {
+    SampleUnwinder sample_unwinder(output_filename_, sample_times_, skip_sample_print_, jobs_);
+    sample_unwinder.SetFailureSummary(failure_summary.get());
+    if (!sample_unwinder.ProcessFile(input_filename_)) {
+      return false;
+    }
+  } else if (generate_test_file_) {
     TestFileGenerator test_file_generator(output_filename_, sample_times_,
                                           kept_binaries_in_test_file_);
     return test_file_generator.ProcessFile(input_filename_);
+  } else if (generate_report_) {
+    ReportGenerator report_generator(output_filename_, skip_sample_print_);
+    report_generator.SetFailureSummary(failure_summary.get());
+    if (!report_generator.ProcessFile(input_filename_)) {
+      return false;
+    }
   }
-  if (generate_report_) {
-    ReportGenerator report_generator(output_filename_);
-    return report_generator.ProcessFile(input_filename_);
+  if (failure_summary) {
+    return failure_summary->Write(failure_summary_filename_, failure_summary_format_);
   }
   return true;
 }
 
 bool DebugUnwindCommand::ParseOptions(const std::vector<std::string>& args) {
   const OptionFormatMap option_formats = {
+      {"--failure-summary", {OptionValueType::STRING, OptionType::SINGLE}},
+      {"--failure-summary-format", {OptionValueType::STRING, OptionType::SINGLE}},
       {"--generate-report", {OptionValueType::NONE, OptionType::SINGLE}},
       {"--generate-test-file", {OptionValueType::NONE, OptionType::SINGLE}},
       {"-i", {OptionValueType::STRING, OptionType::SINGLE}},
+      {"-j", {OptionValueType::UINT, OptionType::SINGLE}},
       {"--keep-binaries-in-test-file", {OptionValueType::STRING, OptionType::MULTIPLE}},
       {"-o", {OptionValueType::STRING, OptionType::SINGLE}},
       {"--sample-time", {OptionValueType::STRING, OptionType::MULTIPLE}},
@@ -689,9 +965,23 @@ bool DebugUnwindCommand::ParseOptions(const std::vector<std::string>& args) {
   if (!PreprocessOptions(args, option_formats, &options, &ordered_options)) {
     return false;
   }
+  options.PullStringValue("--failure-summary", &failure_summary_filename_);
+  if (auto value = options.PullValue("--failure-summary-format"); value) {
+    if (*value->str_value == "csv") {
+      failure_summary_format_ = UnwindingFailureSummary::Format::CSV;
+    } else if (*value->str_value == "json") {
+      failure_summary_format_ = UnwindingFailureSummary::Format::JSON;
+    } else {
+      LOG(ERROR) << "unknown failure summary format: " << *value->str_value;
+      return false;
+    }
+  }
   generate_report_ = options.PullBoolValue("--generate-report");
   generate_test_file_ = options.PullBoolValue("--generate-test-file");
   options.PullStringValue("-i", &input_filename_);
+  if (!options.PullUintValue("-j", &jobs_, 1)) {
+    return false;
+  }
   for (auto& value : options.PullValues("--keep-binaries-in-test-file")) {
     std::vector<std::string> binaries = android::base::Split(*value.str_value, ",");
     kept_binaries_in_test_file_.insert(binaries.begin(), binaries.end());
@@ -723,6 +1013,10 @@ bool DebugUnwindCommand::ParseOptions(const std::vector<std::string>& args) {
       return false;
     }
   }
+  if (!failure_summary_filename_.empty() && !unwind_sample_ && !generate_report_) {
+    LOG(ERROR) << "--failure-summary is only used with --unwind-sample or --generate-report";
+    return false;
+  }
 
   return true;
 }
@@ -23,6 +23,7 @@
 #include <vector>
 
 #include <android-base/file.h>
+#include <android-base/strings.h>
 
 #include "command.h"
 #include "get_test_data.h"
@@ -128,6 +129,28 @@ TEST(cmd_debug_unwind, skip_sample_print_option) {
   ASSERT_NE(output.find("unwinding_sample_count: 8"), std::string::npos);
 }
 
+TEST(cmd_debug_unwind, j_option) {
+  // Unwinding in multiple threads should report the same callchains in the same order.
+  auto get_callchains = [](const std::vector<std::string>& extra_args) {
+    std::vector<std::string> args = {"-i", GetTestData(PERF_DATA_NO_UNWIND), "--unwind-sample"};
+    args.insert(args.end(), extra_args.begin(), extra_args.end());
+    CaptureStdout capture;
+    EXPECT_TRUE(capture.Start());
+    EXPECT_TRUE(DebugUnwindCmd()->Run(args));
+    std::string callchains;
+    for (const std::string& line : android::base::Split(capture.Finish(), "\n")) {
+      if (android::base::StartsWith(line, "sample_time:") ||
+          android::base::StartsWith(line, "ip_") || android::base::StartsWith(line, "symbol_")) {
+        callchains += line + "\n";
+      }
+    }
+    return callchains;
+  };
+  std::string expected = get_callchains({});
+  ASSERT_NE(expected.find("sample_time: 1516379654300997"), std::string::npos);
+  ASSERT_EQ(get_callchains({"-j", "4"}), expected);
+}
+
 TEST(cmd_debug_unwind, generate_test_file) {
   TemporaryFile tmpfile;
   close(tmpfile.release());
@@ -169,6 +192,41 @@ TEST(cmd_debug_unwind, generate_report) {
   ASSERT_NE(output.find("symbol_2: android.os.Handler.enqueueMessage"), std::string::npos);
 }
 
+TEST(cmd_debug_unwind, failure_summary_option) {
+  std::string input_data = GetTestData("perf_with_failed_unwinding_debug_info.data");
+  TemporaryFile tmpfile;
+  close(tmpfile.release());
+  ASSERT_TRUE(DebugUnwindCmd()->Run({"-i", input_data, "--generate-report", "--skip-sample-print",
+                                     "-o", "/dev/null", "--failure-summary", tmpfile.path}));
+  std::string output;
+  ASSERT_TRUE(android::base::ReadFileToString(tmpfile.path, &output));
+  ASSERT_TRUE(android::base::StartsWith(
+      output, "error_code,error_name,dso,symbol,map,count,example_sample_times\n"))
+      << output;
+  ASSERT_NE(output.find("\n4,ERROR_INVALID_MAP,"), std::string::npos) << output;
+
+  ASSERT_TRUE(DebugUnwindCmd()->Run({"-i", input_data, "--generate-report",
+                                     "--skip-sample-print", "-o", "/dev/null",
+                                     "--failure-summary", tmpfile.path,
+                                     "--failure-summary-format", "json"}));
+  ASSERT_TRUE(android::base::ReadFileToString(tmpfile.path, &output));
+  ASSERT_TRUE(android::base::StartsWith(output, "[")) << output;
+  ASSERT_NE(output.find("\"error_name\": \"ERROR_INVALID_MAP\""), std::string::npos) << output;
+  ASSERT_NE(output.find("\"example_sample_times\": ["), std::string::npos) << output;
+
+  // Failures found when unwinding samples again can also be summarized.
+  ASSERT_TRUE(DebugUnwindCmd()->Run({"-i", input_data, "--unwind-sample", "-j", "2",
+                                     "--skip-sample-print", "-o", "/dev/null",
+                                     "--failure-summary", tmpfile.path}));
+  ASSERT_TRUE(android::base::ReadFileToString(tmpfile.path, &output));
+  ASSERT_TRUE(android::base::StartsWith(output, "error_code,")) << output;
+
+  // The summary is only generated from unwinding results.
+  ASSERT_FALSE(DebugUnwindCmd()->Run({"-i", input_data, "--failure-summary", tmpfile.path}));
+  ASSERT_FALSE(DebugUnwindCmd()->Run({"-i", input_data, "--generate-report", "--failure-summary",
+                                      tmpfile.path, "--failure-summary-format", "xml"}));
+}
+
 TEST(cmd_debug_unwind, unwind_sample_for_small_map_range) {
   CaptureStdout capture;
   ASSERT_TRUE(capture.Start());
@@ -27,6 +27,7 @@
 
 #include "ETMBranchListFile.h"
 #include "ETMDecoder.h"
+#include "RecordFilter.h"
 #include "RegEx.h"
 #include "command.h"
 #include "record_file.h"
@@ -91,13 +92,14 @@ using BranchListBinaryCallback = std::function<void(const BinaryKey&, BranchList
 
 class ETMThreadTreeWithFilter : public ETMThreadTree {
  public:
-  void ExcludePid(pid_t pid) { exclude_pid_ = pid; }
+  ETMThreadTreeWithFilter() : record_filter_(thread_tree_) {}
   ThreadTree& GetThreadTree() { return thread_tree_; }
+  RecordFilter& GetRecordFilter() { return record_filter_; }
   void DisableThreadExitRecords() override { thread_tree_.DisableThreadExitRecords(); }
 
   const ThreadEntry* FindThread(int tid) override {
     const ThreadEntry* thread = thread_tree_.FindThread(tid);
-    if (thread != nullptr && exclude_pid_ && thread->pid == exclude_pid_) {
+    if (thread != nullptr && !record_filter_.CheckThread(thread->pid, thread->tid)) {
       return nullptr;
     }
     return thread;
@@ -107,7 +109,7 @@ class ETMThreadTreeWithFilter : public ETMThreadTree {
 
  private:
   ThreadTree thread_tree_;
-  std::optional<pid_t> exclude_pid_;
+  RecordFilter record_filter_;
 };
 
 class BinaryFilter {
@@ -150,11 +152,12 @@ static uint64_t GetFirstLoadSegmentVaddr(Dso* dso) {
 class PerfDataReader {
  public:
   PerfDataReader(const std::string& filename, bool exclude_perf, ETMDumpOption etm_dump_option,
-                 const RegEx* binary_name_regex)
+                 const RegEx* binary_name_regex, const OptionValueMap& record_filter_options)
       : filename_(filename),
         exclude_perf_(exclude_perf),
         etm_dump_option_(etm_dump_option),
-        binary_filter_(binary_name_regex) {}
+        binary_filter_(binary_name_regex),
+        record_filter_options_(record_filter_options) {}
 
   void SetCallback(const AutoFDOBinaryCallback& callback) { autofdo_callback_ = callback; }
   void SetCallback(const BranchListBinaryCallback& callback) { branch_list_callback_ = callback; }
@@ -167,6 +170,10 @@ class PerfDataReader {
     if (record_file_reader_->HasFeature(PerfFileFormat::FEAT_ETM_BRANCH_LIST)) {
       return ProcessETMBranchListFeature();
     }
+    RecordFilter& record_filter = thread_tree_.GetRecordFilter();
+    if (!record_filter.ParseOptions(record_filter_options_)) {
+      return false;
+    }
     if (exclude_perf_) {
       const auto& info_map = record_file_reader_->GetMetaInfoFeature();
       if (auto it = info_map.find("recording_process"); it == info_map.end()) {
@@ -178,7 +185,7 @@ class PerfDataReader {
           LOG(ERROR) << "invalid recording_process " << it->second << " in " << filename_;
           return false;
         }
-        thread_tree_.ExcludePid(pid);
+        record_filter.AddPids({pid}, true);
       }
     }
     if (!record_file_reader_->LoadBuildIdAndFileFeatures(thread_tree_.GetThreadTree())) {
@@ -321,6 +328,7 @@ class PerfDataReader {
   bool exclude_perf_;
   ETMDumpOption etm_dump_option_;
   BinaryFilter binary_filter_;
+  OptionValueMap record_filter_options_;
   AutoFDOBinaryCallback autofdo_callback_;
   BranchListBinaryCallback branch_list_callback_;
 
@@ -569,6 +577,9 @@ class InjectCommand : public Command {
 "--exclude-perf               Exclude trace data for the recording process.\n"
 "--symdir <dir>               Look for binaries in a directory recursively.\n"
 "\n"
+"Sample filter options for perf.data input files:\n"
+RECORD_FILTER_OPTION_HELP_MSG_FOR_INJECTING
+"\n"
 "Examples:\n"
 "1. Generate autofdo text output.\n"
 "$ simpleperf inject -i perf.data -o autofdo.txt --output autofdo\n"
@@ -605,7 +616,7 @@ class InjectCommand : public Command {
 
  private:
   bool ParseOptions(const std::vector<std::string>& args) {
-    const OptionFormatMap option_formats = {
+    OptionFormatMap option_formats = {
         {"--binary", {OptionValueType::STRING, OptionType::SINGLE}},
         {"--dump-etm", {OptionValueType::STRING, OptionType::SINGLE}},
         {"--exclude-perf", {OptionValueType::NONE, OptionType::SINGLE}},
@@ -614,6 +625,10 @@ class InjectCommand : public Command {
         {"--output", {OptionValueType::STRING, OptionType::SINGLE}},
         {"--symdir", {OptionValueType::STRING, OptionType::MULTIPLE}},
     };
+    OptionFormatMap record_filter_options = GetRecordFilterOptionFormats(false);
+    // ETM data isn't split into samples with timestamps, so time filters are not supported.
+    record_filter_options.erase("--filter-file");
+    option_formats.insert(record_filter_options.begin(), record_filter_options.end());
     OptionValueMap options;
     std::vector<std::pair<OptionName, OptionValue>> ordered_options;
     if (!PreprocessOptions(args, option_formats, &options, &ordered_options, nullptr)) {
@@ -632,6 +647,12 @@ class InjectCommand : public Command {
       }
     }
     exclude_perf_ = options.PullBoolValue("--exclude-perf");
+    // Filter options are parsed by each PerfDataReader, which has its own thread tree.
+    for (const auto& [name, _] : record_filter_options) {
+      for (const OptionValue& value : options.PullValues(name)) {
+        record_filter_options_.values.emplace(name, value);
+      }
+    }
 
     for (const OptionValue& value : options.PullValues("-i")) {
       std::vector<std::string> files = android::base::Split(*value.str_value, ",");
@@ -691,7 +712,7 @@ class InjectCommand : public Command {
     };
     for (const auto& input_filename : input_filenames_) {
       PerfDataReader reader(input_filename, exclude_perf_, etm_dump_option_,
-                            binary_name_regex_.get());
+                            binary_name_regex_.get(), record_filter_options_);
       reader.SetCallback(callback);
       if (!reader.Read()) {
         return false;
@@ -707,7 +728,7 @@ class InjectCommand : public Command {
     };
     for (const auto& input_filename : input_filenames_) {
       PerfDataReader reader(input_filename, exclude_perf_, etm_dump_option_,
-                            binary_name_regex_.get());
+                            binary_name_regex_.get(), record_filter_options_);
       reader.SetCallback(callback);
       if (!reader.Read()) {
         return false;
@@ -769,6 +790,7 @@ class InjectCommand : public Command {
 
   std::unique_ptr<RegEx> binary_name_regex_;
   bool exclude_perf_ = false;
+  OptionValueMap record_filter_options_;
   std::vector<std::string> input_filenames_;
   std::string output_filename_ = "perf_inject.data";
   OutputFormat output_format_ = OutputFormat::AutoFDO;
@@ -90,6 +90,14 @@ TEST(cmd_inject, exclude_perf_option) {
   ASSERT_TRUE(RunInjectCmd({"--exclude-perf"}, nullptr));
 }
 
+TEST(cmd_inject, sample_filter_options) {
+  std::string data;
+  ASSERT_TRUE(RunInjectCmd({"--include-process-name", "etm_test_loop"}, &data));
+  ASSERT_NE(data.find("etm_test_loop"), std::string::npos);
+  ASSERT_TRUE(RunInjectCmd({"--exclude-process-name", "etm_test_loop"}, &data));
+  ASSERT_EQ(data.find("etm_test_loop"), std::string::npos);
+}
+
 TEST(cmd_inject, output_option) {
   TemporaryFile tmpfile;
   close(tmpfile.release());
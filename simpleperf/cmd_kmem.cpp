@@ -16,6 +16,7 @@
 
 #include "command.h"
 
+#include <algorithm>
 #include <unordered_map>
 
 #include <android-base/logging.h>
@@ -104,6 +105,292 @@ struct SlabFormat {
   TracingFieldPlace gfp_flags;
 };
 
+// An open addressing hash table from the start address of an allocated space to its live
+// allocation info. Entries are 24 bytes, and the table is resized with the number of live
+// allocations, so memory use doesn't grow with the number of alloc/free events.
+class LiveAllocTable {
+ public:
+  struct Entry {
+    uint64_t ptr;
+    uint32_t bytes_alloc;
+    uint32_t site_id;
+    // The report sample of the allocation and the cpu allocating it, to find cross cpu frees.
+    uint32_t sample_id;
+    uint32_t cpu;
+  };
+  static_assert(sizeof(Entry) == 24);
+
+  LiveAllocTable() { Rehash(kMinCapacity); }
+
+  // Insert an allocation. If ptr is already in the table (the free event was lost), return
+  // true and set the replaced allocation.
+  bool Insert(const Entry& entry, Entry* replaced) {
+    if (used_ + 1 > entries_.size() / 4 * 3) {
+      // Double the capacity only when live entries use over half of it. Otherwise, rehash to
+      // remove deleted entries.
+      Rehash(size_ + 1 > entries_.size() / 2 ? entries_.size() * 2 : entries_.size());
+    }
+    size_t mask = entries_.size() - 1;
+    size_t deleted_pos = SIZE_MAX;
+    for (size_t i = Hash(entry.ptr) & mask;; i = (i + 1) & mask) {
+      Entry& e = entries_[i];
+      if (e.ptr == entry.ptr) {
+        *replaced = e;
+        e = entry;
+        return true;
+      }
+      if (e.ptr == kDeleted) {
+        if (deleted_pos == SIZE_MAX) {
+          deleted_pos = i;
+        }
+      } else if (e.ptr == kEmpty) {
+        if (deleted_pos != SIZE_MAX) {
+          entries_[deleted_pos] = entry;
+        } else {
+          e = entry;
+          used_++;
+        }
+        size_++;
+        return false;
+      }
+    }
+  }
+
+  // Remove an allocation. Return false if ptr isn't in the table.
+  bool Remove(uint64_t ptr, Entry* removed) {
+    size_t mask = entries_.size() - 1;
+    for (size_t i = Hash(ptr) & mask;; i = (i + 1) & mask) {
+      Entry& e = entries_[i];
+      if (e.ptr == ptr) {
+        *removed = e;
+        e.ptr = kDeleted;
+        size_--;
+        if (entries_.size() > kMinCapacity && size_ < entries_.size() / 8) {
+          Rehash(entries_.size() / 2);
+        }
+        return true;
+      }
+      if (e.ptr == kEmpty) {
+        return false;
+      }
+    }
+  }
+
+  size_t size() const { return size_; }
+  size_t capacity() const { return entries_.size(); }
+
+  // Kernel addresses are never 0 or 1, so use them to mark empty and deleted entries.
+  static bool IsValidPtr(uint64_t ptr) { return ptr > kDeleted; }
+
+ private:
+  static constexpr uint64_t kEmpty = 0;
+  static constexpr uint64_t kDeleted = 1;
+  static constexpr size_t kMinCapacity = 1024;
+
+  static size_t Hash(uint64_t ptr) {
+    // Allocated addresses are aligned, so mix all bits before taking low bits.
+    ptr ^= ptr >> 33;
+    ptr *= 0xff51afd7ed558ccdULL;
+    ptr ^= ptr >> 33;
+    return static_cast<size_t>(ptr);
+  }
+
+  void Rehash(size_t capacity) {
+    std::vector<Entry> old_entries(capacity, Entry{kEmpty, 0, 0, 0, 0});
+    old_entries.swap(entries_);
+    size_t mask = entries_.size() - 1;
+    for (const Entry& e : old_entries) {
+      if (IsValidPtr(e.ptr)) {
+        size_t i = Hash(e.ptr) & mask;
+        while (entries_[i].ptr != kEmpty) {
+          i = (i + 1) & mask;
+        }
+        entries_[i] = e;
+      }
+    }
+    used_ = size_;
+  }
+
+  std::vector<Entry> entries_;
+  size_t size_ = 0;  // count of live entries
+  size_t used_ = 0;  // count of live and deleted entries
+};
+
+// Where live allocations are attributed: the function making allocation, the slab size
+// (bytes_alloc) and the kernel callchain of the allocation.
+struct LiveAllocSite {
+  const Symbol* symbol;
+  uint64_t slab_size;
+  std::vector<uint64_t> callchain;
+  uint64_t live_bytes = 0;
+  uint64_t live_count = 0;
+  uint64_t peak_live_bytes = 0;
+  bool changed = false;  // whether changed since the last snapshot
+
+  LiveAllocSite(const Symbol* symbol, uint64_t slab_size, std::vector<uint64_t>&& callchain)
+      : symbol(symbol), slab_size(slab_size), callchain(std::move(callchain)) {}
+};
+
+// Track allocations not freed yet by matching alloc/free events on ptr, and periodically write
+// live bytes per allocation site to a timeline file.
+class LiveAllocTracker {
+ public:
+  LiveAllocTracker(ThreadTree* thread_tree, uint64_t snapshot_interval_in_ns, FILE* timeline_fp)
+      : thread_tree_(thread_tree),
+        snapshot_interval_in_ns_(snapshot_interval_in_ns),
+        timeline_fp_(timeline_fp) {
+    if (timeline_fp_ != nullptr) {
+      fprintf(timeline_fp_, "time_s,site_id,caller,slab_size,live_bytes,live_count\n");
+    }
+  }
+
+  void Alloc(const SampleRecord& r, uint64_t call_site, uint64_t ptr, uint64_t bytes_alloc,
+             uint32_t sample_id) {
+    UpdateTime(r.Timestamp());
+    if (!LiveAllocTable::IsValidPtr(ptr)) {
+      return;
+    }
+    uint32_t site_id = GetSiteId(r, call_site, bytes_alloc);
+    uint32_t size = static_cast<uint32_t>(std::min<uint64_t>(bytes_alloc, UINT32_MAX));
+    LiveAllocTable::Entry entry{ptr, size, site_id, sample_id, r.cpu_data.cpu};
+    LiveAllocTable::Entry replaced;
+    if (table_.Insert(entry, &replaced)) {
+      RemoveFromSite(replaced);
+    }
+    LiveAllocSite& site = sites_[site_id];
+    site.live_bytes += entry.bytes_alloc;
+    site.live_count++;
+    site.peak_live_bytes = std::max(site.peak_live_bytes, site.live_bytes);
+    site.changed = true;
+    total_live_bytes_ += entry.bytes_alloc;
+    peak_live_bytes_ = std::max(peak_live_bytes_, total_live_bytes_);
+  }
+
+  // Return true and set the removed allocation if ptr was live.
+  bool Free(const SampleRecord& r, uint64_t ptr, LiveAllocTable::Entry* removed) {
+    UpdateTime(r.Timestamp());
+    if (LiveAllocTable::IsValidPtr(ptr) && table_.Remove(ptr, removed)) {
+      RemoveFromSite(*removed);
+      return true;
+    }
+    return false;
+  }
+
+  void Finish() {
+    if (last_timestamp_ != 0) {
+      WriteSnapshot(last_timestamp_);
+    }
+  }
+
+  void PrintReport(FILE* fp, bool print_callchain) {
+    fprintf(fp, "Live allocation information:\n");
+    fprintf(fp, "Total live bytes: %" PRIu64 "\n", total_live_bytes_);
+    fprintf(fp, "Total live allocations: %zu\n", table_.size());
+    fprintf(fp, "Peak live bytes: %" PRIu64 "\n", peak_live_bytes_);
+    fprintf(fp, "\n");
+
+    std::vector<const LiveAllocSite*> sites;
+    for (const auto& site : sites_) {
+      if (site.live_count != 0) {
+        sites.push_back(&site);
+      }
+    }
+    std::sort(sites.begin(), sites.end(), [](const LiveAllocSite* s1, const LiveAllocSite* s2) {
+      return s1->live_bytes > s2->live_bytes;
+    });
+    fprintf(fp, "%12s  %10s  %13s  %9s  %s\n", "LiveBytes", "LiveCount", "PeakLiveBytes",
+            "SlabSize", "Caller");
+    for (const LiveAllocSite* site : sites) {
+      fprintf(fp, "%12" PRIu64 "  %10" PRIu64 "  %13" PRIu64 "  %9" PRIu64 "  %s\n",
+              site->live_bytes, site->live_count, site->peak_live_bytes, site->slab_size,
+              site->symbol->DemangledName());
+      if (print_callchain) {
+        for (uint64_t ip : site->callchain) {
+          fprintf(fp, "%*s<- %s\n", 56, "", thread_tree_->FindKernelSymbol(ip)->DemangledName());
+        }
+      }
+    }
+  }
+
+ private:
+  uint32_t GetSiteId(const SampleRecord& r, uint64_t call_site, uint64_t slab_size) {
+    const Symbol* symbol = thread_tree_->FindKernelSymbol(call_site);
+    std::vector<uint64_t> callchain;
+    if (r.sample_type & PERF_SAMPLE_CALLCHAIN) {
+      for (uint64_t i = 0; i < r.callchain_data.ip_nr; ++i) {
+        uint64_t ip = r.callchain_data.ips[i];
+        if (ip == PERF_CONTEXT_USER) {
+          break;
+        }
+        if (ip < PERF_CONTEXT_MAX) {
+          callchain.push_back(ip);
+        }
+      }
+    }
+    std::string key(reinterpret_cast<const char*>(&symbol), sizeof(symbol));
+    key.append(reinterpret_cast<const char*>(&slab_size), sizeof(slab_size));
+    key.append(reinterpret_cast<const char*>(callchain.data()),
+               callchain.size() * sizeof(uint64_t));
+    auto it = site_id_map_.find(key);
+    if (it != site_id_map_.end()) {
+      return it->second;
+    }
+    uint32_t site_id = static_cast<uint32_t>(sites_.size());
+    sites_.emplace_back(symbol, slab_size, std::move(callchain));
+    site_id_map_.emplace(std::move(key), site_id);
+    return site_id;
+  }
+
+  void RemoveFromSite(const LiveAllocTable::Entry& entry) {
+    LiveAllocSite& site = sites_[entry.site_id];
+    site.live_bytes -= entry.bytes_alloc;
+    site.live_count--;
+    site.changed = true;
+    total_live_bytes_ -= entry.bytes_alloc;
+  }
+
+  void UpdateTime(uint64_t timestamp) {
+    if (next_snapshot_timestamp_ == 0) {
+      next_snapshot_timestamp_ = timestamp + snapshot_interval_in_ns_;
+    } else if (timestamp >= next_snapshot_timestamp_) {
+      WriteSnapshot(next_snapshot_timestamp_);
+      while (next_snapshot_timestamp_ <= timestamp) {
+        next_snapshot_timestamp_ += snapshot_interval_in_ns_;
+      }
+    }
+    last_timestamp_ = timestamp;
+  }
+
+  // Write sites changed since the last snapshot, and the total as site -1.
+  void WriteSnapshot(uint64_t timestamp) {
+    if (timeline_fp_ == nullptr) {
+      return;
+    }
+    double time_in_sec = timestamp / 1e9;
+    for (size_t i = 0; i < sites_.size(); ++i) {
+      LiveAllocSite& site = sites_[i];
+      if (site.changed) {
+        fprintf(timeline_fp_, "%.6f,%zu,%s,%" PRIu64 ",%" PRIu64 ",%" PRIu64 "\n", time_in_sec, i,
+                site.symbol->DemangledName(), site.slab_size, site.live_bytes, site.live_count);
+        site.changed = false;
+      }
+    }
+    fprintf(timeline_fp_, "%.6f,-1,[total],0,%" PRIu64 ",%zu\n", time_in_sec, total_live_bytes_,
+            table_.size());
+  }
+
+  ThreadTree* thread_tree_;
+  const uint64_t snapshot_interval_in_ns_;
+  FILE* timeline_fp_;
+  LiveAllocTable table_;
+  std::vector<LiveAllocSite> sites_;
+  std::unordered_map<std::string, uint32_t> site_id_map_;
+  uint64_t total_live_bytes_ = 0;
+  uint64_t peak_live_bytes_ = 0;
+  uint64_t next_snapshot_timestamp_ = 0;
+  uint64_t last_timestamp_ = 0;
+};
+
 class SlabSampleTreeBuilder : public SampleTreeBuilder<SlabSample, SlabAccumulateInfo> {
  public:
   SlabSampleTreeBuilder(const SampleComparator<SlabSample>& sample_comparator,
@@ -134,6 +421,8 @@ class SlabSampleTreeBuilder : public SampleTreeBuilder<SlabSample, SlabAccumulat
     formats_.push_back(std::move(p));
   }
 
+  void SetLiveAllocTracker(LiveAllocTracker* tracker) { live_alloc_tracker_ = tracker; }
+
  protected:
   SlabSample* CreateSample(const SampleRecord& r, bool in_kernel,
                            SlabAccumulateInfo* acc_info) override {
@@ -176,26 +465,56 @@ class SlabSampleTreeBuilder : public SampleTreeBuilder<SlabSample, SlabAccumulat
       uint64_t gfp_flags = format->gfp_flags.ReadFromData(raw_data);
       SlabSample* sample = InsertSample(std::unique_ptr<SlabSample>(
           new SlabSample(symbol, ptr, bytes_req, bytes_alloc, 1, gfp_flags, 0)));
-      alloc_cpu_record_map_.insert(std::make_pair(ptr, std::make_pair(r.cpu_data.cpu, sample)));
+      if (live_alloc_tracker_ != nullptr) {
+        // The live allocation table keeps the cpu of the allocation too.
+        live_alloc_tracker_->Alloc(r, call_site, ptr, bytes_alloc, GetSampleId(sample));
+      } else if (LiveAllocTable::IsValidPtr(ptr)) {
+        // Like the live allocation table, skip failed allocations and replace an allocation
+        // whose free event was lost.
+        alloc_cpu_record_map_[ptr] = std::make_pair(r.cpu_data.cpu, sample);
+      }
       acc_info->bytes_req = bytes_req;
       acc_info->bytes_alloc = bytes_alloc;
       return sample;
     } else if (format->type == SlabFormat::KMEM_FREE) {
       uint64_t ptr = format->ptr.ReadFromData(raw_data);
-      auto it = alloc_cpu_record_map_.find(ptr);
-      if (it != alloc_cpu_record_map_.end()) {
-        SlabSample* sample = it->second.second;
-        if (r.cpu_data.cpu != it->second.first) {
-          sample->cross_cpu_allocations++;
-          nr_cross_cpu_allocations_++;
+      if (live_alloc_tracker_ != nullptr) {
+        LiveAllocTable::Entry removed;
+        if (live_alloc_tracker_->Free(r, ptr, &removed)) {
+          CheckCrossCpuFree(r, removed.cpu, samples_by_id_[removed.sample_id]);
+        }
+      } else {
+        auto it = alloc_cpu_record_map_.find(ptr);
+        if (it != alloc_cpu_record_map_.end()) {
+          CheckCrossCpuFree(r, it->second.first, it->second.second);
+          alloc_cpu_record_map_.erase(it);
         }
-        alloc_cpu_record_map_.erase(it);
       }
       nr_frees_++;
     }
     return nullptr;
   }
 
+  void CheckCrossCpuFree(const SampleRecord& r, uint32_t alloc_cpu, SlabSample* sample) {
+    if (r.cpu_data.cpu != alloc_cpu) {
+      sample->cross_cpu_allocations++;
+      nr_cross_cpu_allocations_++;
+    }
+  }
+
+  // Samples are merged, so there are far fewer samples than live allocations. Refer to them by
+  // 32-bit ids in the live allocation table.
+  uint32_t GetSampleId(SlabSample* sample) {
+    auto it = sample_id_map_.find(sample);
+    if (it != sample_id_map_.end()) {
+      return it->second;
+    }
+    uint32_t id = static_cast<uint32_t>(samples_by_id_.size());
+    samples_by_id_.push_back(sample);
+    sample_id_map_.emplace(sample, id);
+    return id;
+  }
+
   SlabSample* CreateBranchSample(const SampleRecord&, const BranchStackItemType&) override {
     return nullptr;
   }
@@ -243,7 +562,11 @@ class SlabSampleTreeBuilder : public SampleTreeBuilder<SlabSample, SlabAccumulat
 
   std::unordered_map<uint64_t, SlabFormat*> event_id_to_format_map_;
   std::vector<std::unique_ptr<SlabFormat>> formats_;
+  // Without a live allocation tracker, the cpu and sample of each live allocation.
   std::unordered_map<uint64_t, std::pair<uint32_t, SlabSample*>> alloc_cpu_record_map_;
+  LiveAllocTracker* live_alloc_tracker_ = nullptr;
+  std::unordered_map<const SlabSample*, uint32_t> sample_id_map_;
+  std::vector<SlabSample*> samples_by_id_;
 };
 
 using SlabSampleTreeSorter = SampleTreeSorter<SlabSample>;
@@ -293,6 +616,16 @@ class KmemCommand : public Command {
 "                             the cpu allocating them.\n"
 "            The default slab sort keys are:\n"
 "              hit,caller,bytes_req,bytes_alloc,fragment,pingpong.\n"
+"--live      Report allocations not freed at the end of recording, by matching\n"
+"            alloc/free events on ptr. Live bytes are attributed to allocation\n"
+"            sites (caller, slab size and callchain).\n"
+"--live-snapshot-interval time_in_ms\n"
+"            Snapshot live bytes per allocation site every time_in_ms. Default\n"
+"            is 1000. Should be used with --live-timeline.\n"
+"--live-timeline file_name\n"
+"            Write live allocation snapshots to file_name in csv format. Each\n"
+"            snapshot has the sites changed since the last snapshot, and the\n"
+"            total as site -1.\n"
                 // clang-format on
                 ),
         is_record_(false),
@@ -325,6 +658,9 @@ class KmemCommand : public Command {
   bool accumulate_callchain_;
   bool print_callgraph_;
   bool callgraph_show_callee_;
+  bool report_live_ = false;
+  uint64_t live_snapshot_interval_in_ms_ = 1000;
+  std::string live_timeline_filename_;
 
   std::string record_filename_;
   std::unique_ptr<RecordFileReader> record_file_reader_;
@@ -337,6 +673,8 @@ class KmemCommand : public Command {
   std::unique_ptr<SlabSampleTreeBuilder> slab_sample_tree_builder_;
   std::unique_ptr<SlabSampleTreeSorter> slab_sample_tree_sorter_;
   std::unique_ptr<SlabSampleTreeDisplayer> slab_sample_tree_displayer_;
+  std::unique_ptr<FILE, decltype(&fclose)> live_timeline_fp_{nullptr, fclose};
+  std::unique_ptr<LiveAllocTracker> live_alloc_tracker_;
 
   std::string report_filename_;
 };
@@ -416,6 +754,18 @@ bool KmemCommand::ParseOptions(const std::vector<std::string>& args,
           return false;
         }
         slab_sort_keys_ = android::base::Split(args[i], ",");
+      } else if (args[i] == "--live") {
+        report_live_ = true;
+      } else if (args[i] == "--live-snapshot-interval") {
+        if (!GetUintOption(args, &i, &live_snapshot_interval_in_ms_, 1)) {
+          return false;
+        }
+      } else if (args[i] == "--live-timeline") {
+        if (!NextArgumentOrError(args, &i)) {
+          return false;
+        }
+        live_timeline_filename_ = args[i];
+        report_live_ = true;
       } else {
         ReportUnknownOption(args, i);
         return false;
@@ -527,6 +877,18 @@ bool KmemCommand::PrepareToBuildSampleTree() {
       slab_sample_tree_sorter_.reset(new SlabSampleTreeSorter(sort_comparator));
       slab_sample_tree_displayer_.reset(new SlabSampleTreeDisplayer(displayer));
     }
+    if (report_live_) {
+      if (!live_timeline_filename_.empty()) {
+        live_timeline_fp_.reset(fopen(live_timeline_filename_.c_str(), "w"));
+        if (!live_timeline_fp_) {
+          PLOG(ERROR) << "failed to open " << live_timeline_filename_;
+          return false;
+        }
+      }
+      live_alloc_tracker_.reset(new LiveAllocTracker(
+          &thread_tree_, live_snapshot_interval_in_ms_ * 1000000, live_timeline_fp_.get()));
+      slab_sample_tree_builder_->SetLiveAllocTracker(live_alloc_tracker_.get());
+    }
   }
   return true;
 }
@@ -572,6 +934,9 @@ bool KmemCommand::ReadSampleTreeFromRecordFile() {
           [this](std::unique_ptr<Record> record) { return ProcessRecord(std::move(record)); })) {
     return false;
   }
+  if (live_alloc_tracker_) {
+    live_alloc_tracker_->Finish();
+  }
   if (use_slab_) {
     slab_sample_tree_ = slab_sample_tree_builder_->GetSampleTree();
     slab_sample_tree_sorter_->Sort(slab_sample_tree_.samples, print_callgraph_);
@@ -648,6 +1013,10 @@ bool KmemCommand::PrintReport() {
     slab_sample_tree_displayer_->DisplaySamples(report_fp, slab_sample_tree_.samples,
                                                 &slab_sample_tree_);
   }
+  if (live_alloc_tracker_) {
+    fprintf(report_fp, "\n\n");
+    live_alloc_tracker_->PrintReport(report_fp, print_callgraph_);
+  }
   return true;
 }
 
@@ -142,3 +142,34 @@ TEST(kmem_cmd, report_callgraph) {
   ASSERT_NE(result.content.find("__alloc_skb"), std::string::npos);
   ASSERT_NE(result.content.find("system_call_fastpath"), std::string::npos);
 }
+
+TEST(kmem_cmd, report_live) {
+  TemporaryFile timeline_file;
+  close(timeline_file.release());
+  ReportResult result;
+  KmemReportFile(PERF_DATA_WITH_KMEM_SLAB_CALLGRAPH_RECORD,
+                 {"--live", "--live-snapshot-interval", "1", "--live-timeline", timeline_file.path},
+                 &result);
+  ASSERT_TRUE(result.success);
+  ASSERT_NE(result.content.find("Live allocation information:"), std::string::npos);
+  ASSERT_NE(result.content.find("LiveBytes"), std::string::npos);
+  std::string timeline;
+  ASSERT_TRUE(android::base::ReadFileToString(timeline_file.path, &timeline));
+  ASSERT_TRUE(android::base::StartsWith(timeline, "time_s,site_id,caller,slab_size"));
+  ASSERT_NE(timeline.find(",-1,[total],0,"), std::string::npos);
+
+  // Cross cpu frees are found through the live allocation table, with the same result.
+  auto get_cross_cpu_line = [](const std::string& content) {
+    size_t pos = content.find("Total cross cpu allocation/free:");
+    if (pos == std::string::npos) {
+      return std::string();
+    }
+    return content.substr(pos, content.find('\n', pos) - pos);
+  };
+  ReportResult result_without_live;
+  KmemReportFile(PERF_DATA_WITH_KMEM_SLAB_CALLGRAPH_RECORD, {}, &result_without_live);
+  ASSERT_TRUE(result_without_live.success);
+  std::string cross_cpu_line = get_cross_cpu_line(result_without_live.content);
+  ASSERT_FALSE(cross_cpu_line.empty());
+  ASSERT_EQ(cross_cpu_line, get_cross_cpu_line(result.content));
+}
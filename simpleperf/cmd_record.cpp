@@ -115,6 +115,9 @@ static constexpr size_t kDefaultAuxBufferSize = 4 * kMegabyte;
 // So make default period to 100ms.
 static constexpr double kDefaultEtmDataFlushPeriodInSec = 0.1;
 
+// Flush the record file periodically, so `report --follow` can read records while recording.
+static constexpr double kRecordFileFlushPeriodInSec = 1;
+
 struct TimeStat {
   uint64_t prepare_recording_time = 0;
   uint64_t start_recording_time = 0;
@@ -656,9 +659,11 @@ bool RecordCommand::PrepareRecording(Workload* workload) {
   }
 
   // 5. Open perf event files and create mapped buffers.
+  uint64_t open_start_time = GetSystemClock();
   if (!event_selection_set_.OpenEventFiles(cpus_)) {
     return false;
   }
+  uint64_t mmap_start_time = GetSystemClock();
   size_t record_buffer_size = 0;
   if (user_buffer_size_.has_value()) {
     record_buffer_size = user_buffer_size_.value();
@@ -680,9 +685,16 @@ bool RecordCommand::PrepareRecording(Workload* workload) {
   }
 
   // 6. Create perf.data.
+  uint64_t create_file_start_time = GetSystemClock();
   if (!CreateAndInitRecordFile()) {
     return false;
   }
+  LOG(VERBOSE) << "Startup latency: prepare "
+               << (open_start_time - time_stat_.prepare_recording_time) / 1e6
+               << " ms, open event files " << (mmap_start_time - open_start_time) / 1e6
+               << " ms, mmap event files " << (create_file_start_time - mmap_start_time) / 1e6
+               << " ms, create record file " << (GetSystemClock() - create_file_start_time) / 1e6
+               << " ms";
 
   // 7. Add read/signal/periodic Events.
   if (need_to_check_targets && !event_selection_set_.StopWhenNoMoreTargets()) {
@@ -718,6 +730,10 @@ bool RecordCommand::PrepareRecording(Workload* workload) {
       return false;
     }
   }
+  if (!loop->AddPeriodicEvent(SecondToTimeval(kRecordFileFlushPeriodInSec),
+                              [this]() { return record_file_writer_->Flush(); })) {
+    return false;
+  }
   if (jit_debug_reader_) {
     auto callback = [this](const std::vector<JITDebugInfo>& debug_info, bool sync_kernel_records) {
       return ProcessJITDebugInfo(debug_info, sync_kernel_records);
@@ -16,8 +16,10 @@
 
 #include <inttypes.h>
 #include <algorithm>
+#include <chrono>
 #include <functional>
 #include <map>
+#include <optional>
 #include <set>
 #include <string>
 #include <unordered_map>
@@ -449,6 +451,11 @@ class ReportCommand : public Command {
 "                      The default sort keys are:\n"
 "                        comm,pid,tid,dso,symbol\n"
 "--symfs <dir>         Look for files with symbols relative to this directory.\n"
+"--time-slice <milliseconds>  Split samples into time slices of the given length, and report\n"
+"                             each time slice in one pass over the record file. With --csv,\n"
+"                             print one table with a TimeSlice column.\n"
+"--time-slice-top <n>  Set the number of entries for each event in each time slice. Default\n"
+"                      is 10.\n"
 "--vmlinux <file>      Parse kernel symbols from <file>.\n"
 "\n"
 "Sample filter options:\n"
@@ -460,6 +467,15 @@ class ReportCommand : public Command {
 "--symbols symbol1;symbol2;...    Report only for selected symbols.\n"
 "--tids tid1,tid2,...             Same as '--include-tid'.\n"
 RECORD_FILTER_OPTION_HELP_MSG_FOR_REPORTING
+"\n"
+"Follow options:\n"
+"--follow   Report a record file which is still being written by the record command. Records\n"
+"           are read as they are written, and a report of the top entries is printed\n"
+"           periodically. A full report is printed when the recording finishes.\n"
+"--follow-interval <milliseconds>  Set the interval for printing reports when following a\n"
+"                                  record file. Default is 1000.\n"
+"--follow-top <n>   Set the number of entries for each event in a periodic report. Default\n"
+"                   is 20.\n"
             // clang-format on
             ),
         record_filename_("perf.data"),
@@ -485,11 +501,18 @@ RECORD_FILTER_OPTION_HELP_MSG_FOR_REPORTING
   bool ReadEventAttrFromRecordFile();
   bool ReadFeaturesFromRecordFile();
   bool ReadSampleTreeFromRecordFile();
+  std::vector<std::unique_ptr<ReportCmdSampleTreeBuilder>> CreateSampleTreeBuilders();
+  ReportCmdSampleTreeBuilder* GetSampleTreeBuilder(size_t attr_id, uint64_t time);
+  uint64_t GetTimeSliceIndex(uint64_t time);
+  void BuildSampleTrees(const std::vector<std::unique_ptr<ReportCmdSampleTreeBuilder>>& builders);
+  bool PrintFollowReportIfNecessary();
   bool ProcessRecord(std::unique_ptr<Record> record);
   void ProcessSampleRecordInTraceOffCpuMode(std::unique_ptr<Record> record, size_t attr_id);
   bool ProcessTracingData(const std::vector<char>& data);
-  bool PrintReport();
+  bool PrintReport(size_t max_entries = SIZE_MAX);
   void PrintReportContext(FILE* fp);
+  void PrintSampleTrees(FILE* fp, size_t max_entries);
+  void PrintTimeSlices(FILE* fp);
 
   std::string record_filename_;
   ArchType record_file_arch_;
@@ -522,6 +545,15 @@ RECORD_FILTER_OPTION_HELP_MSG_FOR_REPORTING
   std::vector<std::string> sort_keys_;
   std::string report_filename_;
   RecordFilter record_filter_;
+  bool follow_ = false;
+  std::chrono::milliseconds follow_interval_{1000};
+  size_t follow_top_ = 20;
+  std::chrono::steady_clock::time_point next_follow_report_time_;
+  // Used by --time-slice: builders for each time slice, each having a builder for each event.
+  uint64_t time_slice_ns_ = 0;
+  size_t time_slice_top_ = 10;
+  std::optional<uint64_t> time_slice_start_;
+  std::vector<std::vector<std::unique_ptr<ReportCmdSampleTreeBuilder>>> time_slice_builders_;
 };
 
 bool ReportCommand::Run(const std::vector<std::string>& args) {
@@ -531,7 +563,11 @@ bool ReportCommand::Run(const std::vector<std::string>& args) {
   }
 
   // 2. Read record file and build SampleTree.
-  record_file_reader_ = RecordFileReader::CreateInstance(record_filename_);
+  if (follow_) {
+    record_file_reader_ = RecordFileReader::CreateInstanceForFollowing(record_filename_);
+  } else {
+    record_file_reader_ = RecordFileReader::CreateInstance(record_filename_);
+  }
   if (record_file_reader_ == nullptr) {
     return false;
   }
@@ -570,6 +606,9 @@ bool ReportCommand::ParseOptions(const std::vector<std::string>& args) {
       {"--csv", {OptionValueType::NONE, OptionType::SINGLE}},
       {"--csv-separator", {OptionValueType::STRING, OptionType::SINGLE}},
       {"--dsos", {OptionValueType::STRING, OptionType::MULTIPLE}},
+      {"--follow", {OptionValueType::NONE, OptionType::SINGLE}},
+      {"--follow-interval", {OptionValueType::UINT, OptionType::SINGLE}},
+      {"--follow-top", {OptionValueType::UINT, OptionType::SINGLE}},
       {"--full-callgraph", {OptionValueType::NONE, OptionType::SINGLE}},
       {"-g", {OptionValueType::OPT_STRING, OptionType::SINGLE}},
       {"-i", {OptionValueType::STRING, OptionType::SINGLE}},
@@ -587,6 +626,8 @@ bool ReportCommand::ParseOptions(const std::vector<std::string>& args) {
       {"--sort", {OptionValueType::STRING, OptionType::SINGLE}},
       {"--symbols", {OptionValueType::STRING, OptionType::MULTIPLE}},
       {"--symfs", {OptionValueType::STRING, OptionType::SINGLE}},
+      {"--time-slice", {OptionValueType::UINT, OptionType::SINGLE}},
+      {"--time-slice-top", {OptionValueType::UINT, OptionType::SINGLE}},
       {"--vmlinux", {OptionValueType::STRING, OptionType::SINGLE}},
   };
   OptionFormatMap record_filter_options = GetRecordFilterOptionFormats(false);
@@ -621,6 +662,13 @@ bool ReportCommand::ParseOptions(const std::vector<std::string>& args) {
     std::vector<std::string> strs = Split(*value.str_value, ",");
     sample_tree_builder_options_.dso_filter.insert(strs.begin(), strs.end());
   }
+  follow_ = options.PullBoolValue("--follow");
+  uint64_t follow_interval_ms = follow_interval_.count();
+  if (!options.PullUintValue("--follow-interval", &follow_interval_ms, 1) ||
+      !options.PullUintValue("--follow-top", &follow_top_, 1)) {
+    return false;
+  }
+  follow_interval_ = std::chrono::milliseconds(follow_interval_ms);
   brief_callgraph_ = !options.PullBoolValue("--full-callgraph");
 
   if (auto value = options.PullValue("-g"); value) {
@@ -694,6 +742,16 @@ bool ReportCommand::ParseOptions(const std::vector<std::string>& args) {
       return false;
     }
   }
+  uint64_t time_slice_ms = 0;
+  if (!options.PullUintValue("--time-slice", &time_slice_ms, 1) ||
+      !options.PullUintValue("--time-slice-top", &time_slice_top_, 1)) {
+    return false;
+  }
+  time_slice_ns_ = time_slice_ms * 1000000;
+  if (time_slice_ns_ != 0 && follow_) {
+    LOG(ERROR) << "--time-slice can't be used with --follow";
+    return false;
+  }
   if (auto value = options.PullValue("--vmlinux"); value) {
     Dso::SetVmlinux(*value->str_value);
   }
@@ -703,6 +761,12 @@ bool ReportCommand::ParseOptions(const std::vector<std::string>& args) {
 
 bool ReportCommand::BuildSampleComparatorAndDisplayer() {
   SampleDisplayer<SampleEntry, SampleTree> displayer;
+  if (report_csv_ && time_slice_ns_ != 0) {
+    // All samples in a sample tree are in the same time slice.
+    displayer.AddDisplayFunction("TimeSlice(ms)", [this](const SampleEntry* sample) {
+      return std::to_string(GetTimeSliceIndex(sample->time) * (time_slice_ns_ / 1000000));
+    });
+  }
   displayer.SetReportFormat(report_csv_, csv_separator_);
   SampleComparator<SampleEntry> comparator;
 
@@ -880,6 +944,18 @@ bool ReportCommand::ReadEventAttrFromRecordFile() {
       return false;
     }
   }
+  if (time_slice_ns_ != 0) {
+    if (trace_offcpu_) {
+      LOG(ERROR) << "--time-slice isn't supported for recordings with --trace-offcpu";
+      return false;
+    }
+    for (const auto& attr : event_attrs_) {
+      if ((attr.sample_type & PERF_SAMPLE_TIME) == 0) {
+        LOG(ERROR) << record_filename_ << " doesn't have timestamps in samples for --time-slice";
+        return false;
+      }
+    }
+  }
   if (trace_offcpu_) {
     size_t i;
     for (i = 0; i < event_attrs_.size(); ++i) {
@@ -930,28 +1006,86 @@ bool ReportCommand::ReadSampleTreeFromRecordFile() {
   sample_tree_builder_options_.use_caller_as_callchain_root = !callgraph_show_callee_;
   sample_tree_builder_options_.trace_offcpu = trace_offcpu_;
 
+  if (time_slice_ns_ == 0) {
+    sample_tree_builder_ = CreateSampleTreeBuilders();
+  }
+  if (follow_) {
+    next_follow_report_time_ = std::chrono::steady_clock::now() + follow_interval_;
+    record_file_reader_->SetFollowWaitCallback([this]() { return PrintFollowReportIfNecessary(); });
+  }
+  if (!record_file_reader_->ReadDataSection(
+          [this](std::unique_ptr<Record> record) { return ProcessRecord(std::move(record)); })) {
+    return false;
+  }
+  if (time_slice_ns_ == 0) {
+    BuildSampleTrees(sample_tree_builder_);
+  }
+  return true;
+}
+
+std::vector<std::unique_ptr<ReportCmdSampleTreeBuilder>>
+ReportCommand::CreateSampleTreeBuilders() {
+  std::vector<std::unique_ptr<ReportCmdSampleTreeBuilder>> builders;
   for (size_t i = 0; i < event_attrs_.size(); ++i) {
-    sample_tree_builder_.push_back(
-        sample_tree_builder_options_.CreateSampleTreeBuilder(*record_file_reader_));
-    sample_tree_builder_.back()->SetEventName(attr_names_[i]);
-    OfflineUnwinder* unwinder = sample_tree_builder_.back()->GetUnwinder();
+    builders.push_back(sample_tree_builder_options_.CreateSampleTreeBuilder(*record_file_reader_));
+    builders.back()->SetEventName(attr_names_[i]);
+    OfflineUnwinder* unwinder = builders.back()->GetUnwinder();
     if (unwinder != nullptr) {
       unwinder->LoadMetaInfo(record_file_reader_->GetMetaInfoFeature());
     }
   }
+  return builders;
+}
 
-  if (!record_file_reader_->ReadDataSection(
-          [this](std::unique_ptr<Record> record) { return ProcessRecord(std::move(record)); })) {
-    return false;
+// With --time-slice, each time slice has its own builders. They share thread_tree_, so binaries
+// are loaded and symbolized only once for all time slices.
+ReportCmdSampleTreeBuilder* ReportCommand::GetSampleTreeBuilder(size_t attr_id, uint64_t time) {
+  if (time_slice_ns_ == 0) {
+    return sample_tree_builder_[attr_id].get();
   }
-  for (size_t i = 0; i < sample_tree_builder_.size(); ++i) {
-    sample_tree_.push_back(sample_tree_builder_[i]->GetSampleTree());
+  if (!time_slice_start_) {
+    time_slice_start_ = time;
+  }
+  uint64_t index = GetTimeSliceIndex(time);
+  if (index >= time_slice_builders_.size()) {
+    time_slice_builders_.resize(index + 1);
+  }
+  auto& builders = time_slice_builders_[index];
+  if (builders.empty()) {
+    builders = CreateSampleTreeBuilders();
+  }
+  return builders[attr_id].get();
+}
+
+// Time slices start from the first sample. Samples out of order before it go to the first slice.
+uint64_t ReportCommand::GetTimeSliceIndex(uint64_t time) {
+  return time > *time_slice_start_ ? (time - *time_slice_start_) / time_slice_ns_ : 0;
+}
+
+void ReportCommand::BuildSampleTrees(
+    const std::vector<std::unique_ptr<ReportCmdSampleTreeBuilder>>& builders) {
+  // Samples are owned by the builders. So the trees can be rebuilt when following a record file.
+  sample_tree_.clear();
+  for (size_t i = 0; i < builders.size(); ++i) {
+    sample_tree_.push_back(builders[i]->GetSampleTree());
     sample_tree_sorter_->Sort(sample_tree_.back().samples, print_callgraph_);
   }
-  return true;
+}
+
+bool ReportCommand::PrintFollowReportIfNecessary() {
+  auto now = std::chrono::steady_clock::now();
+  if (now < next_follow_report_time_) {
+    return true;
+  }
+  next_follow_report_time_ = now + follow_interval_;
+  BuildSampleTrees(sample_tree_builder_);
+  return PrintReport(follow_top_);
 }
 
 bool ReportCommand::ProcessRecord(std::unique_ptr<Record> record) {
+  if (follow_ && !PrintFollowReportIfNecessary()) {
+    return false;
+  }
   thread_tree_.Update(*record);
   if (record->type() == PERF_RECORD_SAMPLE) {
     if (!record_filter_.Check(static_cast<SampleRecord*>(record.get()))) {
@@ -959,8 +1093,8 @@ bool ReportCommand::ProcessRecord(std::unique_ptr<Record> record) {
     }
     size_t attr_id = record_file_reader_->GetAttrIndexOfRecord(record.get());
     if (!trace_offcpu_) {
-      sample_tree_builder_[attr_id]->ReportCmdProcessSampleRecord(
-          *static_cast<SampleRecord*>(record.get()));
+      auto& r = *static_cast<SampleRecord*>(record.get());
+      GetSampleTreeBuilder(attr_id, r.time_data.time)->ReportCmdProcessSampleRecord(r);
     } else {
       ProcessSampleRecordInTraceOffCpuMode(std::move(record), attr_id);
     }
@@ -1005,7 +1139,7 @@ bool ReportCommand::ProcessTracingData(const std::vector<char>& data) {
   return true;
 }
 
-bool ReportCommand::PrintReport() {
+bool ReportCommand::PrintReport(size_t max_entries) {
   std::unique_ptr<FILE, decltype(&fclose)> file_handler(nullptr, fclose);
   FILE* report_fp = stdout;
   if (!report_filename_.empty()) {
@@ -1017,6 +1151,23 @@ bool ReportCommand::PrintReport() {
     file_handler.reset(report_fp);
   }
   PrintReportContext(report_fp);
+  if (time_slice_ns_ != 0) {
+    PrintTimeSlices(report_fp);
+  } else {
+    PrintSampleTrees(report_fp, max_entries);
+  }
+  if (max_entries != SIZE_MAX) {
+    fprintf(report_fp, "\n");
+  }
+  fflush(report_fp);
+  if (ferror(report_fp) != 0) {
+    PLOG(ERROR) << "print report failed";
+    return false;
+  }
+  return true;
+}
+
+void ReportCommand::PrintSampleTrees(FILE* report_fp, size_t max_entries) {
   for (size_t i = 0; i < event_attrs_.size(); ++i) {
     if (trace_offcpu_ && i == sched_switch_attr_id_) {
       continue;
@@ -1035,14 +1186,38 @@ bool ReportCommand::PrintReport() {
     }
     const char* period_prefix = trace_offcpu_ ? "Time in ns" : "Event count";
     fprintf(report_fp, "%s: %" PRIu64 "\n\n", period_prefix, sample_tree.total_period);
+    if (sample_tree.samples.size() > max_entries) {
+      sample_tree.samples.resize(max_entries);
+    }
     sample_tree_displayer_->DisplaySamples(report_fp, sample_tree.samples, &sample_tree);
   }
-  fflush(report_fp);
-  if (ferror(report_fp) != 0) {
-    PLOG(ERROR) << "print report failed";
-    return false;
+}
+
+void ReportCommand::PrintTimeSlices(FILE* report_fp) {
+  uint64_t time_slice_ms = time_slice_ns_ / 1000000;
+  bool print_names = true;
+  for (size_t i = 0; i < time_slice_builders_.size(); ++i) {
+    if (time_slice_builders_[i].empty()) {
+      continue;
+    }
+    BuildSampleTrees(time_slice_builders_[i]);
+    if (!report_csv_) {
+      fprintf(report_fp, "\nTime slice: %" PRIu64 " ms - %" PRIu64 " ms\n", i * time_slice_ms,
+              (i + 1) * time_slice_ms);
+      PrintSampleTrees(report_fp, time_slice_top_);
+      continue;
+    }
+    // Print all time slices and events in one table. Rows are told apart by the TimeSlice and
+    // EventName columns.
+    for (SampleTree& sample_tree : sample_tree_) {
+      if (sample_tree.samples.size() > time_slice_top_) {
+        sample_tree.samples.resize(time_slice_top_);
+      }
+      sample_tree_displayer_->DisplaySamples(report_fp, sample_tree.samples, &sample_tree,
+                                             print_names);
+      print_names = false;
+    }
   }
-  return true;
 }
 
 void ReportCommand::PrintReportContext(FILE* report_fp) {
@@ -131,6 +131,8 @@ class ReportSampleCommand : public Command {
 "--dump-protobuf-report  <file>\n"
 "           Dump report file generated by\n"
 "           `simpleperf report-sample --protobuf -o <file>`.\n"
+"--follow   Report a record file which is still being written by the record command. Samples\n"
+"           are printed as they are written, until the recording finishes.\n"
 "-i <file>  Specify path of record file, default is perf.data.\n"
 "-o report_file_name  Set report file name. Default report file name is\n"
 "                     report_sample.trace if --protobuf is used, otherwise\n"
@@ -160,7 +162,10 @@ RECORD_FILTER_OPTION_HELP_MSG_FOR_REPORTING
         remove_unknown_kernel_symbols_(false),
         kernel_symbols_available_(false),
         callchain_report_builder_(thread_tree_),
-        record_filter_(thread_tree_) {}
+        record_filter_(thread_tree_) {
+    // Samples are reported right after being read, so maps of exited processes can be reused.
+    thread_tree_.EnableMapReclamation();
+  }
 
   bool Run(const std::vector<std::string>& args) override;
 
@@ -200,6 +205,7 @@ RECORD_FILTER_OPTION_HELP_MSG_FOR_REPORTING
   bool remove_unknown_kernel_symbols_;
   bool kernel_symbols_available_;
   bool show_execution_type_ = false;
+  bool follow_ = false;
   CallChainReportBuilder callchain_report_builder_;
   // map from <pid, tid> to thread name
   std::map<uint64_t, const char*> thread_names_;
@@ -261,6 +267,10 @@ bool ReportSampleCommand::Run(const std::vector<std::string>& args) {
   if (!PrintMetaInfo()) {
     return false;
   }
+  if (follow_) {
+    // Make printed samples visible before waiting for more records.
+    record_file_reader_->SetFollowWaitCallback([this]() { return fflush(report_fp_) == 0; });
+  }
   if (!record_file_reader_->ReadDataSection(
           [this](std::unique_ptr<Record> record) { return ProcessRecord(std::move(record)); })) {
     return false;
@@ -296,6 +306,7 @@ bool ReportSampleCommand::Run(const std::vector<std::string>& args) {
 bool ReportSampleCommand::ParseOptions(const std::vector<std::string>& args) {
   OptionFormatMap option_formats = {
       {"--dump-protobuf-report", {OptionValueType::STRING, OptionType::SINGLE}},
+      {"--follow", {OptionValueType::NONE, OptionType::SINGLE}},
       {"-i", {OptionValueType::STRING, OptionType::SINGLE}},
       {"-o", {OptionValueType::STRING, OptionType::SINGLE}},
       {"--proguard-mapping-file", {OptionValueType::STRING, OptionType::MULTIPLE}},
@@ -314,6 +325,7 @@ bool ReportSampleCommand::ParseOptions(const std::vector<std::string>& args) {
     return false;
   }
   options.PullStringValue("--dump-protobuf-report", &dump_protobuf_report_file_);
+  follow_ = options.PullBoolValue("--follow");
   options.PullStringValue("-i", &record_filename_);
   options.PullStringValue("-o", &report_filename_);
   for (const OptionValue& value : options.PullValues("--proguard-mapping-file")) {
@@ -511,7 +523,11 @@ bool ReportSampleCommand::DumpProtobufReport(const std::string& filename) {
 }
 
 bool ReportSampleCommand::OpenRecordFile() {
-  record_file_reader_ = RecordFileReader::CreateInstance(record_filename_);
+  if (follow_) {
+    record_file_reader_ = RecordFileReader::CreateInstanceForFollowing(record_filename_);
+  } else {
+    record_file_reader_ = RecordFileReader::CreateInstance(record_filename_);
+  }
   if (record_file_reader_ == nullptr) {
     return false;
   }
@@ -89,6 +89,38 @@ TEST_F(ReportCommandTest, no_option) {
   ASSERT_NE(content.find("GlobalFunc"), std::string::npos);
 }
 
+TEST_F(ReportCommandTest, follow_option) {
+  // Following a finished recording gives the same report.
+  Report(PERF_DATA);
+  ASSERT_TRUE(success);
+  std::string expected = content;
+  Report(PERF_DATA, {"--follow"});
+  ASSERT_TRUE(success);
+  ASSERT_EQ(content, expected);
+}
+
+TEST_F(ReportCommandTest, time_slice_option) {
+  Report(PERF_DATA);
+  ASSERT_TRUE(success);
+  size_t total_samples = GetSampleCount();
+  Report(PERF_DATA, {"--time-slice", "10", "--time-slice-top", "3"});
+  ASSERT_TRUE(success);
+  ASSERT_NE(content.find("Time slice: 0 ms - 10 ms"), std::string::npos);
+  // Samples in all time slices add up to the samples in the whole file.
+  size_t slice_samples = 0;
+  auto regex = RegEx::Create(R"(Samples: (\d+))");
+  for (auto match = regex->SearchAll(content); match->IsValid(); match->MoveToNextMatch()) {
+    slice_samples += std::stoul(match->GetField(1));
+  }
+  ASSERT_EQ(slice_samples, total_samples);
+
+  Report(PERF_DATA, {"--time-slice", "10", "--csv"});
+  ASSERT_TRUE(success);
+  ASSERT_NE(content.find("\nTimeSlice(ms),Overhead,"), std::string::npos);
+  // All time slices are printed in one table.
+  ASSERT_EQ(content.find("Event: "), std::string::npos);
+}
+
 TEST_F(ReportCommandTest, report_symbol_from_elf_file_with_mini_debug_info) {
   Report(PERF_DATA_WITH_MINI_DEBUG_INFO);
   ASSERT_TRUE(success);
@@ -14,8 +14,12 @@
  * limitations under the License.
  */
 
+#include <signal.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <algorithm>
 #include <memory>
-#include <queue>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -44,12 +48,65 @@ struct SampleInfo {
       : timestamp(timestamp), runtime_in_ns(runtime_in_ns) {}
 };
 
+// Samples of a thread in the spinloop check period, kept in a ring buffer. push() can be given a
+// max capacity. When the buffer is full, the oldest sample is merged into the next one, which
+// keeps its newer timestamp. So memory use per thread is bounded, and the runtime of the oldest
+// sample stays in the check period longer than it should. Spinloop rates can be overestimated,
+// but not underestimated.
+class SampleRing {
+ public:
+  // The max capacity used in stream mode. Without it, all samples are kept.
+  static constexpr size_t kStreamMaxCapacity = 1024;
+
+  bool empty() const { return size_ == 0; }
+  size_t size() const { return size_; }
+  const SampleInfo& front() const { return buf_[head_]; }
+
+  void push(const SampleInfo& sample, size_t max_capacity = SIZE_MAX) {
+    if (size_ == buf_.size()) {
+      if (buf_.size() < max_capacity) {
+        Grow();
+      } else {
+        SampleInfo& second = buf_[(head_ + 1) % buf_.size()];
+        second.runtime_in_ns += front().runtime_in_ns;
+        pop();
+      }
+    }
+    buf_[(head_ + size_) % buf_.size()] = sample;
+    size_++;
+  }
+
+  void pop() {
+    head_ = (head_ + 1) % buf_.size();
+    size_--;
+  }
+
+  void clear() {
+    head_ = 0;
+    size_ = 0;
+  }
+
+ private:
+  void Grow() {
+    std::vector<SampleInfo> new_buf(std::max<size_t>(4, buf_.size() * 2));
+    for (size_t i = 0; i < size_; ++i) {
+      new_buf[i] = buf_[(head_ + i) % buf_.size()];
+    }
+    buf_ = std::move(new_buf);
+    head_ = 0;
+  }
+
+  std::vector<SampleInfo> buf_;
+  size_t head_ = 0;
+  size_t size_ = 0;
+};
+
 struct SpinInfo {
   uint64_t spinloop_count = 0;
   double max_rate = 0;
   uint64_t max_rate_start_timestamp = 0;
   uint64_t max_rate_end_timestamp = 0;
-  std::queue<SampleInfo> samples_in_check_period;
+  SampleRing samples_in_check_period;
   uint64_t runtime_in_check_period = 0;
 };
 
@@ -87,6 +144,14 @@ class TraceSchedCommand : public Command {
 "--spin-rate spin-rate   Default is 0.8. Vaild range is (0, 1].\n"
 "--show-threads          Show runtime of each thread.\n"
 "--record-file file_path   Read records from file_path.\n"
+"--stream-window time_in_sec\n"
+"        Report runtime and spinloops in each time window of time_in_sec,\n"
+"        while processing records. Only threads running in the current window\n"
+"        are kept, so long traces can be processed in bounded memory. Without\n"
+"        --record-file, records are read directly from the kernel instead of\n"
+"        being saved in a file first. To bound memory, old samples of a thread\n"
+"        may be merged, which can make spinloop rates slightly higher.\n"
+"--csv                   Report in csv format. Needs --stream-window.\n"
                 // clang-format on
                 ),
         duration_in_sec_(10.0),
@@ -99,17 +164,27 @@ class TraceSchedCommand : public Command {
  private:
   bool ParseOptions(const std::vector<std::string>& args);
   bool RecordSchedEvents(const std::string& record_file_path);
+  bool StreamSchedEvents();
   bool ParseSchedEvents(const std::string& record_file_path);
   bool ProcessRecord(Record& record);
+  bool SetTracingData(const std::vector<char>& data);
   void ProcessSampleRecord(const SampleRecord& record);
+  void FinishWindow();
   std::vector<ProcessInfo> BuildProcessInfo();
   void ReportProcessInfo(const std::vector<ProcessInfo>& processes);
+  void ReportProcessInfoInCsv(const std::vector<ProcessInfo>& processes);
 
   double duration_in_sec_;
   double spinloop_check_period_in_sec_;
   double spinloop_check_rate_;
   bool show_threads_;
   std::string record_file_;
+  // In stream mode, the runtime and spinloops of threads are reported and reset per window.
+  uint64_t stream_window_in_ns_ = 0;
+  bool csv_ = false;
+  bool csv_header_printed_ = false;
+  uint64_t window_start_timestamp_ = 0;
+  uint64_t window_end_timestamp_ = 0;
 
   StringTracingFieldPlace tracing_field_comm_;
   TracingFieldPlace tracing_field_runtime_;
@@ -120,6 +195,13 @@ bool TraceSchedCommand::Run(const std::vector<std::string>& args) {
   if (!ParseOptions(args)) {
     return false;
   }
+  if (stream_window_in_ns_ != 0) {
+    if (!(record_file_.empty() ? StreamSchedEvents() : ParseSchedEvents(record_file_))) {
+      return false;
+    }
+    FinishWindow();
+    return true;
+  }
   TemporaryFile tmp_file;
   if (record_file_.empty()) {
     if (!RecordSchedEvents(tmp_file.path)) {
@@ -157,11 +239,23 @@ bool TraceSchedCommand::ParseOptions(const std::vector<std::string>& args) {
         return false;
       }
       record_file_ = args[i];
+    } else if (args[i] == "--stream-window") {
+      double window_in_sec;
+      if (!GetDoubleOption(args, &i, &window_in_sec, 1e-9)) {
+        return false;
+      }
+      stream_window_in_ns_ = static_cast<uint64_t>(window_in_sec * 1e9);
+    } else if (args[i] == "--csv") {
+      csv_ = true;
     } else {
       ReportUnknownOption(args, i);
       return false;
     }
   }
+  if (csv_ && stream_window_in_ns_ == 0) {
+    LOG(ERROR) << "--csv is only used with --stream-window";
+    return false;
+  }
   return true;
 }
 
@@ -186,6 +280,51 @@ bool TraceSchedCommand::RecordSchedEvents(const std::string& record_file_path) {
   return record_cmd->Run(record_args);
 }
 
+bool TraceSchedCommand::StreamSchedEvents() {
+  if (!IsRoot()) {
+    LOG(ERROR) << "Need root privilege to trace system wide events.\n";
+    return false;
+  }
+  EventSelectionSet event_selection_set(false);
+  if (!event_selection_set.AddEventType("sched:sched_stat_runtime")) {
+    return false;
+  }
+  event_selection_set.SampleIdAll();
+  if (IsSettingClockIdSupported()) {
+    event_selection_set.SetClockId(CLOCK_MONOTONIC);
+  }
+  event_selection_set.AddMonitoredThreads({-1});
+  std::vector<char> tracing_data;
+  if (!GetTracingData(event_selection_set.GetTracepointEvents(), &tracing_data) ||
+      !SetTracingData(tracing_data)) {
+    return false;
+  }
+  if (!event_selection_set.OpenEventFiles({})) {
+    return false;
+  }
+  if (!event_selection_set.MmapEventFiles(1, 1024, 0 /* aux_buffer_size */, 64 * kMegabyte,
+                                          false /* allow_cutting_samples */,
+                                          true /* exclude_perf */)) {
+    return false;
+  }
+  auto callback = [this](Record* record) { return ProcessRecord(*record); };
+  if (!event_selection_set.PrepareToReadMmapEventData(callback)) {
+    return false;
+  }
+  IOEventLoop* loop = event_selection_set.GetIOEventLoop();
+  auto exit_loop_callback = [loop]() { return loop->ExitLoop(); };
+  if (!loop->AddSignalEvents({SIGCHLD, SIGINT, SIGTERM}, exit_loop_callback, IOEventHighPriority) ||
+      !loop->AddPeriodicEvent(SecondToTimeval(duration_in_sec_), exit_loop_callback,
+                              IOEventHighPriority)) {
+    return false;
+  }
+  if (!loop->RunLoop() || !event_selection_set.SyncKernelBuffer()) {
+    return false;
+  }
+  event_selection_set.CloseEventFiles();
+  return event_selection_set.FinishReadMmapEventData();
+}
+
 bool TraceSchedCommand::ParseSchedEvents(const std::string& record_file_path) {
   std::unique_ptr<RecordFileReader> reader = RecordFileReader::CreateInstance(record_file_path);
   if (!reader) {
@@ -231,22 +370,39 @@ bool TraceSchedCommand::ProcessRecord(Record& record) {
     case PERF_RECORD_TRACING_DATA:
     case SIMPLE_PERF_RECORD_TRACING_DATA: {
       const TracingDataRecord& r = *static_cast<const TracingDataRecord*>(&record);
-      auto tracing = Tracing::Create(std::vector<char>(r.data, r.data + r.data_size));
-      if (!tracing) {
-        return false;
-      }
-      const EventType* event = FindEventTypeByName("sched:sched_stat_runtime");
-      CHECK(event != nullptr);
-      TracingFormat format = tracing->GetTracingFormatHavingId(event->config);
-      format.GetField("comm", tracing_field_comm_);
-      format.GetField("runtime", tracing_field_runtime_);
-      break;
+      return SetTracingData(std::vector<char>(r.data, r.data + r.data_size));
     }
   }
   return true;
 }
 
+bool TraceSchedCommand::SetTracingData(const std::vector<char>& data) {
+  auto tracing = Tracing::Create(data);
+  if (!tracing) {
+    return false;
+  }
+  const EventType* event = FindEventTypeByName("sched:sched_stat_runtime");
+  CHECK(event != nullptr);
+  TracingFormat format = tracing->GetTracingFormatHavingId(event->config);
+  format.GetField("comm", tracing_field_comm_);
+  format.GetField("runtime", tracing_field_runtime_);
+  return true;
+}
+
 void TraceSchedCommand::ProcessSampleRecord(const SampleRecord& record) {
+  if (stream_window_in_ns_ != 0) {
+    uint64_t timestamp = record.Timestamp();
+    if (window_end_timestamp_ == 0) {
+      window_start_timestamp_ = timestamp;
+      window_end_timestamp_ = timestamp + stream_window_in_ns_;
+    } else if (timestamp >= window_end_timestamp_) {
+      FinishWindow();
+      // Skip windows without samples.
+      uint64_t skipped_windows = (timestamp - window_end_timestamp_) / stream_window_in_ns_;
+      window_start_timestamp_ = window_end_timestamp_ + skipped_windows * stream_window_in_ns_;
+      window_end_timestamp_ = window_start_timestamp_ + stream_window_in_ns_;
+    }
+  }
   std::string thread_name = tracing_field_comm_.ReadFromData(record.raw_data.data);
   uint64_t runtime = tracing_field_runtime_.ReadFromData(record.raw_data.data);
   ThreadInfo& thread = thread_map_[record.tid_data.tid];
@@ -256,7 +412,11 @@ void TraceSchedCommand::ProcessSampleRecord(const SampleRecord& record) {
   thread.total_runtime_in_ns += runtime;
   SpinInfo& spin_info = thread.spin_info;
   spin_info.runtime_in_check_period += runtime;
-  spin_info.samples_in_check_period.push(SampleInfo(record.Timestamp(), runtime));
+  // Merging samples makes spinloop rates approximate, so only do it in stream mode, where long
+  // traces are processed in bounded memory.
+  spin_info.samples_in_check_period.push(
+      SampleInfo(record.Timestamp(), runtime),
+      stream_window_in_ns_ != 0 ? SampleRing::kStreamMaxCapacity : SIZE_MAX);
 
   // Check spin loop.
   if (thread.spin_info.samples_in_check_period.size() == 1u) {
@@ -277,8 +437,7 @@ void TraceSchedCommand::ProcessSampleRecord(const SampleRecord& record) {
       thread.spin_info.max_rate_start_timestamp = start_timestamp;
       thread.spin_info.max_rate_end_timestamp = record.Timestamp();
       // Clear samples to avoid overlapped spin loop periods.
-      std::queue<SampleInfo> empty_q;
-      std::swap(thread.spin_info.samples_in_check_period, empty_q);
+      thread.spin_info.samples_in_check_period.clear();
       thread.spin_info.runtime_in_check_period = 0;
     } else {
       thread.spin_info.runtime_in_check_period -=
@@ -288,6 +447,36 @@ void TraceSchedCommand::ProcessSampleRecord(const SampleRecord& record) {
   }
 }
 
+void TraceSchedCommand::FinishWindow() {
+  if (window_end_timestamp_ == 0) {
+    return;
+  }
+  std::vector<ProcessInfo> processes = BuildProcessInfo();
+  if (csv_) {
+    ReportProcessInfoInCsv(processes);
+  } else {
+    printf("Window [%.6f s - %.6f s]\n", window_start_timestamp_ / 1e9,
+           window_end_timestamp_ / 1e9);
+    ReportProcessInfo(processes);
+    printf("\n");
+  }
+  fflush(stdout);
+
+  // Reset per window info. Threads not running in the window are removed, so memory use is
+  // proportional to the threads running in a window.
+  for (auto it = thread_map_.begin(); it != thread_map_.end();) {
+    ThreadInfo& thread = it->second;
+    if (thread.total_runtime_in_ns == 0) {
+      it = thread_map_.erase(it);
+      continue;
+    }
+    thread.total_runtime_in_ns = 0;
+    thread.spin_info.spinloop_count = 0;
+    thread.spin_info.max_rate = 0;
+    ++it;
+  }
+}
+
 std::vector<ProcessInfo> TraceSchedCommand::BuildProcessInfo() {
   std::unordered_map<pid_t, ProcessInfo> process_map;
   for (auto& pair : thread_map_) {
@@ -413,6 +602,25 @@ void TraceSchedCommand::ReportProcessInfo(const std::vector<ProcessInfo>& proces
   }
 }
 
+void TraceSchedCommand::ReportProcessInfoInCsv(const std::vector<ProcessInfo>& processes) {
+  if (!csv_header_printed_) {
+    printf("window_start_s,window_end_s,pid,tid,process_name,thread_name,runtime_ms,"
+           "spinloop_count,max_spin_rate\n");
+    csv_header_printed_ = true;
+  }
+  for (auto& process : processes) {
+    for (auto& thread : process.threads) {
+      if (thread->total_runtime_in_ns == 0 && thread->spin_info.spinloop_count == 0) {
+        continue;
+      }
+      printf("%.6f,%.6f,%d,%d,%s,%s,%.3f,%" PRIu64 ",%.4f\n", window_start_timestamp_ / 1e9,
+             window_end_timestamp_ / 1e9, process.process_id, thread->thread_id,
+             process.name.c_str(), thread->name.c_str(), thread->total_runtime_in_ns / 1e6,
+             thread->spin_info.spinloop_count, thread->spin_info.max_rate);
+    }
+  }
+}
+
 }  // namespace
 
 void RegisterTraceSchedCommand() {
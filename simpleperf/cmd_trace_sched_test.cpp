@@ -22,6 +22,7 @@
 
 #include <android-base/file.h>
 #include <android-base/stringprintf.h>
+#include <android-base/strings.h>
 
 #include <map>
 #include <memory>
@@ -61,3 +62,24 @@ TEST(trace_sched_cmd, report_smoke) {
                       "taken 997.813 ms / 1003.323 ms (99.45%)."),
             std::string::npos);
 }
+
+TEST(trace_sched_cmd, stream_window) {
+  CaptureStdout capture;
+  ASSERT_TRUE(capture.Start());
+  ASSERT_TRUE(TraceSchedCmd()->Run({"--record-file", GetTestData(PERF_DATA_SCHED_STAT_RUNTIME),
+                                    "--stream-window", "1", "--show-threads"}));
+  std::string data = capture.Finish();
+  ASSERT_NE(data.find("Window ["), std::string::npos);
+  ASSERT_NE(data.find("BusyThread"), std::string::npos);
+
+  ASSERT_TRUE(capture.Start());
+  ASSERT_TRUE(TraceSchedCmd()->Run({"--record-file", GetTestData(PERF_DATA_SCHED_STAT_RUNTIME),
+                                    "--stream-window", "1", "--csv"}));
+  data = capture.Finish();
+  ASSERT_TRUE(android::base::StartsWith(data, "window_start_s,window_end_s,pid,tid,"));
+  ASSERT_NE(data.find(",8603,8615,"), std::string::npos);
+
+  // --csv needs --stream-window.
+  ASSERT_FALSE(
+      TraceSchedCmd()->Run({"--record-file", GetTestData(PERF_DATA_SCHED_STAT_RUNTIME), "--csv"}));
+}
@@ -16,14 +16,19 @@
 
 #include "dso.h"
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <algorithm>
 #include <limits>
 #include <memory>
 #include <optional>
 #include <string_view>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 #include <android-base/file.h>
@@ -58,6 +63,7 @@ void DebugElfFileFinder::Reset() {
   vdso_32bit_.clear();
   symfs_dir_.clear();
   build_id_to_file_map_.clear();
+  ApkInspector::SetIndexDir("");
 }
 
 bool DebugElfFileFinder::SetSymFsDir(const std::string& symfs_dir) {
@@ -76,6 +82,11 @@ bool DebugElfFileFinder::SetSymFsDir(const std::string& symfs_dir) {
       }
     }
   }
+  // Indexes of APKs are kept in the symfs dir if it has an apk_index dir.
+  std::string apk_index_dir = symfs_dir_ + OS_PATH_SEPARATOR + "apk_index";
+  if (IsDir(apk_index_dir)) {
+    ApkInspector::SetIndexDir(apk_index_dir);
+  }
   return true;
 }
 
@@ -89,20 +100,280 @@ bool DebugElfFileFinder::AddSymbolDir(const std::string& symbol_dir) {
   return true;
 }
 
+// The build id index of a symbol dir is saved in the dir, so later runs don't need to read every
+// file again. It has below format:
+//   magic (8 bytes)
+//   dir_count (uint32_t)
+//   dirs, each has mtime_ns (uint64_t), path_size (uint32_t), path, entry_count (uint32_t),
+//         entries, each has name_size (uint32_t), name
+//   file_count (uint32_t)
+//   files, each has file_size (uint64_t), mtime_ns (uint64_t), path_size (uint32_t), path,
+//          build_id_size (uint32_t), build_id
+// Paths are relative to the symbol dir. A dir whose mtime hasn't changed has the same entries, so
+// only changed dirs are listed again. A file is only read again if its size or mtime has changed.
+static constexpr char kBuildIdIndexMagic[8] = {'B', 'I', 'D', 'I', 'D', 'X', '0', '1'};
+static constexpr const char* kBuildIdIndexFile = "build_id_index";
+static constexpr size_t kMaxThreadsToScanSymbolDir = 8;
+
+struct IndexedDir {
+  uint64_t mtime_ns = 0;
+  std::vector<std::string> entries;
+};
+
+struct IndexedFile {
+  uint64_t file_size = 0;
+  uint64_t mtime_ns = 0;
+  // Empty if the file isn't an elf file with build id.
+  std::string build_id;
+};
+
+struct BuildIdIndex {
+  std::unordered_map<std::string, IndexedDir> dirs;
+  std::unordered_map<std::string, IndexedFile> files;
+};
+
+static bool StatFile(const std::string& path, bool* is_dir, uint64_t* file_size,
+                     uint64_t* mtime_ns) {
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0) {
+    return false;
+  }
+  *is_dir = S_ISDIR(st.st_mode);
+  *file_size = st.st_size;
+#if defined(_WIN32)
+  *mtime_ns = static_cast<uint64_t>(st.st_mtime) * 1000000000ULL;
+#else
+  *mtime_ns = static_cast<uint64_t>(st.st_mtim.tv_sec) * 1000000000ULL + st.st_mtim.tv_nsec;
+#endif
+  return true;
+}
+
+static bool LoadBuildIdIndex(const std::string& index_path, BuildIdIndex* index) {
+  std::string data;
+  if (!android::base::ReadFileToString(index_path, &data)) {
+    return false;
+  }
+  const char* p = data.data();
+  const char* end = data.data() + data.size();
+  auto read_u32 = [&](uint32_t* value) {
+    if (end - p < static_cast<ptrdiff_t>(sizeof(*value))) {
+      return false;
+    }
+    MoveFromBinaryFormat(*value, p);
+    return true;
+  };
+  auto read_u64 = [&](uint64_t* value) {
+    if (end - p < static_cast<ptrdiff_t>(sizeof(*value))) {
+      return false;
+    }
+    MoveFromBinaryFormat(*value, p);
+    return true;
+  };
+  auto read_string = [&](std::string* s) {
+    uint32_t size;
+    if (!read_u32(&size) || end - p < static_cast<ptrdiff_t>(size)) {
+      return false;
+    }
+    s->assign(p, size);
+    p += size;
+    return true;
+  };
+
+  if (data.size() < sizeof(kBuildIdIndexMagic) ||
+      memcmp(p, kBuildIdIndexMagic, sizeof(kBuildIdIndexMagic)) != 0) {
+    return false;
+  }
+  p += sizeof(kBuildIdIndexMagic);
+  uint32_t dir_count;
+  if (!read_u32(&dir_count)) {
+    return false;
+  }
+  for (uint32_t i = 0; i < dir_count; i++) {
+    IndexedDir dir;
+    std::string path;
+    uint32_t entry_count;
+    if (!read_u64(&dir.mtime_ns) || !read_string(&path) || !read_u32(&entry_count)) {
+      return false;
+    }
+    for (uint32_t j = 0; j < entry_count; j++) {
+      std::string& entry = dir.entries.emplace_back();
+      if (!read_string(&entry)) {
+        return false;
+      }
+    }
+    index->dirs[path] = std::move(dir);
+  }
+  uint32_t file_count;
+  if (!read_u32(&file_count)) {
+    return false;
+  }
+  for (uint32_t i = 0; i < file_count; i++) {
+    IndexedFile file;
+    std::string path;
+    if (!read_u64(&file.file_size) || !read_u64(&file.mtime_ns) || !read_string(&path) ||
+        !read_string(&file.build_id)) {
+      return false;
+    }
+    index->files[path] = std::move(file);
+  }
+  return true;
+}
+
+static bool SaveBuildIdIndex(const std::string& index_path, const BuildIdIndex& index) {
+  std::string data(kBuildIdIndexMagic, sizeof(kBuildIdIndexMagic));
+  auto append = [&](const auto& value) {
+    data.append(reinterpret_cast<const char*>(&value), sizeof(value));
+  };
+  auto append_string = [&](const std::string& s) {
+    append(static_cast<uint32_t>(s.size()));
+    data.append(s);
+  };
+  append(static_cast<uint32_t>(index.dirs.size()));
+  for (const auto& [path, dir] : index.dirs) {
+    append(dir.mtime_ns);
+    append_string(path);
+    append(static_cast<uint32_t>(dir.entries.size()));
+    for (const auto& entry : dir.entries) {
+      append_string(entry);
+    }
+  }
+  append(static_cast<uint32_t>(index.files.size()));
+  for (const auto& [path, file] : index.files) {
+    append(file.file_size);
+    append(file.mtime_ns);
+    append_string(path);
+    append_string(file.build_id);
+  }
+  // Write to a temporary file first, to avoid leaving a partially written index.
+  std::string tmp_path = index_path + ".tmp";
+  if (!android::base::WriteStringToFile(data, tmp_path) ||
+      !RenameFile(tmp_path, index_path)) {
+    // The symbol dir may not be writable. Then the dir is scanned again next time.
+    PLOG(DEBUG) << "failed to save build id index " << index_path;
+    unlink(tmp_path.c_str());
+    return false;
+  }
+  return true;
+}
+
 void DebugElfFileFinder::CollectBuildIdInDir(const std::string& dir) {
-  for (const std::string& entry : GetEntriesInDir(dir)) {
-    std::string path = dir + OS_PATH_SEPARATOR + entry;
-    if (IsDir(path)) {
-      CollectBuildIdInDir(path);
-    } else {
-      BuildId build_id;
-      ElfStatus status;
-      auto elf = ElfFile::Open(path, &status);
-      if (status == ElfStatus::NO_ERROR && elf->GetBuildId(&build_id) == ElfStatus::NO_ERROR) {
-        build_id_to_file_map_[build_id.ToString()] = path;
+  std::string index_path = dir + OS_PATH_SEPARATOR + kBuildIdIndexFile;
+  BuildIdIndex old_index;
+  if (!LoadBuildIdIndex(index_path, &old_index)) {
+    old_index = BuildIdIndex();
+  }
+  BuildIdIndex new_index;
+  bool changed = false;
+  size_t max_threads =
+      std::min<size_t>(kMaxThreadsToScanSymbolDir, std::thread::hardware_concurrency());
+  auto full_path = [&](const std::string& rel_path) {
+    return rel_path.empty() ? dir : dir + OS_PATH_SEPARATOR + rel_path;
+  };
+  auto child_path = [&](const std::string& rel_dir, const std::string& name) {
+    return rel_dir.empty() ? name : rel_dir + OS_PATH_SEPARATOR + name;
+  };
+
+  // Walk the dir level by level. In each level, dirs are listed and their entries are checked in
+  // parallel.
+  struct Entry {
+    std::string path;
+    bool valid = false;
+    bool is_dir = false;
+    uint64_t file_size = 0;
+    uint64_t mtime_ns = 0;
+  };
+  std::vector<Entry> files;
+  std::vector<std::string> level = {""};
+  while (!level.empty()) {
+    std::vector<IndexedDir> listed(level.size());
+    std::vector<char> dir_changed(level.size(), 0);
+    RunInParallel(level.size(), max_threads, [&](size_t i) {
+      bool is_dir;
+      uint64_t file_size;
+      if (!StatFile(full_path(level[i]), &is_dir, &file_size, &listed[i].mtime_ns)) {
+        return;
+      }
+      auto it = old_index.dirs.find(level[i]);
+      if (it != old_index.dirs.end() && it->second.mtime_ns == listed[i].mtime_ns) {
+        listed[i].entries = it->second.entries;
+        return;
+      }
+      std::vector<std::string> names = GetEntriesInDir(full_path(level[i]));
+      if (level[i].empty()) {
+        // Saving the index changes the mtime of the symbol dir, after the mtime is recorded. So
+        // the symbol dir is listed again in the next scan, and is only a change when entries
+        // other than the index are different.
+        names.erase(std::remove_if(names.begin(), names.end(),
+                                   [](const std::string& name) {
+                                     return StartsWith(name, kBuildIdIndexFile);
+                                   }),
+                    names.end());
+      }
+      std::sort(names.begin(), names.end());
+      dir_changed[i] = it == old_index.dirs.end() || it->second.entries != names;
+      listed[i].entries = std::move(names);
+    });
+    std::vector<Entry> entries;
+    for (size_t i = 0; i < level.size(); i++) {
+      changed |= dir_changed[i] != 0;
+      for (const std::string& name : listed[i].entries) {
+        entries.emplace_back().path = child_path(level[i], name);
+      }
+      new_index.dirs[level[i]] = std::move(listed[i]);
+    }
+    RunInParallel(entries.size(), max_threads, [&](size_t i) {
+      Entry& e = entries[i];
+      e.valid = StatFile(full_path(e.path), &e.is_dir, &e.file_size, &e.mtime_ns);
+    });
+    level.clear();
+    for (Entry& e : entries) {
+      if (!e.valid) {
+        // The entry was removed after the dir was indexed.
+        changed = true;
+      } else if (e.is_dir) {
+        level.emplace_back(std::move(e.path));
+      } else {
+        files.emplace_back(std::move(e));
       }
     }
   }
+
+  // Only read build ids of files changed since the index was saved.
+  std::vector<IndexedFile> indexed_files(files.size());
+  std::vector<size_t> files_to_read;
+  for (size_t i = 0; i < files.size(); i++) {
+    indexed_files[i].file_size = files[i].file_size;
+    indexed_files[i].mtime_ns = files[i].mtime_ns;
+    auto it = old_index.files.find(files[i].path);
+    if (it != old_index.files.end() && it->second.file_size == files[i].file_size &&
+        it->second.mtime_ns == files[i].mtime_ns) {
+      indexed_files[i].build_id = it->second.build_id;
+    } else {
+      files_to_read.push_back(i);
+    }
+  }
+  RunInParallel(files_to_read.size(), max_threads, [&](size_t i) {
+    size_t file_index = files_to_read[i];
+    BuildId build_id;
+    if (GetBuildIdFromElfHeaders(full_path(files[file_index].path), &build_id) ==
+        ElfStatus::NO_ERROR) {
+      indexed_files[file_index].build_id = build_id.ToString();
+    }
+  });
+  LOG(DEBUG) << "Collected build ids in " << dir << ": " << files.size() << " files, read "
+             << files_to_read.size() << " files";
+
+  for (size_t i = 0; i < files.size(); i++) {
+    if (!indexed_files[i].build_id.empty()) {
+      build_id_to_file_map_[indexed_files[i].build_id] = full_path(files[i].path);
+    }
+    new_index.files[files[i].path] = std::move(indexed_files[i]);
+  }
+  changed |= !files_to_read.empty() || new_index.dirs.size() != old_index.dirs.size() ||
+             new_index.files.size() != old_index.files.size();
+  if (changed) {
+    SaveBuildIdIndex(index_path, new_index);
+  }
 }
 
 void DebugElfFileFinder::SetVdsoFile(const std::string& vdso_file, bool is_64bit) {
@@ -16,6 +16,8 @@
 
 #include "dso.h"
 
+#include <sys/stat.h>
+
 #include <gtest/gtest.h>
 
 #include <android-base/file.h>
@@ -94,6 +96,43 @@ TEST(DebugElfFileFinder, add_symbol_dir) {
             symfs_dir + OS_PATH_SEPARATOR + "elf_for_build_id_check");
 }
 
+TEST(DebugElfFileFinder, build_id_index) {
+  TemporaryDir tmpdir;
+  std::string subdir = std::string(tmpdir.path) + OS_PATH_SEPARATOR + "lib";
+  ASSERT_TRUE(MkdirWithParents(subdir + "/"));
+  std::string elf_path = subdir + OS_PATH_SEPARATOR + "elf";
+  std::string data;
+  ASSERT_TRUE(android::base::ReadFileToString(GetTestData(ELF_FILE), &data));
+  ASSERT_TRUE(android::base::WriteStringToFile(data, elf_path));
+  BuildId build_id(ELF_FILE_BUILD_ID);
+
+  // The first scan saves an index in the symbol dir.
+  DebugElfFileFinder finder;
+  ASSERT_TRUE(finder.AddSymbolDir(tmpdir.path));
+  ASSERT_EQ(finder.FindDebugFile("elf", false, build_id), elf_path);
+  std::string index_path = std::string(tmpdir.path) + OS_PATH_SEPARATOR + "build_id_index";
+  ASSERT_TRUE(IsRegularFile(index_path));
+
+  struct stat st;
+  ASSERT_EQ(stat(index_path.c_str(), &st), 0);
+  ino_t index_inode = st.st_ino;
+
+  // Later scans use the index, and don't rewrite it when nothing changed.
+  for (int i = 0; i < 2; i++) {
+    finder.Reset();
+    ASSERT_TRUE(finder.AddSymbolDir(tmpdir.path));
+    ASSERT_EQ(finder.FindDebugFile("elf", false, build_id), elf_path);
+    ASSERT_EQ(stat(index_path.c_str(), &st), 0);
+    ASSERT_EQ(st.st_ino, index_inode);
+  }
+
+  // Changed files are read again.
+  ASSERT_TRUE(android::base::WriteStringToFile("not an elf file", elf_path));
+  finder.Reset();
+  ASSERT_TRUE(finder.AddSymbolDir(tmpdir.path));
+  ASSERT_EQ(finder.FindDebugFile("elf", false, build_id), "elf");
+}
+
 TEST(DebugElfFileFinder, build_id_list) {
   DebugElfFileFinder finder;
   // Find file in symfs dir with correct build_id_list.
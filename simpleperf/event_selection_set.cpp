@@ -615,9 +615,9 @@ static bool CheckIfCpusOnline(const std::vector<int>& cpus) {
   return true;
 }
 
-bool EventSelectionSet::OpenEventFilesOnGroup(EventSelectionGroup& group, pid_t tid, int cpu,
+bool EventSelectionSet::OpenEventFilesOnGroup(const EventSelectionGroup& group, pid_t tid, int cpu,
+                                              std::vector<std::unique_ptr<EventFd>>* event_fds,
                                               std::string* failed_event_type) {
-  std::vector<std::unique_ptr<EventFd>> event_fds;
   // Given a tid and cpu, events on the same group should be all opened
   // successfully or all failed to open.
   EventFd* group_fd = nullptr;
@@ -626,17 +626,15 @@ bool EventSelectionSet::OpenEventFilesOnGroup(EventSelectionGroup& group, pid_t
         selection.event_attr, tid, cpu, group_fd, selection.event_type_modifier.name, false);
     if (!event_fd) {
       *failed_event_type = selection.event_type_modifier.name;
+      event_fds->clear();
       return false;
     }
     LOG(VERBOSE) << "OpenEventFile for " << event_fd->Name();
-    event_fds.push_back(std::move(event_fd));
+    event_fds->push_back(std::move(event_fd));
     if (group_fd == nullptr) {
-      group_fd = event_fds.back().get();
+      group_fd = event_fds->back().get();
     }
   }
-  for (size_t i = 0; i < group.size(); ++i) {
-    group[i].event_fds.push_back(std::move(event_fds[i]));
-  }
   return true;
 }
 
@@ -650,7 +648,14 @@ static std::set<pid_t> PrepareThreads(const std::set<pid_t>& processes,
   return result;
 }
 
+// Monitoring hundreds of threads on each cpu needs thousands of perf_event_open() calls, which
+// delays the start of recording. So open event files in parallel, sharded by cpu, when there are
+// enough of them.
+static constexpr size_t kMinEventFilesToOpenInParallel = 256;
+static constexpr size_t kMaxThreadsToOpenEventFiles = 8;
+
 bool EventSelectionSet::OpenEventFiles(const std::vector<int>& cpus) {
+  uint64_t start_time = GetSystemClock();
   std::vector<int> monitored_cpus;
   if (cpus.empty()) {
     monitored_cpus = GetOnlineCpus();
@@ -662,29 +667,63 @@ bool EventSelectionSet::OpenEventFiles(const std::vector<int>& cpus) {
     }
     monitored_cpus = cpus;
   }
-  std::set<pid_t> threads = PrepareThreads(processes_, threads_);
+  std::set<pid_t> thread_set = PrepareThreads(processes_, threads_);
+  std::vector<pid_t> threads(thread_set.begin(), thread_set.end());
+  uint64_t prepare_threads_time = GetSystemClock();
+
+  size_t max_threads =
+      std::min<size_t>(kMaxThreadsToOpenEventFiles, std::thread::hardware_concurrency());
+  size_t total_open_count = 0;
+  size_t total_success_count = 0;
   for (auto& group : groups_) {
+    // Override cpu list if event's PMU has a cpumask as those PMUs are
+    // agnostic to cpu and it's meaningless to specify cpus for them.
+    const std::vector<int>& group_cpus =
+        group[0].allowed_cpus.empty() ? monitored_cpus : group[0].allowed_cpus;
+
+    // Results are indexed by (thread index * cpu count + cpu index), so they can be added to
+    // the group in the same order as opening them serially.
+    struct OpenResult {
+      std::vector<std::unique_ptr<EventFd>> event_fds;
+      std::string failed_event_type;
+      int error_number = 0;
+    };
+    std::vector<OpenResult> results(threads.size() * group_cpus.size());
+    auto open_on_cpu = [&](size_t cpu_index) {
+      for (size_t i = 0; i < threads.size(); ++i) {
+        OpenResult& result = results[i * group_cpus.size() + cpu_index];
+        if (!OpenEventFilesOnGroup(group, threads[i], group_cpus[cpu_index], &result.event_fds,
+                                   &result.failed_event_type)) {
+          result.error_number = errno;
+        }
+      }
+    };
+    size_t open_count = results.size() * group.size();
+    RunInParallel(group_cpus.size(),
+                  open_count >= kMinEventFilesToOpenInParallel ? max_threads : 1, open_on_cpu);
+
     size_t success_count = 0;
     std::string failed_event_type;
-    for (const auto tid : threads) {
-      const std::vector<int>* pcpus = &monitored_cpus;
-      if (!group[0].allowed_cpus.empty()) {
-        // override cpu list if event's PMU has a cpumask as those PMUs are
-        // agnostic to cpu and it's meaningless to specify cpus for them.
-        pcpus = &group[0].allowed_cpus;
+    int error_number = 0;
+    for (auto& result : results) {
+      if (result.event_fds.empty()) {
+        failed_event_type = result.failed_event_type;
+        error_number = result.error_number;
+        continue;
       }
-      for (const auto& cpu : *pcpus) {
-        if (OpenEventFilesOnGroup(group, tid, cpu, &failed_event_type)) {
-          success_count++;
-        }
+      success_count++;
+      for (size_t i = 0; i < group.size(); ++i) {
+        group[i].event_fds.push_back(std::move(result.event_fds[i]));
       }
     }
+    total_open_count += results.size();
+    total_success_count += success_count;
     // We can't guarantee to open perf event file successfully for each thread on each cpu.
     // Because threads may exit between PrepareThreads() and OpenEventFilesOnGroup(), and
     // cpus may be offlined between GetOnlineCpus() and OpenEventFilesOnGroup().
     // So we only check that we can at least monitor one thread for each event group.
     if (success_count == 0) {
-      int error_number = errno;
+      errno = error_number;
       PLOG(ERROR) << "failed to open perf event file for event_type " << failed_event_type;
       if (error_number == EMFILE) {
         LOG(ERROR) << "Please increase hard limit of open file numbers.";
@@ -692,7 +731,16 @@ bool EventSelectionSet::OpenEventFiles(const std::vector<int>& cpus) {
       return false;
     }
   }
-  return ApplyFilters();
+  uint64_t open_files_time = GetSystemClock();
+  bool result = ApplyFilters();
+  uint64_t apply_filters_time = GetSystemClock();
+  LOG(VERBOSE) << "OpenEventFiles: prepare " << threads.size() << " threads in "
+               << (prepare_threads_time - start_time) / 1e6 << " ms, open " << total_success_count
+               << "/" << total_open_count << " event groups on " << monitored_cpus.size()
+               << " cpus in " << (open_files_time - prepare_threads_time) / 1e6
+               << " ms, apply filters in " << (apply_filters_time - open_files_time) / 1e6
+               << " ms";
+  return result;
 }
 
 bool EventSelectionSet::ApplyFilters() {
@@ -193,7 +193,8 @@ class EventSelectionSet {
   bool BuildAndCheckEventSelection(const std::string& event_name, bool first_event,
                                    EventSelection* selection);
   void UnionSampleType();
-  bool OpenEventFilesOnGroup(EventSelectionGroup& group, pid_t tid, int cpu,
+  bool OpenEventFilesOnGroup(const EventSelectionGroup& group, pid_t tid, int cpu,
+                             std::vector<std::unique_ptr<EventFd>>* event_fds,
                              std::string* failed_event_type);
   bool ApplyFilters();
   bool ApplyAddrFilters();
@@ -56,6 +56,24 @@ struct Counter {
 //    perf->StopCounters();
 //    perf->ReadCounters(&counters);
 //
+// To record perf events, you can do as follows:
+//  1. Create PerfEventSet instance.
+//  2. Select perf events to sample, and optionally the sample frequency and call graph.
+//  3. Set monitored targets.
+//  4. Start recording, pause/resume recording when needed, and stop recording.
+// Samples are read from kernel buffers by a background thread while recording, so pausing and
+// resuming recording only enable/disable the perf event files, which is cheap enough to wrap
+// hot code regions. An example is as below:
+//    PerfEventSet* perf = PerfEventSet::CreateInstance(PerfEventSetType::kPerfForRecording);
+//    perf->AddEvent("cpu-clock");
+//    perf->SetSampleFrequency(4000);
+//    perf->EnableFpCallChain();
+//    perf->MonitorCurrentThread();
+//    perf->StartRecording("/data/local/tmp/perf.data");
+//    perf->PauseRecording();
+//    perf->ResumeRecording();
+//    perf->StopRecording();
+//
 // PerfEventSet is not thread-safe. To access it from different threads, please protect
 // it under locks.
 class SIMPLEPERF_EXPORT PerfEventSet {
@@ -86,6 +104,24 @@ class SIMPLEPERF_EXPORT PerfEventSet {
   // reading them. The counter values are the accumulated value from the first StartCounters().
   virtual bool ReadCounters(std::vector<Counter>* counters);
 
+  // Recording interface:
+  // Set the number of samples taken per second for each event. Should be called before
+  // StartRecording(). If not set, the default frequency of `simpleperf record` is used.
+  virtual bool SetSampleFrequency(uint64_t freq);
+  // Record call graphs using frame pointers. Should be called before StartRecording().
+  virtual bool EnableFpCallChain();
+  // Start recording samples into output_filename in perf.data format. The samples are moved from
+  // kernel buffers to the file by a background thread. Sample timestamps use CLOCK_MONOTONIC
+  // when the kernel supports it.
+  virtual bool StartRecording(const std::string& output_filename);
+  // Pause/resume recording. Only the perf event files are disabled/enabled, so no sample is
+  // taken in a paused period.
+  virtual bool PauseRecording();
+  virtual bool ResumeRecording();
+  // Stop recording, flush remaining samples and finish writing the output file. Return false if
+  // any step fails, then the output file may be incomplete.
+  virtual bool StopRecording();
+
  protected:
   PerfEventSet() {}
 };
@@ -18,24 +18,232 @@
 #include "read_apk.h"
 
 #include <errno.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <memory>
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
+#include <android-base/stringprintf.h>
 #include <android-base/strings.h>
+#include <android-base/unique_fd.h>
 #include <ziparchive/zip_archive.h>
 #include "read_elf.h"
 #include "utils.h"
 
 namespace simpleperf {
 
+static constexpr char kApkIndexMagic[8] = {'A', 'P', 'K', 'I', 'D', 'X', '0', '1'};
+// Size of the tail of an APK used to detect changes. It covers the end of central directory
+// record of APKs without a long zip comment.
+static constexpr size_t kApkTailSize = 4096;
+
+static uint64_t Fnv1aHash(const char* data, size_t size) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= static_cast<uint8_t>(data[i]);
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+ApkIndex::ApkIndex(const std::string& apk_path, const ApkKey& key, std::vector<Entry>&& entries)
+    : apk_path_(apk_path), key_(key), entries_(std::move(entries)) {
+  std::sort(entries_.begin(), entries_.end(),
+            [](const Entry& e1, const Entry& e2) { return e1.offset < e2.offset; });
+  for (size_t i = 0; i < entries_.size(); ++i) {
+    name_map_.emplace(entries_[i].name, i);
+  }
+}
+
+bool ApkIndex::GetApkKey(const std::string& apk_path, ApkKey* key) {
+  android::base::unique_fd fd = FileHelper::OpenReadOnly(apk_path);
+  struct stat st;
+  if (fd == -1 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+    return false;
+  }
+  key->file_size = st.st_size;
+#if defined(_WIN32)
+  key->mtime_ns = static_cast<uint64_t>(st.st_mtime) * 1000000000ULL;
+#else
+  key->mtime_ns = static_cast<uint64_t>(st.st_mtim.tv_sec) * 1000000000ULL + st.st_mtim.tv_nsec;
+#endif
+  size_t tail_size = std::min<uint64_t>(kApkTailSize, key->file_size);
+  std::vector<char> tail(tail_size);
+  if (!android::base::ReadFullyAtOffset(fd, tail.data(), tail_size, key->file_size - tail_size)) {
+    return false;
+  }
+  key->tail_hash = Fnv1aHash(tail.data(), tail_size);
+  return true;
+}
+
+std::unique_ptr<ApkIndex> ApkIndex::Build(const std::string& apk_path) {
+  ApkKey key;
+  if (!GetApkKey(apk_path, &key)) {
+    return nullptr;
+  }
+  std::unique_ptr<ArchiveHelper> ahelper = ArchiveHelper::CreateInstance(apk_path);
+  if (!ahelper) {
+    return nullptr;
+  }
+  // Only uncompressed entries can be mapped into memory and referred by offset.
+  std::vector<Entry> entries;
+  bool result = ahelper->IterateEntries([&](ZipEntry& entry, const std::string& name) {
+    if (entry.method == kCompressStored && entry.compressed_length == entry.uncompressed_length) {
+      entries.emplace_back(Entry{static_cast<uint64_t>(entry.offset),
+                                 static_cast<uint64_t>(entry.uncompressed_length), name});
+    }
+    return true;
+  });
+  if (!result) {
+    return nullptr;
+  }
+  return std::unique_ptr<ApkIndex>(new ApkIndex(apk_path, key, std::move(entries)));
+}
+
+// The index file has below format:
+//   magic (8 bytes)
+//   apk_path_size (uint32_t), apk_path
+//   file_size (uint64_t), mtime_ns (uint64_t), tail_hash (uint64_t)
+//   entry_count (uint32_t)
+//   entries, each has offset (uint64_t), size (uint64_t), name_size (uint32_t), name
+std::unique_ptr<ApkIndex> ApkIndex::Load(const std::string& index_path,
+                                         const std::string& apk_path) {
+  std::string data;
+  if (!android::base::ReadFileToString(index_path, &data)) {
+    return nullptr;
+  }
+  const char* p = data.data();
+  const char* end = data.data() + data.size();
+  auto read_string = [&](std::string* s) {
+    uint32_t size;
+    if (end - p < static_cast<ptrdiff_t>(sizeof(size))) {
+      return false;
+    }
+    MoveFromBinaryFormat(size, p);
+    if (end - p < static_cast<ptrdiff_t>(size)) {
+      return false;
+    }
+    s->assign(p, size);
+    p += size;
+    return true;
+  };
+
+  if (data.size() < sizeof(kApkIndexMagic) ||
+      memcmp(p, kApkIndexMagic, sizeof(kApkIndexMagic)) != 0) {
+    return nullptr;
+  }
+  p += sizeof(kApkIndexMagic);
+  std::string path_in_index;
+  if (!read_string(&path_in_index) || path_in_index != apk_path) {
+    return nullptr;
+  }
+  ApkKey key_in_index;
+  ApkKey key;
+  uint32_t entry_count;
+  if (end - p < static_cast<ptrdiff_t>(sizeof(uint64_t) * 3 + sizeof(entry_count))) {
+    return nullptr;
+  }
+  MoveFromBinaryFormat(key_in_index.file_size, p);
+  MoveFromBinaryFormat(key_in_index.mtime_ns, p);
+  MoveFromBinaryFormat(key_in_index.tail_hash, p);
+  MoveFromBinaryFormat(entry_count, p);
+  if (!GetApkKey(apk_path, &key) || !(key == key_in_index)) {
+    return nullptr;
+  }
+  // Each entry takes at least kMinEntrySize bytes. Check it before allocating entries, so a
+  // corrupted entry_count can't make us allocate a huge vector.
+  constexpr size_t kMinEntrySize = sizeof(uint64_t) * 2 + sizeof(uint32_t);
+  if (static_cast<uint64_t>(end - p) / kMinEntrySize < entry_count) {
+    return nullptr;
+  }
+  std::vector<Entry> entries(entry_count);
+  for (auto& entry : entries) {
+    if (end - p < static_cast<ptrdiff_t>(sizeof(uint64_t) * 2)) {
+      return nullptr;
+    }
+    MoveFromBinaryFormat(entry.offset, p);
+    MoveFromBinaryFormat(entry.size, p);
+    if (!read_string(&entry.name)) {
+      return nullptr;
+    }
+  }
+  return std::unique_ptr<ApkIndex>(new ApkIndex(apk_path, key, std::move(entries)));
+}
+
+bool ApkIndex::Save(const std::string& index_path) const {
+  std::string data(kApkIndexMagic, sizeof(kApkIndexMagic));
+  auto append = [&](const auto& value) {
+    data.append(reinterpret_cast<const char*>(&value), sizeof(value));
+  };
+  auto append_string = [&](const std::string& s) {
+    append(static_cast<uint32_t>(s.size()));
+    data.append(s);
+  };
+  append_string(apk_path_);
+  append(key_.file_size);
+  append(key_.mtime_ns);
+  append(key_.tail_hash);
+  append(static_cast<uint32_t>(entries_.size()));
+  for (const auto& entry : entries_) {
+    append(entry.offset);
+    append(entry.size);
+    append_string(entry.name);
+  }
+  // Write to a temporary file first, to avoid leaving a partially written index.
+  std::string tmp_path = index_path + ".tmp";
+  if (!android::base::WriteStringToFile(data, tmp_path) ||
+      !RenameFile(tmp_path, index_path)) {
+    PLOG(DEBUG) << "failed to save apk index " << index_path;
+    unlink(tmp_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+const ApkIndex::Entry* ApkIndex::FindEntryByOffset(uint64_t file_offset) const {
+  auto it = std::upper_bound(entries_.begin(), entries_.end(), file_offset,
+                             [](uint64_t offset, const Entry& e) { return offset < e.offset; });
+  if (it == entries_.begin()) {
+    return nullptr;
+  }
+  --it;
+  return file_offset < it->offset + it->size ? &*it : nullptr;
+}
+
+const ApkIndex::Entry* ApkIndex::FindEntryByName(const std::string& name) const {
+  auto it = name_map_.find(name);
+  return it != name_map_.end() ? &entries_[it->second] : nullptr;
+}
+
 std::unordered_map<std::string, ApkInspector::ApkNode> ApkInspector::embedded_elf_cache_;
+std::string ApkInspector::index_dir_;
+
+const ApkIndex* ApkInspector::GetApkIndex(const std::string& apk_path, ApkNode& node) {
+  if (!node.index_loaded) {
+    node.index_loaded = true;
+    std::string index_path;
+    if (!index_dir_.empty()) {
+      index_path = index_dir_ + OS_PATH_SEPARATOR +
+                   android::base::StringPrintf(
+                       "%016" PRIx64 ".idx", Fnv1aHash(apk_path.data(), apk_path.size()));
+      node.index = ApkIndex::Load(index_path, apk_path);
+    }
+    if (!node.index) {
+      node.index = ApkIndex::Build(apk_path);
+      if (node.index && !index_path.empty()) {
+        node.index->Save(index_path);
+      }
+    }
+  }
+  return node.index.get();
+}
 
 EmbeddedElf* ApkInspector::FindElfInApkByOffset(const std::string& apk_path, uint64_t file_offset) {
   // Already in cache?
@@ -44,7 +252,10 @@ EmbeddedElf* ApkInspector::FindElfInApkByOffset(const std::string& apk_path, uin
   if (it != node.offset_map.end()) {
     return it->second.get();
   }
-  std::unique_ptr<EmbeddedElf> elf = FindElfInApkByOffsetWithoutCache(apk_path, file_offset);
+  std::unique_ptr<EmbeddedElf> elf;
+  if (const ApkIndex* index = GetApkIndex(apk_path, node); index != nullptr) {
+    elf = FindElfInApkByOffsetWithoutCache(apk_path, *index, file_offset);
+  }
   EmbeddedElf* result = elf.get();
   node.offset_map[file_offset] = std::move(elf);
   if (result != nullptr) {
@@ -60,7 +271,10 @@ EmbeddedElf* ApkInspector::FindElfInApkByName(const std::string& apk_path,
   if (it != node.name_map.end()) {
     return it->second;
   }
-  std::unique_ptr<EmbeddedElf> elf = FindElfInApkByNameWithoutCache(apk_path, entry_name);
+  std::unique_ptr<EmbeddedElf> elf;
+  if (const ApkIndex* index = GetApkIndex(apk_path, node); index != nullptr) {
+    elf = FindElfInApkByNameWithoutCache(apk_path, *index, entry_name);
+  }
   EmbeddedElf* result = elf.get();
   node.name_map[entry_name] = result;
   if (result != nullptr) {
@@ -70,56 +284,32 @@ EmbeddedElf* ApkInspector::FindElfInApkByName(const std::string& apk_path,
 }
 
 std::unique_ptr<EmbeddedElf> ApkInspector::FindElfInApkByOffsetWithoutCache(
-    const std::string& apk_path, uint64_t file_offset) {
-  std::unique_ptr<ArchiveHelper> ahelper = ArchiveHelper::CreateInstance(apk_path);
-  if (!ahelper) {
-    return nullptr;
-  }
-
-  // Iterate through the zip file. Look for a zip entry corresponding
-  // to an uncompressed blob whose range intersects with the mmap
-  // offset we're interested in.
-  bool found = false;
-  ZipEntry found_entry;
-  std::string found_entry_name;
-  bool result = ahelper->IterateEntries([&](ZipEntry& entry, const std::string& name) {
-    if (entry.method == kCompressStored && file_offset >= static_cast<uint64_t>(entry.offset) &&
-        file_offset < static_cast<uint64_t>(entry.offset) + entry.uncompressed_length) {
-      found = true;
-      found_entry = entry;
-      found_entry_name = name;
-      return false;
-    }
-    return true;
-  });
-  if (!result || !found) {
+    const std::string& apk_path, const ApkIndex& index, uint64_t file_offset) {
+  // Look for an uncompressed entry whose range intersects with the mmap offset we're interested
+  // in.
+  const ApkIndex::Entry* entry = index.FindEntryByOffset(file_offset);
+  if (entry == nullptr) {
     return nullptr;
   }
 
   // We found something in the zip file at the right spot. Is it an ELF?
-  if (IsValidElfFile(ahelper->GetFd(), found_entry.offset) != ElfStatus::NO_ERROR) {
+  android::base::unique_fd fd = FileHelper::OpenReadOnly(apk_path);
+  if (fd == -1 || IsValidElfFile(fd, entry->offset) != ElfStatus::NO_ERROR) {
     // Omit files that are not ELF files.
     return nullptr;
   }
-  return std::unique_ptr<EmbeddedElf>(new EmbeddedElf(
-      apk_path, found_entry_name, found_entry.offset, found_entry.uncompressed_length));
+  return std::unique_ptr<EmbeddedElf>(
+      new EmbeddedElf(apk_path, entry->name, entry->offset, entry->size));
 }
 
 std::unique_ptr<EmbeddedElf> ApkInspector::FindElfInApkByNameWithoutCache(
-    const std::string& apk_path, const std::string& entry_name) {
-  std::unique_ptr<ArchiveHelper> ahelper = ArchiveHelper::CreateInstance(apk_path);
-  if (!ahelper) {
-    return nullptr;
-  }
-  ZipEntry zentry;
-  if (!ahelper->FindEntry(entry_name, &zentry)) {
-    return nullptr;
-  }
-  if (zentry.method != kCompressStored || zentry.compressed_length != zentry.uncompressed_length) {
+    const std::string& apk_path, const ApkIndex& index, const std::string& entry_name) {
+  const ApkIndex::Entry* entry = index.FindEntryByName(entry_name);
+  if (entry == nullptr) {
     return nullptr;
   }
   return std::unique_ptr<EmbeddedElf>(
-      new EmbeddedElf(apk_path, entry_name, zentry.offset, zentry.uncompressed_length));
+      new EmbeddedElf(apk_path, entry_name, entry->offset, entry->size));
 }
 
 // Refer file in apk in compliance with
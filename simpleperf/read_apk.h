@@ -21,8 +21,10 @@
 
 #include <memory>
 #include <string>
+#include <string_view>
 #include <tuple>
 #include <unordered_map>
+#include <vector>
 
 #include "read_elf.h"
 
@@ -59,26 +61,81 @@ class EmbeddedElf {
   uint32_t entry_size_;     // size of ELF file in zip
 };
 
+// Index of uncompressed entries in an APK file, sorted by offset. It is built by reading the
+// central directory of the APK once. And it can be saved to a file, so later runs can find
+// entries without opening the APK as a zip file.
+class ApkIndex {
+ public:
+  struct Entry {
+    uint64_t offset;  // offset of entry data from start of the APK file
+    uint64_t size;
+    std::string name;
+  };
+
+  static std::unique_ptr<ApkIndex> Build(const std::string& apk_path);
+  // Load an index saved by Save(). Return nullptr if the index file doesn't exist, or the APK
+  // has changed since the index was saved.
+  static std::unique_ptr<ApkIndex> Load(const std::string& index_path,
+                                        const std::string& apk_path);
+  bool Save(const std::string& index_path) const;
+
+  const Entry* FindEntryByOffset(uint64_t file_offset) const;
+  const Entry* FindEntryByName(const std::string& name) const;
+  const std::vector<Entry>& GetEntries() const { return entries_; }
+
+ private:
+  // Used to check if an APK has changed since its index was built.
+  struct ApkKey {
+    uint64_t file_size = 0;
+    uint64_t mtime_ns = 0;
+    // hash of the end of the APK, which contains the end of central directory record
+    uint64_t tail_hash = 0;
+
+    bool operator==(const ApkKey& other) const {
+      return file_size == other.file_size && mtime_ns == other.mtime_ns &&
+             tail_hash == other.tail_hash;
+    }
+  };
+
+  static bool GetApkKey(const std::string& apk_path, ApkKey* key);
+
+  ApkIndex(const std::string& apk_path, const ApkKey& key, std::vector<Entry>&& entries);
+
+  const std::string apk_path_;
+  const ApkKey key_;
+  std::vector<Entry> entries_;
+  std::unordered_map<std::string_view, size_t> name_map_;
+};
+
 // APK inspector helper class
 class ApkInspector {
  public:
   static EmbeddedElf* FindElfInApkByOffset(const std::string& apk_path, uint64_t file_offset);
   static EmbeddedElf* FindElfInApkByName(const std::string& apk_path,
                                          const std::string& entry_name);
+  // Load and save APK indexes in index_dir. Empty index_dir disables it.
+  static void SetIndexDir(const std::string& index_dir) { index_dir_ = index_dir; }
 
  private:
-  static std::unique_ptr<EmbeddedElf> FindElfInApkByOffsetWithoutCache(const std::string& apk_path,
-                                                                       uint64_t file_offset);
-  static std::unique_ptr<EmbeddedElf> FindElfInApkByNameWithoutCache(const std::string& apk_path,
-                                                                     const std::string& entry_name);
-
   struct ApkNode {
     // Map from entry_offset to EmbeddedElf.
     std::unordered_map<uint64_t, std::unique_ptr<EmbeddedElf>> offset_map;
     // Map from entry_name to EmbeddedElf.
     std::unordered_map<std::string, EmbeddedElf*> name_map;
+    std::unique_ptr<ApkIndex> index;
+    bool index_loaded = false;
   };
+
+  static const ApkIndex* GetApkIndex(const std::string& apk_path, ApkNode& node);
+  static std::unique_ptr<EmbeddedElf> FindElfInApkByOffsetWithoutCache(const std::string& apk_path,
+                                                                       const ApkIndex& index,
+                                                                       uint64_t file_offset);
+  static std::unique_ptr<EmbeddedElf> FindElfInApkByNameWithoutCache(const std::string& apk_path,
+                                                                     const ApkIndex& index,
+                                                                     const std::string& entry_name);
+
   static std::unordered_map<std::string, ApkNode> embedded_elf_cache_;
+  static std::string index_dir_;
 };
 
 std::string GetUrlInApk(const std::string& apk_path, const std::string& elf_filename);
@@ -16,6 +16,7 @@
 
 #include "read_apk.h"
 
+#include <android-base/file.h>
 #include <gtest/gtest.h>
 #include "get_test_data.h"
 #include "test_util.h"
@@ -45,6 +46,43 @@ TEST(read_apk, FindElfInApkByName) {
   ASSERT_EQ(NATIVELIB_SIZE_IN_APK, ee->entry_size());
 }
 
+TEST(read_apk, ApkIndex) {
+  ASSERT_TRUE(ApkIndex::Build("/dev/null") == nullptr);
+  std::unique_ptr<ApkIndex> index = ApkIndex::Build(GetTestData(APK_FILE));
+  ASSERT_TRUE(index);
+  const ApkIndex::Entry* entry =
+      index->FindEntryByOffset(NATIVELIB_OFFSET_IN_APK + NATIVELIB_SIZE_IN_APK / 2);
+  ASSERT_TRUE(entry != nullptr);
+  ASSERT_EQ(entry->name, NATIVELIB_IN_APK);
+  ASSERT_EQ(entry, index->FindEntryByName(NATIVELIB_IN_APK));
+  ASSERT_TRUE(index->FindEntryByOffset(0) == nullptr);
+
+  // Save and load the index.
+  TemporaryFile tmpfile;
+  ASSERT_TRUE(index->Save(tmpfile.path));
+  std::unique_ptr<ApkIndex> loaded_index = ApkIndex::Load(tmpfile.path, GetTestData(APK_FILE));
+  ASSERT_TRUE(loaded_index);
+  ASSERT_EQ(loaded_index->GetEntries().size(), index->GetEntries().size());
+  entry = loaded_index->FindEntryByName(NATIVELIB_IN_APK);
+  ASSERT_TRUE(entry != nullptr);
+  ASSERT_EQ(entry->offset, NATIVELIB_OFFSET_IN_APK);
+  ASSERT_EQ(entry->size, NATIVELIB_SIZE_IN_APK);
+  // The index can't be used for another apk.
+  ASSERT_TRUE(ApkIndex::Load(tmpfile.path, GetTestData(APK_FILE) + "_copy") == nullptr);
+
+  // An index with a too large entry_count is rejected.
+  std::string data;
+  ASSERT_TRUE(android::base::ReadFileToString(tmpfile.path, &data));
+  size_t entry_count_pos =
+      8 + sizeof(uint32_t) + GetTestData(APK_FILE).size() + 3 * sizeof(uint64_t);
+  ASSERT_LT(entry_count_pos + sizeof(uint32_t), data.size());
+  uint32_t entry_count = UINT32_MAX;
+  data.replace(entry_count_pos, sizeof(entry_count), reinterpret_cast<char*>(&entry_count),
+               sizeof(entry_count));
+  ASSERT_TRUE(android::base::WriteStringToFile(data, tmpfile.path));
+  ASSERT_TRUE(ApkIndex::Load(tmpfile.path, GetTestData(APK_FILE)) == nullptr);
+}
+
 TEST(read_apk, ParseExtractedInMemoryPath) {
   std::string zip_path;
   std::string entry_name;
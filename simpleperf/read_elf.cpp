@@ -24,6 +24,7 @@
 
 #include <algorithm>
 #include <limits>
+#include <vector>
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
@@ -130,6 +131,75 @@ ElfStatus GetBuildIdFromNoteFile(const std::string& filename, BuildId* build_id)
   return ElfStatus::NO_ERROR;
 }
 
+// Only reads the elf header, the section header table and note sections, which is much cheaper
+// than mapping the whole file when scanning a large directory of binaries.
+template <typename Ehdr, typename Shdr>
+static ElfStatus GetBuildIdFromElfHeadersImpl(int fd, uint64_t file_size, BuildId* build_id) {
+  // Limit the size of note sections read, in case of malformed files.
+  static constexpr uint64_t kMaxNoteSectionSize = 64 * 1024;
+  Ehdr ehdr;
+  if (!android::base::ReadFullyAtOffset(fd, &ehdr, sizeof(ehdr), 0)) {
+    return ElfStatus::READ_FAILED;
+  }
+  if (ehdr.e_shentsize != sizeof(Shdr) || ehdr.e_shoff == 0 ||
+      ehdr.e_shoff + static_cast<uint64_t>(ehdr.e_shnum) * sizeof(Shdr) > file_size) {
+    return ElfStatus::NO_BUILD_ID;
+  }
+  std::vector<Shdr> shdrs(ehdr.e_shnum);
+  if (!android::base::ReadFullyAtOffset(fd, shdrs.data(), shdrs.size() * sizeof(Shdr),
+                                        ehdr.e_shoff)) {
+    return ElfStatus::READ_FAILED;
+  }
+  std::vector<char> data;
+  for (const Shdr& shdr : shdrs) {
+    if (shdr.sh_type != llvm::ELF::SHT_NOTE || shdr.sh_size == 0 ||
+        shdr.sh_size > kMaxNoteSectionSize || shdr.sh_offset + shdr.sh_size > file_size) {
+      continue;
+    }
+    data.resize(shdr.sh_size);
+    if (!android::base::ReadFullyAtOffset(fd, data.data(), data.size(), shdr.sh_offset)) {
+      return ElfStatus::READ_FAILED;
+    }
+    if (GetBuildIdFromNoteSection(data.data(), data.size(), build_id)) {
+      return ElfStatus::NO_ERROR;
+    }
+  }
+  return ElfStatus::NO_BUILD_ID;
+}
+
+ElfStatus GetBuildIdFromElfHeaders(const std::string& filename, BuildId* build_id) {
+  if (!IsRegularFile(filename)) {
+    return ElfStatus::FILE_NOT_FOUND;
+  }
+  android::base::unique_fd fd = FileHelper::OpenReadOnly(filename);
+  if (fd == -1) {
+    return ElfStatus::READ_FAILED;
+  }
+  char ident[llvm::ELF::EI_NIDENT];
+  if (!android::base::ReadFullyAtOffset(fd, ident, sizeof(ident), 0)) {
+    return ElfStatus::READ_FAILED;
+  }
+  if (!IsValidElfFileMagic(ident, sizeof(ident))) {
+    return ElfStatus::FILE_MALFORMED;
+  }
+  if (ident[llvm::ELF::EI_DATA] != llvm::ELF::ELFDATA2LSB) {
+    // Headers are read in host byte order. Leave other files to llvm.
+    ElfStatus status;
+    auto elf = ElfFile::Open(filename, &status);
+    return elf ? elf->GetBuildId(build_id) : status;
+  }
+  uint64_t file_size = GetFileSize(filename);
+  if (ident[llvm::ELF::EI_CLASS] == llvm::ELF::ELFCLASS64) {
+    return GetBuildIdFromElfHeadersImpl<llvm::ELF::Elf64_Ehdr, llvm::ELF::Elf64_Shdr>(
+        fd, file_size, build_id);
+  }
+  if (ident[llvm::ELF::EI_CLASS] == llvm::ELF::ELFCLASS32) {
+    return GetBuildIdFromElfHeadersImpl<llvm::ELF::Elf32_Ehdr, llvm::ELF::Elf32_Shdr>(
+        fd, file_size, build_id);
+  }
+  return ElfStatus::FILE_MALFORMED;
+}
+
 bool IsArmMappingSymbol(const char* name) {
   // Mapping symbols in arm, which are described in "ELF for ARM Architecture" and
   // "ELF for ARM 64-bit Architecture". The regular expression to match mapping symbol
@@ -46,6 +46,9 @@ enum class ElfStatus {
 std::ostream& operator<<(std::ostream& os, const ElfStatus& status);
 
 ElfStatus GetBuildIdFromNoteFile(const std::string& filename, BuildId* build_id);
+// Get the build id of an elf file by reading only its headers and note sections. It is used to
+// index a large number of files. Like ElfFile::GetBuildId(), it doesn't support embedded elf files.
+ElfStatus GetBuildIdFromElfHeaders(const std::string& filename, BuildId* build_id);
 
 // The symbol prefix used to indicate that the symbol belongs to android linker.
 static const std::string linker_prefix = "__dl_";
@@ -71,6 +71,16 @@ TEST(read_elf, GetBuildIdFromElfFile) {
   ASSERT_EQ(build_id, BuildId(elf_file_build_id));
 }
 
+TEST(read_elf, GetBuildIdFromElfHeaders) {
+  BuildId build_id;
+  ASSERT_EQ(ElfStatus::NO_ERROR, GetBuildIdFromElfHeaders(GetTestData(ELF_FILE), &build_id));
+  ASSERT_EQ(build_id, BuildId(elf_file_build_id));
+  ASSERT_EQ(ElfStatus::FILE_MALFORMED,
+            GetBuildIdFromElfHeaders(GetTestData(PERF_DATA_WITH_SYMBOLS), &build_id));
+  ASSERT_EQ(ElfStatus::FILE_NOT_FOUND,
+            GetBuildIdFromElfHeaders(GetTestData("file_not_exist"), &build_id));
+}
+
 TEST(read_elf, GetBuildIdFromEmbeddedElfFile) {
   BuildId build_id;
   ElfStatus status;
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <memory>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "benchmark_util.h"
+#include "event_attr.h"
+#include "event_type.h"
+#include "get_test_data.h"
+#include "record.h"
+#include "record_file.h"
+#include "utils.h"
+
+using namespace simpleperf;
+
+// Parse a buffer of sample records, which is what happens for each mmap buffer read in
+// `simpleperf record` and for each record read by RecordFileReader.
+static void BM_ReadRecordFromBuffer(benchmark::State& state) {
+  size_t sample_count = state.range(0);
+  size_t callchain_depth = state.range(1);
+  std::unique_ptr<EventTypeAndModifier> event_type = ParseEventType("cpu-cycles");
+  perf_event_attr attr = CreateDefaultPerfEventAttr(event_type->event_type);
+  attr.sample_id_all = 1;
+  if (callchain_depth > 0) {
+    attr.sample_type |= PERF_SAMPLE_CALLCHAIN;
+  }
+  std::vector<char> buf;
+  for (auto& r : GenerateSyntheticSamples(attr, sample_count, callchain_depth)) {
+    buf.insert(buf.end(), r->Binary(), r->Binary() + r->size());
+  }
+
+  for (auto _ : state) {
+    char* p = buf.data();
+    char* end = p + buf.size();
+    size_t records = 0;
+    while (p < end) {
+      std::unique_ptr<Record> r = ReadRecordFromBuffer(attr, p, end);
+      if (!r) {
+        state.SkipWithError("failed to parse record");
+        return;
+      }
+      p += r->size();
+      records++;
+    }
+    benchmark::DoNotOptimize(records);
+  }
+  state.SetItemsProcessed(state.iterations() * sample_count);
+  state.SetBytesProcessed(state.iterations() * buf.size());
+}
+BENCHMARK(BM_ReadRecordFromBuffer)->Apply(SyntheticPerfDataArgs);
+
+static bool ReadAllRecords(const std::string& path, size_t* record_count) {
+  std::unique_ptr<RecordFileReader> reader = RecordFileReader::CreateInstance(path);
+  if (!reader) {
+    return false;
+  }
+  *record_count = 0;
+  auto callback = [&](std::unique_ptr<Record> r) {
+    benchmark::DoNotOptimize(r.get());
+    (*record_count)++;
+    return true;
+  };
+  return reader->ReadDataSection(callback);
+}
+
+static void RecordFileReaderBenchmark(benchmark::State& state, const std::string& path) {
+  if (path.empty()) {
+    state.SkipWithError("failed to get perf.data");
+    return;
+  }
+  size_t record_count = 0;
+  for (auto _ : state) {
+    if (!ReadAllRecords(path, &record_count)) {
+      state.SkipWithError("failed to read perf.data");
+      return;
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * record_count);
+  state.SetBytesProcessed(state.iterations() * GetFileSize(path));
+}
+
+static void BM_RecordFileReader(benchmark::State& state) {
+  RecordFileReaderBenchmark(state, GetSyntheticPerfData(state.range(0), state.range(1)));
+}
+BENCHMARK(BM_RecordFileReader)->Apply(SyntheticPerfDataArgs)->Unit(benchmark::kMillisecond);
+
+static void BM_RecordFileReader_testdata(benchmark::State& state) {
+  RecordFileReaderBenchmark(state, GetTestData(PERF_DATA_WITH_MULTIPLE_PIDS_AND_TIDS));
+}
+BENCHMARK(BM_RecordFileReader_testdata)->Unit(benchmark::kMicrosecond);
@@ -84,6 +84,8 @@ class RecordFileWriter {
   bool WriteAttrSection(const EventAttrIds& attr_ids);
   bool WriteRecord(const Record& record);
   bool WriteData(const void* buf, size_t len);
+  // Make written records visible to readers following the record file.
+  bool Flush();
 
   uint64_t GetDataSectionSize() const { return data_section_size_; }
   bool ReadDataSection(const std::function<void(const Record*)>& callback);
@@ -137,8 +139,20 @@ class RecordFileReader {
  public:
   static std::unique_ptr<RecordFileReader> CreateInstance(const std::string& filename);
 
+  // Open a record file which may still be written by `simpleperf record`. While the recording is
+  // in progress, ReadRecord() and ReadDataSection() wait for new records instead of stopping at
+  // the end of the file. They stop when the recording finishes, when the file is replaced, or when
+  // the callback set by SetFollowWaitCallback() returns false.
+  static std::unique_ptr<RecordFileReader> CreateInstanceForFollowing(const std::string& filename);
+
   ~RecordFileReader();
 
+  // In follow mode, [callback] is called each time before waiting for new data.
+  void SetFollowWaitCallback(std::function<bool()> callback) {
+    follow_wait_callback_ = std::move(callback);
+  }
+  bool IsFollowing() const { return following_; }
+
   const PerfFileFormat::FileHeader& FileHeader() const { return header_; }
 
   const EventAttrIds& AttrSection() const { return event_attrs_; }
@@ -203,6 +217,11 @@ class RecordFileReader {
  private:
   RecordFileReader(const std::string& filename, FILE* fp);
   bool ReadHeader();
+  bool WaitForFileHeader();
+  bool WaitForNextRecord();
+  bool WaitForFileSize(uint64_t size);
+  bool UpdateFollowState();
+  void StopFollowing();
   bool CheckSectionDesc(const PerfFileFormat::SectionDesc& desc, uint64_t min_offset,
                         uint64_t alignment = 1);
   bool ReadAttrSection();
@@ -230,6 +249,9 @@ class RecordFileReader {
   size_t event_id_reverse_pos_in_non_sample_records_;
 
   uint64_t read_record_size_;
+  // True when following a record file which is still being written.
+  bool following_ = false;
+  std::function<bool()> follow_wait_callback_;
 
   std::unordered_map<std::string, std::string> meta_info_;
   std::unique_ptr<ScopedCurrentArch> scoped_arch_;
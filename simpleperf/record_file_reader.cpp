@@ -18,11 +18,15 @@
 
 #include <fcntl.h>
 #include <string.h>
+#include <sys/stat.h>
 
+#include <chrono>
 #include <set>
 #include <string_view>
+#include <thread>
 #include <vector>
 
+#include <android-base/file.h>
 #include <android-base/logging.h>
 
 #include "event_attr.h"
@@ -95,6 +99,44 @@ std::unique_ptr<RecordFileReader> RecordFileReader::CreateInstance(const std::st
   return reader;
 }
 
+// How often to check a followed record file for new data.
+static constexpr std::chrono::milliseconds kFollowPollInterval(50);
+
+// RecordFileWriter writes a header with an empty data section and no features when starting a
+// recording, and writes the complete header when the recording finishes.
+static bool IsRecordingInProgress(const FileHeader& header) {
+  if (header.data.size != 0) {
+    return false;
+  }
+  for (size_t i = 0; i < sizeof(header.features); i++) {
+    if (header.features[i] != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::unique_ptr<RecordFileReader> RecordFileReader::CreateInstanceForFollowing(
+    const std::string& filename) {
+  std::string mode = std::string("rb") + CLOSE_ON_EXEC_MODE;
+  FILE* fp = fopen(filename.c_str(), mode.c_str());
+  if (fp == nullptr) {
+    PLOG(ERROR) << "failed to open record file '" << filename << "'";
+    return nullptr;
+  }
+  auto reader = std::unique_ptr<RecordFileReader>(new RecordFileReader(filename, fp));
+  if (!reader->WaitForFileHeader() || !reader->ReadHeader()) {
+    return nullptr;
+  }
+  reader->following_ = IsRecordingInProgress(reader->header_);
+  if (!reader->ReadAttrSection() || !reader->ReadFeatureSectionDescriptors() ||
+      !reader->ReadMetaInfoFeature()) {
+    return nullptr;
+  }
+  reader->UseRecordingEnvironment();
+  return reader;
+}
+
 RecordFileReader::RecordFileReader(const std::string& filename, FILE* fp)
     : filename_(filename),
       record_fp_(fp),
@@ -136,6 +178,155 @@ bool RecordFileReader::ReadHeader() {
   return true;
 }
 
+// The record file is created before the attr section is written, and the header is zero until
+// then. So wait until the header appears.
+bool RecordFileReader::WaitForFileHeader() {
+  while (true) {
+    struct stat st;
+    if (fstat(fileno(record_fp_), &st) != 0) {
+      PLOG(ERROR) << "failed to stat " << filename_;
+      return false;
+    }
+    file_size_ = st.st_size;
+    if (file_size_ >= sizeof(header_)) {
+      if (!android::base::ReadFullyAtOffset(fileno(record_fp_), &header_, sizeof(header_), 0)) {
+        PLOG(ERROR) << "failed to read file " << filename_;
+        return false;
+      }
+      if (memcmp(header_.magic, PERF_MAGIC, sizeof(header_.magic)) == 0) {
+        return true;
+      }
+      static const char zero_magic[sizeof(header_.magic)] = {};
+      if (memcmp(header_.magic, zero_magic, sizeof(header_.magic)) != 0) {
+        LOG(ERROR) << filename_ << " is not a valid profiling record file.";
+        return false;
+      }
+    }
+    std::this_thread::sleep_for(kFollowPollInterval);
+  }
+}
+
+// Wait until the next record is completely written. The next record may be split into several
+// SPLIT records, and an AUXTRACE record is followed by aux data.
+bool RecordFileReader::WaitForNextRecord() {
+  uint64_t end = header_.data.offset + read_record_size_;
+  int fd = fileno(record_fp_);
+  while (true) {
+    if (!WaitForFileSize(end + Record::header_size())) {
+      return false;
+    }
+    if (!following_) {
+      return true;
+    }
+    char header_buf[Record::header_size()];
+    RecordHeader header;
+    if (!android::base::ReadFullyAtOffset(fd, header_buf, sizeof(header_buf), end) ||
+        !header.Parse(header_buf)) {
+      LOG(ERROR) << "failed to read record header in " << filename_;
+      return false;
+    }
+    uint64_t record_start = end;
+    end += header.size;
+    if (header.type == PERF_RECORD_AUXTRACE) {
+      if (header.size < AuxTraceRecord::Size()) {
+        LOG(ERROR) << "invalid auxtrace record in " << filename_;
+        return false;
+      }
+      if (!WaitForFileSize(end)) {
+        return false;
+      }
+      if (!following_) {
+        return true;
+      }
+      uint64_t aux_size;
+      if (!android::base::ReadFullyAtOffset(fd, &aux_size, sizeof(aux_size),
+                                            record_start + Record::header_size())) {
+        PLOG(ERROR) << "failed to read file " << filename_;
+        return false;
+      }
+      end += aux_size;
+    }
+    if (header.type != SIMPLE_PERF_RECORD_SPLIT) {
+      break;
+    }
+  }
+  return WaitForFileSize(end);
+}
+
+// Wait until the file has [size] bytes, or following stops.
+bool RecordFileReader::WaitForFileSize(uint64_t size) {
+  while (following_) {
+    if (!UpdateFollowState()) {
+      return false;
+    }
+    if (!following_ || size <= file_size_) {
+      break;
+    }
+    if (follow_wait_callback_ && !follow_wait_callback_()) {
+      StopFollowing();
+      break;
+    }
+    std::this_thread::sleep_for(kFollowPollInterval);
+  }
+  return true;
+}
+
+// Update file size, and check if the recording has finished or the file has been replaced.
+bool RecordFileReader::UpdateFollowState() {
+  struct stat st;
+  if (fstat(fileno(record_fp_), &st) != 0) {
+    PLOG(ERROR) << "failed to stat " << filename_;
+    return false;
+  }
+  file_size_ = st.st_size;
+  if (file_size_ < sizeof(header_)) {
+    return true;
+  }
+#if !defined(_WIN32)
+  struct stat path_st;
+  if (stat(filename_.c_str(), &path_st) != 0 || path_st.st_dev != st.st_dev ||
+      path_st.st_ino != st.st_ino) {
+    // simpleperf record may move the file when post-processing records.
+    LOG(WARNING) << filename_ << " has been replaced, stop following it";
+    StopFollowing();
+    return true;
+  }
+#endif
+  FileHeader header;
+  if (!android::base::ReadFullyAtOffset(fileno(record_fp_), &header, sizeof(header), 0)) {
+    PLOG(ERROR) << "failed to read file " << filename_;
+    return false;
+  }
+  if (IsRecordingInProgress(header)) {
+    return true;
+  }
+  // The recording has finished. Switch to the complete header, to read the rest of the data
+  // section and the feature section.
+  following_ = false;
+  if (memcmp(header.magic, PERF_MAGIC, sizeof(header.magic)) != 0 ||
+      header.data.offset != header_.data.offset || header.data.size < read_record_size_) {
+    LOG(ERROR) << "invalid header in " << filename_;
+    return false;
+  }
+  header_ = header;
+  if (!CheckSectionDesc(header_.data, sizeof(header_)) || !ReadFeatureSectionDescriptors() ||
+      !ReadMetaInfoFeature()) {
+    LOG(ERROR) << "invalid header in " << filename_;
+    return false;
+  }
+  if (fseek(record_fp_, header_.data.offset + read_record_size_, SEEK_SET) != 0) {
+    PLOG(ERROR) << "fseek() failed";
+    return false;
+  }
+  return true;
+}
+
+// End the data section at the records already read.
+void RecordFileReader::StopFollowing() {
+  following_ = false;
+  header_.data.size = read_record_size_;
+}
+
 bool RecordFileReader::CheckSectionDesc(const SectionDesc& desc, uint64_t min_offset,
                                         uint64_t alignment) {
   uint64_t desc_end;
@@ -286,7 +477,10 @@ bool RecordFileReader::ReadRecord(std::unique_ptr<Record>& record) {
     }
   }
   record = nullptr;
-  if (read_record_size_ < header_.data.size) {
+  if (following_ && !WaitForNextRecord()) {
+    return false;
+  }
+  if (following_ || read_record_size_ < header_.data.size) {
     record = ReadRecord();
     if (record == nullptr) {
       return false;
@@ -254,4 +254,57 @@ TEST_F(RecordFileTest, write_file2_feature_section) {
   }
   ASSERT_FALSE(error);
   ASSERT_EQ(file_id, files.size());
-}
\ No newline at end of file
+}
+
+TEST_F(RecordFileTest, follow_record_file) {
+  std::unique_ptr<RecordFileWriter> writer = RecordFileWriter::CreateInstance(tmpfile_.path);
+  ASSERT_TRUE(writer != nullptr);
+  AddEventType("cpu-clock");
+  ASSERT_TRUE(writer->WriteAttrSection(attr_ids_));
+  MmapRecord r1(attr_ids_[0].attr, true, 1, 1, 0x1000, 0x2000, 0x3000, "mmap1", 0);
+  MmapRecord r2(attr_ids_[0].attr, true, 1, 1, 0x4000, 0x2000, 0x3000, "mmap2", 0);
+  ASSERT_TRUE(writer->WriteRecord(r1));
+  ASSERT_TRUE(writer->Flush());
+
+  std::unique_ptr<RecordFileReader> reader =
+      RecordFileReader::CreateInstanceForFollowing(tmpfile_.path);
+  ASSERT_TRUE(reader);
+  ASSERT_TRUE(reader->IsFollowing());
+  ASSERT_EQ(reader->AttrSection().size(), 1u);
+
+  // Write more records and finish the recording while the reader is waiting.
+  size_t wait_count = 0;
+  reader->SetFollowWaitCallback([&]() {
+    wait_count++;
+    if (wait_count == 1) {
+      return writer->WriteRecord(r2) && writer->Flush();
+    }
+    return writer->BeginWriteFeatures(1) && writer->WriteFeatureString(FEAT_OSRELEASE, "6.1") &&
+           writer->EndWriteFeatures() && writer->Close();
+  });
+  std::vector<std::unique_ptr<Record>> records = reader->DataSection();
+  ASSERT_EQ(records.size(), 2u);
+  CheckRecordEqual(r1, *records[0]);
+  CheckRecordEqual(r2, *records[1]);
+  ASSERT_EQ(wait_count, 2u);
+  ASSERT_FALSE(reader->IsFollowing());
+  ASSERT_EQ(reader->ReadFeatureString(FEAT_OSRELEASE), "6.1");
+}
+
+TEST_F(RecordFileTest, stop_following_record_file) {
+  std::unique_ptr<RecordFileWriter> writer = RecordFileWriter::CreateInstance(tmpfile_.path);
+  ASSERT_TRUE(writer != nullptr);
+  AddEventType("cpu-clock");
+  ASSERT_TRUE(writer->WriteAttrSection(attr_ids_));
+  MmapRecord r1(attr_ids_[0].attr, true, 1, 1, 0x1000, 0x2000, 0x3000, "mmap1", 0);
+  ASSERT_TRUE(writer->WriteRecord(r1));
+  ASSERT_TRUE(writer->Flush());
+
+  std::unique_ptr<RecordFileReader> reader =
+      RecordFileReader::CreateInstanceForFollowing(tmpfile_.path);
+  ASSERT_TRUE(reader);
+  reader->SetFollowWaitCallback([]() { return false; });
+  std::vector<std::unique_ptr<Record>> records = reader->DataSection();
+  ASSERT_EQ(records.size(), 1u);
+  ASSERT_FALSE(reader->IsFollowing());
+}
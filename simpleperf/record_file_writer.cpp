@@ -122,7 +122,13 @@ bool RecordFileWriter::WriteAttrSection(const EventAttrIds& attr_ids) {
 
   // Save event_attr for use when reading records.
   event_attr_ = attr_ids[0].attr;
-  return true;
+
+  // Write a header with an empty data section, so readers following the recording can find the
+  // attr section and the data section. The complete header is written in Close().
+  if (!WriteFileHeader() || fseek(record_fp_, data_section_offset_, SEEK_SET) == -1) {
+    return false;
+  }
+  return Flush();
 }
 
 bool RecordFileWriter::WriteRecord(const Record& record) {
@@ -480,6 +486,14 @@ bool RecordFileWriter::EndWriteFeatures() {
   return true;
 }
 
+bool RecordFileWriter::Flush() {
+  if (fflush(record_fp_) != 0) {
+    PLOG(ERROR) << "failed to flush record file '" << filename_ << "'";
+    return false;
+  }
+  return true;
+}
+
 bool RecordFileWriter::WriteFileHeader() {
   FileHeader header;
   memset(&header, 0, sizeof(header));
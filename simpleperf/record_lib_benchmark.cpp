@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "include/simpleperf.h"
+
+#include <unistd.h>
+
+#include <memory>
+
+#include <android-base/file.h>
+#include <benchmark/benchmark.h>
+
+using namespace simpleperf;
+
+// Measure the latency of wrapping a code region with PauseRecording()/ResumeRecording(), which
+// should only cost the ioctls enabling/disabling the perf event files.
+static void BM_PerfEventSet_PauseResumeRecording(benchmark::State& state) {
+  std::unique_ptr<PerfEventSet> perf(
+      PerfEventSet::CreateInstance(PerfEventSet::Type::kPerfForRecording));
+  TemporaryFile tmpfile;
+  close(tmpfile.release());
+  if (!perf || !perf->AddEvent("cpu-clock") || !perf->EnableFpCallChain() ||
+      !perf->MonitorCurrentThread() || !perf->StartRecording(tmpfile.path)) {
+    state.SkipWithError("failed to start recording");
+    return;
+  }
+  for (auto _ : state) {
+    perf->ResumeRecording();
+    perf->PauseRecording();
+  }
+  perf->StopRecording();
+}
+BENCHMARK(BM_PerfEventSet_PauseResumeRecording);
+
+// For comparison, the latency of wrapping a code region with StartCounters()/StopCounters(),
+// which read the counters each time.
+static void BM_PerfEventSet_StartStopCounters(benchmark::State& state) {
+  std::unique_ptr<PerfEventSet> perf(
+      PerfEventSet::CreateInstance(PerfEventSet::Type::kPerfForCounting));
+  if (!perf || !perf->AddEvent("cpu-clock") || !perf->MonitorCurrentThread()) {
+    state.SkipWithError("failed to create PerfEventSet");
+    return;
+  }
+  for (auto _ : state) {
+    perf->StartCounters();
+    perf->StopCounters();
+  }
+}
+BENCHMARK(BM_PerfEventSet_StartStopCounters);
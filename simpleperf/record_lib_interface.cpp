@@ -17,18 +17,31 @@
 #define SIMPLEPERF_EXPORT __attribute__((visibility("default")))
 #include "include/simpleperf.h"
 
+#include <fcntl.h>
+#include <sys/utsname.h>
+#include <time.h>
+#include <unistd.h>
+
 #include <memory>
 #include <set>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
+#include <android-base/file.h>
 #include <android-base/logging.h>
+#include <android-base/unique_fd.h>
 
+#include "IOEventLoop.h"
+#include "MapRecordReader.h"
 #include "environment.h"
 #include "event_attr.h"
 #include "event_fd.h"
 #include "event_selection_set.h"
 #include "event_type.h"
+#include "record_file.h"
+#include "utils.h"
 
 namespace simpleperf {
 
@@ -256,6 +269,245 @@ bool PerfEventSetForCounting::ReadCounters(std::vector<Counter>* counters) {
   return true;
 }
 
+// Buffer sizes are smaller than those used by `simpleperf record`, because the buffers live in
+// the profiled process.
+static constexpr size_t kMinMmapPages = 4;
+static constexpr size_t kMaxMmapPages = 64;
+static constexpr size_t kRecordBufferSize = 4 * kMegabyte;
+
+class PerfEventSetForRecording : public PerfEventSetImpl {
+ public:
+  PerfEventSetForRecording() {}
+  virtual ~PerfEventSetForRecording() {
+    if (event_selection_set_) {
+      StopRecording();
+    }
+  }
+
+  bool SetSampleFrequency(uint64_t freq) override;
+  bool EnableFpCallChain() override;
+  bool StartRecording(const std::string& output_filename) override;
+  bool PauseRecording() override;
+  bool ResumeRecording() override;
+  bool StopRecording() override;
+
+ private:
+  bool CreateEventSelectionSet();
+  bool DumpMaps();
+  bool ProcessRecord(Record* r);
+  bool StartWriterThread();
+  bool StopWriterThread();
+  bool WriteFeatures();
+
+  uint64_t sample_freq_ = 0;
+  bool fp_callchain_ = false;
+  // Clock used by the recorded events, written to the meta info as "clockid".
+  std::string clockid_ = "perf";
+  std::unique_ptr<EventSelectionSet> event_selection_set_;
+  std::unique_ptr<RecordFileWriter> record_file_writer_;
+  // The writer thread runs the IOEventLoop of event_selection_set_, which moves records from
+  // the RecordReadThread to the record file. It exits when a byte is written to stop_write_fd_.
+  std::thread writer_thread_;
+  bool writer_thread_result_ = false;
+  android::base::unique_fd stop_read_fd_;
+  android::base::unique_fd stop_write_fd_;
+};
+
+bool PerfEventSetForRecording::SetSampleFrequency(uint64_t freq) {
+  if (event_selection_set_ || freq == 0) {
+    return false;
+  }
+  sample_freq_ = freq;
+  return true;
+}
+
+bool PerfEventSetForRecording::EnableFpCallChain() {
+  if (event_selection_set_) {
+    return false;
+  }
+  fp_callchain_ = true;
+  return true;
+}
+
+bool PerfEventSetForRecording::CreateEventSelectionSet() {
+  std::unique_ptr<EventSelectionSet> set(new EventSelectionSet(false));
+  if (event_names_.empty()) {
+    LOG(ERROR) << "No events.";
+    return false;
+  }
+  for (const auto& name : event_names_) {
+    size_t group_id;
+    if (!set->AddEventType(name, &group_id)) {
+      return false;
+    }
+    if (sample_freq_ != 0) {
+      set->SetSampleSpeed(group_id, SampleSpeed(sample_freq_, 0));
+    }
+  }
+  if (fp_callchain_) {
+    set->EnableFpCallChainSampling();
+  }
+  set->SampleIdAll();
+  // Use the same clock as `simpleperf record`, so samples can be matched with app events.
+  if (IsSettingClockIdSupported()) {
+    set->SetClockId(CLOCK_MONOTONIC);
+    clockid_ = "monotonic";
+  }
+  std::vector<int> cpus;
+  if (whole_process_) {
+    set->AddMonitoredProcesses({getpid()});
+  } else {
+    if (threads_.empty()) {
+      LOG(ERROR) << "No monitored threads.";
+      return false;
+    }
+    set->AddMonitoredThreads(threads_);
+    if (threads_.size() == 1) {
+      // For a single thread, open one event file per event on any cpu. So they can share one
+      // mapped buffer, and pausing/resuming only needs one ioctl per event. Event files of
+      // different threads can't share a buffer unless they are bound to the same cpu.
+      set->SetInherit(false);
+      cpus.push_back(-1);
+    }
+  }
+  // An empty cpu list means all online cpus.
+  if (!set->OpenEventFiles(cpus)) {
+    return false;
+  }
+  if (!set->MmapEventFiles(kMinMmapPages, kMaxMmapPages, 0, kRecordBufferSize, true, false)) {
+    return false;
+  }
+  event_selection_set_ = std::move(set);
+  return true;
+}
+
+bool PerfEventSetForRecording::DumpMaps() {
+  EventAttrIds attrs = event_selection_set_->GetEventAttrWithId();
+  CHECK(!attrs.empty() && !attrs[0].ids.empty());
+  MapRecordReader reader(attrs[0].attr, attrs[0].ids[0],
+                         event_selection_set_->RecordNotExecutableMaps());
+  reader.SetCallback([this](Record* r) { return ProcessRecord(r); });
+  return reader.ReadProcessMaps(getpid(), 0);
+}
+
+bool PerfEventSetForRecording::ProcessRecord(Record* r) {
+  return record_file_writer_->WriteRecord(*r);
+}
+
+bool PerfEventSetForRecording::StartWriterThread() {
+  if (!android::base::Pipe(&stop_read_fd_, &stop_write_fd_, O_CLOEXEC)) {
+    PLOG(ERROR) << "pipe";
+    return false;
+  }
+  IOEventLoop* loop = event_selection_set_->GetIOEventLoop();
+  if (!loop->AddReadEvent(stop_read_fd_, [loop]() { return loop->ExitLoop(); })) {
+    return false;
+  }
+  writer_thread_ = std::thread([this, loop]() { writer_thread_result_ = loop->RunLoop(); });
+  return true;
+}
+
+bool PerfEventSetForRecording::StopWriterThread() {
+  bool result = true;
+  char c = 0;
+  if (TEMP_FAILURE_RETRY(write(stop_write_fd_, &c, 1)) != 1) {
+    PLOG(ERROR) << "failed to stop the writer thread";
+    // Closing the write end also makes stop_read_fd_ readable, so the writer thread still exits.
+    stop_write_fd_.reset();
+    result = false;
+  }
+  writer_thread_.join();
+  return result && writer_thread_result_;
+}
+
+bool PerfEventSetForRecording::StartRecording(const std::string& output_filename) {
+  if (event_selection_set_) {
+    LOG(ERROR) << "Recording is already started.";
+    return false;
+  }
+  if (!CreateEventSelectionSet()) {
+    return false;
+  }
+  record_file_writer_ = RecordFileWriter::CreateInstance(output_filename);
+  if (!record_file_writer_ ||
+      !record_file_writer_->WriteAttrSection(event_selection_set_->GetEventAttrWithId()) ||
+      !DumpMaps() ||
+      !event_selection_set_->PrepareToReadMmapEventData(
+          [this](Record* r) { return ProcessRecord(r); }) ||
+      !StartWriterThread()) {
+    record_file_writer_.reset();
+    event_selection_set_.reset();
+    return false;
+  }
+  return true;
+}
+
+bool PerfEventSetForRecording::PauseRecording() {
+  return event_selection_set_ && event_selection_set_->SetEnableEvents(false);
+}
+
+bool PerfEventSetForRecording::ResumeRecording() {
+  return event_selection_set_ && event_selection_set_->SetEnableEvents(true);
+}
+
+bool PerfEventSetForRecording::StopRecording() {
+  if (!event_selection_set_) {
+    LOG(ERROR) << "Recording isn't started.";
+    return false;
+  }
+  bool result = event_selection_set_->SetEnableEvents(false);
+  result &= StopWriterThread();
+  // Flush samples left in kernel buffers and the record buffer.
+  result = result && event_selection_set_->SyncKernelBuffer() &&
+           event_selection_set_->FinishReadMmapEventData();
+  event_selection_set_->CloseEventFiles();
+  result = result && WriteFeatures() && record_file_writer_->Close();
+  record_file_writer_.reset();
+  event_selection_set_.reset();
+  return result;
+}
+
+bool PerfEventSetForRecording::WriteFeatures() {
+  // No build id or file features are written, so the recording is reported with binaries on the
+  // device, like a recording made with `simpleperf record --no-dump-symbols`.
+  if (!record_file_writer_->BeginWriteFeatures(4)) {
+    return false;
+  }
+  utsname uname_buf;
+  if (TEMP_FAILURE_RETRY(uname(&uname_buf)) != 0) {
+    PLOG(ERROR) << "uname() failed";
+    return false;
+  }
+  if (!record_file_writer_->WriteFeatureString(PerfFileFormat::FEAT_OSRELEASE,
+                                               uname_buf.release) ||
+      !record_file_writer_->WriteFeatureString(PerfFileFormat::FEAT_ARCH, uname_buf.machine)) {
+    return false;
+  }
+  std::vector<std::string> cmdline = {android::base::GetExecutablePath(), "record"};
+  for (const auto& name : event_names_) {
+    cmdline.insert(cmdline.end(), {"-e", name});
+  }
+  if (sample_freq_ != 0) {
+    cmdline.insert(cmdline.end(), {"-f", std::to_string(sample_freq_)});
+  }
+  if (fp_callchain_) {
+    cmdline.insert(cmdline.end(), {"--call-graph", "fp"});
+  }
+  if (!record_file_writer_->WriteCmdlineFeature(cmdline)) {
+    return false;
+  }
+  std::unordered_map<std::string, std::string> info_map;
+  info_map["simpleperf_version"] = GetSimpleperfVersion();
+  info_map["event_type_info"] = ScopedEventTypes::BuildString(event_selection_set_->GetEvents());
+  info_map["recording_process"] = std::to_string(getpid());
+  info_map["clockid"] = clockid_;
+  info_map["timestamp"] = std::to_string(time(nullptr));
+  if (!record_file_writer_->WriteMetaInfoFeature(info_map)) {
+    return false;
+  }
+  return record_file_writer_->EndWriteFeatures();
+}
+
 PerfEventSet* PerfEventSet::CreateInstance(PerfEventSet::Type type) {
   if (!CheckPerfEventLimit()) {
     return nullptr;
@@ -263,6 +515,9 @@ PerfEventSet* PerfEventSet::CreateInstance(PerfEventSet::Type type) {
   if (type == Type::kPerfForCounting) {
     return new PerfEventSetForCounting;
   }
+  if (type == Type::kPerfForRecording) {
+    return new PerfEventSetForRecording;
+  }
   return nullptr;
 }
 
@@ -294,4 +549,28 @@ bool PerfEventSet::ReadCounters(std::vector<Counter>*) {
   return false;
 }
 
+bool PerfEventSet::SetSampleFrequency(uint64_t) {
+  return false;
+}
+
+bool PerfEventSet::EnableFpCallChain() {
+  return false;
+}
+
+bool PerfEventSet::StartRecording(const std::string&) {
+  return false;
+}
+
+bool PerfEventSet::PauseRecording() {
+  return false;
+}
+
+bool PerfEventSet::ResumeRecording() {
+  return false;
+}
+
+bool PerfEventSet::StopRecording() {
+  return false;
+}
+
 }  // namespace simpleperf
@@ -17,8 +17,15 @@
 #include "simpleperf.h"
 
 #include <gtest/gtest.h>
+#include <linux/perf_event.h>
+#include <string.h>
+#include <time.h>
 
+#include <algorithm>
 #include <memory>
+#include <unordered_map>
+
+#include <android-base/file.h>
 
 using namespace simpleperf;
 
@@ -141,3 +148,198 @@ TEST(counter, no_change_after_stop) {
   ASSERT_EQ(counters[0].time_enabled_in_ns, prev_counter.time_enabled_in_ns);
   ASSERT_EQ(counters[0].time_running_in_ns, prev_counter.time_running_in_ns);
 }
+
+static uint64_t GetMonotonicClock() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Read timestamps of samples in a recording made by PerfEventSet. libsimpleperf_record doesn't
+// export the record file reader, so parse the file here. It has the layout in
+// record_file_format.h, with one event type. Set *monotonic if the timestamps use
+// CLOCK_MONOTONIC.
+static void ReadSampleTimestamps(const std::string& path, std::vector<uint64_t>* timestamps,
+                                 bool* monotonic) {
+  std::string data;
+  ASSERT_TRUE(android::base::ReadFileToString(path, &data));
+  ASSERT_GE(data.size(), 56u);
+  ASSERT_EQ(data.compare(0, 8, "PERFILE2"), 0);
+  auto read_u64 = [&](size_t offset) {
+    uint64_t value;
+    memcpy(&value, data.data() + offset, sizeof(value));
+    return value;
+  };
+  // FileHeader: magic, header_size, attr_size, attrs, data, ...
+  uint64_t attr_size = read_u64(16);
+  uint64_t attr_offset = read_u64(24);
+  uint64_t data_offset = read_u64(40);
+  uint64_t data_size = read_u64(48);
+  // Each FileAttr has a perf_event_attr and a 16-byte id section.
+  ASSERT_GT(attr_size, 16u);
+  ASSERT_LE(attr_offset + attr_size, data.size());
+  ASSERT_LE(data_offset + data_size, data.size());
+  perf_event_attr attr = {};
+  memcpy(&attr, data.data() + attr_offset, std::min<uint64_t>(sizeof(attr), attr_size - 16));
+  ASSERT_TRUE(attr.sample_type & PERF_SAMPLE_TIME);
+  *monotonic = attr.use_clockid && attr.clockid == CLOCK_MONOTONIC;
+
+  // Fields before the timestamp in a sample record.
+  size_t time_offset = sizeof(perf_event_header);
+  for (uint64_t type : {PERF_SAMPLE_IDENTIFIER, PERF_SAMPLE_IP, PERF_SAMPLE_TID}) {
+    if (attr.sample_type & type) {
+      time_offset += sizeof(uint64_t);
+    }
+  }
+  timestamps->clear();
+  const char* p = data.data() + data_offset;
+  const char* end = p + data_size;
+  while (p < end) {
+    perf_event_header header;
+    ASSERT_GE(static_cast<size_t>(end - p), sizeof(header));
+    memcpy(&header, p, sizeof(header));
+    ASSERT_GE(static_cast<size_t>(header.size), sizeof(header));
+    ASSERT_LE(static_cast<size_t>(header.size), static_cast<size_t>(end - p));
+    if (header.type == PERF_RECORD_SAMPLE) {
+      ASSERT_LE(time_offset + sizeof(uint64_t), static_cast<size_t>(header.size));
+      uint64_t timestamp;
+      memcpy(&timestamp, p + time_offset, sizeof(timestamp));
+      timestamps->push_back(timestamp);
+    }
+    p += header.size;
+  }
+}
+
+// Read the meta info feature of a recording made by PerfEventSet. Feature section descriptors
+// follow the data section, one per bit set in FileHeader::features, in bit order. The meta info
+// section is a list of "key\0value\0" pairs.
+static void ReadMetaInfo(const std::string& path,
+                         std::unordered_map<std::string, std::string>* info) {
+  constexpr size_t kFeatMetaInfo = 129;
+  std::string data;
+  ASSERT_TRUE(android::base::ReadFileToString(path, &data));
+  // FileHeader: magic, header_size, attr_size, attrs, data, event_types, features[32].
+  ASSERT_GE(data.size(), 104u);
+  ASSERT_EQ(data.compare(0, 8, "PERFILE2"), 0);
+  auto read_u64 = [&](size_t offset) {
+    uint64_t value;
+    memcpy(&value, data.data() + offset, sizeof(value));
+    return value;
+  };
+  const uint8_t* features = reinterpret_cast<const uint8_t*>(data.data() + 72);
+  ASSERT_TRUE(features[kFeatMetaInfo / 8] & (1 << (kFeatMetaInfo % 8)));
+  size_t desc_index = 0;
+  for (size_t i = 0; i < kFeatMetaInfo; i++) {
+    if (features[i / 8] & (1 << (i % 8))) {
+      desc_index++;
+    }
+  }
+  // Each SectionDesc has a u64 offset and a u64 size.
+  uint64_t desc_offset = read_u64(40) + read_u64(48) + desc_index * 16;
+  ASSERT_LE(desc_offset + 16, data.size());
+  uint64_t section_offset = read_u64(desc_offset);
+  uint64_t section_size = read_u64(desc_offset + 8);
+  ASSERT_LE(section_offset + section_size, data.size());
+
+  info->clear();
+  const char* p = data.data() + section_offset;
+  const char* end = p + section_size;
+  while (p < end) {
+    const char* key_end = static_cast<const char*>(memchr(p, '\0', end - p));
+    ASSERT_NE(key_end, nullptr);
+    const char* value = key_end + 1;
+    const char* value_end = static_cast<const char*>(memchr(value, '\0', end - value));
+    ASSERT_NE(value_end, nullptr);
+    (*info)[std::string(p, key_end)] = std::string(value, value_end);
+    p = value_end + 1;
+  }
+}
+
+TEST(recording, smoke) {
+  std::unique_ptr<PerfEventSet> perf(
+      PerfEventSet::CreateInstance(PerfEventSet::Type::kPerfForRecording));
+  ASSERT_TRUE(perf);
+  ASSERT_TRUE(perf->AddEvent("cpu-clock"));
+  ASSERT_TRUE(perf->SetSampleFrequency(1000));
+  ASSERT_TRUE(perf->EnableFpCallChain());
+  ASSERT_TRUE(perf->MonitorCurrentThread());
+  ASSERT_FALSE(perf->StopRecording());
+  TemporaryFile tmpfile;
+  ASSERT_TRUE(perf->StartRecording(tmpfile.path));
+  ASSERT_FALSE(perf->StartRecording(tmpfile.path));
+  ASSERT_FALSE(perf->SetSampleFrequency(2000));
+  DoSomeWork();
+  for (size_t i = 0; i < 10; ++i) {
+    ASSERT_TRUE(perf->PauseRecording());
+    ASSERT_TRUE(perf->ResumeRecording());
+  }
+  DoSomeWork();
+  ASSERT_TRUE(perf->StopRecording());
+  std::vector<uint64_t> timestamps;
+  bool monotonic;
+  ReadSampleTimestamps(tmpfile.path, &timestamps, &monotonic);
+  ASSERT_FALSE(timestamps.empty());
+  // The meta info should name the clock the samples actually use.
+  std::unordered_map<std::string, std::string> meta_info;
+  ReadMetaInfo(tmpfile.path, &meta_info);
+  ASSERT_EQ(meta_info["clockid"], monotonic ? "monotonic" : "perf");
+}
+
+TEST(recording, pause_recording) {
+  std::unique_ptr<PerfEventSet> perf(
+      PerfEventSet::CreateInstance(PerfEventSet::Type::kPerfForRecording));
+  ASSERT_TRUE(perf);
+  ASSERT_TRUE(perf->AddEvent("cpu-clock"));
+  ASSERT_TRUE(perf->SetSampleFrequency(1000));
+  ASSERT_TRUE(perf->MonitorCurrentThread());
+  TemporaryFile tmpfile;
+  ASSERT_TRUE(perf->StartRecording(tmpfile.path));
+  DoSomeWork();
+  ASSERT_TRUE(perf->PauseRecording());
+  uint64_t pause_time = GetMonotonicClock();
+  DoSomeWork();
+  uint64_t resume_time = GetMonotonicClock();
+  ASSERT_TRUE(perf->ResumeRecording());
+  DoSomeWork();
+  ASSERT_TRUE(perf->StopRecording());
+
+  std::vector<uint64_t> timestamps;
+  bool monotonic;
+  ReadSampleTimestamps(tmpfile.path, &timestamps, &monotonic);
+  ASSERT_FALSE(timestamps.empty());
+  if (!monotonic) {
+    GTEST_LOG_(INFO) << "Skip checking the paused period, as the kernel doesn't support "
+                        "CLOCK_MONOTONIC timestamps.";
+    return;
+  }
+  size_t samples_before_pause = 0;
+  size_t samples_after_resume = 0;
+  for (uint64_t timestamp : timestamps) {
+    ASSERT_FALSE(timestamp > pause_time && timestamp < resume_time);
+    samples_before_pause += timestamp <= pause_time;
+    samples_after_resume += timestamp >= resume_time;
+  }
+  ASSERT_GT(samples_before_pause, 0u);
+  ASSERT_GT(samples_after_resume, 0u);
+}
+
+TEST(recording, different_targets) {
+  auto test_function = [](std::function<void(PerfEventSet*)> set_target_func) {
+    std::unique_ptr<PerfEventSet> perf(
+        PerfEventSet::CreateInstance(PerfEventSet::Type::kPerfForRecording));
+    ASSERT_TRUE(perf);
+    ASSERT_TRUE(perf->AddEvent("cpu-clock"));
+    set_target_func(perf.get());
+    TemporaryFile tmpfile;
+    ASSERT_TRUE(perf->StartRecording(tmpfile.path));
+    DoSomeWork();
+    ASSERT_TRUE(perf->StopRecording());
+    std::string data;
+    ASSERT_TRUE(android::base::ReadFileToString(tmpfile.path, &data));
+    ASSERT_EQ(data.compare(0, 8, "PERFILE2"), 0);
+  };
+  test_function([](PerfEventSet* perf) { ASSERT_TRUE(perf->MonitorCurrentProcess()); });
+  test_function([](PerfEventSet* perf) { ASSERT_TRUE(perf->MonitorCurrentThread()); });
+  test_function(
+      [](PerfEventSet* perf) { ASSERT_TRUE(perf->MonitorThreadsInCurrentProcess({getpid()})); });
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+#include "benchmark_util.h"
+#include "get_test_data.h"
+
+// The interface exported by report_lib_interface.cpp, as used by python scripts. Structures are
+// only passed around here, so they are kept opaque.
+extern "C" {
+struct ReportLib;
+struct Sample;
+struct SymbolEntry;
+struct CallChain;
+
+ReportLib* CreateReportLib();
+void DestroyReportLib(ReportLib* report_lib);
+bool SetLogSeverity(ReportLib* report_lib, const char* log_level);
+bool SetRecordFile(ReportLib* report_lib, const char* record_file);
+Sample* GetNextSample(ReportLib* report_lib);
+SymbolEntry* GetSymbolOfCurrentSample(ReportLib* report_lib);
+CallChain* GetCallChainOfCurrentSample(ReportLib* report_lib);
+}
+
+using namespace simpleperf;
+
+// Measure the cost per sample seen by python scripts: reading the sample, its symbol and its
+// callchain. The ReportLib instance is created in each iteration, so the per-file setup is
+// included and amortized over the samples in the file.
+static void ReportLibBenchmark(benchmark::State& state, const std::string& path) {
+  if (path.empty()) {
+    state.SkipWithError("failed to get perf.data");
+    return;
+  }
+  size_t sample_count = 0;
+  for (auto _ : state) {
+    ReportLib* report_lib = CreateReportLib();
+    SetLogSeverity(report_lib, "error");
+    SetRecordFile(report_lib, path.c_str());
+    sample_count = 0;
+    while (GetNextSample(report_lib) != nullptr) {
+      benchmark::DoNotOptimize(GetSymbolOfCurrentSample(report_lib));
+      benchmark::DoNotOptimize(GetCallChainOfCurrentSample(report_lib));
+      sample_count++;
+    }
+    DestroyReportLib(report_lib);
+  }
+  state.SetItemsProcessed(state.iterations() * sample_count);
+}
+
+static void BM_ReportLib(benchmark::State& state) {
+  ReportLibBenchmark(state, GetSyntheticPerfData(state.range(0), state.range(1)));
+}
+BENCHMARK(BM_ReportLib)->Apply(SyntheticPerfDataArgs)->Unit(benchmark::kMillisecond);
+
+static void BM_ReportLib_testdata(benchmark::State& state) {
+  ReportLibBenchmark(state, GetTestData(CALLGRAPH_FP_PERF_DATA));
+}
+BENCHMARK(BM_ReportLib_testdata)->Unit(benchmark::kMillisecond);
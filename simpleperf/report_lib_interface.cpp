@@ -97,6 +97,27 @@ struct FeatureSection {
   uint32_t data_size;
 };
 
+struct TracingFieldColumn {
+  const char* name;
+  // Values of TracingFieldAccessor::ValueType: 0 for int, 1 for uint, 2 for string, 3 for bytes.
+  uint32_t type;
+  // For int and uint columns, an int64_t or uint64_t value for each sample.
+  const void* values;
+  // For string and bytes columns, the value of sample i is data[offsets[i]:offsets[i + 1]].
+  const uint32_t* offsets;
+  const char* data;
+};
+
+struct TracingFieldBatch {
+  uint32_t sample_count;
+  const uint64_t* times;
+  const uint32_t* pids;
+  const uint32_t* tids;
+  const uint32_t* cpus;
+  uint32_t column_count;
+  TracingFieldColumn* columns;
+};
+
 }  // extern "C"
 
 namespace simpleperf {
@@ -155,6 +176,30 @@ static std::optional<TraceOffCpuMode> StringToTraceOffCpuMode(const std::string&
   return std::nullopt;
 }
 
+// Selected fields of a tracepoint event, read in batches by GetNextTracingFieldBatch().
+struct TracingFieldSelection {
+  std::string event_name;
+  std::vector<std::string> field_names;
+  // Resolved when reading the first sample, because tracing data is stored in records.
+  std::optional<size_t> attr_index;
+  uint32_t tracing_data_size = 0;
+  std::vector<TracingFieldAccessor> accessors;
+
+  // Buffers of the last batch.
+  std::vector<uint64_t> times;
+  std::vector<uint32_t> pids;
+  std::vector<uint32_t> tids;
+  std::vector<uint32_t> cpus;
+  struct ColumnData {
+    std::vector<uint64_t> values;
+    std::vector<uint32_t> offsets;
+    std::string data;
+  };
+  std::vector<ColumnData> column_data;
+  std::vector<TracingFieldColumn> columns;
+  TracingFieldBatch batch;
+};
+
 struct TraceOffCpuData {
   std::vector<TraceOffCpuMode> supported_modes;
   std::string supported_modes_string;
@@ -171,7 +216,10 @@ class ReportLib {
         record_filename_("perf.data"),
         current_thread_(nullptr),
         callchain_report_builder_(thread_tree_),
-        record_filter_(thread_tree_) {}
+        record_filter_(thread_tree_) {
+    // Map info is copied into Mapping for each sample, so maps of exited processes can be reused.
+    thread_tree_.EnableMapReclamation();
+  }
 
   bool SetLogSeverity(const char* log_level);
 
@@ -186,6 +234,13 @@ class ReportLib {
     return OpenRecordFileIfNecessary();
   }
 
+  // Like SetRecordFile(), but GetNextSample() waits for new samples while the file is still being
+  // written by the record command.
+  bool FollowRecordFile(const char* record_file) {
+    follow_ = true;
+    return SetRecordFile(record_file);
+  }
+
   bool SetKallsymsFile(const char* kallsyms_file);
 
   void ShowIpForUnknownSymbol() { thread_tree_.ShowIpForUnknownSymbol(); }
@@ -207,11 +262,15 @@ class ReportLib {
   SymbolEntry* GetSymbolOfCurrentSample() { return current_symbol_; }
   CallChain* GetCallChainOfCurrentSample() { return &current_callchain_; }
   const char* GetTracingDataOfCurrentSample() { return current_tracing_data_; }
+  bool SelectTracingFields(const char* event_name, const char** field_names, int field_count);
+  TracingFieldBatch* GetNextTracingFieldBatch(uint32_t max_samples);
 
   const char* GetBuildIdForPath(const char* path);
   FeatureSection* GetFeatureSection(const char* feature_name);
 
  private:
+  const SampleRecord* ReadNextSampleRecord();
+  bool ResolveTracingFieldSelection();
   void ProcessSampleRecord(std::unique_ptr<Record> r);
   void ProcessSwitchRecord(std::unique_ptr<Record> r);
   void AddSampleRecordToQueue(SampleRecord* r);
@@ -224,6 +283,7 @@ class ReportLib {
 
   std::unique_ptr<android::base::ScopedLogSeverity> log_severity_;
   std::string record_filename_;
+  bool follow_ = false;
   std::unique_ptr<RecordFileReader> record_file_reader_;
   ThreadTree thread_tree_;
   std::queue<std::unique_ptr<SampleRecord>> sample_record_queue_;
@@ -243,6 +303,7 @@ class ReportLib {
   CallChainReportBuilder callchain_report_builder_;
   ThreadReportBuilder thread_report_builder_;
   std::unique_ptr<Tracing> tracing_;
+  std::unique_ptr<TracingFieldSelection> tracing_field_selection_;
   RecordFilter record_filter_;
 };
 
@@ -322,7 +383,11 @@ bool ReportLib::AggregateThreads(const char** thread_name_regex, int thread_name
 
 bool ReportLib::OpenRecordFileIfNecessary() {
   if (record_file_reader_ == nullptr) {
-    record_file_reader_ = RecordFileReader::CreateInstance(record_filename_);
+    if (follow_) {
+      record_file_reader_ = RecordFileReader::CreateInstanceForFollowing(record_filename_);
+    } else {
+      record_file_reader_ = RecordFileReader::CreateInstance(record_filename_);
+    }
     if (record_file_reader_ == nullptr) {
       return false;
     }
@@ -354,6 +419,15 @@ bool ReportLib::OpenRecordFileIfNecessary() {
 }
 
 Sample* ReportLib::GetNextSample() {
+  const SampleRecord* r = ReadNextSampleRecord();
+  if (r == nullptr) {
+    return nullptr;
+  }
+  SetCurrentSample(*r);
+  return &current_sample_;
+}
+
+const SampleRecord* ReportLib::ReadNextSampleRecord() {
   if (!OpenRecordFileIfNecessary()) {
     return nullptr;
   }
@@ -380,8 +454,116 @@ Sample* ReportLib::GetNextSample() {
       }
     }
   }
-  SetCurrentSample(*sample_record_queue_.front());
-  return &current_sample_;
+  return sample_record_queue_.front().get();
+}
+
+bool ReportLib::SelectTracingFields(const char* event_name, const char** field_names,
+                                    int field_count) {
+  tracing_field_selection_.reset(new TracingFieldSelection);
+  tracing_field_selection_->event_name = event_name;
+  for (int i = 0; i < field_count; i++) {
+    tracing_field_selection_->field_names.emplace_back(field_names[i]);
+  }
+  return true;
+}
+
+bool ReportLib::ResolveTracingFieldSelection() {
+  TracingFieldSelection& selection = *tracing_field_selection_;
+  if (events_.empty()) {
+    CreateEvents();
+  }
+  for (size_t i = 0; i < events_.size(); i++) {
+    if (events_[i].name == selection.event_name) {
+      selection.attr_index = i;
+      break;
+    }
+  }
+  if (!selection.attr_index || !tracing_ ||
+      events_[*selection.attr_index].attr.type != PERF_TYPE_TRACEPOINT) {
+    LOG(ERROR) << "no tracepoint event " << selection.event_name << " in " << record_filename_;
+    return false;
+  }
+  const EventInfo& event = events_[*selection.attr_index];
+  TracingFormat format = tracing_->GetTracingFormatHavingId(event.attr.config);
+  for (const std::string& name : selection.field_names) {
+    const TracingField* field = format.FindField(name);
+    if (field == nullptr) {
+      LOG(ERROR) << "no field " << name << " in tracepoint event " << selection.event_name;
+      return false;
+    }
+    selection.accessors.emplace_back(*field);
+  }
+  selection.tracing_data_size = event.tracing_info.data_format.size;
+  selection.column_data.resize(selection.accessors.size());
+  selection.columns.resize(selection.accessors.size());
+  for (size_t i = 0; i < selection.columns.size(); i++) {
+    selection.columns[i].name = selection.field_names[i].c_str();
+    selection.columns[i].type = selection.accessors[i].type;
+  }
+  return true;
+}
+
+TracingFieldBatch* ReportLib::GetNextTracingFieldBatch(uint32_t max_samples) {
+  if (!tracing_field_selection_) {
+    LOG(ERROR) << "no tracing fields are selected";
+    return nullptr;
+  }
+  TracingFieldSelection& selection = *tracing_field_selection_;
+  selection.times.clear();
+  selection.pids.clear();
+  selection.tids.clear();
+  selection.cpus.clear();
+  for (auto& column : selection.column_data) {
+    column.values.clear();
+    column.offsets.assign(1, 0);
+    column.data.clear();
+  }
+  // Samples are decoded here instead of in SetCurrentSample(), to skip building callchains.
+  while (selection.times.size() < max_samples) {
+    const SampleRecord* r = ReadNextSampleRecord();
+    if (r == nullptr) {
+      break;
+    }
+    if (!selection.attr_index) {
+      if (!ResolveTracingFieldSelection()) {
+        return nullptr;
+      }
+    }
+    if (record_file_reader_->GetAttrIndexOfRecord(r) != *selection.attr_index ||
+        !(r->sample_type & PERF_SAMPLE_RAW) || r->raw_data.size < selection.tracing_data_size) {
+      continue;
+    }
+    selection.times.push_back(r->time_data.time);
+    selection.pids.push_back(r->tid_data.pid);
+    selection.tids.push_back(r->tid_data.tid);
+    selection.cpus.push_back(r->cpu_data.cpu);
+    for (size_t i = 0; i < selection.accessors.size(); i++) {
+      const TracingFieldAccessor& accessor = selection.accessors[i];
+      auto& column = selection.column_data[i];
+      if (accessor.type == TracingFieldAccessor::INT ||
+          accessor.type == TracingFieldAccessor::UINT) {
+        column.values.push_back(accessor.ReadValue(r->raw_data.data));
+      } else {
+        column.data += accessor.ReadBytes(r->raw_data.data, r->raw_data.size);
+        column.offsets.push_back(column.data.size());
+      }
+    }
+  }
+  for (size_t i = 0; i < selection.columns.size(); i++) {
+    auto& column = selection.column_data[i];
+    selection.columns[i].values = column.values.data();
+    selection.columns[i].offsets = column.offsets.data();
+    selection.columns[i].data = column.data.data();
+  }
+  TracingFieldBatch& batch = selection.batch;
+  batch.sample_count = selection.times.size();
+  batch.times = selection.times.data();
+  batch.pids = selection.pids.data();
+  batch.tids = selection.tids.data();
+  batch.cpus = selection.cpus.data();
+  batch.column_count = selection.columns.size();
+  batch.columns = selection.columns.data();
+  return &batch;
 }
 
 void ReportLib::ProcessSampleRecord(std::unique_ptr<Record> r) {
@@ -607,6 +789,7 @@ void DestroyReportLib(ReportLib* report_lib) EXPORT;
 bool SetLogSeverity(ReportLib* report_lib, const char* log_level) EXPORT;
 bool SetSymfs(ReportLib* report_lib, const char* symfs_dir) EXPORT;
 bool SetRecordFile(ReportLib* report_lib, const char* record_file) EXPORT;
+bool FollowRecordFile(ReportLib* report_lib, const char* record_file) EXPORT;
 bool SetKallsymsFile(ReportLib* report_lib, const char* kallsyms_file) EXPORT;
 void ShowIpForUnknownSymbol(ReportLib* report_lib) EXPORT;
 void ShowArtFrames(ReportLib* report_lib, bool show) EXPORT;
@@ -623,6 +806,13 @@ Event* GetEventOfCurrentSample(ReportLib* report_lib) EXPORT;
 SymbolEntry* GetSymbolOfCurrentSample(ReportLib* report_lib) EXPORT;
 CallChain* GetCallChainOfCurrentSample(ReportLib* report_lib) EXPORT;
 const char* GetTracingDataOfCurrentSample(ReportLib* report_lib) EXPORT;
+// Select fields of a tracepoint event, like "sched:sched_switch", to read in batches.
+bool SelectTracingFields(ReportLib* report_lib, const char* event_name, const char** field_names,
+                         int field_count) EXPORT;
+// Read selected fields of the next max_samples samples of the selected event, as arrays of
+// values. The arrays are valid until the next call. It shares samples with GetNextSample(), and
+// returns an empty batch when there are no more samples.
+TracingFieldBatch* GetNextTracingFieldBatch(ReportLib* report_lib, uint32_t max_samples) EXPORT;
 
 const char* GetBuildIdForPath(ReportLib* report_lib, const char* path) EXPORT;
 FeatureSection* GetFeatureSection(ReportLib* report_lib, const char* feature_name) EXPORT;
@@ -649,6 +839,10 @@ bool SetRecordFile(ReportLib* report_lib, const char* record_file) {
   return report_lib->SetRecordFile(record_file);
 }
 
+bool FollowRecordFile(ReportLib* report_lib, const char* record_file) {
+  return report_lib->FollowRecordFile(record_file);
+}
+
 void ShowIpForUnknownSymbol(ReportLib* report_lib) {
   return report_lib->ShowIpForUnknownSymbol();
 }
@@ -706,6 +900,15 @@ const char* GetTracingDataOfCurrentSample(ReportLib* report_lib) {
   return report_lib->GetTracingDataOfCurrentSample();
 }
 
+bool SelectTracingFields(ReportLib* report_lib, const char* event_name, const char** field_names,
+                         int field_count) {
+  return report_lib->SelectTracingFields(event_name, field_names, field_count);
+}
+
+TracingFieldBatch* GetNextTracingFieldBatch(ReportLib* report_lib, uint32_t max_samples) {
+  return report_lib->GetNextTracingFieldBatch(max_samples);
+}
+
 const char* GetBuildIdForPath(ReportLib* report_lib, const char* path) {
   return report_lib->GetBuildIdForPath(path);
 }
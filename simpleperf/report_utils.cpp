@@ -17,9 +17,9 @@
 #include "report_utils.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 #include <android-base/parsebool.h>
-#include <android-base/scopeguard.h>
 #include <android-base/strings.h>
 
 #include "JITDebugReader.h"
@@ -32,45 +32,111 @@ bool ProguardMappingRetrace::AddProguardMappingFile(std::string_view mapping_fil
   // https://www.guardsquare.com/en/products/proguard/manual/retrace.
   // Additional info provided by R8 is described in
   // https://r8.googlesource.com/r8/+/refs/heads/main/doc/retrace.md.
-  line_reader_.reset(new LineReader(mapping_file));
-  android::base::ScopeGuard g([&]() { line_reader_ = nullptr; });
-
-  if (!line_reader_->Ok()) {
+  std::string path(mapping_file);
+  android::base::unique_fd fd = FileHelper::OpenReadOnly(path);
+  if (fd == -1) {
     PLOG(ERROR) << "failed to read " << mapping_file;
     return false;
   }
-
-  MoveToNextLine();
-  while (cur_line_.type != LineType::LINE_EOF) {
-    if (cur_line_.type == LineType::CLASS_LINE) {
-      // Match line "original_classname -> obfuscated_classname:".
-      std::string_view s = cur_line_.data;
-      auto arrow_pos = s.find(" -> ");
-      auto arrow_end_pos = arrow_pos + strlen(" -> ");
-      if (auto colon_pos = s.find(':', arrow_end_pos); colon_pos != s.npos) {
-        std::string_view original_classname = s.substr(0, arrow_pos);
-        std::string obfuscated_classname(s.substr(arrow_end_pos, colon_pos - arrow_end_pos));
-        MappingClass& cur_class = class_map_[obfuscated_classname];
-        cur_class.original_classname = original_classname;
-        MoveToNextLine();
-        if (cur_line_.type == LineType::SYNTHESIZED_COMMENT) {
-          cur_class.synthesized = true;
-          MoveToNextLine();
-        }
-
-        while (cur_line_.type == LineType::METHOD_LINE) {
-          ParseMethod(cur_class);
+  uint64_t file_size = GetFileSize(path);
+  if (file_size == 0) {
+    return true;
+  }
+  auto mapped_file = android::base::MappedFile::FromFd(fd, 0, file_size, PROT_READ);
+  if (!mapped_file) {
+    PLOG(ERROR) << "failed to mmap " << mapping_file;
+    return false;
+  }
+  const char* p = mapped_file->data();
+  const char* end = p + mapped_file->size();
+  mapping_files_.emplace_back(std::move(mapped_file));
+
+  // Index class sections by scanning line starts. Only class lines need more than a look at
+  // their first char. A class section ends at the next class line.
+  uint32_t cur_range = kNoClassRange;
+  std::vector<uint32_t> ranges_of_parsed_classes;
+  auto finish_cur_range = [&](const char* range_end) {
+    if (cur_range != kNoClassRange) {
+      ClassRange& range = class_ranges_[cur_range];
+      range.data = std::string_view(range.data.data(), range_end - range.data.data());
+      cur_range = kNoClassRange;
+    }
+  };
+  while (p < end) {
+    const char* line_end = static_cast<const char*>(memchr(p, '\n', end - p));
+    if (line_end == nullptr) {
+      line_end = end;
+    }
+    if (p != line_end && *p != ' ' && *p != '#') {
+      std::string_view s(p, line_end - p);
+      // Mapping files written on Windows end lines with "\r\n".
+      if (!s.empty() && s.back() == '\r') {
+        s.remove_suffix(1);
+      }
+      if (auto arrow_pos = s.find(" -> "); arrow_pos != s.npos) {
+        finish_cur_range(p);
+        // Match line "original_classname -> obfuscated_classname:".
+        auto arrow_end_pos = arrow_pos + strlen(" -> ");
+        if (auto colon_pos = s.find(':', arrow_end_pos); colon_pos != s.npos) {
+          std::string_view obfuscated_classname = s.substr(arrow_end_pos, colon_pos - arrow_end_pos);
+          cur_range = static_cast<uint32_t>(class_ranges_.size());
+          class_ranges_.emplace_back(ClassRange{obfuscated_classname, s, kNoClassRange});
+          if (class_map_.count(obfuscated_classname) != 0) {
+            ranges_of_parsed_classes.push_back(cur_range);
+          } else if (auto it = class_index_.find(obfuscated_classname); it != class_index_.end()) {
+            class_ranges_[it->second.second].next = cur_range;
+            it->second.second = cur_range;
+          } else {
+            class_index_.emplace(obfuscated_classname, std::make_pair(cur_range, cur_range));
+          }
         }
-        continue;
       }
     }
+    p = line_end + 1;
+  }
+  finish_cur_range(end);
 
-    // Skip unparsed line.
-    MoveToNextLine();
+  // Classes already parsed from previous mapping files are extended right away.
+  for (uint32_t i : ranges_of_parsed_classes) {
+    const ClassRange& range = class_ranges_[i];
+    ParseClass(range.data, class_map_[range.obfuscated_classname]);
   }
   return true;
 }
 
+const ProguardMappingRetrace::MappingClass* ProguardMappingRetrace::GetMappingClass(
+    std::string_view obfuscated_classname) {
+  if (auto it = class_map_.find(obfuscated_classname); it != class_map_.end()) {
+    return &it->second;
+  }
+  auto it = class_index_.find(obfuscated_classname);
+  if (it == class_index_.end()) {
+    return nullptr;
+  }
+  MappingClass& mapping_class = class_map_[it->first];
+  for (uint32_t i = it->second.first; i != kNoClassRange; i = class_ranges_[i].next) {
+    ParseClass(class_ranges_[i].data, mapping_class);
+  }
+  class_index_.erase(it);
+  return &mapping_class;
+}
+
+void ProguardMappingRetrace::ParseClass(std::string_view data, MappingClass& mapping_class) {
+  text_ = data;
+  // The first line is the class line "original_classname -> obfuscated_classname:".
+  MoveToNextLine();
+  std::string_view s = cur_line_.data;
+  mapping_class.original_classname = s.substr(0, s.find(" -> "));
+  MoveToNextLine();
+  if (cur_line_.type == LineType::SYNTHESIZED_COMMENT) {
+    mapping_class.synthesized = true;
+    MoveToNextLine();
+  }
+  while (cur_line_.type == LineType::METHOD_LINE) {
+    ParseMethod(mapping_class);
+  }
+}
+
 void ProguardMappingRetrace::ParseMethod(MappingClass& mapping_class) {
   // Match line "... [original_classname.]original_methodname(...)... -> obfuscated_methodname".
   std::string_view s = cur_line_.data;
@@ -118,9 +184,13 @@ void ProguardMappingRetrace::ParseMethod(MappingClass& mapping_class) {
 }
 
 void ProguardMappingRetrace::MoveToNextLine() {
-  std::string* line;
-  while ((line = line_reader_->ReadLine()) != nullptr) {
-    std::string_view s = *line;
+  while (!text_.empty()) {
+    size_t line_end = text_.find('\n');
+    std::string_view s = text_.substr(0, line_end);
+    text_.remove_prefix(line_end == text_.npos ? text_.size() : line_end + 1);
+    if (!s.empty() && s.back() == '\r') {
+      s.remove_suffix(1);
+    }
     if (s.empty()) {
       continue;
     }
@@ -152,10 +222,10 @@ void ProguardMappingRetrace::MoveToNextLine() {
 bool ProguardMappingRetrace::DeObfuscateJavaMethods(std::string_view obfuscated_name,
                                                     std::string* original_name, bool* synthesized) {
   if (auto split_pos = obfuscated_name.rfind('.'); split_pos != obfuscated_name.npos) {
-    std::string obfuscated_classname(obfuscated_name.substr(0, split_pos));
+    std::string_view obfuscated_classname = obfuscated_name.substr(0, split_pos);
 
-    if (auto it = class_map_.find(obfuscated_classname); it != class_map_.end()) {
-      const MappingClass& mapping_class = it->second;
+    if (const MappingClass* p = GetMappingClass(obfuscated_classname); p != nullptr) {
+      const MappingClass& mapping_class = *p;
       const auto& method_map = mapping_class.method_map;
       std::string obfuscated_methodname(obfuscated_name.substr(split_pos + 1));
 
@@ -18,11 +18,14 @@
 
 #include <inttypes.h>
 
+#include <memory>
 #include <string>
 #include <string_view>
 #include <unordered_map>
 #include <vector>
 
+#include <android-base/mapped_file.h>
+
 #include "RegEx.h"
 #include "dso.h"
 #include "thread_tree.h"
@@ -30,6 +33,8 @@
 
 namespace simpleperf {
 
+// Mapping files are mapped into memory and only indexed by obfuscated class names when added.
+// The section of a class is parsed the first time the class is used in DeObfuscateJavaMethods().
 class ProguardMappingRetrace {
  public:
   // Add proguard mapping.txt to de-obfuscate minified symbols.
@@ -64,12 +69,29 @@ class ProguardMappingRetrace {
     std::string_view data;
   };
 
+  // The section of a class in a mapping file, starting from the class line.
+  struct ClassRange {
+    std::string_view obfuscated_classname;
+    std::string_view data;
+    // Index of the next range of the same class in class_ranges_, or kNoClassRange.
+    uint32_t next;
+  };
+
+  static constexpr uint32_t kNoClassRange = UINT32_MAX;
+
+  const MappingClass* GetMappingClass(std::string_view obfuscated_classname);
+  void ParseClass(std::string_view data, MappingClass& mapping_class);
   void ParseMethod(MappingClass& mapping_class);
   void MoveToNextLine();
 
-  // Map from obfuscated class names to ProguardMappingClass.
-  std::unordered_map<std::string, MappingClass> class_map_;
-  std::unique_ptr<LineReader> line_reader_;
+  std::vector<std::unique_ptr<android::base::MappedFile>> mapping_files_;
+  std::vector<ClassRange> class_ranges_;
+  // Map from obfuscated class names of classes not parsed yet to their first and last ranges.
+  std::unordered_map<std::string_view, std::pair<uint32_t, uint32_t>> class_index_;
+  // Map from obfuscated class names to parsed classes.
+  std::unordered_map<std::string_view, MappingClass> class_map_;
+  // Text left to parse.
+  std::string_view text_;
   LineInfo cur_line_;
 };
 
@@ -68,6 +68,60 @@ TEST(ProguardMappingRetrace, smoke) {
   ASSERT_TRUE(synthesized);
 }
 
+TEST(ProguardMappingRetrace, multiple_mapping_files) {
+  TemporaryFile tmpfile1;
+  close(tmpfile1.release());
+  ASSERT_TRUE(android::base::WriteStringToFile("original.class.A -> A:\n"
+                                               "    void method_a() -> a\n",
+                                               tmpfile1.path));
+  TemporaryFile tmpfile2;
+  close(tmpfile2.release());
+  ASSERT_TRUE(android::base::WriteStringToFile("original.class.A -> A:\n"
+                                               "    void method_b() -> b\n"
+                                               "original.class.B -> B:\n",
+                                               tmpfile2.path));
+  ProguardMappingRetrace retrace;
+  ASSERT_TRUE(retrace.AddProguardMappingFile(tmpfile1.path));
+  std::string original_name;
+  bool synthesized;
+  // Class A is parsed before adding the second mapping file.
+  ASSERT_TRUE(retrace.DeObfuscateJavaMethods("A.a", &original_name, &synthesized));
+  ASSERT_EQ(original_name, "original.class.A.method_a");
+  ASSERT_TRUE(retrace.AddProguardMappingFile(tmpfile2.path));
+  ASSERT_TRUE(retrace.DeObfuscateJavaMethods("A.a", &original_name, &synthesized));
+  ASSERT_EQ(original_name, "original.class.A.method_a");
+  ASSERT_TRUE(retrace.DeObfuscateJavaMethods("A.b", &original_name, &synthesized));
+  ASSERT_EQ(original_name, "original.class.A.method_b");
+  ASSERT_TRUE(retrace.DeObfuscateJavaMethods("B.b", &original_name, &synthesized));
+  ASSERT_EQ(original_name, "original.class.B.b");
+  ASSERT_FALSE(retrace.DeObfuscateJavaMethods("C.c", &original_name, &synthesized));
+}
+
+TEST(ProguardMappingRetrace, crlf_line_endings) {
+  TemporaryFile tmpfile;
+  close(tmpfile.release());
+  ASSERT_TRUE(android::base::WriteStringToFile(
+      "original.class.A -> A:\r\n"
+      "\r\n"
+      "    void method_a() -> a\r\n"
+      "    void method_b() -> b\r\n"
+      "      # {\"id\":\"com.android.tools.r8.synthesized\"}\r\n"
+      "original.class.B -> B:\r\n",
+      tmpfile.path));
+  ProguardMappingRetrace retrace;
+  ASSERT_TRUE(retrace.AddProguardMappingFile(tmpfile.path));
+  std::string original_name;
+  bool synthesized;
+  ASSERT_TRUE(retrace.DeObfuscateJavaMethods("A.a", &original_name, &synthesized));
+  ASSERT_EQ(original_name, "original.class.A.method_a");
+  ASSERT_FALSE(synthesized);
+  ASSERT_TRUE(retrace.DeObfuscateJavaMethods("A.b", &original_name, &synthesized));
+  ASSERT_EQ(original_name, "original.class.A.method_b");
+  ASSERT_TRUE(synthesized);
+  ASSERT_TRUE(retrace.DeObfuscateJavaMethods("B.b", &original_name, &synthesized));
+  ASSERT_EQ(original_name, "original.class.B.b");
+}
+
 class CallChainReportBuilderTest : public testing::Test {
  protected:
   virtual void SetUp() {
@@ -252,10 +252,10 @@ class SampleTreeBuilder {
   void AddCallChainDuplicateInfo() {
     if (build_callchain_) {
       for (EntryT* sample : sample_set_) {
+        // Recompute the flag, because it can be called again after processing more samples.
         auto it = callchain_parent_map_.find(sample);
-        if (it != callchain_parent_map_.end() && !it->second.has_multiple_parents) {
-          sample->callchain.duplicated = true;
-        }
+        sample->callchain.duplicated =
+            it != callchain_parent_map_.end() && !it->second.has_multiple_parents;
       }
     }
   }
@@ -330,12 +330,15 @@ class SampleTreeDisplayer {
 
   virtual ~SampleTreeDisplayer() {}
 
-  void DisplaySamples(FILE* fp, const std::vector<EntryT*>& samples, const InfoT* info) {
+  void DisplaySamples(FILE* fp, const std::vector<EntryT*>& samples, const InfoT* info,
+                      bool print_names = true) {
     displayer_.SetInfo(info);
     for (const auto& sample : samples) {
       displayer_.AdjustWidth(sample);
     }
-    displayer_.PrintNames(fp);
+    if (print_names) {
+      displayer_.PrintNames(fp);
+    }
     for (const auto& sample : samples) {
       displayer_.PrintSample(fp, sample);
     }
@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <unistd.h>
+
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <android-base/file.h>
+#include <benchmark/benchmark.h>
+
+#include "benchmark_util.h"
+#include "command.h"
+#include "sample_tree.h"
+#include "thread_tree.h"
+
+using namespace simpleperf;
+
+namespace {
+
+struct BenchSampleEntry {
+  int pid;
+  int tid;
+  uint64_t ip;
+  uint64_t period;
+};
+
+BUILD_COMPARE_VALUE_FUNCTION(BenchComparePid, pid);
+BUILD_COMPARE_VALUE_FUNCTION(BenchCompareTid, tid);
+BUILD_COMPARE_VALUE_FUNCTION(BenchCompareIp, ip);
+
+class BenchSampleComparator : public SampleComparator<BenchSampleEntry> {
+ public:
+  BenchSampleComparator() {
+    AddCompareFunction(BenchComparePid);
+    AddCompareFunction(BenchCompareTid);
+    AddCompareFunction(BenchCompareIp);
+  }
+};
+
+class BenchSampleTreeBuilder : public SampleTreeBuilder<BenchSampleEntry, int> {
+ public:
+  BenchSampleTreeBuilder() : SampleTreeBuilder(BenchSampleComparator()) {}
+
+  void AddSample(const BenchSampleEntry& entry) {
+    InsertSample(std::unique_ptr<BenchSampleEntry>(new BenchSampleEntry(entry)));
+  }
+
+ protected:
+  BenchSampleEntry* CreateSample(const SampleRecord&, bool, int*) override { return nullptr; }
+  BenchSampleEntry* CreateBranchSample(const SampleRecord&, const BranchStackItemType&) override {
+    return nullptr;
+  }
+  BenchSampleEntry* CreateCallChainSample(const ThreadEntry*, const BenchSampleEntry*, uint64_t,
+                                          bool, const std::vector<BenchSampleEntry*>&,
+                                          const int&) override {
+    return nullptr;
+  }
+  const ThreadEntry* GetThreadOfSample(BenchSampleEntry*) override { return nullptr; }
+  uint64_t GetPeriodForCallChain(const int&) override { return 0; }
+  void MergeSample(BenchSampleEntry* sample1, BenchSampleEntry* sample2) override {
+    sample1->period += sample2->period;
+  }
+};
+
+}  // namespace
+
+// Insert samples drawn from [distinct] different keys, so most insertions merge into existing
+// samples when distinct is small.
+static void BM_SampleTreeBuilder_InsertMerge(benchmark::State& state) {
+  size_t sample_count = state.range(0);
+  size_t distinct = state.range(1);
+  std::mt19937_64 rng(sample_count + distinct);
+  std::uniform_int_distribution<size_t> dist(0, distinct - 1);
+  std::vector<BenchSampleEntry> entries;
+  for (size_t i = 0; i < sample_count; i++) {
+    size_t key = dist(rng);
+    entries.push_back(BenchSampleEntry{static_cast<int>(key % 16), static_cast<int>(key % 64),
+                                       0x1000 + key * 4, 1});
+  }
+
+  for (auto _ : state) {
+    BenchSampleTreeBuilder builder;
+    for (const auto& entry : entries) {
+      builder.AddSample(entry);
+    }
+    benchmark::DoNotOptimize(builder.GetSamples());
+  }
+  state.SetItemsProcessed(state.iterations() * sample_count);
+}
+BENCHMARK(BM_SampleTreeBuilder_InsertMerge)
+    ->ArgNames({"samples", "distinct"})
+    ->Args({100000, 100})
+    ->Args({100000, 10000})
+    ->Args({100000, 100000})
+    ->Unit(benchmark::kMillisecond);
+
+// Build sample trees (with callchains when depth > 0) through the report command, which covers
+// symbolization, callchain merging and sorting on top of sample insertion.
+static void BM_ReportCmd(benchmark::State& state) {
+  size_t sample_count = state.range(0);
+  size_t callchain_depth = state.range(1);
+  const std::string& path = GetSyntheticPerfData(sample_count, callchain_depth);
+  if (path.empty()) {
+    state.SkipWithError("failed to generate perf.data");
+    return;
+  }
+  TemporaryFile tmpfile;
+  close(tmpfile.release());
+  std::vector<std::string> args = {"-i", path, "-o", tmpfile.path, "--sort",
+                                   "comm,pid,tid,dso,symbol"};
+  if (callchain_depth > 0) {
+    args.push_back("-g");
+  }
+  for (auto _ : state) {
+    std::unique_ptr<Command> cmd = CreateCommandInstance("report");
+    if (!cmd->Run(args)) {
+      state.SkipWithError("report command failed");
+      return;
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * sample_count);
+}
+BENCHMARK(BM_ReportCmd)->Apply(SyntheticPerfDataArgs)->Unit(benchmark::kMillisecond);
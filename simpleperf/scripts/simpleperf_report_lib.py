@@ -233,6 +233,80 @@ class FeatureSectionStructure(ct.Structure):
                 ('data_size', ct.c_uint32)]
 
 
+class TracingFieldColumnStruct(ct.Structure):
+    """ Values of a tracing field for samples in a TracingFieldBatchStruct.
+        name: name of the field.
+        type: 0 for int, 1 for uint, 2 for string, 3 for bytes.
+        values: for int and uint columns, an int64 or uint64 value for each sample.
+        offsets, data: for string and bytes columns, the value of sample i is
+                       data[offsets[i]:offsets[i + 1]].
+    """
+    _fields_ = [('_name', ct.c_char_p),
+                ('type', ct.c_uint32),
+                ('values', ct.c_void_p),
+                ('offsets', ct.POINTER(ct.c_uint32)),
+                ('data', ct.c_void_p)]
+
+    TYPE_INT = 0
+    TYPE_UINT = 1
+    TYPE_STRING = 2
+    TYPE_BYTES = 3
+
+    @property
+    def name(self) -> str:
+        return _char_pt_to_str(self._name)
+
+
+class TracingFieldBatchStruct(ct.Structure):
+    _fields_ = [('sample_count', ct.c_uint32),
+                ('times', ct.c_void_p),
+                ('pids', ct.c_void_p),
+                ('tids', ct.c_void_p),
+                ('cpus', ct.c_void_p),
+                ('column_count', ct.c_uint32),
+                ('columns', ct.POINTER(TracingFieldColumnStruct))]
+
+
+class TracingFieldBatch:
+    """ Selected tracing fields of a batch of samples, stored by column.
+        times, pids, tids, cpus: memoryviews of sample times, pids, tids and cpus.
+        fields: map from a field name to its values. Int fields are memoryviews, string fields
+                are lists of str, and other fields are lists of bytes.
+        Memoryviews refer to buffers in ReportLib, which are only valid until reading the next
+        batch. Use tolist() to keep their values.
+    """
+
+    def __init__(self, batch: TracingFieldBatchStruct):
+        n = batch.sample_count
+        self.sample_count = n
+        self.times = self._to_memoryview(batch.times, ct.c_uint64, n)
+        self.pids = self._to_memoryview(batch.pids, ct.c_uint32, n)
+        self.tids = self._to_memoryview(batch.tids, ct.c_uint32, n)
+        self.cpus = self._to_memoryview(batch.cpus, ct.c_uint32, n)
+        self.fields: Dict[str, Any] = collections.OrderedDict()
+        for i in range(batch.column_count):
+            column = batch.columns[i]
+            if column.type == TracingFieldColumnStruct.TYPE_INT:
+                self.fields[column.name] = self._to_memoryview(column.values, ct.c_int64, n)
+            elif column.type == TracingFieldColumnStruct.TYPE_UINT:
+                self.fields[column.name] = self._to_memoryview(column.values, ct.c_uint64, n)
+            else:
+                offsets = column.offsets[:n + 1]
+                data = ct.string_at(column.data, offsets[n]) if n > 0 else b''
+                values = [data[offsets[j]:offsets[j + 1]] for j in range(n)]
+                if column.type == TracingFieldColumnStruct.TYPE_STRING:
+                    values = [bytes_to_str(value) for value in values]
+                self.fields[column.name] = values
+
+    @staticmethod
+    def _to_memoryview(p: Optional[int], elem_type: Any, n: int) -> memoryview:
+        if n == 0:
+            return memoryview(b'')
+        # Cast to a native format, because ctypes arrays export formats like '<q'.
+        fmt = {ct.c_int64: 'q', ct.c_uint64: 'Q', ct.c_uint32: 'I'}[elem_type]
+        return memoryview((elem_type * n).from_address(p)).cast('B').cast(fmt)
+
+
 class ReportLibStructure(ct.Structure):
     _fields_ = []
 
@@ -252,6 +326,7 @@ class ReportLib(object):
         self._SetLogSeverityFunc = self._lib.SetLogSeverity
         self._SetSymfsFunc = self._lib.SetSymfs
         self._SetRecordFileFunc = self._lib.SetRecordFile
+        self._FollowRecordFileFunc = self._lib.FollowRecordFile
         self._SetKallsymsFileFunc = self._lib.SetKallsymsFile
         self._ShowIpForUnknownSymbolFunc = self._lib.ShowIpForUnknownSymbol
         self._ShowArtFramesFunc = self._lib.ShowArtFrames
@@ -276,6 +351,10 @@ class ReportLib(object):
         self._GetCallChainOfCurrentSampleFunc.restype = ct.POINTER(CallChainStructure)
         self._GetTracingDataOfCurrentSampleFunc = self._lib.GetTracingDataOfCurrentSample
         self._GetTracingDataOfCurrentSampleFunc.restype = ct.POINTER(ct.c_char)
+        self._SelectTracingFieldsFunc = self._lib.SelectTracingFields
+        self._SelectTracingFieldsFunc.restype = ct.c_bool
+        self._GetNextTracingFieldBatchFunc = self._lib.GetNextTracingFieldBatch
+        self._GetNextTracingFieldBatchFunc.restype = ct.POINTER(TracingFieldBatchStruct)
         self._GetBuildIdForPathFunc = self._lib.GetBuildIdForPath
         self._GetBuildIdForPathFunc.restype = ct.c_char_p
         self._GetFeatureSection = self._lib.GetFeatureSection
@@ -329,6 +408,13 @@ class ReportLib(object):
         cond: bool = self._SetRecordFileFunc(self.getInstance(), _char_pt(record_file))
         _check(cond, 'Failed to set record file')
 
+    def FollowRecordFile(self, record_file: str):
+        """ Like SetRecordFile(), but for a record file still being written by the record
+            command. GetNextSample() waits for new samples until the recording finishes.
+        """
+        cond: bool = self._FollowRecordFileFunc(self.getInstance(), _char_pt(record_file))
+        _check(cond, 'Failed to follow record file')
+
     def ShowIpForUnknownSymbol(self):
         self._ShowIpForUnknownSymbolFunc(self.getInstance())
 
@@ -453,6 +539,28 @@ class ReportLib(object):
             result[field.name] = field.parse_value(data)
         return result
 
+    def SelectTracingFields(self, event_name: str, field_names: List[str]):
+        """ Select fields of a tracepoint event, like 'sched:sched_switch', to read via
+            GetNextTracingFieldBatch(). Decoding fields in batches is much faster than calling
+            GetTracingDataOfCurrentSample() for each sample.
+        """
+        name_array = (ct.c_char_p * len(field_names))()
+        name_array[:] = [_char_pt(f) for f in field_names]
+        res: bool = self._SelectTracingFieldsFunc(
+            self.getInstance(), _char_pt(event_name), name_array, len(field_names))
+        _check(res, f'Failed to call SelectTracingFields({event_name}, {field_names})')
+
+    def GetNextTracingFieldBatch(self, max_samples: int = 10000) -> Optional[TracingFieldBatch]:
+        """ Return selected fields of the next max_samples samples of the selected event.
+            Samples of other events are skipped. It shares samples with GetNextSample().
+            If no more samples, return None.
+        """
+        batch = self._GetNextTracingFieldBatchFunc(self.getInstance(), max_samples)
+        _check(not _is_null(batch), 'Failed to call GetNextTracingFieldBatch()')
+        if batch[0].sample_count == 0:
+            return None
+        return TracingFieldBatch(batch[0])
+
     def GetBuildIdForPath(self, path: str) -> str:
         build_id = self._GetBuildIdForPathFunc(self.getInstance(), _char_pt(path))
         assert not _is_null(build_id)
@@ -204,6 +204,49 @@ class TestReportLib(TestBase):
                 self.assertIsNone(tracing_data)
         self.assertTrue(has_dynamic_field)
 
+    def test_tracing_field_batch(self):
+        def get_expected_values(record_file: str, event_name: str, field_names: List[str]):
+            report_lib = ReportLib()
+            report_lib.SetRecordFile(record_file)
+            values = []
+            while report_lib.GetNextSample():
+                if report_lib.GetEventOfCurrentSample().name == event_name:
+                    tracing_data = report_lib.GetTracingDataOfCurrentSample()
+                    sample = report_lib.GetCurrentSample()
+                    values.append([sample.time] + [tracing_data[name] for name in field_names])
+            report_lib.Close()
+            return values
+
+        def get_batch_values(record_file: str, event_name: str, field_names: List[str]):
+            report_lib = ReportLib()
+            report_lib.SetRecordFile(record_file)
+            report_lib.SelectTracingFields(event_name, field_names)
+            values = []
+            while True:
+                batch = report_lib.GetNextTracingFieldBatch(max_samples=3)
+                if not batch:
+                    break
+                self.assertLessEqual(batch.sample_count, 3)
+                columns = [batch.times.tolist()] + [list(batch.fields[name])
+                                                    for name in field_names]
+                values += [list(row) for row in zip(*columns)]
+            report_lib.Close()
+            return values
+
+        for record_file, event_name, field_names in [
+                ('perf_with_tracepoint_event.data', 'sched:sched_switch',
+                 ['prev_pid', 'prev_comm', 'next_comm', 'prev_state']),
+                ('perf_with_tracepoint_event_dynamic_field.data', 'kprobes:myopen', ['name'])]:
+            record_file = TestHelper.testdata_path(record_file)
+            expected = get_expected_values(record_file, event_name, field_names)
+            self.assertGreater(len(expected), 0)
+            self.assertEqual(get_batch_values(record_file, event_name, field_names), expected)
+
+        self.report_lib.SetRecordFile(TestHelper.testdata_path('perf_with_tracepoint_event.data'))
+        self.report_lib.SelectTracingFields('sched:sched_switch', ['no_such_field'])
+        with self.assertRaises(RuntimeError):
+            self.report_lib.GetNextTracingFieldBatch()
+
     def test_add_proguard_mapping_file(self):
         with self.assertRaises(ValueError):
             self.report_lib.AddProguardMappingFile('non_exist_file')
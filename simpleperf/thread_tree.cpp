@@ -44,8 +44,8 @@ std::string GetSymbolMapDsoName(int pid) {
 void ThreadTree::SetThreadName(int pid, int tid, const std::string& comm) {
   ThreadEntry* thread = FindThreadOrNew(pid, tid);
   if (comm != thread->comm) {
-    thread_comm_storage_.push_back(std::unique_ptr<std::string>(new std::string(comm)));
-    thread->comm = thread_comm_storage_.back()->c_str();
+    thread->comm = InternString(comm);
+    thread_name_version_++;
   }
 }
 
@@ -61,10 +61,14 @@ bool ThreadTree::ForkThread(int pid, int tid, int ppid, int ptid) {
   ThreadEntry* parent = FindThreadOrNew(ppid, ptid);
   ThreadEntry* child = FindThreadOrNew(pid, tid);
   child->comm = parent->comm;
+  thread_name_version_++;
   if (pid != ppid) {
     // Copy maps from parent process.
     if (child->maps->maps.empty()) {
       *child->maps = *parent->maps;
+      for (auto& pair : child->maps->maps) {
+        AddMapRef(pair.second);
+      }
     } else {
       CHECK_NE(child->maps, parent->maps);
       for (auto& pair : parent->maps->maps) {
@@ -98,7 +102,7 @@ ThreadEntry* ThreadTree::CreateThread(int pid, int tid) {
   std::shared_ptr<MapSet> maps;
   if (pid == tid) {
     comm = "unknown";
-    maps.reset(new MapSet);
+    maps.reset(new MapSet, [this](MapSet* maps) { ReleaseMapSet(maps); });
   } else {
     // Share maps among threads in the same thread group.
     ThreadEntry* process = FindThreadOrNew(pid, pid);
@@ -113,6 +117,7 @@ ThreadEntry* ThreadTree::CreateThread(int pid, int tid) {
   };
   auto pair = thread_tree_.insert(std::make_pair(tid, std::unique_ptr<ThreadEntry>(thread)));
   CHECK(pair.second);
+  thread_name_version_++;
   if (pid == tid) {
     // If there is a symbol map dso for the process, add maps for the symbols.
     auto name = GetSymbolMapDsoName(pid);
@@ -124,10 +129,20 @@ ThreadEntry* ThreadTree::CreateThread(int pid, int tid) {
   return thread;
 }
 
+const char* ThreadTree::InternString(std::string_view s) {
+  if (auto it = interned_strings_.find(s); it != interned_strings_.end()) {
+    return it->data();
+  }
+  const char* p = arena_.CopyString(s);
+  interned_strings_.emplace(p, s.size());
+  return p;
+}
+
 void ThreadTree::ExitThread(int pid, int tid) {
   auto it = thread_tree_.find(tid);
   if (it != thread_tree_.end() && pid == it->second.get()->pid) {
     thread_tree_.erase(it);
+    thread_name_version_++;
   }
 }
 
@@ -228,8 +243,34 @@ void ThreadTree::AddSymbolsForProcess(int pid, std::vector<Symbol>* symbols) {
 }
 
 const MapEntry* ThreadTree::AllocateMap(const MapEntry& entry) {
-  map_storage_.emplace_back(new MapEntry(entry));
-  return map_storage_.back().get();
+  MapSlot* slot;
+  if (!free_map_slots_.empty()) {
+    slot = free_map_slots_.back();
+    free_map_slots_.pop_back();
+    slot->map = entry;
+  } else {
+    slot = arena_.New<MapSlot>(MapSlot{entry, 0});
+  }
+  slot->ref_count = 1;
+  return &slot->map;
+}
+
+void ThreadTree::AddMapRef(const MapEntry* map) {
+  reinterpret_cast<MapSlot*>(const_cast<MapEntry*>(map))->ref_count++;
+}
+
+void ThreadTree::ReleaseMap(const MapEntry* map) {
+  MapSlot* slot = reinterpret_cast<MapSlot*>(const_cast<MapEntry*>(map));
+  if (--slot->ref_count == 0 && reclaim_maps_) {
+    free_map_slots_.push_back(slot);
+  }
+}
+
+void ThreadTree::ReleaseMapSet(MapSet* maps) {
+  for (auto& pair : maps->maps) {
+    ReleaseMap(pair.second);
+  }
+  delete maps;
 }
 
 static MapEntry RemoveFirstPartOfMapEntry(const MapEntry* entry, uint64_t new_start_addr) {
@@ -260,21 +301,27 @@ void ThreadTree::InsertMap(MapSet& maps, const MapEntry& entry) {
                   AllocateMap(RemoveFirstPartOfMapEntry(it2->second, entry.get_end_addr())));
     }
     if (it2->second->get_end_addr() > entry.start_addr) {
-      it2->second =
-          AllocateMap(RemoveSecondPartOfMapEntry(it2->second, entry.start_addr - it2->first));
+      const MapEntry* old_map = it2->second;
+      it2->second = AllocateMap(RemoveSecondPartOfMapEntry(old_map, entry.start_addr - it2->first));
+      ReleaseMap(old_map);
     }
   }
   // Remove overlapped entries with start_addr >= entry.start_addr.
   while (it != map.end() && it->second->get_end_addr() <= entry.get_end_addr()) {
+    ReleaseMap(it->second);
     it = map.erase(it);
   }
   if (it != map.end() && it->second->start_addr < entry.get_end_addr()) {
     map.emplace(entry.get_end_addr(),
                 AllocateMap(RemoveFirstPartOfMapEntry(it->second, entry.get_end_addr())));
+    ReleaseMap(it->second);
     map.erase(it);
   }
   // Insert the new entry.
-  map.emplace(entry.start_addr, AllocateMap(entry));
+  const MapEntry* new_map = AllocateMap(entry);
+  if (!map.emplace(entry.start_addr, new_map).second) {
+    ReleaseMap(new_map);
+  }
   maps.version++;
 }
 
@@ -355,9 +402,11 @@ const Symbol* ThreadTree::FindKernelSymbol(uint64_t ip) {
 
 void ThreadTree::ClearThreadAndMap() {
   thread_tree_.clear();
-  thread_comm_storage_.clear();
+  thread_name_version_++;
   kernel_maps_.maps.clear();
-  map_storage_.clear();
+  interned_strings_.clear();
+  free_map_slots_.clear();
+  arena_.Clear();
 }
 
 bool ThreadTree::AddDsoInfo(FileFeature& file) {
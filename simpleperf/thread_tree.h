@@ -22,9 +22,12 @@
 #include <limits>
 #include <map>
 #include <memory>
+#include <string_view>
 #include <unordered_map>
+#include <unordered_set>
 
 #include "dso.h"
+#include "utils.h"
 
 namespace simpleperf {
 
@@ -101,11 +104,17 @@ class ThreadTree {
   virtual ~ThreadTree() {}
 
   void DisableThreadExitRecords() { disable_thread_exit_records_ = true; }
+  // Reuse memory of map entries no longer used by any process, like maps of exited processes.
+  // It can only be enabled when callers don't keep MapEntry pointers after processing a record.
+  void EnableMapReclamation() { reclaim_maps_ = true; }
   void SetThreadName(int pid, int tid, const std::string& comm);
   bool ForkThread(int pid, int tid, int ppid, int ptid);
   virtual ThreadEntry* FindThread(int tid) const;
   ThreadEntry* FindThreadOrNew(int pid, int tid);
   void ExitThread(int pid, int tid);
+  // Changed whenever a thread is added or removed, or a thread name changes. It is used to
+  // cache results derived from thread names.
+  uint64_t GetThreadNameVersion() const { return thread_name_version_; }
   void AddKernelMap(uint64_t start_addr, uint64_t len, uint64_t pgoff, const std::string& filename);
   const MapSet& GetKernelMaps() { return kernel_maps_; }
   void AddThreadMap(int pid, int tid, uint64_t start_addr, uint64_t len, uint64_t pgoff,
@@ -143,22 +152,38 @@ class ThreadTree {
                         DsoType dso_type = DSO_ELF_FILE);
 
  private:
+  // A map entry with the count of MapSets referring to it.
+  struct MapSlot {
+    MapEntry map;
+    uint32_t ref_count;
+  };
+
   ThreadEntry* CreateThread(int pid, int tid);
+  const char* InternString(std::string_view s);
   Dso* FindKernelDsoOrNew();
   Dso* FindKernelModuleDsoOrNew(const std::string& filename, uint64_t memory_start,
                                 uint64_t memory_end);
 
   const MapEntry* AllocateMap(const MapEntry& entry);
+  void AddMapRef(const MapEntry* map);
+  void ReleaseMap(const MapEntry* map);
+  void ReleaseMapSet(MapSet* maps);
   void InsertMap(MapSet& maps, const MapEntry& entry);
 
   // Add thread maps to cover symbols in dso.
   void AddThreadMapsForDsoSymbols(ThreadEntry* thread, Dso* dso);
 
+  // Comms and map entries are allocated in arena_. They are declared before thread_tree_, to
+  // outlive MapSets of threads.
+  BumpArena arena_;
+  std::unordered_set<std::string_view> interned_strings_;
+  std::vector<MapSlot*> free_map_slots_;
+  bool reclaim_maps_ = false;
+
   std::unordered_map<int, std::unique_ptr<ThreadEntry>> thread_tree_;
-  std::vector<std::unique_ptr<std::string>> thread_comm_storage_;
+  uint64_t thread_name_version_ = 0;
 
   MapSet kernel_maps_;
-  std::vector<std::unique_ptr<MapEntry>> map_storage_;
   MapEntry unknown_map_;
 
   std::unique_ptr<Dso> kernel_dso_;
@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <sys/resource.h>
+
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <android-base/stringprintf.h>
+#include <benchmark/benchmark.h>
+
+#include "record_file.h"
+#include "thread_tree.h"
+
+using namespace simpleperf;
+
+namespace {
+
+constexpr int kPid = 1;
+constexpr uint64_t kMapStart = 0x70000000;
+constexpr uint64_t kMapSize = 0x10000;
+constexpr uint64_t kSymbolSize = 0x100;
+constexpr size_t kLookupCount = 4096;
+
+// A thread with [map_count] maps, each backed by a dso fully covered by symbols.
+class ThreadTreeFixture {
+ public:
+  explicit ThreadTreeFixture(size_t map_count) {
+    thread_tree_.SetThreadName(kPid, kPid, "bench");
+    for (size_t i = 0; i < map_count; i++) {
+      FileFeature file;
+      file.path = android::base::StringPrintf("/synthetic/map%zu.so", i);
+      file.type = DSO_ELF_FILE;
+      file.min_vaddr = file.file_offset_of_min_vaddr = 0;
+      for (uint64_t addr = 0; addr < kMapSize; addr += kSymbolSize) {
+        file.symbols.emplace_back(android::base::StringPrintf("func_%zu_%zu", i, (size_t)addr),
+                                  addr, kSymbolSize);
+      }
+      thread_tree_.AddDsoInfo(file);
+      thread_tree_.AddThreadMap(kPid, kPid, kMapStart + i * kMapSize, kMapSize, 0, file.path);
+    }
+    thread_ = thread_tree_.FindThread(kPid);
+
+    std::mt19937_64 rng(map_count);
+    std::uniform_int_distribution<uint64_t> dist(kMapStart, kMapStart + map_count * kMapSize - 1);
+    for (size_t i = 0; i < kLookupCount; i++) {
+      ips_.push_back(dist(rng));
+    }
+  }
+
+  ThreadTree thread_tree_;
+  const ThreadEntry* thread_;
+  std::vector<uint64_t> ips_;
+};
+
+}  // namespace
+
+static void BM_ThreadTree_FindMap(benchmark::State& state) {
+  ThreadTreeFixture fixture(state.range(0));
+  for (auto _ : state) {
+    for (uint64_t ip : fixture.ips_) {
+      benchmark::DoNotOptimize(fixture.thread_tree_.FindMap(fixture.thread_, ip, false));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * fixture.ips_.size());
+}
+BENCHMARK(BM_ThreadTree_FindMap)->ArgName("maps")->RangeMultiplier(4)->Range(16, 4096);
+
+static void BM_ThreadTree_FindSymbol(benchmark::State& state) {
+  ThreadTreeFixture fixture(state.range(0));
+  std::vector<const MapEntry*> maps;
+  for (uint64_t ip : fixture.ips_) {
+    maps.push_back(fixture.thread_tree_.FindMap(fixture.thread_, ip, false));
+  }
+  for (auto _ : state) {
+    uint64_t vaddr_in_file;
+    for (size_t i = 0; i < maps.size(); i++) {
+      benchmark::DoNotOptimize(
+          fixture.thread_tree_.FindSymbol(maps[i], fixture.ips_[i], &vaddr_in_file));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * maps.size());
+}
+BENCHMARK(BM_ThreadTree_FindSymbol)->ArgName("maps")->RangeMultiplier(4)->Range(16, 4096);
+
+// Simulate a system wide recording with process churn: each process is forked, renamed, maps
+// libraries and exits. Peak RSS is reported, so run it alone with --benchmark_filter to compare
+// with and without map reclamation.
+static void BM_ThreadTree_ProcessChurn(benchmark::State& state) {
+  constexpr size_t kMapsPerProcess = 64;
+  size_t process_count = state.range(0);
+  bool reclaim_maps = state.range(1) != 0;
+  std::vector<std::string> lib_paths;
+  for (size_t i = 0; i < kMapsPerProcess; i++) {
+    lib_paths.push_back(android::base::StringPrintf("/system/lib64/lib%zu.so", i));
+  }
+  for (auto _ : state) {
+    ThreadTree thread_tree;
+    thread_tree.SetThreadName(kPid, kPid, "init");
+    if (reclaim_maps) {
+      thread_tree.EnableMapReclamation();
+    }
+    for (size_t i = 0; i < process_count; i++) {
+      int pid = kPid + 1 + i;
+      thread_tree.ForkThread(pid, pid, kPid, kPid);
+      thread_tree.SetThreadName(pid, pid, android::base::StringPrintf("app_process%zu", i % 16));
+      for (size_t j = 0; j < kMapsPerProcess; j++) {
+        thread_tree.AddThreadMap(pid, pid, kMapStart + j * kMapSize, kMapSize, 0, lib_paths[j]);
+      }
+      thread_tree.ExitThread(pid, pid);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * process_count);
+  rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0) {
+    state.counters["peak_rss_kb"] = usage.ru_maxrss;
+  }
+}
+BENCHMARK(BM_ThreadTree_ProcessChurn)
+    ->ArgNames({"processes", "reclaim"})
+    ->Args({100000, 0})
+    ->Args({100000, 1})
+    ->Unit(benchmark::kMillisecond);
@@ -150,3 +150,32 @@ TEST_F(ThreadTreeTest, invalid_fork) {
   // pid != tid && pid != ppid
   ASSERT_FALSE(thread_tree_.ForkThread(1, 2, 3, 1));
 }
+
+TEST_F(ThreadTreeTest, intern_thread_names) {
+  thread_tree_.SetThreadName(1, 1, "name");
+  thread_tree_.SetThreadName(2, 2, "name");
+  ThreadEntry* thread1 = thread_tree_.FindThread(1);
+  ThreadEntry* thread2 = thread_tree_.FindThread(2);
+  ASSERT_STREQ(thread1->comm, "name");
+  ASSERT_EQ(thread1->comm, thread2->comm);
+}
+
+TEST_F(ThreadTreeTest, reclaim_maps_of_exited_processes) {
+  thread_tree_.EnableMapReclamation();
+  thread_tree_.AddThreadMap(1, 1, 0x1000, 0x1000, 0, "lib1");
+  // Maps copied to a forked process are still used after the parent process exits.
+  thread_tree_.ForkThread(2, 2, 1, 1);
+  const MapEntry* map = thread_tree_.FindMap(thread_tree_.FindThread(2), 0x1000, false);
+  ASSERT_TRUE(map != nullptr);
+  thread_tree_.ExitThread(1, 1);
+  thread_tree_.AddThreadMap(3, 3, 0x2000, 0x1000, 0, "lib3");
+  ASSERT_EQ(map->dso->Path(), "lib1");
+  ASSERT_EQ(map->start_addr, 0x1000u);
+
+  // Maps no longer used are reused.
+  thread_tree_.ExitThread(2, 2);
+  thread_tree_.AddThreadMap(4, 4, 0x3000, 0x1000, 0, "lib4");
+  const MapEntry* new_map = thread_tree_.FindMap(thread_tree_.FindThread(4), 0x3000, false);
+  ASSERT_EQ(new_map, map);
+  ASSERT_EQ(new_map->dso->Path(), "lib4");
+}
@@ -333,6 +333,24 @@ static TracingField ParseTracingField(const std::string& s) {
   return field;
 }
 
+TracingFieldAccessor::TracingFieldAccessor(const TracingField& field) {
+  place.offset = field.offset;
+  place.size = field.elem_size * field.elem_count;
+  string_place.offset = field.offset;
+  string_place.size = place.size;
+  string_place.is_dynamic = field.is_dynamic;
+  if (field.is_dynamic || (field.elem_size == 1 && field.elem_count > 1)) {
+    // Like in report scripts, char arrays are read as strings regardless of is_signed, which is
+    // different on x86 and arm.
+    type = STRING;
+  } else if (field.elem_count == 1 && (field.elem_size == 1 || field.elem_size == 2 ||
+                                       field.elem_size == 4 || field.elem_size == 8)) {
+    type = field.is_signed ? INT : UINT;
+  } else {
+    type = BYTES;
+  }
+}
+
 TracingFormat ParseTracingFormat(const std::string& data) {
   TracingFormat format;
   std::vector<std::string> strs = Split(data, "\n");
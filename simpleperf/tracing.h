@@ -17,8 +17,13 @@
 #ifndef SIMPLE_PERF_TRACING_H_
 #define SIMPLE_PERF_TRACING_H_
 
+#include <string.h>
+
+#include <algorithm>
 #include <optional>
 #include <set>
+#include <string>
+#include <string_view>
 #include <vector>
 
 #include <android-base/logging.h>
@@ -55,13 +60,38 @@ struct TracingFieldPlace {
 struct StringTracingFieldPlace {
   uint32_t offset;
   uint32_t size;
+  // A dynamic (__data_loc) field stores the offset and size of the string instead of the string.
+  bool is_dynamic = false;
 
   std::string ReadFromData(const char* raw_data) {
+    if (is_dynamic) {
+      return std::string(ReadFromData(raw_data, SIZE_MAX));
+    }
     char s[size + 1];
     s[size] = '\0';
     memcpy(s, raw_data + offset, size);
     return s;
   }
+
+  // Return the string without copying it, or an empty string if it is out of raw_data.
+  std::string_view ReadFromData(const char* raw_data, size_t raw_data_size) const {
+    uint32_t str_offset = offset;
+    uint32_t str_size = size;
+    if (is_dynamic) {
+      if (offset + 4 > raw_data_size) {
+        return {};
+      }
+      uint32_t data_loc = ConvertBytesToValue(raw_data + offset, 4);
+      str_offset = data_loc & 0xffff;
+      str_size = data_loc >> 16;
+    }
+    if (str_offset > raw_data_size) {
+      return {};
+    }
+    str_size = std::min<size_t>(str_size, raw_data_size - str_offset);
+    const char* s = raw_data + str_offset;
+    return std::string_view(s, strnlen(s, str_size));
+  }
 };
 
 struct TracingFormat {
@@ -79,7 +109,17 @@ struct TracingFormat {
   void GetField(const std::string& name, StringTracingFieldPlace& place) {
     const TracingField& field = GetField(name);
     place.offset = field.offset;
-    place.size = field.elem_count;
+    place.size = field.is_dynamic ? field.elem_size : field.elem_count;
+    place.is_dynamic = field.is_dynamic;
+  }
+
+  const TracingField* FindField(const std::string& name) const {
+    for (const auto& field : fields) {
+      if (field.name == name) {
+        return &field;
+      }
+    }
+    return nullptr;
   }
 
  private:
@@ -94,6 +134,46 @@ struct TracingFormat {
   }
 };
 
+// Read a field from tracing data of many samples, with the place and value type of the field
+// resolved once from its TracingField.
+struct TracingFieldAccessor {
+  enum ValueType : uint32_t {
+    INT,     // A signed integer of 1, 2, 4 or 8 bytes.
+    UINT,    // An unsigned integer of 1, 2, 4 or 8 bytes.
+    STRING,  // A char array or a dynamic string.
+    BYTES,   // Other fields, like arrays of integers.
+  };
+
+  ValueType type;
+  // For INT, UINT and BYTES fields.
+  TracingFieldPlace place;
+  // For STRING fields.
+  StringTracingFieldPlace string_place;
+
+  explicit TracingFieldAccessor(const TracingField& field);
+
+  // For INT and UINT fields. Signed values are sign extended. The field should be in raw_data.
+  uint64_t ReadValue(const char* raw_data) const {
+    uint64_t value = ConvertBytesToValue(raw_data + place.offset, place.size);
+    if (type == INT && place.size < 8) {
+      uint32_t shift = 64 - place.size * 8;
+      value = static_cast<uint64_t>(static_cast<int64_t>(value << shift) >> shift);
+    }
+    return value;
+  }
+
+  // For STRING and BYTES fields. Return an empty value if the field is out of raw_data.
+  std::string_view ReadBytes(const char* raw_data, size_t raw_data_size) const {
+    if (type == STRING) {
+      return string_place.ReadFromData(raw_data, raw_data_size);
+    }
+    if (place.offset + place.size > raw_data_size) {
+      return {};
+    }
+    return std::string_view(raw_data + place.offset, place.size);
+  }
+};
+
 class TracingFile;
 
 class Tracing {
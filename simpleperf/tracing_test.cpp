@@ -100,3 +100,42 @@ TEST(tracing, ParseTracingFormat) {
                                             .is_signed = true,
                                             .is_dynamic = true}));
 }
+
+TEST(tracing, TracingFieldAccessor) {
+  std::vector<char> data(40, '\0');
+  data[4] = '\xfe';
+  data[5] = '\xff';
+  data[6] = '\xff';
+  data[7] = '\xff';
+  memcpy(&data[8], "comm", 4);
+  // The dynamic field "name" points to a string of size 8 at offset 28.
+  data[24] = 28;
+  data[26] = 8;
+  memcpy(&data[28], "dynamic", 8);
+
+  TracingFieldAccessor pid(TracingField({.name = "pid", .offset = 4, .elem_size = 4}));
+  ASSERT_EQ(pid.type, TracingFieldAccessor::UINT);
+  ASSERT_EQ(pid.ReadValue(data.data()), 0xfffffffe);
+  TracingFieldAccessor signed_pid(
+      TracingField({.name = "pid", .offset = 4, .elem_size = 4, .is_signed = true}));
+  ASSERT_EQ(signed_pid.type, TracingFieldAccessor::INT);
+  ASSERT_EQ(static_cast<int64_t>(signed_pid.ReadValue(data.data())), -2);
+
+  TracingFieldAccessor comm(
+      TracingField({.name = "comm", .offset = 8, .elem_size = 1, .elem_count = 16}));
+  ASSERT_EQ(comm.type, TracingFieldAccessor::STRING);
+  ASSERT_EQ(comm.ReadBytes(data.data(), data.size()), "comm");
+
+  TracingFieldAccessor name(
+      TracingField({.name = "name", .offset = 24, .elem_size = 4, .is_dynamic = true}));
+  ASSERT_EQ(name.type, TracingFieldAccessor::STRING);
+  ASSERT_EQ(name.ReadBytes(data.data(), data.size()), "dynamic");
+  // Strings out of the tracing data are not read.
+  ASSERT_EQ(name.ReadBytes(data.data(), 30), "dy");
+  ASSERT_EQ(name.ReadBytes(data.data(), 20), "");
+
+  TracingFieldAccessor array(
+      TracingField({.name = "array", .offset = 8, .elem_size = 4, .elem_count = 2}));
+  ASSERT_EQ(array.type, TracingFieldAccessor::BYTES);
+  ASSERT_EQ(array.ReadBytes(data.data(), data.size()).size(), 8);
+}
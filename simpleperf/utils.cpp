@@ -22,12 +22,15 @@
 #include <inttypes.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <string.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
 #include <algorithm>
+#include <atomic>
 #include <map>
 #include <string>
+#include <thread>
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
@@ -236,6 +239,14 @@ uint64_t GetFileSize(const std::string& filename) {
   return 0;
 }
 
+bool RenameFile(const std::string& from, const std::string& to) {
+#if defined(_WIN32)
+  // rename() doesn't replace an existing file on Windows.
+  unlink(to.c_str());
+#endif
+  return rename(from.c_str(), to.c_str()) == 0;
+}
+
 bool MkdirWithParents(const std::string& path) {
   size_t prev_end = 0;
   while (prev_end < path.size()) {
@@ -498,4 +509,61 @@ void OverflowSafeAdd(uint64_t& dest, uint64_t add) {
   }
 }
 
+void RunInParallel(size_t task_count, size_t max_threads, const std::function<void(size_t)>& task) {
+  size_t thread_count = std::min(task_count, max_threads);
+  if (thread_count <= 1) {
+    for (size_t i = 0; i < task_count; i++) {
+      task(i);
+    }
+    return;
+  }
+  std::atomic<size_t> next_task(0);
+  auto worker = [&]() {
+    for (size_t i = next_task++; i < task_count; i = next_task++) {
+      task(i);
+    }
+  };
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < thread_count; i++) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+void* BumpArena::Allocate(size_t size, size_t alignment) {
+  uintptr_t start = Align(reinterpret_cast<uintptr_t>(cur_), alignment);
+  if (cur_ == nullptr || start + size > reinterpret_cast<uintptr_t>(end_)) {
+    // Large objects get their own blocks, without wasting the rest of the current block.
+    size_t block_size = std::max(block_size_, size + alignment);
+    blocks_.emplace_back(new char[block_size]);
+    allocated_bytes_ += block_size;
+    char* block = blocks_.back().get();
+    start = Align(reinterpret_cast<uintptr_t>(block), alignment);
+    if (block_size == block_size_) {
+      cur_ = block;
+      end_ = block + block_size;
+    } else {
+      return reinterpret_cast<void*>(start);
+    }
+  }
+  cur_ = reinterpret_cast<char*>(start + size);
+  return reinterpret_cast<void*>(start);
+}
+
+const char* BumpArena::CopyString(std::string_view s) {
+  char* p = static_cast<char*>(Allocate(s.size() + 1, 1));
+  memcpy(p, s.data(), s.size());
+  p[s.size()] = '\0';
+  return p;
+}
+
+void BumpArena::Clear() {
+  blocks_.clear();
+  cur_ = end_ = nullptr;
+  allocated_bytes_ = 0;
+}
+
 }  // namespace simpleperf
@@ -23,9 +23,14 @@
 
 #include <fstream>
 #include <functional>
+#include <memory>
+#include <new>
 #include <optional>
 #include <set>
 #include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 #include <android-base/logging.h>
@@ -237,6 +242,8 @@ std::vector<std::string> GetSubDirs(const std::string& dirpath);
 bool IsDir(const std::string& dirpath);
 bool IsRegularFile(const std::string& filename);
 uint64_t GetFileSize(const std::string& filename);
+// Rename [from] to [to], replacing [to] if it exists.
+bool RenameFile(const std::string& from, const std::string& to);
 bool MkdirWithParents(const std::string& path);
 
 bool XzDecompress(const std::string& compressed_data, std::string* decompressed_data);
@@ -290,6 +297,42 @@ struct OverflowResult {
 OverflowResult SafeAdd(uint64_t a, uint64_t b);
 void OverflowSafeAdd(uint64_t& dest, uint64_t add);
 
+// Call task(0), ..., task(task_count - 1) using at most max_threads threads, including the calling
+// thread. Tasks are started in index order, but may finish in any order.
+void RunInParallel(size_t task_count, size_t max_threads, const std::function<void(size_t)>& task);
+
+// Allocate memory from large blocks, which are only freed when the arena is cleared or destroyed.
+// It avoids per-allocation overhead and heap fragmentation for many small objects sharing a
+// lifetime. Objects allocated by New() never have their destructors called.
+class BumpArena {
+ public:
+  explicit BumpArena(size_t block_size = 64 * kKilobyte) : block_size_(block_size) {}
+
+  void* Allocate(size_t size, size_t alignment);
+
+  template <typename T, typename... Args>
+  T* New(Args&&... args) {
+    static_assert(std::is_trivially_destructible_v<T>);
+    return new (Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+  }
+
+  // Return a null-terminated copy of the string.
+  const char* CopyString(std::string_view s);
+
+  void Clear();
+  // Return bytes allocated from the heap.
+  size_t AllocatedBytes() const { return allocated_bytes_; }
+
+ private:
+  const size_t block_size_;
+  std::vector<std::unique_ptr<char[]>> blocks_;
+  char* cur_ = nullptr;
+  char* end_ = nullptr;
+  size_t allocated_bytes_ = 0;
+
+  DISALLOW_COPY_AND_ASSIGN(BumpArena);
+};
+
 }  // namespace simpleperf
 
 #endif  // SIMPLE_PERF_UTILS_H_
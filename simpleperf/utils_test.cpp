@@ -105,3 +105,30 @@ TEST(utils, LineReader) {
   ASSERT_EQ(*line, "line2");
   ASSERT_TRUE(reader.ReadLine() == nullptr);
 }
+
+TEST(utils, RunInParallel) {
+  for (size_t max_threads : {1, 4}) {
+    std::vector<int> called(100, 0);
+    RunInParallel(called.size(), max_threads, [&](size_t i) { called[i]++; });
+    ASSERT_EQ(called, std::vector<int>(100, 1));
+  }
+  RunInParallel(0, 4, [](size_t) { FAIL(); });
+}
+
+TEST(utils, BumpArena) {
+  BumpArena arena(64);
+  const char* s = arena.CopyString("hello");
+  ASSERT_STREQ(s, "hello");
+  for (int i = 0; i < 100; i++) {
+    uint64_t* p = arena.New<uint64_t>(i);
+    ASSERT_EQ(reinterpret_cast<uintptr_t>(p) % alignof(uint64_t), 0u);
+    ASSERT_EQ(*p, static_cast<uint64_t>(i));
+  }
+  // Large objects are allocated in separate blocks.
+  void* p = arena.Allocate(1024, 16);
+  ASSERT_EQ(reinterpret_cast<uintptr_t>(p) % 16, 0u);
+  ASSERT_STREQ(s, "hello");
+  ASSERT_GE(arena.AllocatedBytes(), 1024u + 100 * sizeof(uint64_t));
+  arena.Clear();
+  ASSERT_EQ(arena.AllocatedBytes(), 0u);
+}
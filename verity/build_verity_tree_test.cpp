@@ -48,6 +48,7 @@ class BuildVerityTreeTest : public ::testing::Test {
   const std::vector<std::vector<unsigned char>>& verity_tree() const {
     return builder->verity_tree_;
   }
+  void set_chunk_size(size_t chunk_size) { builder->chunk_size_ = chunk_size; }
 
   void GenerateHashTree(const std::vector<unsigned char>& data,
                         const std::vector<unsigned char>& salt) {
@@ -205,3 +206,53 @@ TEST_F(BuildVerityTreeTest, SHA1MultipleBlocks) {
   ASSERT_EQ("7ea287e6167929988810077abaafbc313b2b8593000000000000000000000000",
             HashTreeBuilder::BytesArrayToString(builder->root_hash()));
 }
+
+TEST_F(BuildVerityTreeTest, MultipleThreads) {
+  // Enough blocks for several chunks per worker thread.
+  std::vector<unsigned char> data(1027 * 4096);
+  for (size_t i = 0; i < data.size(); i++) {
+    data[i] = i * 7 / 4096;
+  }
+  // Zero ranges are passed as nullptr, as with don't care chunks in sparse
+  // images. The range doesn't start on a block boundary.
+  size_t zero_offset = 100 * 4096 + 100;
+  size_t zero_length = 50 * 4096;
+  std::fill_n(data.begin() + zero_offset, zero_length, 0);
+
+  auto stream = [&](HashTreeBuilder* hasher) {
+    ASSERT_TRUE(hasher->Initialize(data.size(), salt_hex));
+    srand(1);
+    auto update = [&](size_t offset, size_t end) {
+      while (offset < end) {
+        size_t data_length =
+            std::min<size_t>(rand() % (1024 * 1024), end - offset);
+        ASSERT_TRUE(hasher->Update(data.data() + offset, data_length));
+        offset += data_length;
+      }
+    };
+    update(0, zero_offset);
+    ASSERT_TRUE(hasher->Update(nullptr, zero_length));
+    update(zero_offset + zero_length, data.size());
+    ASSERT_TRUE(hasher->BuildHashTree());
+  };
+
+  stream(builder.get());
+  std::vector<std::vector<unsigned char>> expected_tree = verity_tree();
+  std::vector<unsigned char> expected_root_hash = builder->root_hash();
+
+  // With 4 block chunks, the upper levels are split between the threads too.
+  constexpr size_t kSmallChunkSize = 4 * 4096;
+  ASSERT_GT(expected_tree[0].size(), kSmallChunkSize);
+  for (size_t chunk_size : {kSmallChunkSize, size_t{1024 * 1024}}) {
+    for (size_t threads : {2, 4, 16}) {
+      builder.reset(new HashTreeBuilder(4096, EVP_sha256()));
+      builder->set_threads(threads);
+      set_chunk_size(chunk_size);
+      stream(builder.get());
+      ASSERT_EQ(expected_tree, verity_tree())
+          << threads << " threads, chunk size " << chunk_size;
+      ASSERT_EQ(expected_root_hash, builder->root_hash())
+          << threads << " threads, chunk size " << chunk_size;
+    }
+  }
+}
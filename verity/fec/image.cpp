@@ -398,8 +398,9 @@ bool image_process(image_proc_func func, image *ctx)
         args[i].end = (current + rs_blocks_per_thread) * ctx->rs_n;
 
         args[i].rs = init_rs_char(FEC_PARAMS(ctx->roots));
+        args[i].codec = fec_rs_init(ctx->roots);
 
-        if (!args[i].rs) {
+        if (!args[i].rs || !args[i].codec) {
             FATAL("failed to initialize encoder for thread %d\n", i);
         }
 
@@ -438,6 +439,9 @@ bool image_process(image_proc_func func, image *ctx)
             free_rs_char(args[i].rs);
             args[i].rs = nullptr;
         }
+
+        fec_rs_free(args[i].codec);
+        args[i].codec = nullptr;
     }
 
     return true;
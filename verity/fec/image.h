@@ -75,6 +75,7 @@ struct image_proc_ctx {
     uint64_t start;
     uint64_t end;
     void *rs;
+    fec_rs *codec;
 };
 
 extern bool image_load(const std::vector<std::string>& filename, image *ctx);
@@ -28,6 +28,9 @@ extern "C" {
 #include <stdlib.h>
 #include <string.h>
 
+#include <algorithm>
+#include <vector>
+
 #include <android-base/file.h>
 #include "image.h"
 
@@ -39,20 +42,47 @@ enum {
     MODE_GETVERITYSTART
 };
 
+/* returns the number of codewords starting from `c' that can be processed
+   at once: byte j of codeword c is at j * rounds * FEC_BLOCKSIZE + c, so
+   each byte of the codewords is in a single block as long as they don't
+   cross a block boundary */
+static uint64_t get_codewords(struct image_proc_ctx *ctx, uint64_t c)
+{
+    uint64_t end = ctx->end / ctx->ctx->rs_n;
+
+    return std::min(end, (c / FEC_BLOCKSIZE + 1) * FEC_BLOCKSIZE) - c;
+}
+
+/* sets `rows' to point to the bytes of the codewords starting from `c' */
+static void get_rows(struct image *fcx, uint64_t c, const uint8_t **rows)
+{
+    static const uint8_t zeros[FEC_BLOCKSIZE] = {0};
+
+    for (int j = 0; j < fcx->rs_n; ++j) {
+        uint64_t offset = j * fcx->rounds * FEC_BLOCKSIZE + c;
+
+        /* the input size is a multiple of FEC_BLOCKSIZE, so either all or
+           none of the bytes in the row are past the end of input */
+        if (unlikely(offset >= fcx->inp_size)) {
+            rows[j] = zeros;
+        } else {
+            rows[j] = &fcx->input[offset];
+        }
+    }
+}
+
 static void encode_rs(struct image_proc_ctx *ctx)
 {
     struct image *fcx = ctx->ctx;
-    int j;
-    uint8_t data[fcx->rs_n];
-    uint64_t i;
+    const uint8_t *rows[FEC_RSM];
+    uint64_t c, count;
 
-    for (i = ctx->start; i < ctx->end; i += fcx->rs_n) {
-        for (j = 0; j < fcx->rs_n; ++j) {
-            data[j] = image_get_interleaved_byte(i + j, fcx);
-        }
+    for (c = ctx->start / fcx->rs_n; c < ctx->end / fcx->rs_n; c += count) {
+        count = get_codewords(ctx, c);
+        get_rows(fcx, c, rows);
 
-        encode_rs_char(ctx->rs, data, &fcx->fec[ctx->fec_pos]);
-        ctx->fec_pos += fcx->roots;
+        fec_rs_encode(ctx->codec, rows, count, &fcx->fec[ctx->fec_pos]);
+        ctx->fec_pos += count * fcx->roots;
     }
 }
 
@@ -61,31 +91,60 @@ static void decode_rs(struct image_proc_ctx *ctx)
     struct image *fcx = ctx->ctx;
     int j, rv;
     uint8_t data[fcx->rs_n + fcx->roots];
-    uint64_t i;
+    const uint8_t *rows[FEC_RSM];
+    std::vector<uint8_t> parity(fcx->roots * FEC_BLOCKSIZE);
+    uint8_t errors[FEC_BLOCKSIZE];
+    uint64_t c, count;
 
     assert(sizeof(data) == FEC_RSM);
 
-    for (i = ctx->start; i < ctx->end; i += fcx->rs_n) {
-        for (j = 0; j < fcx->rs_n; ++j) {
-            data[j] = image_get_interleaved_byte(i + j, fcx);
+    for (j = 0; j < fcx->roots; ++j) {
+        rows[fcx->rs_n + j] = &parity[j * FEC_BLOCKSIZE];
+    }
+
+    for (c = ctx->start / fcx->rs_n; c < ctx->end / fcx->rs_n; c += count) {
+        count = get_codewords(ctx, c);
+        get_rows(fcx, c, rows);
+
+        for (uint64_t k = 0; k < count; ++k) {
+            for (j = 0; j < fcx->roots; ++j) {
+                parity[j * FEC_BLOCKSIZE + k] =
+                    fcx->fec[ctx->fec_pos + k * fcx->roots + j];
+            }
+        }
+
+        /* only decode the codewords that have errors */
+        if (!fec_rs_check(ctx->codec, rows, count, errors)) {
+            ctx->fec_pos += count * fcx->roots;
+            continue;
         }
 
-        memcpy(&data[fcx->rs_n], &fcx->fec[ctx->fec_pos], fcx->roots);
-        rv = decode_rs_char(ctx->rs, data, nullptr, 0);
+        for (uint64_t k = 0; k < count; ++k, ctx->fec_pos += fcx->roots) {
+            if (!errors[k]) {
+                continue;
+            }
+
+            uint64_t i = (c + k) * fcx->rs_n;
 
-        if (rv < 0) {
-            FATAL("failed to recover [%" PRIu64 ", %" PRIu64 ")\n",
-                i, i + fcx->rs_n);
-        } else if (rv > 0) {
-            /* copy corrected data to output */
             for (j = 0; j < fcx->rs_n; ++j) {
-                image_set_interleaved_byte(i + j, fcx, data[j]);
+                data[j] = image_get_interleaved_byte(i + j, fcx);
             }
 
-            ctx->rv += rv;
-        }
+            memcpy(&data[fcx->rs_n], &fcx->fec[ctx->fec_pos], fcx->roots);
+            rv = decode_rs_char(ctx->rs, data, nullptr, 0);
 
-        ctx->fec_pos += fcx->roots;
+            if (rv < 0) {
+                FATAL("failed to recover [%" PRIu64 ", %" PRIu64 ")\n",
+                    i, i + fcx->rs_n);
+            } else if (rv > 0) {
+                /* copy corrected data to output */
+                for (j = 0; j < fcx->rs_n; ++j) {
+                    image_set_interleaved_byte(i + j, fcx, data[j]);
+                }
+
+                ctx->rv += rv;
+            }
+        }
     }
 }
 
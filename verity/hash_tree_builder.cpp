@@ -17,8 +17,12 @@
 #include "verity/hash_tree_builder.h"
 
 #include <algorithm>
+#include <condition_variable>
+#include <deque>
 #include <functional>
 #include <memory>
+#include <mutex>
+#include <thread>
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
@@ -29,6 +33,140 @@
 
 #include "build_verity_tree_utils.h"
 
+// The default number of bytes hashed by a worker thread at a time.
+static constexpr size_t kChunkSize = 1024 * 1024;
+// The number of chunks queued for each worker thread before Update() blocks,
+// which bounds the memory used for copies of the input.
+static constexpr size_t kChunksPerThread = 4;
+
+// Threads hashing chunks of blocks from a bounded queue. Each thread copies
+// the builder's salted context for every block, so no state is shared
+// between the threads except the queue.
+class HashTreeBuilder::Workers {
+ public:
+  Workers(const HashTreeBuilder* builder, size_t threads);
+  ~Workers();
+
+  // Queues |len| bytes of blocks at |data| to be hashed to |out|. If |copy| is
+  // true, the data is copied and the caller can reuse it once this returns.
+  // Blocks while the queue is full.
+  void Add(const unsigned char* data, size_t len, unsigned char* out,
+           bool copy);
+  // Waits until all the queued blocks are hashed. Returns false if hashing
+  // any of them failed.
+  bool Finish();
+
+ private:
+  struct Chunk {
+    const unsigned char* data;
+    size_t len;
+    unsigned char* out;
+    std::vector<unsigned char> buffer;
+  };
+
+  void Run();
+
+  const HashTreeBuilder* builder_;
+  size_t max_pending_;
+  std::mutex mutex_;
+  // Signaled when a chunk is queued, or when the threads should exit.
+  std::condition_variable queued_;
+  // Signaled when a chunk has been hashed.
+  std::condition_variable done_;
+  std::deque<Chunk> queue_;
+  // Buffers of hashed chunks, reused for the next copies.
+  std::vector<std::vector<unsigned char>> buffers_;
+  // The number of chunks queued or being hashed.
+  size_t pending_ = 0;
+  bool failed_ = false;
+  bool exit_ = false;
+  std::vector<std::thread> threads_;
+};
+
+HashTreeBuilder::Workers::Workers(const HashTreeBuilder* builder,
+                                  size_t threads)
+    : builder_(builder), max_pending_(threads * kChunksPerThread) {
+  for (size_t i = 0; i < threads; i++) {
+    threads_.emplace_back(&Workers::Run, this);
+  }
+}
+
+HashTreeBuilder::Workers::~Workers() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    exit_ = true;
+  }
+  queued_.notify_all();
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+}
+
+void HashTreeBuilder::Workers::Add(const unsigned char* data, size_t len,
+                                   unsigned char* out, bool copy) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_.wait(lock, [this] { return pending_ < max_pending_; });
+  pending_++;
+
+  Chunk chunk = {data, len, out, {}};
+  if (copy) {
+    if (!buffers_.empty()) {
+      chunk.buffer = std::move(buffers_.back());
+      buffers_.pop_back();
+    }
+    // Copy without holding the lock, this is where the input is actually read
+    // when it's mapped from a file.
+    lock.unlock();
+    chunk.buffer.assign(data, data + len);
+    chunk.data = chunk.buffer.data();
+    lock.lock();
+  }
+
+  queue_.push_back(std::move(chunk));
+  queued_.notify_one();
+}
+
+bool HashTreeBuilder::Workers::Finish() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_.wait(lock, [this] { return pending_ == 0; });
+
+  bool success = !failed_;
+  failed_ = false;
+  return success;
+}
+
+void HashTreeBuilder::Workers::Run() {
+  MdCtxPtr ctx(EVP_MD_CTX_new(), EVP_MD_CTX_free);
+  CHECK(ctx != nullptr);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    queued_.wait(lock, [this] { return exit_ || !queue_.empty(); });
+    if (exit_) {
+      return;
+    }
+
+    Chunk chunk = std::move(queue_.front());
+    queue_.pop_front();
+    lock.unlock();
+
+    bool success = true;
+    for (size_t i = 0; i < chunk.len; i += builder_->block_size_) {
+      success &= builder_->HashBlock(
+          ctx.get(), chunk.data + i,
+          chunk.out + i / builder_->block_size_ * builder_->hash_size_);
+    }
+
+    lock.lock();
+    failed_ |= !success;
+    if (!chunk.buffer.empty()) {
+      buffers_.emplace_back(std::move(chunk.buffer));
+    }
+    pending_--;
+    done_.notify_all();
+  }
+}
+
 const EVP_MD* HashTreeBuilder::HashFunction(const std::string& hash_name) {
   if (android::base::EqualsIgnoreCase(hash_name, "sha1")) {
     return EVP_sha1();
@@ -51,8 +189,15 @@ const EVP_MD* HashTreeBuilder::HashFunction(const std::string& hash_name) {
 }
 
 HashTreeBuilder::HashTreeBuilder(size_t block_size, const EVP_MD* md)
-    : block_size_(block_size), data_size_(0), md_(md) {
+    : block_size_(block_size),
+      data_size_(0),
+      md_(md),
+      threads_(1),
+      chunk_size_(kChunkSize),
+      salted_ctx_(nullptr, EVP_MD_CTX_free),
+      ctx_(EVP_MD_CTX_new(), EVP_MD_CTX_free) {
   CHECK(md_ != nullptr) << "Failed to initialize md";
+  CHECK(ctx_ != nullptr);
 
   hash_size_raw_ = EVP_MD_size(md_);
 
@@ -64,6 +209,11 @@ HashTreeBuilder::HashTreeBuilder(size_t block_size, const EVP_MD* md)
   CHECK_LT(hash_size_ * 2, block_size_);
 }
 
+HashTreeBuilder::~HashTreeBuilder() {
+  // The workers may still be writing to |verity_tree_|.
+  workers_.reset();
+}
+
 std::string HashTreeBuilder::BytesArrayToString(
     const std::vector<unsigned char>& bytes) {
   std::string result;
@@ -129,26 +279,38 @@ bool HashTreeBuilder::Initialize(int64_t expected_data_size,
   base_level.reserve(base_level_blocks * block_size_);
   verity_tree_.emplace_back(std::move(base_level));
 
+  InitSaltedContext();
+
   // Save the hash of the zero block to avoid future recalculation.
   std::vector<unsigned char> zero_block(block_size_, 0);
   zero_block_hash_.resize(hash_size_);
   HashBlock(zero_block.data(), zero_block_hash_.data());
 
+  if (threads_ > 1) {
+    workers_ = std::make_unique<Workers>(this, threads_);
+  }
+
   return true;
 }
 
-bool HashTreeBuilder::HashBlock(const unsigned char* block,
-                                unsigned char* out) {
+void HashTreeBuilder::InitSaltedContext() {
+  salted_ctx_.reset(EVP_MD_CTX_new());
+  CHECK(salted_ctx_ != nullptr);
+
+  int ret = 1;
+  ret &= EVP_DigestInit_ex(salted_ctx_.get(), md_, nullptr);
+  ret &= EVP_DigestUpdate(salted_ctx_.get(), salt_.data(), salt_.size());
+  CHECK_EQ(1, ret);
+}
+
+bool HashTreeBuilder::HashBlock(EVP_MD_CTX* ctx, const unsigned char* block,
+                                unsigned char* out) const {
   unsigned int s;
   int ret = 1;
 
-  EVP_MD_CTX* mdctx = EVP_MD_CTX_create();
-  CHECK(mdctx != nullptr);
-  ret &= EVP_DigestInit_ex(mdctx, md_, nullptr);
-  ret &= EVP_DigestUpdate(mdctx, salt_.data(), salt_.size());
-  ret &= EVP_DigestUpdate(mdctx, block, block_size_);
-  ret &= EVP_DigestFinal_ex(mdctx, out, &s);
-  EVP_MD_CTX_destroy(mdctx);
+  ret &= EVP_MD_CTX_copy_ex(ctx, salted_ctx_.get());
+  ret &= EVP_DigestUpdate(ctx, block, block_size_);
+  ret &= EVP_DigestFinal_ex(ctx, out, &s);
 
   CHECK_EQ(1, ret);
   CHECK_EQ(hash_size_raw_, s);
@@ -157,6 +319,15 @@ bool HashTreeBuilder::HashBlock(const unsigned char* block,
   return true;
 }
 
+bool HashTreeBuilder::HashBlock(const unsigned char* block,
+                                unsigned char* out) {
+  // CalculateRootDigest() can be called without Initialize().
+  if (salted_ctx_ == nullptr) {
+    InitSaltedContext();
+  }
+  return HashBlock(ctx_.get(), block, out);
+}
+
 bool HashTreeBuilder::HashBlocks(const unsigned char* data, size_t len,
                                  std::vector<unsigned char>* output_vector) {
   if (len == 0) {
@@ -164,6 +335,14 @@ bool HashTreeBuilder::HashBlocks(const unsigned char* data, size_t len,
   }
   CHECK_EQ(0, len % block_size_);
 
+  size_t offset = output_vector->size();
+  size_t hashes_size = len / block_size_ * hash_size_;
+  // The workers may still be writing to |output_vector|, as they do to the
+  // base level while data is queued, so it must not be reallocated.
+  if (workers_ != nullptr) {
+    CHECK_LE(offset + hashes_size, output_vector->capacity());
+  }
+
   if (data == nullptr) {
     for (size_t i = 0; i < len; i += block_size_) {
       output_vector->insert(output_vector->end(), zero_block_hash_.begin(),
@@ -172,13 +351,45 @@ bool HashTreeBuilder::HashBlocks(const unsigned char* data, size_t len,
     return true;
   }
 
+  output_vector->resize(offset + hashes_size);
+  unsigned char* out = output_vector->data() + offset;
+
+  if (workers_ != nullptr && len > chunk_size_) {
+    for (size_t i = 0; i < len; i += chunk_size_) {
+      workers_->Add(data + i, std::min(chunk_size_, len - i),
+                    out + i / block_size_ * hash_size_, false);
+    }
+    return workers_->Finish();
+  }
+
   for (size_t i = 0; i < len; i += block_size_) {
-    unsigned char hash_buffer[hash_size_];
-    if (!HashBlock(data + i, hash_buffer)) {
+    if (!HashBlock(data + i, out + i / block_size_ * hash_size_)) {
       return false;
     }
-    output_vector->insert(output_vector->end(), hash_buffer,
-                          hash_buffer + hash_size_);
+  }
+
+  return true;
+}
+
+bool HashTreeBuilder::QueueBlocks(const unsigned char* data, size_t len) {
+  CHECK(workers_ != nullptr);
+  if (data == nullptr || len == 0) {
+    return HashBlocks(data, len, &verity_tree_[0]);
+  }
+  CHECK_EQ(0, len % block_size_);
+
+  // The workers write the hashes in place, so the base level must not be
+  // reallocated before BuildHashTree().
+  auto& base_level = verity_tree_[0];
+  size_t offset = base_level.size();
+  size_t hashes_size = len / block_size_ * hash_size_;
+  CHECK_LE(offset + hashes_size, base_level.capacity());
+  base_level.resize(offset + hashes_size);
+
+  for (size_t i = 0; i < len; i += chunk_size_) {
+    workers_->Add(data + i, std::min(chunk_size_, len - i),
+                  base_level.data() + offset + i / block_size_ * hash_size_,
+                  true);
   }
 
   return true;
@@ -215,6 +426,9 @@ bool HashTreeBuilder::Update(const unsigned char* data, size_t len) {
     }
     len -= len % block_size_;
   }
+  if (workers_ != nullptr) {
+    return QueueBlocks(data, len);
+  }
   return HashBlocks(data, len, &verity_tree_[0]);
 }
 
@@ -235,6 +449,12 @@ bool HashTreeBuilder::BuildHashTree() {
     return false;
   }
 
+  // Waits for the queued blocks of the base level.
+  if (workers_ != nullptr && !workers_->Finish()) {
+    LOG(ERROR) << "Failed to hash the base level";
+    return false;
+  }
+
   // Expects the base level to have the same size as the total hash size of
   // input data.
   AppendPaddings(&verity_tree_.back());
@@ -251,7 +471,10 @@ bool HashTreeBuilder::BuildHashTree() {
     std::vector<unsigned char> next_level;
     next_level.reserve(next_level_blocks * block_size_);
 
-    HashBlocks(current_level.data(), current_level.size(), &next_level);
+    if (!HashBlocks(current_level.data(), current_level.size(),
+                    &next_level)) {
+      return false;
+    }
     AppendPaddings(&next_level);
 
     // Checks the size of the next level.
@@ -259,6 +482,9 @@ bool HashTreeBuilder::BuildHashTree() {
     verity_tree_.emplace_back(std::move(next_level));
   }
 
+  // The tree is complete, there's no need to keep the threads around.
+  workers_.reset();
+
   CHECK_EQ(block_size_, verity_tree_.back().size());
   return CalculateRootDigest(verity_tree_.back(), &root_hash_);
 }
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <android-base/file.h>
+#include <benchmark/benchmark.h>
+#include <openssl/evp.h>
+
+#include "verity/build_verity_tree.h"
+#include "verity/hash_tree_builder.h"
+
+static constexpr size_t kBlockSize = 4096;
+static const std::vector<unsigned char> kSalt(32, 0xaa);
+
+// Fills |data| with data that differs in every block.
+static void FillData(unsigned char* data, size_t len, uint32_t* seed) {
+  for (size_t i = 0; i + sizeof(*seed) <= len; i += sizeof(*seed)) {
+    *seed = *seed * 1103515245 + 12345;
+    memcpy(data + i, seed, sizeof(*seed));
+  }
+}
+
+// Returns an image file of |size| bytes, created once per size and removed at
+// exit. Reads are mostly served from the page cache, unless the image is
+// larger than the available memory.
+static const char* GetImage(uint64_t size) {
+  static std::map<uint64_t, std::unique_ptr<TemporaryFile>> images;
+
+  auto& image = images[size];
+  if (image == nullptr) {
+    image = std::make_unique<TemporaryFile>();
+    std::vector<unsigned char> buffer(16 * 1024 * 1024);
+    uint32_t seed = 1;
+    for (uint64_t offset = 0; offset < size; offset += buffer.size()) {
+      FillData(buffer.data(), buffer.size(), &seed);
+      if (!android::base::WriteFully(image->fd, buffer.data(),
+                                     buffer.size())) {
+        abort();
+      }
+    }
+  }
+  return image->path;
+}
+
+// Builds the hash tree of data already in memory. Arguments are the data size
+// and the number of threads.
+static void BM_HashTreeBuilder(benchmark::State& state) {
+  std::vector<unsigned char> data(state.range(0));
+  uint32_t seed = 1;
+  FillData(data.data(), data.size(), &seed);
+
+  for (auto _ : state) {
+    HashTreeBuilder builder(kBlockSize, EVP_sha256());
+    builder.set_threads(state.range(1));
+    if (!builder.Initialize(data.size(), kSalt) ||
+        !builder.Update(data.data(), data.size()) || !builder.BuildHashTree()) {
+      state.SkipWithError("failed to build the hash tree");
+      return;
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_HashTreeBuilder)
+    ->ArgsProduct({{256 * 1024 * 1024}, {1, 2, 4, 8}})
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+// Runs build_verity_tree on an image file, so reading the image overlaps with
+// hashing when there's more than one thread. Arguments are the image size and
+// the number of threads.
+static void BM_generate_verity_tree(benchmark::State& state) {
+  uint64_t size = state.range(0);
+  const char* image = GetImage(size);
+  TemporaryFile tree;
+
+  for (auto _ : state) {
+    HashTreeBuilder builder(kBlockSize, EVP_sha256());
+    builder.set_threads(state.range(1));
+    if (!generate_verity_tree(image, tree.path, &builder, kSalt, kBlockSize,
+                              false, false)) {
+      state.SkipWithError("generate_verity_tree failed");
+      return;
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * size);
+}
+BENCHMARK(BM_generate_verity_tree)
+    ->ArgsProduct({{1LL << 30, 4LL << 30}, {1, 2, 4, 8}})
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -20,7 +20,9 @@
 #include <inttypes.h>
 #include <stddef.h>
 
+#include <algorithm>
 #include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -34,6 +36,7 @@
 class HashTreeBuilder {
  public:
   HashTreeBuilder(size_t block_size, const EVP_MD* md);
+  ~HashTreeBuilder();
   // Returns the size of the verity tree in bytes given the input data size.
   uint64_t CalculateSize(uint64_t input_size) const {
       return CalculateSize(input_size, block_size_, hash_size_);
@@ -58,6 +61,11 @@ class HashTreeBuilder {
   bool WriteHashTree(std::function<bool(const void*, size_t)> callback) const;
 
   size_t hash_size() const { return hash_size_; }
+  // Sets the number of threads used to hash the data, 1 by default. With more
+  // than one thread, Update() copies the data to a bounded queue and returns
+  // while the blocks are hashed, so reading the input overlaps with hashing.
+  // Must be called before Initialize().
+  void set_threads(size_t threads) { threads_ = std::max<size_t>(threads, 1); }
   const std::vector<unsigned char>& root_hash() const { return root_hash_; }
   // Converts |bytes| to string for hexdump.
   static std::string BytesArrayToString(
@@ -76,13 +84,23 @@ class HashTreeBuilder {
 
  private:
   friend class BuildVerityTreeTest;
-  // Calculates the hash of one single block. Write the result to |out|, a
-  // buffer allocated by the caller.
+  class Workers;
+  using MdCtxPtr = std::unique_ptr<EVP_MD_CTX, decltype(&EVP_MD_CTX_free)>;
+
+  // Creates |salted_ctx_| from |salt_|.
+  void InitSaltedContext();
+  // Calculates the hash of one single block using |ctx| as scratch space.
+  // Write the result to |out|, a buffer allocated by the caller.
+  bool HashBlock(EVP_MD_CTX* ctx, const unsigned char* block,
+                 unsigned char* out) const;
   bool HashBlock(const unsigned char* block, unsigned char* out);
   // Calculates the hash of |len| bytes of data starting from |data|. Append the
   // result to |output_vector|.
   bool HashBlocks(const unsigned char* data, size_t len,
                   std::vector<unsigned char>* output_vector);
+  // Like HashBlocks() for the base level, but only queues the data to the
+  // worker threads. The hashes are complete after |workers_| is finished.
+  bool QueueBlocks(const unsigned char* data, size_t len);
   // Aligns |data| with block_size by padding 0s to the end.
   void AppendPaddings(std::vector<unsigned char>* data);
 
@@ -96,6 +114,16 @@ class HashTreeBuilder {
   size_t hash_size_raw_;
   // Hash size rounded up to the next power of 2. (e.g. 20 -> 32)
   size_t hash_size_;
+  size_t threads_;
+  // The number of bytes hashed by a worker thread at a time.
+  size_t chunk_size_;
+
+  // A context that has already hashed the salt, copied for each block.
+  MdCtxPtr salted_ctx_;
+  // Scratch space for hashing on the calling thread.
+  MdCtxPtr ctx_;
+  // Threads hashing the data in parallel, if |threads_| > 1.
+  std::unique_ptr<Workers> workers_;
 
   // Pre-calculated hash of a zero block.
   std::vector<unsigned char> zero_block_hash_;